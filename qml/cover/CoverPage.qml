@@ -84,6 +84,7 @@ CoverBackground {
             refreshStats()
             loadCoverPhotos()
         }
+        onPhotosIngested: refreshStats()
     }
 
     Timer {
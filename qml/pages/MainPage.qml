@@ -269,6 +269,7 @@ Page {
     function openEvents() { pageStack.push(Qt.resolvedUrl("EventsPage.qml")) }
     function openIdentify() { pageStack.push(Qt.resolvedUrl("IdentifyFacesPage.qml")) }
     function openScan() { pageStack.push(Qt.resolvedUrl("ScanningPage.qml")) }
+    function resumeScan() { pageStack.push(Qt.resolvedUrl("ScanningPage.qml"), { resume: true }) }
 
     Component.onCompleted: {
         reloadViewMode()
@@ -292,6 +293,7 @@ Page {
     Connections {
         target: facePipeline
         onScanCompleted: refreshPeople()
+        onPhotosIngested: refreshPeople()
     }
 
     // Shared header for both layouts
@@ -430,6 +432,12 @@ Page {
                     enabled: facePipeline && facePipeline.initialized && !facePipeline.processing
                     onClicked: openScan()
                 }
+                MenuItem {
+                    text: qsTr("Resume Interrupted Scan")
+                    visible: facePipeline && facePipeline.canResumeScan
+                    enabled: !facePipeline.processing
+                    onClicked: resumeScan()
+                }
             }
 
             delegate: ListItem {
@@ -593,6 +601,12 @@ Page {
                     enabled: facePipeline && facePipeline.initialized && !facePipeline.processing
                     onClicked: openScan()
                 }
+                MenuItem {
+                    text: qsTr("Resume Interrupted Scan")
+                    visible: facePipeline && facePipeline.canResumeScan
+                    enabled: !facePipeline.processing
+                    onClicked: resumeScan()
+                }
             }
 
             delegate: ListItem {
@@ -77,6 +77,20 @@ Page {
         userRotation = facePipeline.photoRotation(currentPath)
         rotationTurns = Math.round(userRotation / 90)
         details = facePipeline.photoDetails(currentPath)
+
+        // Not scanned yet: the photo on screen jumps the queue
+        if (details.exists && !details.in_library) {
+            facePipeline.prioritizePhoto(currentPath)
+        }
+    }
+
+    Connections {
+        target: facePipeline
+        onPhotoReady: {
+            if (filePath === page.currentPath) {
+                page.loadCurrentPhoto()
+            }
+        }
     }
 
     Timer {
@@ -10,8 +10,14 @@ Page {
     property int totalPhotos: 0
     property int facesDetected: 0
     property bool scanning: true
+    // Continue the interrupted scan instead of starting a new one
+    property bool resume: false
 
     Component.onCompleted: {
+        if (resume && facePipeline.resumeScan()) {
+            return
+        }
+
         // Start scanning every whitelisted folder (defaults to Pictures)
         var raw = facePipeline.getSetting("scan_folders", "")
         var folders = raw.length > 0
@@ -141,7 +147,8 @@ Page {
 
                         Label {
                             anchors.horizontalCenter: parent.horizontalCenter
-                            text: totalPhotos > 0 ? "/ " + totalPhotos : "..."
+                            // Still counting while the walk runs
+                            text: totalPhotos > 0 ? "/ " + (facePipeline.walking ? "~" : "") + totalPhotos : "..."
                             font.pixelSize: Theme.fontSizeLarge
                             color: Theme.secondaryColor
                         }
@@ -171,6 +178,19 @@ Page {
                 color: Theme.secondaryColor
             }
 
+            // Time left, from the pace of the last few dozen photos
+            Label {
+                readonly property int eta: facePipeline.scanStats.eta_seconds !== undefined
+                                           ? facePipeline.scanStats.eta_seconds : -1
+                anchors.horizontalCenter: parent.horizontalCenter
+                visible: scanning && eta >= 0
+                text: eta < 60 ? qsTr("Less than a minute left")
+                               : eta < 3600 ? qsTr("About %n minute(s) left", "", Math.round(eta / 60))
+                                            : qsTr("About %n hour(s) left", "", Math.round(eta / 3600))
+                font.pixelSize: Theme.fontSizeSmall
+                color: Theme.secondaryHighlightColor
+            }
+
             // Stats
             Item {
                 width: parent.width
@@ -67,6 +67,35 @@ Page {
         loadStatistics()
     }
 
+    function modelComparisonText(result) {
+        if (!result || result.error) {
+            return qsTr("Comparison failed: %1").arg(result ? result.error : "")
+        }
+        if (!result.photos) {
+            return qsTr("No photos to compare on yet — scan first")
+        }
+        var lines = [
+            qsTr("%n photo(s), %1 faces", "", result.photos).arg(result.faces),
+            qsTr("Detection: %1 ms → %2 ms per photo (%3× faster), %4 of %5 faces found by both")
+                .arg(result.detector.fp32_ms.toFixed(0)).arg(result.detector.int8_ms.toFixed(0))
+                .arg(result.detector.speedup.toFixed(1))
+                .arg(result.detector.found_by_both).arg(result.faces)
+        ]
+        if (result.faces > 0) {
+            lines.push(qsTr("Recognition: %1 ms → %2 ms per face (%3× faster), similarity %4% on average, %5% at worst")
+                .arg(result.recognizer.fp32_ms.toFixed(1)).arg(result.recognizer.int8_ms.toFixed(1))
+                .arg(result.recognizer.speedup.toFixed(1))
+                .arg((result.recognizer.mean_similarity * 100).toFixed(1))
+                .arg((result.recognizer.min_similarity * 100).toFixed(1)))
+        }
+        return lines.join("\n")
+    }
+
+    Connections {
+        target: facePipeline
+        onModelComparisonCompleted: modelComparisonLabel.text = modelComparisonText(result)
+    }
+
     SilicaFlickable {
         anchors.fill: parent
         contentHeight: column.height
@@ -155,6 +184,45 @@ Page {
                 }
             }
 
+            TextSwitch {
+                text: qsTr("Watch for new photos")
+                description: qsTr("Process new and edited photos in these folders in the background while Nami is running, without waiting for a scan.")
+                enabled: facePipeline && facePipeline.initialized
+                automaticCheck: false
+                checked: facePipeline && facePipeline.watchGalleries
+                onClicked: facePipeline.watchGalleries = !facePipeline.watchGalleries
+            }
+
+            ComboBox {
+                id: scanProfileCombo
+                width: parent.width
+                label: qsTr("Scan speed")
+                description: qsTr("Balanced and Background slow down when the phone is busy or getting hot. Applies to a running scan at once.")
+                enabled: facePipeline && facePipeline.initialized
+
+                readonly property var profiles: ["fast", "balanced", "background"]
+                property bool ready: false
+
+                menu: ContextMenu {
+                    MenuItem { text: qsTr("Fast") }
+                    MenuItem { text: qsTr("Balanced") }
+                    MenuItem { text: qsTr("Background") }
+                }
+
+                Component.onCompleted: {
+                    if (facePipeline && facePipeline.initialized) {
+                        var idx = profiles.indexOf(facePipeline.getSetting("scan_profile", "balanced"))
+                        currentIndex = idx >= 0 ? idx : 1
+                    }
+                    ready = true
+                }
+
+                onCurrentIndexChanged: {
+                    if (!ready) return
+                    facePipeline.setSetting("scan_profile", profiles[currentIndex])
+                }
+            }
+
             SectionHeader {
                 text: qsTr("Language")
             }
@@ -328,6 +396,155 @@ Page {
                 wrapMode: Text.WordWrap
             }
 
+            TextSwitch {
+                width: parent.width
+                text: qsTr("Copies keep their people")
+                description: qsTr("A photo that also exists elsewhere, for example copied to the SD card, gets the same people as the original instead of being matched again.")
+                enabled: facePipeline && facePipeline.initialized
+                automaticCheck: false
+                checked: facePipeline && facePipeline.getSetting("duplicates_keep_people", "false") === "true"
+                onClicked: {
+                    checked = !checked
+                    facePipeline.setSetting("duplicates_keep_people", checked ? "true" : "false")
+                }
+            }
+
+            ComboBox {
+                id: faceQualityCombo
+                width: parent.width
+                label: qsTr("Face quality filter")
+                description: qsTr("Faces that are tiny, blurred or seen from the side are left out instead of being recognised. Applies to photos scanned from now on.")
+                enabled: facePipeline && facePipeline.initialized
+
+                readonly property var levels: ["off", "normal", "strict"]
+                property bool ready: false
+
+                menu: ContextMenu {
+                    MenuItem { text: qsTr("Off") }
+                    MenuItem { text: qsTr("Normal") }
+                    MenuItem { text: qsTr("Strict") }
+                }
+
+                Component.onCompleted: {
+                    if (facePipeline && facePipeline.initialized) {
+                        var idx = levels.indexOf(facePipeline.getSetting("face_quality", "normal"))
+                        currentIndex = idx >= 0 ? idx : 1
+                    }
+                    ready = true
+                }
+
+                onCurrentIndexChanged: {
+                    if (!ready) return
+                    facePipeline.setSetting("face_quality", levels[currentIndex])
+                }
+            }
+
+            TextSwitch {
+                width: parent.width
+                text: qsTr("Check burst shots for faces")
+                description: qsTr("Shots taken moments apart reuse the faces of the shot before them. When on, faces are still detected in every shot, so someone who turns up only in a later shot is not missed; slower.")
+                enabled: facePipeline && facePipeline.initialized
+                automaticCheck: false
+                checked: facePipeline && facePipeline.getSetting("burst_verify", "false") === "true"
+                onClicked: {
+                    checked = !checked
+                    facePipeline.setSetting("burst_verify", checked ? "true" : "false")
+                }
+            }
+
+            TextSwitch {
+                width: parent.width
+                text: qsTr("Record scan timelines")
+                description: qsTr("For troubleshooting slow scans: each scan writes a nami-trace file to Documents, which can be opened in Perfetto.")
+                enabled: facePipeline && facePipeline.initialized
+                automaticCheck: false
+                checked: facePipeline && facePipeline.getSetting("trace_scans", "false") === "true"
+                onClicked: {
+                    checked = !checked
+                    facePipeline.setSetting("trace_scans", checked ? "true" : "false")
+                }
+            }
+
+            SectionHeader {
+                text: qsTr("Face models")
+            }
+
+            Label {
+                x: Theme.horizontalPageMargin
+                width: parent.width - 2 * Theme.horizontalPageMargin
+                text: qsTr("The compact models are much faster on most phones and recognise people almost as well. Switching face recognition on a library with faces needs \"Compare models\" first, to show both kinds agree closely enough for automatic matching.")
+                font.pixelSize: Theme.fontSizeExtraSmall
+                color: Theme.secondaryColor
+                wrapMode: Text.Wrap
+            }
+
+            Repeater {
+                model: [
+                    { kind: "detector", key: "detector_model", label: qsTr("Face detection") },
+                    { kind: "recognizer", key: "recognizer_model", label: qsTr("Face recognition") }
+                ]
+
+                ComboBox {
+                    width: column.width
+                    label: modelData.label
+                    enabled: facePipeline && facePipeline.initialized && !facePipeline.processing
+
+                    readonly property var variants: ["fp32", "int8"]
+                    property bool ready: false
+
+                    menu: ContextMenu {
+                        MenuItem { text: qsTr("Standard") }
+                        MenuItem {
+                            text: qsTr("Compact (INT8)")
+                            enabled: facePipeline && facePipeline.initialized
+                                     && facePipeline.isModelVariantAvailable(modelData.kind, "int8")
+                        }
+                    }
+
+                    Component.onCompleted: {
+                        if (facePipeline && facePipeline.initialized) {
+                            var idx = variants.indexOf(facePipeline.getSetting(modelData.key, "fp32"))
+                            currentIndex = idx >= 0 ? idx : 0
+                        }
+                        ready = true
+                    }
+
+                    onCurrentIndexChanged: {
+                        if (!ready) return
+                        if (!facePipeline.setSetting(modelData.key, variants[currentIndex])) {
+                            // Busy or not installed: show what is still in use
+                            ready = false
+                            currentIndex = variants.indexOf(facePipeline.getSetting(modelData.key, "fp32"))
+                            ready = true
+                        }
+                    }
+                }
+            }
+
+            ButtonLayout {
+                Button {
+                    text: facePipeline && facePipeline.comparingModels ? qsTr("Comparing…") : qsTr("Compare models")
+                    enabled: facePipeline && facePipeline.initialized && !facePipeline.processing
+                             && !facePipeline.comparingModels
+                             && facePipeline.isModelVariantAvailable("detector", "int8")
+                             && facePipeline.isModelVariantAvailable("recognizer", "int8")
+                    onClicked: {
+                        modelComparisonLabel.text = ""
+                        facePipeline.compareModelVariants()
+                    }
+                }
+            }
+
+            Label {
+                id: modelComparisonLabel
+                x: Theme.horizontalPageMargin
+                width: parent.width - 2 * Theme.horizontalPageMargin
+                visible: text.length > 0
+                font.pixelSize: Theme.fontSizeExtraSmall
+                color: Theme.highlightColor
+                wrapMode: Text.Wrap
+            }
+
             SectionHeader {
                 text: qsTr("Storage")
             }
@@ -0,0 +1,52 @@
+#include "burstindex.h"
+
+#include <QMutexLocker>
+#include "perceptualhash.h"
+
+void BurstIndex::add(const Frame &frame)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_frames.size() >= CAPACITY) {
+        m_frames.removeFirst();
+    }
+    m_frames.append(frame);
+}
+
+bool BurstIndex::find(qint64 takenMs, quint64 dhash, const QSize &size, Frame *match) const
+{
+    QMutexLocker locker(&m_mutex);
+    int best = -1;
+    int bestDistance = MAX_DISTANCE + 1;
+    qint64 bestGap = 0;
+    for (int i = 0; i < m_frames.size(); i++) {
+        const Frame &frame = m_frames[i];
+        const qint64 gap = qAbs(frame.takenMs - takenMs);
+        if (gap > WINDOW_MS || frame.size != size) {
+            continue;
+        }
+        const int distance = PerceptualHash::distance(frame.dhash, dhash);
+        if (distance < bestDistance || (distance == bestDistance && gap < bestGap)) {
+            best = i;
+            bestDistance = distance;
+            bestGap = gap;
+        }
+    }
+
+    if (best < 0) {
+        return false;
+    }
+    *match = m_frames[best];
+    return true;
+}
+
+void BurstIndex::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_frames.clear();
+}
+
+int BurstIndex::size() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_frames.size();
+}
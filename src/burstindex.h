@@ -0,0 +1,63 @@
+#ifndef BURSTINDEX_H
+#define BURSTINDEX_H
+
+#include <QMutex>
+#include <QRectF>
+#include <QSize>
+#include <QString>
+#include <QVector>
+#include "faceembedding.h"
+
+/**
+ * @brief One face extracted from a photo (detection + embedding, no DB state)
+ */
+struct ExtractedFace {
+    QRectF bbox;
+    float confidence;
+    FaceEmbedding embedding;
+    bool ignored = false;  // a copy's face the user dismissed on the original
+};
+
+/**
+ * @brief Recently processed photos, to recognise the next frame of a burst
+ *
+ * A photo taken within WINDOW_MS of one in here, at the same size and with
+ * a dHash at most MAX_DISTANCE bits away (see PerceptualHash), shows the
+ * same people in the same places: its faces can be taken from that frame
+ * instead of running the models again. Boxes are normalised to the image,
+ * so at the same size they carry over as they are.
+ *
+ * Holds the last CAPACITY frames; safe to use from any thread.
+ */
+class BurstIndex
+{
+public:
+    static constexpr int CAPACITY = 256;
+    static constexpr int WINDOW_MS = 10000;
+    static constexpr int MAX_DISTANCE = 6;
+
+    struct Frame {
+        QString filePath;
+        qint64 takenMs = 0;
+        quint64 dhash = 0;
+        QSize size;
+        QVector<ExtractedFace> faces;
+    };
+
+    void add(const Frame &frame);
+
+    /**
+     * @brief The closest frame to this one (fewest differing bits, then
+     *        nearest in time), if any qualifies
+     */
+    bool find(qint64 takenMs, quint64 dhash, const QSize &size, Frame *match) const;
+
+    void clear();
+    int size() const;
+
+private:
+    mutable QMutex m_mutex;
+    QVector<Frame> m_frames;    // oldest first
+};
+
+#endif // BURSTINDEX_H
@@ -0,0 +1,269 @@
+#include "embeddingcodec.h"
+
+#include <QDataStream>
+#include <QtEndian>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+const char MAGIC_0 = 'N';
+const char MAGIC_1 = 'E';
+const int HEADER_SIZE = 4;
+
+quint32 floatBits(float value)
+{
+    quint32 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+float bitsToFloat(quint32 bits)
+{
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// IEEE 754 binary16, round to nearest even (Qt 5.6 predates qfloat16)
+quint16 floatToHalf(float value)
+{
+    const quint32 bits = floatBits(value);
+    const quint16 sign = static_cast<quint16>((bits >> 16) & 0x8000);
+    const quint32 rawExponent = (bits >> 23) & 0xFF;
+    quint32 mantissa = bits & 0x7FFFFF;
+
+    if (rawExponent == 0xFF) {
+        return sign | 0x7C00 | (mantissa ? 0x200 : 0);  // inf / NaN
+    }
+
+    const int exponent = static_cast<int>(rawExponent) - 127 + 15;
+    if (exponent >= 31) {
+        return sign | 0x7C00;  // overflow
+    }
+
+    if (exponent <= 0) {
+        if (exponent < -10) {
+            return sign;  // below the smallest subnormal
+        }
+        mantissa |= 0x800000;
+        const int shift = 14 - exponent;
+        quint32 half = mantissa >> shift;
+        const quint32 rest = mantissa & ((1u << shift) - 1);
+        const quint32 halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1))) {
+            half++;
+        }
+        return sign | static_cast<quint16>(half);
+    }
+
+    // A carry out of the mantissa correctly bumps the exponent
+    quint32 half = (static_cast<quint32>(exponent) << 10) | (mantissa >> 13);
+    const quint32 rest = mantissa & 0x1FFF;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+        half++;
+    }
+    return sign | static_cast<quint16>(half);
+}
+
+float halfToFloat(quint16 half)
+{
+    const quint32 sign = static_cast<quint32>(half & 0x8000) << 16;
+    const int exponent = (half >> 10) & 0x1F;
+    quint32 mantissa = half & 0x3FF;
+
+    if (exponent == 0x1F) {
+        return bitsToFloat(sign | 0x7F800000 | (mantissa << 13));
+    }
+    if (exponent != 0) {
+        return bitsToFloat(sign | (static_cast<quint32>(exponent + 112) << 23) | (mantissa << 13));
+    }
+    if (mantissa == 0) {
+        return bitsToFloat(sign);
+    }
+
+    // Subnormal half, normal float
+    int floatExponent = 113;
+    while (!(mantissa & 0x400)) {
+        mantissa <<= 1;
+        floatExponent--;
+    }
+    mantissa &= 0x3FF;
+    return bitsToFloat(sign | (static_cast<quint32>(floatExponent) << 23) | (mantissa << 13));
+}
+
+void normalize(FaceEmbedding &embedding)
+{
+    float norm = 0.0f;
+    for (float v : embedding) {
+        norm += v * v;
+    }
+    norm = std::sqrt(norm);
+    if (norm > 0.0f) {
+        for (float &v : embedding) {
+            v /= norm;
+        }
+    }
+}
+
+FaceEmbedding decodeLegacy(const QByteArray &data)
+{
+    QDataStream stream(data);
+    quint32 size;
+    stream >> size;
+
+    // Each element took 8 bytes (QDataStream::DoublePrecision)
+    if (stream.status() != QDataStream::Ok
+        || size > static_cast<quint32>((data.size() - 4) / 8)) {
+        return FaceEmbedding();
+    }
+
+    FaceEmbedding embedding(size);
+    for (quint32 i = 0; i < size; i++) {
+        stream >> embedding[i];
+    }
+    return embedding;
+}
+
+} // namespace
+
+QByteArray EmbeddingCodec::encode(const FaceEmbedding &embedding, Format format)
+{
+    const int n = static_cast<int>(embedding.size());
+
+    QByteArray data;
+    data.reserve(HEADER_SIZE + 4 + n * 4);
+    data.append(MAGIC_0);
+    data.append(MAGIC_1);
+    data.append(static_cast<char>(format));
+    data.append('\0');
+
+    switch (format) {
+    case Float32: {
+        data.resize(HEADER_SIZE + n * 4);
+        uchar *out = reinterpret_cast<uchar *>(data.data() + HEADER_SIZE);
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+        std::memcpy(out, embedding.data(), n * 4);
+#else
+        for (int i = 0; i < n; i++) {
+            qToLittleEndian<quint32>(floatBits(embedding[i]), out + i * 4);
+        }
+#endif
+        break;
+    }
+    case Float16: {
+        data.resize(HEADER_SIZE + n * 2);
+        uchar *out = reinterpret_cast<uchar *>(data.data() + HEADER_SIZE);
+        for (int i = 0; i < n; i++) {
+            qToLittleEndian<quint16>(floatToHalf(embedding[i]), out + i * 2);
+        }
+        break;
+    }
+    case Int8: {
+        float maxAbs = 0.0f;
+        for (float v : embedding) {
+            maxAbs = std::max(maxAbs, std::fabs(v));
+        }
+        const float scale = maxAbs / 127.0f;
+
+        data.resize(HEADER_SIZE + 4 + n);
+        uchar *out = reinterpret_cast<uchar *>(data.data() + HEADER_SIZE);
+        qToLittleEndian<quint32>(floatBits(scale), out);
+        for (int i = 0; i < n; i++) {
+            const long q = scale > 0.0f ? std::lround(embedding[i] / scale) : 0;
+            out[4 + i] = static_cast<uchar>(static_cast<qint8>(qBound(-127L, q, 127L)));
+        }
+        break;
+    }
+    }
+
+    return data;
+}
+
+FaceEmbedding EmbeddingCodec::decode(const QByteArray &data)
+{
+    if (data.size() < HEADER_SIZE || data[0] != MAGIC_0 || data[1] != MAGIC_1) {
+        return decodeLegacy(data);
+    }
+
+    const uchar *in = reinterpret_cast<const uchar *>(data.constData() + HEADER_SIZE);
+    const int payload = data.size() - HEADER_SIZE;
+    FaceEmbedding embedding;
+
+    switch (static_cast<Format>(data[2])) {
+    case Float32: {
+        const int n = payload / 4;
+        embedding.resize(n);
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+        std::memcpy(embedding.data(), in, n * 4);
+#else
+        for (int i = 0; i < n; i++) {
+            embedding[i] = bitsToFloat(qFromLittleEndian<quint32>(in + i * 4));
+        }
+#endif
+        return embedding;
+    }
+    case Float16: {
+        const int n = payload / 2;
+        embedding.resize(n);
+        for (int i = 0; i < n; i++) {
+            embedding[i] = halfToFloat(qFromLittleEndian<quint16>(in + i * 2));
+        }
+        break;
+    }
+    case Int8: {
+        if (payload < 4) {
+            return FaceEmbedding();
+        }
+        const float scale = bitsToFloat(qFromLittleEndian<quint32>(in));
+        const int n = payload - 4;
+        embedding.resize(n);
+        for (int i = 0; i < n; i++) {
+            embedding[i] = static_cast<qint8>(in[4 + i]) * scale;
+        }
+        break;
+    }
+    default:
+        return FaceEmbedding();
+    }
+
+    normalize(embedding);
+    return embedding;
+}
+
+bool EmbeddingCodec::isFormat(const QByteArray &data, Format format)
+{
+    return data.size() >= HEADER_SIZE && data[0] == MAGIC_0 && data[1] == MAGIC_1
+        && data[2] == static_cast<char>(format);
+}
+
+EmbeddingCodec::Format EmbeddingCodec::formatFromName(const QString &name, bool *ok)
+{
+    if (ok) {
+        *ok = true;
+    }
+    if (name == QLatin1String("float16")) {
+        return Float16;
+    }
+    if (name == QLatin1String("int8")) {
+        return Int8;
+    }
+    if (name != QLatin1String("float32") && ok) {
+        *ok = false;
+    }
+    return Float32;
+}
+
+QString EmbeddingCodec::formatName(Format format)
+{
+    switch (format) {
+    case Float16:
+        return QStringLiteral("float16");
+    case Int8:
+        return QStringLiteral("int8");
+    case Float32:
+        break;
+    }
+    return QStringLiteral("float32");
+}
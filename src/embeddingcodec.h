@@ -0,0 +1,60 @@
+#ifndef EMBEDDINGCODEC_H
+#define EMBEDDINGCODEC_H
+
+#include <QByteArray>
+#include <QString>
+#include "faceembedding.h"
+
+/**
+ * @brief On-disk format of face embeddings (faces.embedding BLOB)
+ *
+ * Embeddings used to be written with QDataStream, whose default double
+ * precision stored every float in 8 bytes: ~1 KB per face, read back one
+ * stream operator at a time. A blob is now a 4-byte header followed by raw
+ * little-endian values:
+ *
+ *   'N' 'E' <format> <reserved = 0> <payload>
+ *
+ * - Float32: n x float32, 512 bytes for SFace, decoded with one memcpy
+ * - Float16: n x IEEE half, 256 bytes, ~1e-3 error per component
+ * - Int8:    float32 scale + n x int8 (symmetric), 132 bytes
+ *
+ * Legacy QDataStream blobs start with the big-endian element count, whose
+ * first byte is 0 for any realistic dimension, so they can never be taken
+ * for a header and still decode.
+ */
+namespace EmbeddingCodec
+{
+    enum Format {
+        Float32 = 1,
+        Float16 = 2,
+        Int8 = 3
+    };
+
+    /**
+     * @brief Encode an embedding in the given format
+     */
+    QByteArray encode(const FaceEmbedding &embedding, Format format = Float32);
+
+    /**
+     * @brief Decode any blob, current or legacy; empty on malformed input
+     *
+     * Quantized formats are re-normalized to unit length, which is what
+     * every similarity computation assumes.
+     */
+    FaceEmbedding decode(const QByteArray &data);
+
+    /**
+     * @brief Whether data is already stored in exactly this format
+     */
+    bool isFormat(const QByteArray &data, Format format);
+
+    /**
+     * @brief Setting value <-> format ("float32", "float16", "int8")
+     * @param ok Set to false for an unknown name (Float32 is returned)
+     */
+    Format formatFromName(const QString &name, bool *ok = nullptr);
+    QString formatName(Format format);
+}
+
+#endif // EMBEDDINGCODEC_H
@@ -0,0 +1,329 @@
+#include "embeddingmatrix.h"
+
+#include <QVarLengthArray>
+#include <QtGlobal>
+#include <algorithm>
+#include <cstring>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#  include <arm_neon.h>
+#  define NAMI_SIMD_NEON
+#elif defined(__SSE__) || defined(_M_X64)
+#  include <immintrin.h>
+#  define NAMI_SIMD_SSE
+#  if defined(__GNUC__) && !defined(__AVX__)
+#    define NAMI_SIMD_AVX_DISPATCH
+#  endif
+#endif
+
+namespace {
+
+// Row padding and buffer alignment: one cache line, four SSE / two AVX
+// registers, so kernels run over whole rows without a scalar tail
+const int ROW_ALIGN_FLOATS = 16;
+const size_t BUFFER_ALIGNMENT = 64;
+
+#if defined(NAMI_SIMD_NEON)
+
+float dotNeon(const float *a, const float *b, int n)
+{
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+    float32x4_t acc2 = vdupq_n_f32(0.0f);
+    float32x4_t acc3 = vdupq_n_f32(0.0f);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+        acc1 = vmlaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+        acc2 = vmlaq_f32(acc2, vld1q_f32(a + i + 8), vld1q_f32(b + i + 8));
+        acc3 = vmlaq_f32(acc3, vld1q_f32(a + i + 12), vld1q_f32(b + i + 12));
+    }
+    const float32x4_t acc = vaddq_f32(vaddq_f32(acc0, acc1), vaddq_f32(acc2, acc3));
+#if defined(__aarch64__)
+    float sum = vaddvq_f32(acc);
+#else
+    float32x2_t pair = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+    pair = vpadd_f32(pair, pair);
+    float sum = vget_lane_f32(pair, 0);
+#endif
+    for (; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+#elif defined(NAMI_SIMD_SSE)
+
+#if !defined(__AVX__)
+#define NAMI_SIMD_SSE_KERNEL
+#endif
+
+inline float horizontalSum(__m128 v)
+{
+    __m128 high = _mm_movehl_ps(v, v);
+    __m128 sums = _mm_add_ps(v, high);
+    high = _mm_shuffle_ps(sums, sums, _MM_SHUFFLE(1, 1, 1, 1));
+    return _mm_cvtss_f32(_mm_add_ss(sums, high));
+}
+
+#if defined(NAMI_SIMD_SSE_KERNEL)
+float dotSse(const float *a, const float *b, int n)
+{
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    __m128 acc2 = _mm_setzero_ps();
+    __m128 acc3 = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+        acc2 = _mm_add_ps(acc2, _mm_mul_ps(_mm_loadu_ps(a + i + 8), _mm_loadu_ps(b + i + 8)));
+        acc3 = _mm_add_ps(acc3, _mm_mul_ps(_mm_loadu_ps(a + i + 12), _mm_loadu_ps(b + i + 12)));
+    }
+    float sum = horizontalSum(_mm_add_ps(_mm_add_ps(acc0, acc1), _mm_add_ps(acc2, acc3)));
+    for (; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+#endif
+
+#if defined(__AVX__) || defined(NAMI_SIMD_AVX_DISPATCH)
+
+#if defined(NAMI_SIMD_AVX_DISPATCH)
+__attribute__((target("avx")))
+#endif
+float dotAvx(const float *a, const float *b, int n)
+{
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+        acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(_mm256_loadu_ps(a + i + 8),
+                                                 _mm256_loadu_ps(b + i + 8)));
+    }
+    const __m256 acc = _mm256_add_ps(acc0, acc1);
+    float sum = horizontalSum(_mm_add_ps(_mm256_castps256_ps128(acc),
+                                         _mm256_extractf128_ps(acc, 1)));
+    for (; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+#endif
+
+#endif
+
+typedef float (*DotKernel)(const float *, const float *, int);
+
+struct Kernel {
+    DotKernel function;
+    const char *name;
+};
+
+Kernel selectKernel()
+{
+#if defined(NAMI_SIMD_NEON)
+    return Kernel{dotNeon, "neon"};
+#elif defined(NAMI_SIMD_SSE) && defined(__AVX__)
+    return Kernel{dotAvx, "avx"};
+#elif defined(NAMI_SIMD_AVX_DISPATCH)
+    if (__builtin_cpu_supports("avx")) {
+        return Kernel{dotAvx, "avx"};
+    }
+    return Kernel{dotSse, "sse"};
+#elif defined(NAMI_SIMD_SSE)
+    return Kernel{dotSse, "sse"};
+#else
+    return Kernel{EmbeddingMath::dotScalar, "scalar"};
+#endif
+}
+
+const Kernel &kernel()
+{
+    static const Kernel selected = selectKernel();
+    return selected;
+}
+
+} // namespace
+
+float EmbeddingMath::dot(const float *a, const float *b, int n)
+{
+    return kernel().function(a, b, n);
+}
+
+float EmbeddingMath::dotScalar(const float *a, const float *b, int n)
+{
+    float sum = 0.0f;
+    for (int i = 0; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+const char *EmbeddingMath::kernelName()
+{
+    return kernel().name;
+}
+
+EmbeddingMatrix::EmbeddingMatrix()
+    : m_data(nullptr)
+    , m_rows(0)
+    , m_capacity(0)
+    , m_dim(0)
+    , m_stride(0)
+{
+}
+
+EmbeddingMatrix::~EmbeddingMatrix()
+{
+    qFreeAligned(m_data);
+}
+
+void EmbeddingMatrix::clear()
+{
+    qFreeAligned(m_data);
+    m_data = nullptr;
+    m_rows = 0;
+    m_capacity = 0;
+    m_dim = 0;
+    m_stride = 0;
+    m_rowPerson.clear();
+    m_blocks.clear();
+}
+
+void EmbeddingMatrix::reserve(int rows)
+{
+    if (rows <= m_capacity) {
+        return;
+    }
+
+    const int capacity = qMax(rows, qMax(16, m_capacity * 2));
+    const size_t bytes = static_cast<size_t>(capacity) * m_stride * sizeof(float);
+    m_data = static_cast<float *>(
+        qReallocAligned(m_data, bytes,
+                        static_cast<size_t>(m_capacity) * m_stride * sizeof(float),
+                        BUFFER_ALIGNMENT));
+    Q_CHECK_PTR(m_data);
+    m_capacity = capacity;
+}
+
+void EmbeddingMatrix::setPerson(int personId, const QVector<FaceEmbedding> &exemplars)
+{
+    QVector<const FaceEmbedding *> rows;
+    for (const FaceEmbedding &exemplar : exemplars) {
+        if (exemplar.empty()) {
+            continue;
+        }
+        if (m_dim == 0) {
+            m_dim = static_cast<int>(exemplar.size());
+            m_stride = (m_dim + ROW_ALIGN_FLOATS - 1) / ROW_ALIGN_FLOATS * ROW_ALIGN_FLOATS;
+        }
+        if (static_cast<int>(exemplar.size()) == m_dim) {
+            rows.append(&exemplar);
+        }
+    }
+
+    int blockIndex = -1;
+    for (int i = 0; i < m_blocks.size(); i++) {
+        if (m_blocks[i].personId == personId) {
+            blockIndex = i;
+            break;
+        }
+    }
+
+    if (blockIndex < 0) {
+        if (rows.isEmpty()) {
+            return;
+        }
+        m_blocks.append(Block{personId, m_rows, 0});
+        blockIndex = m_blocks.size() - 1;
+    }
+
+    // Open or close a gap the size of the row-count change, keeping the
+    // rows of everyone after this person in place relative to each other
+    Block &block = m_blocks[blockIndex];
+    const int delta = rows.size() - block.rowCount;
+    const int tailStart = block.firstRow + block.rowCount;
+    const int tailRows = m_rows - tailStart;
+
+    reserve(m_rows + delta);
+    if (delta != 0 && tailRows > 0) {
+        std::memmove(m_data + static_cast<size_t>(tailStart + delta) * m_stride,
+                     m_data + static_cast<size_t>(tailStart) * m_stride,
+                     static_cast<size_t>(tailRows) * m_stride * sizeof(float));
+    }
+
+    for (int i = 0; i < rows.size(); i++) {
+        float *row = m_data + static_cast<size_t>(block.firstRow + i) * m_stride;
+        std::memcpy(row, rows[i]->data(), m_dim * sizeof(float));
+        std::fill(row + m_dim, row + m_stride, 0.0f);
+    }
+
+    m_rows += delta;
+    block.rowCount = rows.size();
+
+    m_rowPerson.remove(block.firstRow, tailStart - block.firstRow);
+    m_rowPerson.insert(block.firstRow, rows.size(), personId);
+
+    for (int i = blockIndex + 1; i < m_blocks.size(); i++) {
+        m_blocks[i].firstRow += delta;
+    }
+    if (rows.isEmpty()) {
+        m_blocks.remove(blockIndex);
+    }
+}
+
+void EmbeddingMatrix::scoreAll(const FaceEmbedding &query, QVector<float> &scores) const
+{
+    scores.fill(0.0f, m_rows);
+    if (static_cast<int>(query.size()) != m_dim || m_rows == 0) {
+        return;
+    }
+
+    // Zero-padded to the row stride so every row is a whole-kernel sweep
+    QVarLengthArray<float, 256> padded(m_stride);
+    std::memcpy(padded.data(), query.data(), m_dim * sizeof(float));
+    std::fill(padded.data() + m_dim, padded.data() + m_stride, 0.0f);
+
+    const float *row = m_data;
+    float *out = scores.data();
+    for (int r = 0; r < m_rows; r++, row += m_stride) {
+        // Cosine of unit vectors, mapped from [-1, 1] to [0, 1]
+        out[r] = (EmbeddingMath::dot(row, padded.constData(), m_stride) + 1.0f) * 0.5f;
+    }
+}
+
+EmbeddingMatrix::PersonScore EmbeddingMatrix::bestMatch(const FaceEmbedding &query) const
+{
+    PersonScore best{-1, 0.0f};
+
+    QVector<float> scores;
+    scoreAll(query, scores);
+    for (int r = 0; r < scores.size(); r++) {
+        if (scores[r] > best.similarity) {
+            best.personId = m_rowPerson[r];
+            best.similarity = scores[r];
+        }
+    }
+    return best;
+}
+
+QVector<EmbeddingMatrix::PersonScore> EmbeddingMatrix::bestPerPerson(const FaceEmbedding &query) const
+{
+    QVector<float> scores;
+    scoreAll(query, scores);
+
+    QVector<PersonScore> result;
+    result.reserve(m_blocks.size());
+    for (const Block &block : m_blocks) {
+        float best = 0.0f;
+        for (int r = block.firstRow; r < block.firstRow + block.rowCount; r++) {
+            best = qMax(best, scores[r]);
+        }
+        result.append(PersonScore{block.personId, best});
+    }
+    return result;
+}
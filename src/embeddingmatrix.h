@@ -0,0 +1,104 @@
+#ifndef EMBEDDINGMATRIX_H
+#define EMBEDDINGMATRIX_H
+
+#include <QVector>
+#include "faceembedding.h"
+
+namespace EmbeddingMath
+{
+    /**
+     * @brief Dot product of two float arrays
+     *
+     * NEON on ARM (aarch64 and armv7hl), AVX or SSE on x86 - AVX picked at
+     * runtime, so the x86 build needs no -march flag - and a scalar
+     * fallback elsewhere. Neither pointer needs to be aligned.
+     */
+    float dot(const float *a, const float *b, int n);
+
+    /**
+     * @brief Same as dot(), plain C++: the reference the SIMD paths are
+     * tested and benchmarked against
+     */
+    float dotScalar(const float *a, const float *b, int n);
+
+    /**
+     * @brief Name of the dot() implementation in use ("avx", "neon", ...)
+     */
+    const char *kernelName();
+}
+
+/**
+ * @brief Person exemplar embeddings as one contiguous matrix
+ *
+ * Matching a face used to walk QVector<QPair<int, QVector<FaceEmbedding>>>,
+ * chasing two pointers per exemplar. Here every exemplar is one row of a
+ * single 64-byte aligned, row-major float buffer (rows padded to 16
+ * floats), with a parallel person id per row, so scoring a query against
+ * every person is one linear sweep through memory.
+ *
+ * A person's exemplars are consecutive rows, and people keep the order
+ * they were first added in, also when their exemplars are replaced.
+ *
+ * No OpenCV, no Qt GUI: testable on its own like the storage layer.
+ */
+class EmbeddingMatrix
+{
+public:
+    struct PersonScore {
+        int personId;
+        float similarity;  // 0.0 - 1.0, as FaceRecognizer::computeSimilarity
+    };
+
+    EmbeddingMatrix();
+    ~EmbeddingMatrix();
+
+    EmbeddingMatrix(const EmbeddingMatrix &other) = delete;
+    EmbeddingMatrix &operator=(const EmbeddingMatrix &other) = delete;
+
+    void clear();
+
+    /**
+     * @brief Set (or replace) a person's exemplars; empty removes them
+     *
+     * Exemplars whose size differs from the matrix dimension (set by the
+     * first one stored) are skipped.
+     */
+    void setPerson(int personId, const QVector<FaceEmbedding> &exemplars);
+
+    bool isEmpty() const { return m_rows == 0; }
+    int rowCount() const { return m_rows; }
+    int personCount() const { return m_blocks.size(); }
+    int dimension() const { return m_dim; }
+
+    /**
+     * @brief Best-scoring exemplar over everyone, {-1, 0} when empty
+     */
+    PersonScore bestMatch(const FaceEmbedding &query) const;
+
+    /**
+     * @brief Best exemplar score of each person, in matrix order
+     */
+    QVector<PersonScore> bestPerPerson(const FaceEmbedding &query) const;
+
+private:
+    struct Block {
+        int personId;
+        int firstRow;
+        int rowCount;
+    };
+
+    float *m_data;
+    int m_rows;
+    int m_capacity;   // rows allocated
+    int m_dim;        // floats per embedding, 0 until the first row
+    int m_stride;     // floats per row, m_dim rounded up to 16
+    QVector<int> m_rowPerson;
+    QVector<Block> m_blocks;
+
+    void reserve(int rows);
+
+    // Dot product of the query with every row, into scores[0..m_rows)
+    void scoreAll(const FaceEmbedding &query, QVector<float> &scores) const;
+};
+
+#endif // EMBEDDINGMATRIX_H
@@ -148,17 +148,22 @@ bool scanGpsIfd(const QByteArray &tiff, quint32 ifdOffset, bool le,
 
 ExifReader::Metadata ExifReader::readMetadata(const QString &filePath)
 {
-    Metadata result;
-
     QFile file(filePath);
     if (!file.open(QIODevice::ReadOnly)) {
-        return result;
+        return Metadata();
     }
 
     // EXIF APP1 sits near the start of the file
     QByteArray head = file.read(256 * 1024);
     file.close();
 
+    return parseMetadata(head);
+}
+
+ExifReader::Metadata ExifReader::parseMetadata(const QByteArray &head)
+{
+    Metadata result;
+
     if (head.size() < 4 || static_cast<uchar>(head[0]) != 0xFF
         || static_cast<uchar>(head[1]) != 0xD8) {
         return result;  // not a JPEG
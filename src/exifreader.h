@@ -1,6 +1,7 @@
 #ifndef EXIFREADER_H
 #define EXIFREADER_H
 
+#include <QByteArray>
 #include <QString>
 #include <QDateTime>
 
@@ -26,6 +27,14 @@ namespace ExifReader
      * @brief Capture date and GPS location of a JPEG file
      */
     Metadata readMetadata(const QString &filePath);
+
+    /**
+     * @brief Same, from file contents already in memory
+     *
+     * @param head The file's bytes, or at least its first 256 KB; only the
+     *             APP1 segment is looked at, nothing is copied beyond it
+     */
+    Metadata parseMetadata(const QByteArray &head);
 }
 
 #endif // EXIFREADER_H
@@ -0,0 +1,249 @@
+#include "faceclustering.h"
+#include "faceindex.h"
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace {
+
+struct Edge {
+    int from;
+    int to;
+    float weight;
+};
+
+// Neighbour lists for faces [begin, end), as edges between indices into
+// the input (from < to, so both directions of a pair compare equal)
+class NeighbourTask : public QRunnable
+{
+public:
+    NeighbourTask(const FaceIndex &index, const QVector<QPair<int, FaceEmbedding>> &faces,
+                  const QHash<int, int> &indexOfFace, float threshold, int probes,
+                  int begin, int end, std::vector<Edge> &edges)
+        : m_index(index), m_faces(faces), m_indexOfFace(indexOfFace)
+        , m_threshold(threshold), m_probes(probes), m_begin(begin), m_end(end), m_edges(edges)
+    {
+        setAutoDelete(false);
+    }
+
+    void run() override
+    {
+        for (int i = m_begin; i < m_end; i++) {
+            QVector<FaceIndex::Hit> hits = m_index.neighbours(m_faces[i].first, m_threshold, m_probes);
+            if (hits.size() > FaceClustering::NEIGHBOURS) {
+                std::partial_sort(hits.begin(), hits.begin() + FaceClustering::NEIGHBOURS, hits.end(),
+                                  [](const FaceIndex::Hit &a, const FaceIndex::Hit &b) {
+                                      return a.similarity > b.similarity;
+                                  });
+                hits.resize(FaceClustering::NEIGHBOURS);
+            }
+            for (const FaceIndex::Hit &hit : hits) {
+                const int j = m_indexOfFace.value(hit.faceId, -1);
+                if (j >= 0) {
+                    m_edges.push_back(Edge{qMin(i, j), qMax(i, j), hit.similarity});
+                }
+            }
+        }
+    }
+
+private:
+    const FaceIndex &m_index;
+    const QVector<QPair<int, FaceEmbedding>> &m_faces;
+    const QHash<int, int> &m_indexOfFace;
+    float m_threshold;
+    int m_probes;
+    int m_begin;
+    int m_end;
+    std::vector<Edge> &m_edges;
+};
+
+// Adjacency in compressed rows: neighbours of i are
+// targets[offsets[i] .. offsets[i + 1])
+struct Graph {
+    std::vector<int> offsets;
+    std::vector<int> targets;
+    std::vector<float> weights;
+};
+
+Graph buildGraph(int nodeCount, std::vector<Edge> &edges)
+{
+    // A pair found from both ends is one edge
+    std::sort(edges.begin(), edges.end(), [](const Edge &a, const Edge &b) {
+        return a.from != b.from ? a.from < b.from : a.to < b.to;
+    });
+    edges.erase(std::unique(edges.begin(), edges.end(), [](const Edge &a, const Edge &b) {
+        return a.from == b.from && a.to == b.to;
+    }), edges.end());
+
+    Graph graph;
+    graph.offsets.assign(nodeCount + 1, 0);
+    for (const Edge &edge : edges) {
+        graph.offsets[edge.from + 1]++;
+        graph.offsets[edge.to + 1]++;
+    }
+    for (int i = 0; i < nodeCount; i++) {
+        graph.offsets[i + 1] += graph.offsets[i];
+    }
+
+    graph.targets.resize(edges.size() * 2);
+    graph.weights.resize(edges.size() * 2);
+    std::vector<int> fill(graph.offsets.begin(), graph.offsets.end() - 1);
+    for (const Edge &edge : edges) {
+        graph.targets[fill[edge.from]] = edge.to;
+        graph.weights[fill[edge.from]++] = edge.weight;
+        graph.targets[fill[edge.to]] = edge.from;
+        graph.weights[fill[edge.to]++] = edge.weight;
+    }
+    return graph;
+}
+
+// Returns the number of rounds run
+int chineseWhispers(const Graph &graph, std::vector<int> &labels)
+{
+    const int nodeCount = static_cast<int>(labels.size());
+    for (int i = 0; i < nodeCount; i++) {
+        labels[i] = i;
+    }
+
+    // Fixed shuffle (Fisher-Yates on a small LCG): visiting faces in
+    // database order would let the oldest photos win every tie
+    std::vector<int> order(nodeCount);
+    for (int i = 0; i < nodeCount; i++) {
+        order[i] = i;
+    }
+    quint32 rng = 0x2545F491u;
+    for (int i = nodeCount - 1; i > 0; i--) {
+        rng = rng * 1664525u + 1013904223u;
+        std::swap(order[i], order[(rng >> 8) % static_cast<quint32>(i + 1)]);
+    }
+
+    // Weight per label around the current face; only touched slots are reset
+    std::vector<float> weightOf(nodeCount, 0.0f);
+    std::vector<int> touched;
+
+    int iteration = 0;
+    while (iteration < FaceClustering::MAX_ITERATIONS) {
+        iteration++;
+        int changed = 0;
+
+        for (int node : order) {
+            const int begin = graph.offsets[node];
+            const int end = graph.offsets[node + 1];
+            if (begin == end) {
+                continue;
+            }
+
+            touched.clear();
+            for (int e = begin; e < end; e++) {
+                const int label = labels[graph.targets[e]];
+                if (weightOf[label] == 0.0f) {
+                    touched.push_back(label);
+                }
+                weightOf[label] += graph.weights[e];
+            }
+
+            int best = labels[node];
+            float bestWeight = 0.0f;
+            for (int label : touched) {
+                const float weight = weightOf[label];
+                if (weight > bestWeight || (weight == bestWeight && label < best)) {
+                    best = label;
+                    bestWeight = weight;
+                }
+                weightOf[label] = 0.0f;
+            }
+
+            if (best != labels[node]) {
+                labels[node] = best;
+                changed++;
+            }
+        }
+
+        if (changed == 0) {
+            break;
+        }
+    }
+    return iteration;
+}
+
+} // namespace
+
+FaceClustering::Result FaceClustering::cluster(const QVector<QPair<int, FaceEmbedding>> &faces,
+                                               float threshold, int minGroupSize, int threads)
+{
+    Result result;
+    result.faces = faces.size();
+    if (faces.isEmpty()) {
+        return result;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    FaceIndex index;
+    index.build(faces);
+
+    const int minProbes = FaceIndex::MIN_PROBES;
+    const int probes = qMax(minProbes, index.listCount() / FaceClustering::PROBE_DIVISOR);
+
+    QHash<int, int> indexOfFace;
+    indexOfFace.reserve(faces.size());
+    for (int i = 0; i < faces.size(); i++) {
+        indexOfFace.insert(faces[i].first, i);
+    }
+
+    // A pool of our own: the caller is typically a task of the global pool,
+    // and waiting on that pool from inside it could starve it
+    if (threads <= 0) {
+        threads = qMax(1, QThread::idealThreadCount());
+    }
+    const int chunks = qMin(threads * 4, faces.size());
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+
+    std::vector<std::vector<Edge>> chunkEdges(chunks);
+    std::vector<std::unique_ptr<NeighbourTask>> tasks;
+    for (int c = 0; c < chunks; c++) {
+        const int begin = static_cast<int>(static_cast<qint64>(faces.size()) * c / chunks);
+        const int end = static_cast<int>(static_cast<qint64>(faces.size()) * (c + 1) / chunks);
+        tasks.emplace_back(new NeighbourTask(index, faces, indexOfFace, threshold, probes,
+                                             begin, end, chunkEdges[c]));
+        pool.start(tasks.back().get());
+    }
+    pool.waitForDone();
+
+    std::vector<Edge> edges;
+    for (const std::vector<Edge> &chunk : chunkEdges) {
+        edges.insert(edges.end(), chunk.begin(), chunk.end());
+    }
+    const Graph graph = buildGraph(faces.size(), edges);
+    result.edges = static_cast<int>(edges.size());
+    result.graphMs = timer.restart();
+
+    std::vector<int> labels(faces.size());
+    result.iterations = chineseWhispers(graph, labels);
+
+    QHash<int, QVector<int>> byLabel;
+    for (int i = 0; i < faces.size(); i++) {
+        byLabel[labels[i]].append(faces[i].first);
+    }
+    for (auto it = byLabel.begin(); it != byLabel.end(); ++it) {
+        if (it.value().size() >= minGroupSize) {
+            result.groups.append(it.value());
+        }
+    }
+
+    // Largest first, ties by first face so the order is stable run to run
+    std::sort(result.groups.begin(), result.groups.end(),
+              [](const QVector<int> &a, const QVector<int> &b) {
+                  return a.size() != b.size() ? a.size() > b.size() : a.first() < b.first();
+              });
+    result.clusterMs = timer.elapsed();
+    return result;
+}
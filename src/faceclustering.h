@@ -0,0 +1,59 @@
+#ifndef FACECLUSTERING_H
+#define FACECLUSTERING_H
+
+#include <QPair>
+#include <QVector>
+#include "faceembedding.h"
+
+/**
+ * @brief Groups unmapped faces into likely people
+ *
+ * Two stages, both independent of the database so cluster() can run on a
+ * worker thread:
+ *
+ * 1. k-NN graph: every face is linked to its NEIGHBOURS most similar faces
+ *    above the threshold, found through a FaceIndex. The queries are split
+ *    across a private thread pool, one chunk of faces per core.
+ * 2. Chinese whispers over that graph: each face repeatedly takes the label
+ *    carrying the most edge weight among its neighbours until no label
+ *    changes. Unlike the old "seed and absorb" loop, one face of a blurry
+ *    chain cannot pull two people together, and the result does not depend
+ *    on which face happened to be seeded first.
+ *
+ * Deterministic for a given input: the visiting order is a fixed shuffle.
+ */
+namespace FaceClustering
+{
+    // k of the k-NN graph: enough to hold a person's faces together,
+    // few enough that the graph stays linear in the face count
+    const int NEIGHBOURS = 20;
+
+    // Index lists probed per face, as a fraction of all lists: half the
+    // default. A neighbour missed here is usually still reached through
+    // the others, so the graph loses next to nothing.
+    const int PROBE_DIVISOR = 16;
+
+    // Chinese whispers converges in a handful of rounds; this is a cap
+    const int MAX_ITERATIONS = 20;
+
+    struct Result {
+        QVector<QVector<int>> groups;  // face ids, largest group first
+        int faces = 0;
+        int edges = 0;        // undirected edges in the k-NN graph
+        int iterations = 0;   // Chinese whispers rounds run
+        qint64 graphMs = 0;
+        qint64 clusterMs = 0;
+    };
+
+    /**
+     * @brief Cluster faces by similarity
+     * @param faces (face id, embedding) pairs
+     * @param threshold Minimum similarity (0.0 - 1.0) for two faces to be linked
+     * @param minGroupSize Smaller clusters are left out of the result
+     * @param threads Worker threads for the graph; 0 = one per core
+     */
+    Result cluster(const QVector<QPair<int, FaceEmbedding>> &faces, float threshold,
+                   int minGroupSize = 2, int threads = 0);
+}
+
+#endif // FACECLUSTERING_H
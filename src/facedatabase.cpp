@@ -1,10 +1,10 @@
 #include "facedatabase.h"
 #include <QDebug>
 #include "logging.h"
+#include "tracer.h"
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QVariant>
-#include <QDataStream>
 #include <QBuffer>
 #include <QFile>
 #include <QFileInfo>
@@ -16,6 +16,10 @@
 FaceDatabase::FaceDatabase(QObject *parent)
     : QObject(parent)
     , m_isOpen(false)
+    , m_embeddingFormat(EmbeddingCodec::Float32)
+    , m_transactionDepth(0)
+    , m_unmappedLoaded(false)
+    , m_negativeMatchesLoaded(false)
 {
 }
 
@@ -65,6 +69,8 @@ void FaceDatabase::close()
     if (m_isOpen) {
         m_db.close();
         m_isOpen = false;
+        m_transactionDepth = 0;
+        dropResidentCaches();
         qCDebug(lcNami) << "Database closed";
     }
 }
@@ -116,6 +122,9 @@ bool FaceDatabase::initializeSchema()
     query.exec("ALTER TABLE faces ADD COLUMN similarity_score REAL DEFAULT 0.0");
     query.exec("ALTER TABLE faces ADD COLUMN verified INTEGER DEFAULT 0");
     query.exec("ALTER TABLE faces ADD COLUMN ignored INTEGER DEFAULT 0");
+    // ModelRegistry::modelId() of the recognizer; NULL for faces from
+    // before it was recorded
+    query.exec("ALTER TABLE faces ADD COLUMN embedding_model TEXT");
     query.exec("ALTER TABLE photos ADD COLUMN rotation INTEGER DEFAULT 0");
     // NULL means "no GPS data in EXIF", not "0,0"
     query.exec("ALTER TABLE photos ADD COLUMN latitude REAL");
@@ -124,6 +133,15 @@ bool FaceDatabase::initializeSchema()
     // to a different path (backfilled lazily for photos scanned before
     // this column existed)
     query.exec("ALTER TABLE photos ADD COLUMN file_hash TEXT");
+    // File fingerprint at the time the photo was read (FileFingerprint),
+    // NULL until the next scan for photos scanned before these existed
+    query.exec("ALTER TABLE photos ADD COLUMN file_size INTEGER");
+    query.exec("ALTER TABLE photos ADD COLUMN file_mtime INTEGER");
+    query.exec("ALTER TABLE photos ADD COLUMN file_inode INTEGER");
+    query.exec("ALTER TABLE photos ADD COLUMN file_device INTEGER");
+    // Perceptual hash of the image (PerceptualHash), to tell burst frames
+    // apart from different photos; NULL for photos scanned before it
+    query.exec("ALTER TABLE photos ADD COLUMN dhash INTEGER");
 
     // Rejections: "this face is NOT this person", so auto-matching never
     // reassigns a face the user explicitly removed from a person
@@ -213,6 +231,34 @@ bool FaceDatabase::initializeSchema()
         return false;
     }
 
+    // Folder listings of the last scan (GalleryWalker): a folder whose
+    // mtime is unchanged is not read again. Names are joined with '/',
+    // the one character a file name can't contain.
+    if (!query.exec(R"(
+        CREATE TABLE IF NOT EXISTS scanned_dirs (
+            path TEXT PRIMARY KEY,
+            mtime INTEGER NOT NULL,
+            images TEXT NOT NULL,
+            subdirs TEXT NOT NULL
+        )
+    )")) {
+        emit error("Failed to create scanned_dirs table: " + query.lastError().text());
+        return false;
+    }
+
+    // Checkpoint of an interrupted scan, see getScanQueue()
+    if (!query.exec(R"(
+        CREATE TABLE IF NOT EXISTS scan_queue (
+            position INTEGER PRIMARY KEY,
+            file_path TEXT NOT NULL UNIQUE,
+            changed INTEGER NOT NULL DEFAULT 0
+        )
+    )")) {
+        emit error("Failed to create scan_queue table: " + query.lastError().text());
+        return false;
+    }
+    query.exec("ALTER TABLE scan_queue ADD COLUMN priority INTEGER NOT NULL DEFAULT 0");
+
     // Create indexes
     query.exec("CREATE INDEX IF NOT EXISTS idx_faces_photo ON faces(photo_id)");
     query.exec("CREATE INDEX IF NOT EXISTS idx_faces_person ON faces(person_id)");
@@ -220,6 +266,19 @@ bool FaceDatabase::initializeSchema()
     query.exec("CREATE INDEX IF NOT EXISTS idx_photos_hash ON photos(file_hash)");
     query.exec("CREATE INDEX IF NOT EXISTS idx_trip_dates_trip ON trip_dates(trip_id)");
 
+    // Migrate existing database: embeddings written by QDataStream (8-byte
+    // doubles) before "embedding_storage" existed are re-encoded once
+    const QString storage = getSetting("embedding_storage");
+    if (storage.isEmpty()) {
+        if (!recodeEmbeddings(EmbeddingCodec::Float32)) {
+            emit error("Failed to migrate face embeddings");
+            return false;
+        }
+        setSetting("embedding_storage", EmbeddingCodec::formatName(EmbeddingCodec::Float32));
+    } else {
+        m_embeddingFormat = EmbeddingCodec::formatFromName(storage);
+    }
+
     qCDebug(lcNami) << "Database schema initialized";
     return true;
 }
@@ -228,17 +287,63 @@ bool FaceDatabase::initializeSchema()
 
 bool FaceDatabase::beginTransaction()
 {
-    return m_db.transaction();
+    TRACE_FUNCTION("db");
+    if (m_transactionDepth == 0) {
+        if (!m_db.transaction()) {
+            return false;
+        }
+    } else {
+        // Nested: a savepoint, so it can still be rolled back on its own
+        QSqlQuery query(m_db);
+        if (!query.exec(QString("SAVEPOINT nested_%1").arg(m_transactionDepth))) {
+            return false;
+        }
+    }
+    m_transactionDepth++;
+    return true;
 }
 
 bool FaceDatabase::commitTransaction()
 {
-    return m_db.commit();
+    TRACE_FUNCTION("db");
+    if (m_transactionDepth == 0) {
+        return false;
+    }
+
+    if (m_transactionDepth == 1) {
+        if (!m_db.commit()) {
+            return false;
+        }
+    } else {
+        QSqlQuery query(m_db);
+        if (!query.exec(QString("RELEASE nested_%1").arg(m_transactionDepth - 1))) {
+            return false;
+        }
+    }
+    m_transactionDepth--;
+    return true;
 }
 
 bool FaceDatabase::rollbackTransaction()
 {
-    return m_db.rollback();
+    TRACE_FUNCTION("db");
+    // Writes since beginTransaction() already updated the resident copies
+    dropResidentCaches();
+
+    if (m_transactionDepth == 0) {
+        return false;
+    }
+
+    bool ok;
+    if (m_transactionDepth == 1) {
+        ok = m_db.rollback();
+    } else {
+        const QString savepoint = QString("nested_%1").arg(m_transactionDepth - 1);
+        QSqlQuery query(m_db);
+        ok = query.exec("ROLLBACK TO " + savepoint) && query.exec("RELEASE " + savepoint);
+    }
+    m_transactionDepth--;
+    return ok;
 }
 
 // === Photo operations ===
@@ -246,8 +351,9 @@ bool FaceDatabase::rollbackTransaction()
 int FaceDatabase::addPhoto(const QString &filePath, const QDateTime &dateTaken,
                            int width, int height, bool hasLocation,
                            double latitude, double longitude,
-                           const QString &fileHash)
+                           const QString &fileHash, const FileFingerprint &fingerprint)
 {
+    TRACE_FUNCTION("db");
     qCDebug(lcNami) << "  → Attempting to insert photo:" << filePath;
 
     // Check if photo already exists
@@ -261,19 +367,35 @@ int FaceDatabase::addPhoto(const QString &filePath, const QDateTime &dateTaken,
         if (!fileHash.isEmpty()) {
             setPhotoHash(existingId, fileHash);  // no-op if already set
         }
+        if (fingerprint.isValid()) {
+            setPhotoFingerprints({ qMakePair(existingId, fingerprint) });
+        }
         return existingId;  // Return existing photo ID
     }
 
     QSqlQuery query(m_db);
     query.prepare(R"(
-        INSERT INTO photos (file_path, date_taken, width, height, latitude, longitude, file_hash)
-        VALUES (:file_path, :date_taken, :width, :height, :latitude, :longitude, :file_hash)
+        INSERT INTO photos (file_path, date_taken, width, height, latitude, longitude, file_hash,
+                            file_size, file_mtime, file_inode, file_device)
+        VALUES (:file_path, :date_taken, :width, :height, :latitude, :longitude, :file_hash,
+                :file_size, :file_mtime, :file_inode, :file_device)
     )");
     query.bindValue(":file_path", filePath);
     query.bindValue(":date_taken", dateTaken.toString(Qt::ISODate));
     query.bindValue(":width", width);
     query.bindValue(":height", height);
     query.bindValue(":file_hash", fileHash.isEmpty() ? QVariant(QVariant::String) : QVariant(fileHash));
+    if (fingerprint.isValid()) {
+        query.bindValue(":file_size", fingerprint.size);
+        query.bindValue(":file_mtime", fingerprint.mtimeMs);
+        query.bindValue(":file_inode", static_cast<qint64>(fingerprint.inode));
+        query.bindValue(":file_device", static_cast<qint64>(fingerprint.device));
+    } else {
+        query.bindValue(":file_size", QVariant(QVariant::LongLong));
+        query.bindValue(":file_mtime", QVariant(QVariant::LongLong));
+        query.bindValue(":file_inode", QVariant(QVariant::LongLong));
+        query.bindValue(":file_device", QVariant(QVariant::LongLong));
+    }
     if (hasLocation) {
         query.bindValue(":latitude", latitude);
         query.bindValue(":longitude", longitude);
@@ -319,6 +441,7 @@ static Photo photoFromRow(const QSqlQuery &query)
 
 Photo FaceDatabase::getPhoto(int photoId)
 {
+    TRACE_FUNCTION("db");
     QSqlQuery query(m_db);
     query.prepare("SELECT * FROM photos WHERE id = :id");
     query.bindValue(":id", photoId);
@@ -332,6 +455,7 @@ Photo FaceDatabase::getPhoto(int photoId)
 
 Photo FaceDatabase::getPhotoByPath(const QString &filePath)
 {
+    TRACE_FUNCTION("db");
     QSqlQuery query(m_db);
     query.prepare("SELECT * FROM photos WHERE file_path = :path");
     query.bindValue(":path", filePath);
@@ -365,6 +489,34 @@ bool FaceDatabase::setPhotoRotation(const QString &filePath, int rotation)
     return query.exec();
 }
 
+bool FaceDatabase::updatePhotoMetadata(int photoId, const QDateTime &dateTaken,
+                                       int width, int height, bool hasLocation,
+                                       double latitude, double longitude,
+                                       const QString &fileHash)
+{
+    TRACE_FUNCTION("db");
+    QSqlQuery query(m_db);
+    query.prepare(R"(
+        UPDATE photos SET date_taken = :date_taken, width = :width, height = :height,
+                          latitude = :latitude, longitude = :longitude, file_hash = :file_hash
+        WHERE id = :id
+    )");
+    query.bindValue(":date_taken", dateTaken.toString(Qt::ISODate));
+    query.bindValue(":width", width);
+    query.bindValue(":height", height);
+    query.bindValue(":file_hash", fileHash.isEmpty() ? QVariant(QVariant::String) : QVariant(fileHash));
+    if (hasLocation) {
+        query.bindValue(":latitude", latitude);
+        query.bindValue(":longitude", longitude);
+    } else {
+        query.bindValue(":latitude", QVariant(QVariant::Double));
+        query.bindValue(":longitude", QVariant(QVariant::Double));
+    }
+    query.bindValue(":id", photoId);
+
+    return query.exec();
+}
+
 bool FaceDatabase::setPhotoHash(int photoId, const QString &fileHash)
 {
     if (fileHash.isEmpty()) {
@@ -382,8 +534,53 @@ bool FaceDatabase::setPhotoHash(int photoId, const QString &fileHash)
     return query.exec();
 }
 
+bool FaceDatabase::setPhotoDHash(int photoId, quint64 dhash)
+{
+    QSqlQuery query(m_db);
+    query.prepare("UPDATE photos SET dhash = :dhash WHERE id = :id");
+    // The 64 bits as SQLite's signed integer
+    query.bindValue(":dhash", dhash != 0 ? QVariant(static_cast<qint64>(dhash)) : QVariant(QVariant::LongLong));
+    query.bindValue(":id", photoId);
+    return query.exec();
+}
+
+QVector<BurstIndex::Frame> FaceDatabase::getBurstFrames(int limit)
+{
+    TRACE_FUNCTION("db");
+    QVector<BurstIndex::Frame> frames;
+    QSqlQuery query(m_db);
+    query.prepare(R"(
+        SELECT id, file_path, date_taken, width, height, dhash FROM photos p
+        WHERE dhash IS NOT NULL AND processed_at IS NOT NULL
+          AND NOT EXISTS (SELECT 1 FROM faces f WHERE f.photo_id = p.id
+                          AND COALESCE(f.embedding_model, '') != :model)
+        ORDER BY date_taken DESC
+        LIMIT :limit
+    )");
+    query.bindValue(":model", m_embeddingModel);
+    query.bindValue(":limit", limit);
+    if (!query.exec()) {
+        return frames;
+    }
+
+    while (query.next()) {
+        BurstIndex::Frame frame;
+        frame.filePath = query.value("file_path").toString();
+        frame.takenMs = QDateTime::fromString(query.value("date_taken").toString(), Qt::ISODate)
+                            .toMSecsSinceEpoch();
+        frame.dhash = static_cast<quint64>(query.value("dhash").toLongLong());
+        frame.size = QSize(query.value("width").toInt(), query.value("height").toInt());
+        for (const Face &face : getFacesForPhoto(query.value("id").toInt())) {
+            frame.faces.append(ExtractedFace{ face.bbox, face.confidence, face.embedding });
+        }
+        frames.prepend(frame);
+    }
+    return frames;
+}
+
 int FaceDatabase::findPhotoByHash(const QString &fileHash)
 {
+    TRACE_FUNCTION("db");
     if (fileHash.isEmpty()) {
         return -1;
     }
@@ -398,6 +595,53 @@ int FaceDatabase::findPhotoByHash(const QString &fileHash)
     return -1;
 }
 
+int FaceDatabase::findProcessedCopy(const QString &fileHash, const QString &otherThanPath)
+{
+    TRACE_FUNCTION("db");
+    if (fileHash.isEmpty()) {
+        return -1;
+    }
+
+    QSqlQuery query(m_db);
+    query.prepare(R"(
+        SELECT id FROM photos
+        WHERE file_hash = :hash AND processed_at IS NOT NULL AND file_path != :path
+        LIMIT 1
+    )");
+    query.bindValue(":hash", fileHash);
+    query.bindValue(":path", otherThanPath);
+
+    if (query.exec() && query.next()) {
+        return query.value(0).toInt();
+    }
+    return -1;
+}
+
+QSet<quint64> FaceDatabase::getProcessedHashKeys()
+{
+    TRACE_FUNCTION("db");
+    QSet<quint64> keys;
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+
+    if (query.exec("SELECT file_hash FROM photos WHERE processed_at IS NOT NULL AND file_hash IS NOT NULL")) {
+        while (query.next()) {
+            const quint64 key = hashKey(query.value(0).toString());
+            if (key != 0) {
+                keys.insert(key);
+            }
+        }
+    }
+    return keys;
+}
+
+quint64 FaceDatabase::hashKey(const QString &fileHash)
+{
+    bool ok = false;
+    const quint64 key = fileHash.leftRef(16).toULongLong(&ok, 16);
+    return ok ? key : 0;
+}
+
 QVector<QPair<int, QString>> FaceDatabase::getPhotosMissingHash()
 {
     QVector<QPair<int, QString>> result;
@@ -442,6 +686,7 @@ QVector<Photo> FaceDatabase::getAllPhotos()
 
 bool FaceDatabase::markPhotoProcessed(int photoId)
 {
+    TRACE_FUNCTION("db");
     QSqlQuery query(m_db);
     query.prepare("UPDATE photos SET processed_at = :processed_at WHERE id = :id");
     query.bindValue(":processed_at", QDateTime::currentDateTime().toString(Qt::ISODate));
@@ -456,12 +701,15 @@ int FaceDatabase::addFace(int photoId, const QRectF &bbox, float confidence,
                           const FaceEmbedding &embedding, int personId,
                           float similarityScore, bool verified)
 {
+    TRACE_FUNCTION("db");
     QSqlQuery query(m_db);
     query.prepare(R"(
         INSERT INTO faces (photo_id, bbox_x, bbox_y, bbox_width, bbox_height,
-                          confidence, embedding, person_id, similarity_score, verified)
+                          confidence, embedding, person_id, similarity_score, verified,
+                          embedding_model)
         VALUES (:photo_id, :bbox_x, :bbox_y, :bbox_width, :bbox_height,
-                :confidence, :embedding, :person_id, :similarity_score, :verified)
+                :confidence, :embedding, :person_id, :similarity_score, :verified,
+                :embedding_model)
     )");
     query.bindValue(":photo_id", photoId);
     query.bindValue(":bbox_x", bbox.x());
@@ -469,17 +717,25 @@ int FaceDatabase::addFace(int photoId, const QRectF &bbox, float confidence,
     query.bindValue(":bbox_width", bbox.width());
     query.bindValue(":bbox_height", bbox.height());
     query.bindValue(":confidence", confidence);
-    query.bindValue(":embedding", serializeEmbedding(embedding));
+    const QByteArray blob = serializeEmbedding(embedding);
+    query.bindValue(":embedding", blob);
     query.bindValue(":person_id", personId);
     query.bindValue(":similarity_score", similarityScore);
     query.bindValue(":verified", verified ? 1 : 0);
+    query.bindValue(":embedding_model",
+                    m_embeddingModel.isEmpty() ? QVariant(QVariant::String) : QVariant(m_embeddingModel));
 
     if (!query.exec()) {
         emit error("Failed to add face: " + query.lastError().text());
         return -1;
     }
 
-    return query.lastInsertId().toInt();
+    const int faceId = query.lastInsertId().toInt();
+    if (m_unmappedLoaded && personId < 0) {
+        // As it will read back: quantized formats lose a little
+        m_unmappedEmbeddings.insert(faceId, deserializeEmbedding(blob));
+    }
+    return faceId;
 }
 
 Face FaceDatabase::getFace(int faceId)
@@ -503,15 +759,17 @@ Face FaceDatabase::getFace(int faceId)
         face.personId = query.value("person_id").toInt();
         face.similarityScore = query.value("similarity_score").toFloat();
         face.verified = query.value("verified").toInt() == 1;
+        face.ignored = query.value("ignored").toInt() == 1;
         face.detectedAt = QDateTime::fromString(query.value("detected_at").toString(), Qt::ISODate);
         return face;
     }
 
-    return Face{-1, -1, QRectF(), 0.0f, FaceEmbedding(), -1, 0.0f, false, QDateTime()};
+    return Face{-1, -1, QRectF(), 0.0f, FaceEmbedding(), -1, 0.0f, false, false, QDateTime()};
 }
 
 QVector<Face> FaceDatabase::getFacesForPhoto(int photoId)
 {
+    TRACE_FUNCTION("db");
     QVector<Face> faces;
     QSqlQuery query(m_db);
     query.prepare("SELECT * FROM faces WHERE photo_id = :photo_id");
@@ -533,7 +791,9 @@ QVector<Face> FaceDatabase::getFacesForPhoto(int photoId)
             face.personId = query.value("person_id").toInt();
             face.similarityScore = query.value("similarity_score").toFloat();
             face.verified = query.value("verified").toInt() == 1;
+            face.ignored = query.value("ignored").toInt() == 1;
             face.detectedAt = QDateTime::fromString(query.value("detected_at").toString(), Qt::ISODate);
+            face.embeddingModel = query.value("embedding_model").toString();
             faces.append(face);
         }
     }
@@ -562,6 +822,7 @@ QVector<Face> FaceDatabase::getUnmappedFaces()
             face.personId = query.value("person_id").toInt();
             face.similarityScore = query.value("similarity_score").toFloat();
             face.verified = query.value("verified").toInt() == 1;
+            face.ignored = query.value("ignored").toInt() == 1;
             face.detectedAt = QDateTime::fromString(query.value("detected_at").toString(), Qt::ISODate);
             faces.append(face);
         }
@@ -570,14 +831,153 @@ QVector<Face> FaceDatabase::getUnmappedFaces()
     return faces;
 }
 
+QVector<QPair<int, FaceEmbedding>> FaceDatabase::getUnmappedEmbeddings()
+{
+    TRACE_FUNCTION("db");
+    const QHash<int, FaceEmbedding> &resident = unmappedEmbeddings();
+
+    QVector<QPair<int, FaceEmbedding>> faces;
+    faces.reserve(resident.size());
+    for (auto it = resident.constBegin(); it != resident.constEnd(); ++it) {
+        faces.append(qMakePair(it.key(), it.value()));
+    }
+    return faces;
+}
+
+const QHash<int, FaceEmbedding> &FaceDatabase::unmappedEmbeddings()
+{
+    ensureUnmappedLoaded();
+    return m_unmappedEmbeddings;
+}
+
+void FaceDatabase::ensureUnmappedLoaded()
+{
+    if (m_unmappedLoaded) {
+        return;
+    }
+
+    m_unmappedEmbeddings.clear();
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+
+    if (!query.exec("SELECT id, embedding FROM faces WHERE person_id = -1 AND ignored = 0")) {
+        qWarning() << "Failed to load unmapped embeddings:" << query.lastError().text();
+        return;
+    }
+    while (query.next()) {
+        m_unmappedEmbeddings.insert(query.value(0).toInt(),
+                                    deserializeEmbedding(query.value(1).toByteArray()));
+    }
+    m_unmappedLoaded = true;
+    qCDebug(lcNami) << "Loaded" << m_unmappedEmbeddings.size() << "unmapped embeddings";
+}
+
+void FaceDatabase::ensureNegativeMatchesLoaded()
+{
+    if (m_negativeMatchesLoaded) {
+        return;
+    }
+
+    m_negativeMatches.clear();
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+
+    if (!query.exec("SELECT face_id, person_id FROM negative_matches")) {
+        qWarning() << "Failed to load negative matches:" << query.lastError().text();
+        return;
+    }
+    while (query.next()) {
+        m_negativeMatches[query.value(0).toInt()].insert(query.value(1).toInt());
+    }
+    m_negativeMatchesLoaded = true;
+}
+
+void FaceDatabase::refreshUnmapped(int faceId)
+{
+    if (!m_unmappedLoaded) {
+        return;
+    }
+
+    QSqlQuery query(m_db);
+    query.prepare("SELECT embedding FROM faces WHERE id = :id AND person_id = -1 AND ignored = 0");
+    query.bindValue(":id", faceId);
+    if (!query.exec()) {
+        dropResidentCaches();
+        return;
+    }
+
+    if (query.next()) {
+        m_unmappedEmbeddings.insert(faceId, deserializeEmbedding(query.value(0).toByteArray()));
+    } else {
+        m_unmappedEmbeddings.remove(faceId);
+    }
+}
+
+void FaceDatabase::dropResidentCaches()
+{
+    m_unmappedEmbeddings.clear();
+    m_unmappedLoaded = false;
+    m_negativeMatches.clear();
+    m_negativeMatchesLoaded = false;
+}
+
 bool FaceDatabase::updateFacePersonMapping(int faceId, int personId)
 {
+    TRACE_FUNCTION("db");
     QSqlQuery query(m_db);
     query.prepare("UPDATE faces SET person_id = :person_id WHERE id = :id");
     query.bindValue(":person_id", personId);
     query.bindValue(":id", faceId);
 
-    return query.exec();
+    if (!query.exec()) {
+        return false;
+    }
+
+    if (personId >= 0) {
+        m_unmappedEmbeddings.remove(faceId);
+    } else {
+        refreshUnmapped(faceId);
+    }
+    return true;
+}
+
+int FaceDatabase::assignFaces(int personId, const QVector<QPair<int, float>> &faces)
+{
+    if (faces.isEmpty()) {
+        return 0;
+    }
+    if (!beginTransaction()) {
+        return -1;
+    }
+
+    QSqlQuery query(m_db);
+    query.prepare("UPDATE faces SET person_id = :person_id, similarity_score = :similarity_score, "
+                  "verified = 0 WHERE id = :id AND person_id = -1 AND ignored = 0");
+
+    QVector<int> assigned;
+    for (const auto &face : faces) {
+        query.bindValue(":person_id", personId);
+        query.bindValue(":similarity_score", face.second);
+        query.bindValue(":id", face.first);
+        if (!query.exec()) {
+            qWarning() << "Failed to assign face:" << query.lastError().text();
+            rollbackTransaction();
+            return -1;
+        }
+        if (query.numRowsAffected() > 0) {
+            assigned.append(face.first);
+        }
+    }
+
+    if (!commitTransaction()) {
+        rollbackTransaction();
+        return -1;
+    }
+
+    for (int faceId : assigned) {
+        m_unmappedEmbeddings.remove(faceId);
+    }
+    return assigned.size();
 }
 
 bool FaceDatabase::updateFaceMetadata(int faceId, float similarityScore, bool verified)
@@ -597,7 +997,11 @@ bool FaceDatabase::removeFaceFromPerson(int faceId)
     query.prepare("UPDATE faces SET person_id = -1, verified = 0 WHERE id = :id");
     query.bindValue(":id", faceId);
 
-    return query.exec();
+    if (!query.exec()) {
+        return false;
+    }
+    refreshUnmapped(faceId);
+    return true;
 }
 
 bool FaceDatabase::removePersonFromPhoto(int personId, int photoId)
@@ -624,7 +1028,34 @@ bool FaceDatabase::removePersonFromPhoto(int personId, int photoId)
     upd.bindValue(":photo", photoId);
     upd.bindValue(":person", personId);
 
-    return upd.exec();
+    if (!upd.exec()) {
+        return false;
+    }
+    for (int faceId : faceIds) {
+        refreshUnmapped(faceId);
+    }
+    return true;
+}
+
+bool FaceDatabase::setFaceEmbeddingModel(int faceId, const QString &model)
+{
+    QSqlQuery query(m_db);
+    query.prepare("UPDATE faces SET embedding_model = :model WHERE id = :id");
+    query.bindValue(":model", model.isEmpty() ? QVariant(QVariant::String) : QVariant(model));
+    query.bindValue(":id", faceId);
+    return query.exec();
+}
+
+QVariantMap FaceDatabase::countFacesByEmbeddingModel()
+{
+    QVariantMap counts;
+    QSqlQuery query(m_db);
+    if (query.exec("SELECT COALESCE(embedding_model, ''), COUNT(*) FROM faces GROUP BY 1")) {
+        while (query.next()) {
+            counts.insert(query.value(0).toString(), query.value(1).toInt());
+        }
+    }
+    return counts;
 }
 
 bool FaceDatabase::setFaceIgnored(int faceId, bool ignored)
@@ -634,7 +1065,15 @@ bool FaceDatabase::setFaceIgnored(int faceId, bool ignored)
     query.bindValue(":ignored", ignored ? 1 : 0);
     query.bindValue(":id", faceId);
 
-    return query.exec();
+    if (!query.exec()) {
+        return false;
+    }
+    if (ignored) {
+        m_unmappedEmbeddings.remove(faceId);
+    } else {
+        refreshUnmapped(faceId);
+    }
+    return true;
 }
 
 bool FaceDatabase::addNegativeMatch(int faceId, int personId)
@@ -644,33 +1083,26 @@ bool FaceDatabase::addNegativeMatch(int faceId, int personId)
     query.bindValue(":face_id", faceId);
     query.bindValue(":person_id", personId);
 
-    return query.exec();
+    if (!query.exec()) {
+        return false;
+    }
+    if (m_negativeMatchesLoaded) {
+        m_negativeMatches[faceId].insert(personId);
+    }
+    return true;
 }
 
 bool FaceDatabase::hasNegativeMatch(int faceId, int personId)
 {
-    QSqlQuery query(m_db);
-    query.prepare("SELECT 1 FROM negative_matches WHERE face_id = :face_id AND person_id = :person_id");
-    query.bindValue(":face_id", faceId);
-    query.bindValue(":person_id", personId);
-
-    return query.exec() && query.next();
+    ensureNegativeMatchesLoaded();
+    auto it = m_negativeMatches.constFind(faceId);
+    return it != m_negativeMatches.constEnd() && it.value().contains(personId);
 }
 
 QSet<int> FaceDatabase::getNegativeMatches(int faceId)
 {
-    QSet<int> people;
-    QSqlQuery query(m_db);
-    query.prepare("SELECT person_id FROM negative_matches WHERE face_id = :face_id");
-    query.bindValue(":face_id", faceId);
-
-    if (query.exec()) {
-        while (query.next()) {
-            people.insert(query.value(0).toInt());
-        }
-    }
-
-    return people;
+    ensureNegativeMatchesLoaded();
+    return m_negativeMatches.value(faceId);
 }
 
 QSet<int> FaceDatabase::getPeopleAroundDate(const QDateTime &date, int days)
@@ -703,6 +1135,21 @@ QSet<int> FaceDatabase::getPeopleAroundDate(const QDateTime &date, int days)
 
 bool FaceDatabase::deleteFacesForPhoto(int photoId)
 {
+    TRACE_FUNCTION("db");
+    if (m_unmappedLoaded || m_negativeMatchesLoaded) {
+        QSqlQuery sel(m_db);
+        sel.prepare("SELECT id FROM faces WHERE photo_id = :photo_id");
+        sel.bindValue(":photo_id", photoId);
+        if (!sel.exec()) {
+            dropResidentCaches();
+        }
+        while (sel.next()) {
+            const int faceId = sel.value(0).toInt();
+            m_unmappedEmbeddings.remove(faceId);
+            m_negativeMatches.remove(faceId);
+        }
+    }
+
     QSqlQuery cleanup(m_db);
     cleanup.prepare(R"(
         DELETE FROM negative_matches
@@ -720,6 +1167,7 @@ bool FaceDatabase::deleteFacesForPhoto(int photoId)
 
 int FaceDatabase::removeMissingPhotos()
 {
+    TRACE_FUNCTION("db");
     QSqlQuery sel(m_db);
     if (!sel.exec("SELECT id, file_path FROM photos")) {
         qWarning() << "Could not list photos to prune:" << sel.lastError().text();
@@ -786,18 +1234,222 @@ int FaceDatabase::removeMissingPhotos()
     return gone.size();
 }
 
-QSet<QString> FaceDatabase::getProcessedFilePaths()
+QVector<StoredFingerprint> FaceDatabase::getPhotoFingerprints(const QString &folder,
+                                                              const QDateTime &processedSince)
 {
-    QSet<QString> paths;
+    TRACE_FUNCTION("db");
+    QVector<StoredFingerprint> photos;
     QSqlQuery query(m_db);
+    query.setForwardOnly(true);
 
-    if (query.exec("SELECT file_path FROM photos WHERE processed_at IS NOT NULL")) {
-        while (query.next()) {
-            paths.insert(query.value(0).toString());
+    // processed_at is stored as a local ISO date, which sorts as text
+    QString sql = QString("SELECT id, file_path, %1, "
+                          "file_size, file_mtime, file_inode, file_device FROM photos")
+                      .arg(processedSince.isValid() ? "IFNULL(processed_at >= :since, 0)"
+                                                    : "processed_at IS NOT NULL");
+    if (!folder.isEmpty()) {
+        // A range on idx_photos_path ('0' is the character after '/'),
+        // minus the subfolders
+        sql += " WHERE file_path >= :from AND file_path < :to"
+               " AND instr(substr(file_path, length(:prefix) + 1), '/') = 0";
+    }
+    query.prepare(sql);
+    if (!folder.isEmpty()) {
+        query.bindValue(":from", folder + '/');
+        query.bindValue(":to", folder + '0');
+        query.bindValue(":prefix", folder + '/');
+    }
+    if (processedSince.isValid()) {
+        query.bindValue(":since", processedSince.toString(Qt::ISODate));
+    }
+
+    if (!query.exec()) {
+        qWarning() << "Failed to read photo fingerprints:" << query.lastError().text();
+        return photos;
+    }
+
+    while (query.next()) {
+        StoredFingerprint photo;
+        photo.photoId = query.value(0).toInt();
+        photo.filePath = query.value(1).toString();
+        photo.processed = query.value(2).toBool();
+        if (!query.value(3).isNull()) {
+            photo.fingerprint.size = query.value(3).toLongLong();
+            photo.fingerprint.mtimeMs = query.value(4).toLongLong();
+            photo.fingerprint.inode = static_cast<quint64>(query.value(5).toLongLong());
+            photo.fingerprint.device = static_cast<quint64>(query.value(6).toLongLong());
+        }
+        photos.append(photo);
+    }
+
+    return photos;
+}
+
+bool FaceDatabase::setPhotoFingerprints(const QVector<QPair<int, FileFingerprint>> &fingerprints)
+{
+    TRACE_FUNCTION("db");
+    if (fingerprints.isEmpty()) {
+        return true;
+    }
+    if (!beginTransaction()) {
+        return false;
+    }
+
+    QSqlQuery query(m_db);
+    query.prepare("UPDATE photos SET file_size = :size, file_mtime = :mtime, "
+                  "file_inode = :inode, file_device = :device WHERE id = :id");
+    for (const auto &entry : fingerprints) {
+        query.bindValue(":size", entry.second.size);
+        query.bindValue(":mtime", entry.second.mtimeMs);
+        query.bindValue(":inode", static_cast<qint64>(entry.second.inode));
+        query.bindValue(":device", static_cast<qint64>(entry.second.device));
+        query.bindValue(":id", entry.first);
+        if (!query.exec()) {
+            qWarning() << "Failed to store fingerprint:" << query.lastError().text();
+            rollbackTransaction();
+            return false;
+        }
+    }
+
+    return commitTransaction();
+}
+
+QHash<QString, DirListing> FaceDatabase::getScannedDirs()
+{
+    TRACE_FUNCTION("db");
+    QHash<QString, DirListing> dirs;
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+
+    if (!query.exec("SELECT path, mtime, images, subdirs FROM scanned_dirs")) {
+        qWarning() << "Failed to read scanned folders:" << query.lastError().text();
+        return dirs;
+    }
+
+    while (query.next()) {
+        DirListing listing;
+        listing.mtimeMs = query.value(1).toLongLong();
+        listing.images = query.value(2).toString().split('/', QString::SkipEmptyParts);
+        listing.subdirs = query.value(3).toString().split('/', QString::SkipEmptyParts);
+        dirs.insert(query.value(0).toString(), listing);
+    }
+
+    return dirs;
+}
+
+bool FaceDatabase::updateScannedDirs(const QHash<QString, DirListing> &listings,
+                                     const QStringList &removed)
+{
+    TRACE_FUNCTION("db");
+    if (listings.isEmpty() && removed.isEmpty()) {
+        return true;
+    }
+    if (!beginTransaction()) {
+        return false;
+    }
+
+    QSqlQuery store(m_db);
+    store.prepare("INSERT OR REPLACE INTO scanned_dirs (path, mtime, images, subdirs) "
+                  "VALUES (:path, :mtime, :images, :subdirs)");
+    for (auto it = listings.constBegin(); it != listings.constEnd(); ++it) {
+        store.bindValue(":path", it.key());
+        store.bindValue(":mtime", it.value().mtimeMs);
+        store.bindValue(":images", it.value().images.join('/'));
+        store.bindValue(":subdirs", it.value().subdirs.join('/'));
+        if (!store.exec()) {
+            qWarning() << "Failed to store scanned folder:" << store.lastError().text();
+            rollbackTransaction();
+            return false;
+        }
+    }
+
+    QSqlQuery drop(m_db);
+    drop.prepare("DELETE FROM scanned_dirs WHERE path = :path");
+    for (const QString &path : removed) {
+        drop.bindValue(":path", path);
+        if (!drop.exec()) {
+            rollbackTransaction();
+            return false;
         }
     }
 
-    return paths;
+    return commitTransaction();
+}
+
+QVector<ScanItem> FaceDatabase::getScanQueue()
+{
+    TRACE_FUNCTION("db");
+    QVector<ScanItem> items;
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+
+    if (!query.exec("SELECT file_path, changed, priority FROM scan_queue "
+                    "ORDER BY priority DESC, position")) {
+        qWarning() << "Failed to read the scan checkpoint:" << query.lastError().text();
+        return items;
+    }
+
+    while (query.next()) {
+        items.append(ScanItem{query.value(0).toString(), query.value(1).toBool(),
+                              query.value(2).toLongLong()});
+    }
+
+    return items;
+}
+
+bool FaceDatabase::appendScanQueue(const QVector<ScanItem> &items)
+{
+    TRACE_FUNCTION("db");
+    if (items.isEmpty()) {
+        return true;
+    }
+    if (!beginTransaction()) {
+        return false;
+    }
+
+    QSqlQuery query(m_db);
+    query.prepare("INSERT OR IGNORE INTO scan_queue (file_path, changed, priority) "
+                  "VALUES (:path, :changed, :priority)");
+    for (const ScanItem &item : items) {
+        query.bindValue(":path", item.filePath);
+        query.bindValue(":changed", item.changed ? 1 : 0);
+        query.bindValue(":priority", item.priority);
+        if (!query.exec()) {
+            qWarning() << "Failed to checkpoint the scan:" << query.lastError().text();
+            rollbackTransaction();
+            return false;
+        }
+    }
+
+    return commitTransaction();
+}
+
+bool FaceDatabase::removeFromScanQueue(const QString &filePath)
+{
+    TRACE_FUNCTION("db");
+    QSqlQuery query(m_db);
+    query.prepare("DELETE FROM scan_queue WHERE file_path = :path");
+    query.bindValue(":path", filePath);
+    return query.exec();
+}
+
+bool FaceDatabase::isInScanQueue(const QString &filePath)
+{
+    TRACE_FUNCTION("db");
+    QSqlQuery query(m_db);
+    query.prepare("SELECT 1 FROM scan_queue WHERE file_path = :path");
+    query.bindValue(":path", filePath);
+    return query.exec() && query.next();
+}
+
+bool FaceDatabase::clearScanQueue()
+{
+    QSqlQuery query(m_db);
+    if (!query.exec("DELETE FROM scan_queue")) {
+        qWarning() << "Failed to clear the scan checkpoint:" << query.lastError().text();
+        return false;
+    }
+    return true;
 }
 
 // === Person operations ===
@@ -816,6 +1468,75 @@ int FaceDatabase::createPerson(const QString &name)
     return query.lastInsertId().toInt();
 }
 
+int FaceDatabase::createPeopleFromGroups(const QVector<QVector<int>> &groups, int minGroupSize,
+                                         int *facesAssigned)
+{
+    if (!beginTransaction()) {
+        return -1;
+    }
+
+    QSqlQuery insertPerson(m_db);
+    insertPerson.prepare("INSERT INTO people (name) VALUES (:name)");
+    QSqlQuery assign(m_db);
+    assign.prepare("UPDATE faces SET person_id = :person_id "
+                   "WHERE id = :id AND person_id = -1 AND ignored = 0");
+    QSqlQuery release(m_db);
+    release.prepare("UPDATE faces SET person_id = -1 WHERE person_id = :person_id");
+    QSqlQuery deletePerson(m_db);
+    deletePerson.prepare("DELETE FROM people WHERE id = :id");
+
+    int created = 0;
+    QVector<int> claimed;
+    for (const QVector<int> &group : groups) {
+        insertPerson.bindValue(":name", QString("Person %1").arg(created + 1));
+        if (!insertPerson.exec()) {
+            qWarning() << "Failed to create person:" << insertPerson.lastError().text();
+            rollbackTransaction();
+            return -1;
+        }
+        const int personId = insertPerson.lastInsertId().toInt();
+
+        int assigned = 0;
+        for (int faceId : group) {
+            assign.bindValue(":person_id", personId);
+            assign.bindValue(":id", faceId);
+            if (!assign.exec()) {
+                qWarning() << "Failed to assign face:" << assign.lastError().text();
+                rollbackTransaction();
+                return -1;
+            }
+            if (assign.numRowsAffected() > 0) {
+                claimed.append(faceId);
+                assigned++;
+            }
+        }
+
+        // Too few faces left for a group: they stay unmapped
+        if (assigned < minGroupSize) {
+            claimed.resize(claimed.size() - assigned);
+            release.bindValue(":person_id", personId);
+            release.exec();
+            deletePerson.bindValue(":id", personId);
+            deletePerson.exec();
+            continue;
+        }
+        created++;
+    }
+
+    if (!commitTransaction()) {
+        rollbackTransaction();
+        return -1;
+    }
+
+    for (int faceId : claimed) {
+        m_unmappedEmbeddings.remove(faceId);
+    }
+    if (facesAssigned) {
+        *facesAssigned = claimed.size();
+    }
+    return created;
+}
+
 Person FaceDatabase::getPerson(int personId)
 {
     QSqlQuery query(m_db);
@@ -843,6 +1564,7 @@ Person FaceDatabase::getPerson(int personId)
 
 QVector<Person> FaceDatabase::getAllPeople()
 {
+    TRACE_FUNCTION("db");
     QVector<Person> people;
     QSqlQuery query(m_db);
 
@@ -895,7 +1617,7 @@ bool FaceDatabase::setPersonContact(int personId, const QString &contactId)
 
 bool FaceDatabase::deletePerson(int personId)
 {
-    m_db.transaction();
+    beginTransaction();
 
     // Unmap all faces for this person
     QSqlQuery query1(m_db);
@@ -903,7 +1625,7 @@ bool FaceDatabase::deletePerson(int personId)
     query1.bindValue(":person_id", personId);
 
     if (!query1.exec()) {
-        m_db.rollback();
+        rollbackTransaction();
         return false;
     }
 
@@ -913,7 +1635,7 @@ bool FaceDatabase::deletePerson(int personId)
     query2.bindValue(":id", personId);
 
     if (!query2.exec()) {
-        m_db.rollback();
+        rollbackTransaction();
         return false;
     }
 
@@ -923,13 +1645,16 @@ bool FaceDatabase::deletePerson(int personId)
     query3.bindValue(":person_id", personId);
     query3.exec();
 
-    m_db.commit();
+    commitTransaction();
+
+    // Every face of theirs is unmapped again
+    dropResidentCaches();
     return true;
 }
 
 bool FaceDatabase::mergePersons(int fromPersonId, int intoPersonId)
 {
-    m_db.transaction();
+    beginTransaction();
 
     // Reassign faces (verified flags and similarity scores carry over)
     QSqlQuery moveFaces(m_db);
@@ -937,7 +1662,7 @@ bool FaceDatabase::mergePersons(int fromPersonId, int intoPersonId)
     moveFaces.bindValue(":into", intoPersonId);
     moveFaces.bindValue(":from", fromPersonId);
     if (!moveFaces.exec()) {
-        m_db.rollback();
+        rollbackTransaction();
         return false;
     }
 
@@ -950,7 +1675,7 @@ bool FaceDatabase::mergePersons(int fromPersonId, int intoPersonId)
     moveRejections.bindValue(":into", intoPersonId);
     moveRejections.bindValue(":from", fromPersonId);
     if (!moveRejections.exec()) {
-        m_db.rollback();
+        rollbackTransaction();
         return false;
     }
 
@@ -963,11 +1688,15 @@ bool FaceDatabase::mergePersons(int fromPersonId, int intoPersonId)
     dropPerson.prepare("DELETE FROM people WHERE id = :from");
     dropPerson.bindValue(":from", fromPersonId);
     if (!dropPerson.exec()) {
-        m_db.rollback();
+        rollbackTransaction();
         return false;
     }
 
-    m_db.commit();
+    commitTransaction();
+
+    // Rejections moved to the surviving person
+    m_negativeMatches.clear();
+    m_negativeMatchesLoaded = false;
     return true;
 }
 
@@ -1065,6 +1794,7 @@ QVector<Face> FaceDatabase::getFacesForPerson(int personId)
             face.personId = query.value("person_id").toInt();
             face.similarityScore = query.value("similarity_score").toFloat();
             face.verified = query.value("verified").toInt() == 1;
+            face.ignored = query.value("ignored").toInt() == 1;
             face.detectedAt = QDateTime::fromString(query.value("detected_at").toString(), Qt::ISODate);
             faces.append(face);
         }
@@ -1088,7 +1818,7 @@ Face FaceDatabase::getBestFaceForPerson(int personId)
         return getFace(query.value(0).toInt());
     }
 
-    return Face{-1, -1, QRectF(), 0.0f, FaceEmbedding(), -1, 0.0f, false, QDateTime()};
+    return Face{-1, -1, QRectF(), 0.0f, FaceEmbedding(), -1, 0.0f, false, false, QDateTime()};
 }
 
 QVector<FaceEmbedding> FaceDatabase::getPersonExemplars(int personId, int maxCount)
@@ -1170,7 +1900,9 @@ QJsonObject FaceDatabase::exportBackup()
 {
     QJsonObject root;
     root["app"] = "harbour-nami";
-    root["backup_version"] = 1;
+    // 2: embedding blobs in EmbeddingCodec format (1: QDataStream doubles);
+    // import reads both
+    root["backup_version"] = 2;
     root["exported_at"] = QDateTime::currentDateTime().toString(Qt::ISODate);
 
     QVector<Person> people = getAllPeople();
@@ -1232,6 +1964,9 @@ QJsonObject FaceDatabase::exportBackup()
             f["ignored"] = faceQuery.value("ignored").toInt() == 1;
             f["detected_at"] = faceQuery.value("detected_at").toString();
             f["embedding"] = QString::fromLatin1(faceQuery.value("embedding").toByteArray().toBase64());
+            if (!faceQuery.value("embedding_model").isNull()) {
+                f["embedding_model"] = faceQuery.value("embedding_model").toString();
+            }
             facesArray.append(f);
         }
     }
@@ -1428,6 +2163,9 @@ FaceDatabase::ImportStats FaceDatabase::importBackup(const QJsonObject &root)
             if (f["ignored"].toBool()) {
                 setFaceIgnored(faceId, true);
             }
+            // Not this device's current model: the one the backup's was
+            // computed with, or unknown for backups from before it
+            setFaceEmbeddingModel(faceId, f["embedding_model"].toString());
             stats.facesImported++;
             faceIdByKey[faceKey(photoPath, bboxArr)] = faceId;
         }
@@ -1468,12 +2206,13 @@ FaceDatabase::ImportStats FaceDatabase::importBackup(const QJsonObject &root)
     }
 
     commitTransaction();
+    dropResidentCaches();
     return stats;
 }
 
 bool FaceDatabase::deleteAllData()
 {
-    m_db.transaction();
+    beginTransaction();
 
     QSqlQuery query(m_db);
 
@@ -1484,21 +2223,26 @@ bool FaceDatabase::deleteAllData()
         !query.exec("DELETE FROM trip_dates") ||
         !query.exec("DELETE FROM trips") ||
         !query.exec("DELETE FROM event_covers") ||
-        !query.exec("DELETE FROM hidden_events")) {
-        m_db.rollback();
+        !query.exec("DELETE FROM hidden_events") ||
+        !query.exec("DELETE FROM scan_queue")) {
+        rollbackTransaction();
         return false;
     }
 
-    m_db.commit();
+    commitTransaction();
+    dropResidentCaches();
 
-    // Reclaim space and purge deleted embeddings from free pages
-    query.exec("VACUUM");
+    // Reclaim space and purge deleted embeddings from free pages. Not
+    // possible inside a caller's transaction; the next delete-all does it.
+    if (m_transactionDepth == 0) {
+        query.exec("VACUUM");
+    }
     return true;
 }
 
 bool FaceDatabase::clearFaceData()
 {
-    m_db.transaction();
+    beginTransaction();
 
     QSqlQuery query(m_db);
 
@@ -1507,16 +2251,18 @@ bool FaceDatabase::clearFaceData()
         !query.exec("DELETE FROM faces") ||
         !query.exec("DELETE FROM people") ||
         !query.exec("UPDATE photos SET processed_at = NULL")) {
-        m_db.rollback();
+        rollbackTransaction();
         return false;
     }
 
-    m_db.commit();
+    commitTransaction();
+    dropResidentCaches();
     return true;
 }
 
 QString FaceDatabase::getSetting(const QString &key, const QString &defaultValue)
 {
+    TRACE_FUNCTION("db");
     QSqlQuery query(m_db);
     query.prepare("SELECT value FROM settings WHERE key = :key");
     query.bindValue(":key", key);
@@ -1530,6 +2276,7 @@ QString FaceDatabase::getSetting(const QString &key, const QString &defaultValue
 
 bool FaceDatabase::setSetting(const QString &key, const QString &value)
 {
+    TRACE_FUNCTION("db");
     QSqlQuery query(m_db);
     query.prepare("INSERT OR REPLACE INTO settings (key, value) VALUES (:key, :value)");
     query.bindValue(":key", key);
@@ -1540,6 +2287,7 @@ bool FaceDatabase::setSetting(const QString &key, const QString &value)
 
 QVariantMap FaceDatabase::getStatistics()
 {
+    TRACE_FUNCTION("db");
     QVariantMap stats;
     QSqlQuery query(m_db);
 
@@ -1767,6 +2515,7 @@ QVariantMap FaceDatabase::getEventCovers()
 
 QVector<Photo> FaceDatabase::getRecentPhotos(int limit)
 {
+    TRACE_FUNCTION("db");
     QVector<Photo> photos;
     QSqlQuery query(m_db);
     query.prepare(R"(
@@ -1803,29 +2552,96 @@ QVector<Photo> FaceDatabase::getRecentPhotos(int limit)
 
 QByteArray FaceDatabase::serializeEmbedding(const FaceEmbedding &embedding)
 {
-    QByteArray data;
-    QDataStream stream(&data, QIODevice::WriteOnly);
+    return EmbeddingCodec::encode(embedding, m_embeddingFormat);
+}
+
+FaceEmbedding FaceDatabase::deserializeEmbedding(const QByteArray &data)
+{
+    return EmbeddingCodec::decode(data);
+}
 
-    stream << static_cast<quint32>(embedding.size());
-    for (float val : embedding) {
-        stream << val;
+bool FaceDatabase::setEmbeddingStorage(EmbeddingCodec::Format format)
+{
+    if (!recodeEmbeddings(format)) {
+        return false;
     }
 
-    return data;
+    m_embeddingFormat = format;
+    return setSetting("embedding_storage", EmbeddingCodec::formatName(format));
 }
 
-FaceEmbedding FaceDatabase::deserializeEmbedding(const QByteArray &data)
+bool FaceDatabase::recodeEmbeddings(EmbeddingCodec::Format format)
 {
-    QDataStream stream(data);
-    quint32 size;
-    stream >> size;
+    // Keyset batches: never more than a few hundred blobs in memory, and
+    // each SELECT is finished before its rows are updated
+    const int batchSize = 500;
+    int lastId = 0;
+    int recoded = 0;
+
+    if (!beginTransaction()) {
+        return false;
+    }
+
+    QSqlQuery select(m_db);
+    select.prepare("SELECT id, embedding FROM faces WHERE id > :last ORDER BY id LIMIT :limit");
+    QSqlQuery update(m_db);
+    update.prepare("UPDATE faces SET embedding = :embedding WHERE id = :id");
+
+    int rowsRead;
+    do {
+        select.bindValue(":last", lastId);
+        select.bindValue(":limit", batchSize);
+        if (!select.exec()) {
+            qWarning() << "Failed to read embeddings:" << select.lastError().text();
+            rollbackTransaction();
+            return false;
+        }
 
-    FaceEmbedding embedding(size);
-    for (quint32 i = 0; i < size; i++) {
-        stream >> embedding[i];
+        QVector<QPair<int, QByteArray>> batch;
+        rowsRead = 0;
+        while (select.next()) {
+            rowsRead++;
+            lastId = select.value(0).toInt();
+            const QByteArray blob = select.value(1).toByteArray();
+            if (!EmbeddingCodec::isFormat(blob, format)) {
+                batch.append(qMakePair(lastId, blob));
+            }
+        }
+        select.finish();
+
+        for (const auto &row : batch) {
+            update.bindValue(":embedding",
+                             EmbeddingCodec::encode(EmbeddingCodec::decode(row.second), format));
+            update.bindValue(":id", row.first);
+            if (!update.exec()) {
+                qWarning() << "Failed to rewrite embedding:" << update.lastError().text();
+                rollbackTransaction();
+                return false;
+            }
+            recoded++;
+        }
+    } while (rowsRead == batchSize);
+
+    if (!commitTransaction()) {
+        return false;
     }
 
-    return embedding;
+    if (recoded > 0) {
+        // Quantized formats read back slightly differently
+        dropResidentCaches();
+
+        qCDebug(lcNami) << "Re-encoded" << recoded << "embeddings as"
+                        << EmbeddingCodec::formatName(format);
+
+        // Blobs shrank: hand the freed pages back to the filesystem (not
+        // possible inside a caller's transaction)
+        if (m_transactionDepth == 0) {
+            QSqlQuery vacuum(m_db);
+            vacuum.exec("VACUUM");
+        }
+    }
+
+    return true;
 }
 
 int FaceDatabase::findClosestUnassignedFace(int photoId, const QRectF &bbox)
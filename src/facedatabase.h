@@ -6,6 +6,7 @@
 #include <QStringList>
 #include <QVector>
 #include <QSet>
+#include <QHash>
 #include <QVariantMap>
 #include <QDateTime>
 #include <QSqlDatabase>
@@ -13,6 +14,11 @@
 #include <QPair>
 #include <QRectF>
 #include "faceembedding.h"
+#include "embeddingcodec.h"
+#include "filefingerprint.h"
+#include "burstindex.h"
+#include "gallerywalker.h"
+#include "scanqueue.h"
 
 /**
  * @brief Photo record
@@ -80,7 +86,9 @@ struct Face {
     int personId;  // -1 if unmapped
     float similarityScore;  // Similarity score when matched (0.0-1.0)
     bool verified;  // true if manually verified by user
+    bool ignored;   // dismissed by the user: never matched or grouped
     QDateTime detectedAt;
+    QString embeddingModel;  // ModelRegistry::modelId(), empty if not recorded
 };
 
 /**
@@ -119,10 +127,14 @@ public:
     bool initializeSchema();
 
     // === Transactions (batch several writes, e.g. one photo commit) ===
+    // They nest: inside an open transaction, begin/commit/rollback act on a
+    // savepoint, so every helper here can batch its own writes even while
+    // a scan holds a transaction open across many photos.
 
     bool beginTransaction();
     bool commitTransaction();
     bool rollbackTransaction();
+    bool inTransaction() const { return m_transactionDepth > 0; }
 
     // === Photo operations ===
 
@@ -131,25 +143,72 @@ public:
      *
      * If the photo already exists (same file_path) and fileHash is given
      * while the stored row has none yet, the row is backfilled with it.
+     * A valid fingerprint is stored either way: it describes the file the
+     * caller has just read.
      *
      * @return Photo ID or -1 on error
      */
     int addPhoto(const QString &filePath, const QDateTime &dateTaken,
                  int width, int height, bool hasLocation = false,
                  double latitude = 0.0, double longitude = 0.0,
-                 const QString &fileHash = QString());
+                 const QString &fileHash = QString(),
+                 const FileFingerprint &fingerprint = FileFingerprint());
+
+    /**
+     * @brief Overwrite what was read from a photo's file, after it changed
+     *
+     * Unlike addPhoto() on an existing row, the hash is replaced too.
+     */
+    bool updatePhotoMetadata(int photoId, const QDateTime &dateTaken,
+                             int width, int height, bool hasLocation,
+                             double latitude, double longitude,
+                             const QString &fileHash);
 
     /**
      * @brief Store (or backfill) a photo's content hash
      */
     bool setPhotoHash(int photoId, const QString &fileHash);
 
+    /**
+     * @brief Store a photo's perceptual hash (PerceptualHash::dHash())
+     *
+     * Only for photos a burst may start from: the models ran on them and
+     * their capture time is from EXIF. 0 clears it.
+     */
+    bool setPhotoDHash(int photoId, quint64 dhash);
+
+    /**
+     * @brief The most recently taken photos with a perceptual hash, as
+     *        BurstIndex frames, oldest first
+     *
+     * Photos whose faces were embedded by another model than the current
+     * one (setEmbeddingModel()) are left out.
+     */
+    QVector<BurstIndex::Frame> getBurstFrames(int limit);
+
     /**
      * @brief Find a photo by content hash (used when its path has changed)
      * @return Photo ID, or -1 if no photo has this hash
      */
     int findPhotoByHash(const QString &fileHash);
 
+    /**
+     * @brief A processed photo with these exact bytes, at another path
+     *        (a copy whose faces can be reused)
+     * @return Photo ID, or -1 if there is none
+     */
+    int findProcessedCopy(const QString &fileHash, const QString &otherThanPath);
+
+    /**
+     * @brief hashKey() of every processed photo's hash, to tell a copy of a
+     *        known photo from a new one without a query per photo
+     */
+    QSet<quint64> getProcessedHashKeys();
+
+    // First 64 bits of a hex SHA-256, 0 if there is none. Collisions are
+    // for findProcessedCopy() to rule out.
+    static quint64 hashKey(const QString &fileHash);
+
     /**
      * @brief (id, file_path) of every photo that has no stored hash yet
      */
@@ -226,6 +285,35 @@ public:
      */
     QVector<Face> getUnmappedFaces();
 
+    /**
+     * @brief (face id, embedding) of every unmapped, non-ignored face
+     *
+     * What clustering and the unmapped face index need. Served from the
+     * resident store (see unmappedEmbeddings()).
+     */
+    QVector<QPair<int, FaceEmbedding>> getUnmappedEmbeddings();
+
+    /**
+     * @brief Embeddings of every unmapped, non-ignored face, by face id
+     *
+     * Read from SQLite once, on first use, then kept in memory and updated
+     * by every write path of this class, so re-matching after each
+     * identification decodes no BLOB. Bulk changes (import, re-encoding,
+     * a rolled back transaction) drop it and it is read again on next use.
+     */
+    const QHash<int, FaceEmbedding> &unmappedEmbeddings();
+
+    /**
+     * @brief Assign unmapped faces to a person, as auto-matches
+     *
+     * One transaction for the whole batch; sets the similarity score and
+     * verified = false. Faces that were mapped or ignored in the meantime
+     * are skipped.
+     * @param faces (face id, similarity) pairs
+     * @return Number of faces assigned, or -1 on error (nothing written)
+     */
+    int assignFaces(int personId, const QVector<QPair<int, float>> &faces);
+
     /**
      * @brief Update face's person mapping
      */
@@ -255,6 +343,18 @@ public:
      */
     bool setFaceIgnored(int faceId, bool ignored);
 
+    /**
+     * @brief Record which model computed a face's embedding
+     * @param model ModelRegistry::modelId(); empty for unknown
+     */
+    bool setFaceEmbeddingModel(int faceId, const QString &model);
+
+    /**
+     * @brief Faces per embedding model; "" counts faces from before models
+     *        were recorded (all of them FP32 SFace)
+     */
+    QVariantMap countFacesByEmbeddingModel();
+
     /**
      * @brief Record that a face must never be auto-matched to a person
      */
@@ -262,6 +362,9 @@ public:
 
     /**
      * @brief Check if a face was rejected for a person
+     *
+     * Negative matches are held in memory after the first call, like
+     * unmappedEmbeddings(), so this costs no query.
      */
     bool hasNegativeMatch(int faceId, int personId);
 
@@ -289,9 +392,49 @@ public:
     bool deleteFacesForPhoto(int photoId);
 
     /**
-     * @brief File paths of photos already processed (for incremental scans)
+     * @brief Path, state and file fingerprint of every photo (incremental
+     *        scans, see diffFingerprints())
+     * @param folder Only photos directly in this folder
+     * @param processedSince Count as processed only photos processed since
+     *        then (resuming a forced scan)
+     */
+    QVector<StoredFingerprint> getPhotoFingerprints(const QString &folder = QString(),
+                                                    const QDateTime &processedSince = QDateTime());
+
+    /**
+     * @brief Store fingerprints for photos whose files did not change
+     */
+    bool setPhotoFingerprints(const QVector<QPair<int, FileFingerprint>> &fingerprints);
+
+    /**
+     * @brief Folder listings of the last scan, by absolute path
+     */
+    QHash<QString, DirListing> getScannedDirs();
+
+    /**
+     * @brief Store fresh folder listings and forget folders that are gone
+     */
+    bool updateScannedDirs(const QHash<QString, DirListing> &listings,
+                           const QStringList &removed);
+
+    /**
+     * @brief Photos a scan has found and not committed yet, highest
+     *        priority first, then in scan order
+     *
+     * Checkpoint of the scan in progress: rows go in as the walk finds
+     * photos and out in the same transaction as each photo's commit, so
+     * a scan killed midway resumes exactly where it stopped.
      */
-    QSet<QString> getProcessedFilePaths();
+    QVector<ScanItem> getScanQueue();
+
+    /**
+     * @brief Append to the checkpoint; photos already in it are kept as they are
+     */
+    bool appendScanQueue(const QVector<ScanItem> &items);
+
+    bool removeFromScanQueue(const QString &filePath);
+    bool isInScanQueue(const QString &filePath);
+    bool clearScanQueue();
 
     // === Person operations ===
 
@@ -301,6 +444,21 @@ public:
      */
     int createPerson(const QString &name);
 
+    /**
+     * @brief Create one person per group and assign the group's faces
+     *
+     * One transaction. Only faces that are still unmapped are assigned,
+     * so groups computed from an older snapshot cannot steal faces the
+     * user has identified since; a group left with fewer than minGroupSize
+     * such faces creates no one and keeps none of them.
+     * People are named "Person 1", "Person 2", ... in group order.
+     * @param facesAssigned If set, receives the number of faces actually
+     *        assigned (not those claimed since)
+     * @return Number of people created, or -1 on error (nothing written)
+     */
+    int createPeopleFromGroups(const QVector<QVector<int>> &groups, int minGroupSize,
+                               int *facesAssigned = nullptr);
+
     /**
      * @brief Get person by ID
      */
@@ -418,6 +576,26 @@ public:
      */
     bool clearFaceData();
 
+    /**
+     * @brief Re-encode every stored embedding in the given format
+     *
+     * Stored as the "embedding_storage" setting; new faces are written in
+     * it too. Going to float16/int8 loses precision that going back does
+     * not restore.
+     */
+    bool setEmbeddingStorage(EmbeddingCodec::Format format);
+
+    EmbeddingCodec::Format embeddingStorage() const { return m_embeddingFormat; }
+
+    /**
+     * @brief Model that computes the embeddings of new faces
+     *
+     * Written with every face addFace() adds. Not stored: the pipeline sets
+     * it from the "recognizer_model" setting.
+     */
+    void setEmbeddingModel(const QString &model) { m_embeddingModel = model; }
+    QString embeddingModel() const { return m_embeddingModel; }
+
     // === Settings ===
 
     /**
@@ -524,6 +702,26 @@ private:
     QSqlDatabase m_db;
     QString m_dbPath;
     bool m_isOpen;
+    EmbeddingCodec::Format m_embeddingFormat;
+    QString m_embeddingModel;
+    int m_transactionDepth;  // 0 = none open, 1 = transaction, > 1 = savepoints
+
+    // Resident copies of what re-matching reads for every identification;
+    // see unmappedEmbeddings(). Each is loaded on first use.
+    QHash<int, FaceEmbedding> m_unmappedEmbeddings;
+    bool m_unmappedLoaded;
+    QHash<int, QSet<int>> m_negativeMatches;  // face id -> rejected people
+    bool m_negativeMatchesLoaded;
+
+    // Helper: Load the resident copies if they are not
+    void ensureUnmappedLoaded();
+    void ensureNegativeMatchesLoaded();
+
+    // Helper: Re-read one face into the unmapped store (or out of it)
+    void refreshUnmapped(int faceId);
+
+    // Helper: Forget both resident copies; read again on next use
+    void dropResidentCaches();
 
     // Helper: Serialize embedding to BLOB
     QByteArray serializeEmbedding(const FaceEmbedding &embedding);
@@ -531,6 +729,9 @@ private:
     // Helper: Deserialize embedding from BLOB
     FaceEmbedding deserializeEmbedding(const QByteArray &data);
 
+    // Helper: Rewrite embedding BLOBs not in the given format, in batches
+    bool recodeEmbeddings(EmbeddingCodec::Format format);
+
     // Helper: Execute query and log errors
     bool executeQuery(const QString &query);
 
@@ -1,6 +1,8 @@
 #include "facedetector.h"
 #include <QDebug>
 #include "logging.h"
+#include "tracer.h"
+#include "imageconvert.h"
 #include <algorithm>
 #include <cmath>
 
@@ -63,6 +65,7 @@ QVector<FaceDetection> FaceDetector::detect(const QImage &image, float confidenc
 
 QVector<FaceDetection> FaceDetector::detect(const cv::Mat &image, float confidenceThreshold)
 {
+    TRACE_SCOPE("model", "detect");
     if (!m_modelLoaded) {
         emit error("Model not loaded");
         return QVector<FaceDetection>();
@@ -181,11 +184,5 @@ cv::Mat FaceDetector::qImageToCvMat(const QImage &image)
 {
     // OpenCV convention is BGR; both YuNet and the recognition preprocessing
     // expect it, so everything downstream works on BGR mats
-    QImage rgb = image.convertToFormat(QImage::Format_RGB888);
-    cv::Mat rgbMat(rgb.height(), rgb.width(), CV_8UC3,
-                   const_cast<uchar*>(rgb.bits()), rgb.bytesPerLine());
-
-    cv::Mat bgr;
-    cv::cvtColor(rgbMat, bgr, cv::COLOR_RGB2BGR);
-    return bgr;
+    return qImageToBgrMat(image);
 }
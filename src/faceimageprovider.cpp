@@ -1,5 +1,6 @@
 #include "faceimageprovider.h"
 #include "logging.h"
+#include "tracer.h"
 
 #include <QUrlQuery>
 #include <QUrl>
@@ -120,6 +121,7 @@ QImage FaceImageProvider::requestThumbnail(const QString &id, QSize *size,
 
 QImage FaceImageProvider::requestImage(const QString &id, QSize *size, const QSize &requestedSize)
 {
+    TRACE_FUNCTION("images");
     if (id.startsWith(QLatin1String("thumb?"))) {
         return requestThumbnail(id, size, requestedSize);
     }
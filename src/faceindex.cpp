@@ -0,0 +1,296 @@
+#include "faceindex.h"
+#include "embeddingmatrix.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// k-means is trained on a sample of this many points per list: plenty to
+// place the centroids, and it keeps build() linear in the face count
+const int TRAINING_POINTS_PER_LIST = 32;
+const int TRAINING_ITERATIONS = 8;
+
+// Cosine -> the [0, 1] similarity used across the app
+inline float toSimilarity(float dot)
+{
+    return (dot + 1.0f) * 0.5f;
+}
+
+void normalize(float *v, int dim)
+{
+    float norm = std::sqrt(EmbeddingMath::dot(v, v, dim));
+    if (norm > 0.0f) {
+        for (int i = 0; i < dim; i++) {
+            v[i] /= norm;
+        }
+    }
+}
+
+// Deterministic, so a given set of faces always builds the same index
+quint32 nextRandom(quint32 &state)
+{
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+} // namespace
+
+FaceIndex::FaceIndex()
+    : m_dim(0)
+{
+}
+
+void FaceIndex::clear()
+{
+    m_dim = 0;
+    m_centroids.clear();
+    m_lists.clear();
+    m_location.clear();
+}
+
+void FaceIndex::build(const QVector<QPair<int, FaceEmbedding>> &faces)
+{
+    clear();
+    for (const auto &face : faces) {
+        if (!face.second.empty()) {
+            m_dim = static_cast<int>(face.second.size());
+            break;
+        }
+    }
+    if (m_dim == 0) {
+        return;
+    }
+
+    const int listCount = faces.size() < EXACT_BELOW
+        ? 1 : qBound(1, static_cast<int>(std::sqrt(static_cast<double>(faces.size()))), 1024);
+    train(faces, listCount);
+
+    m_location.reserve(faces.size());
+    for (const auto &face : faces) {
+        add(face.first, face.second);
+    }
+}
+
+void FaceIndex::train(const QVector<QPair<int, FaceEmbedding>> &faces, int listCount)
+{
+    m_lists.assign(listCount, List());
+    m_centroids.assign(static_cast<size_t>(listCount) * m_dim, 0.0f);
+    if (listCount == 1) {
+        return;  // single list: the centroid is never consulted
+    }
+
+    // Training sample, drawn without replacement
+    QVector<const float *> sample;
+    for (const auto &face : faces) {
+        if (static_cast<int>(face.second.size()) == m_dim) {
+            sample.append(face.second.data());
+        }
+    }
+    quint32 rng = 0x9E3779B9u;
+    const int sampleSize = qMin(sample.size(), listCount * TRAINING_POINTS_PER_LIST);
+    for (int i = 0; i < sampleSize; i++) {
+        std::swap(sample[i], sample[i + static_cast<int>(nextRandom(rng) % (sample.size() - i))]);
+    }
+    sample.resize(sampleSize);
+
+    for (int c = 0; c < listCount; c++) {
+        std::memcpy(&m_centroids[static_cast<size_t>(c) * m_dim], sample[c % sampleSize],
+                    m_dim * sizeof(float));
+    }
+
+    // Spherical k-means: assign by cosine, centroid = normalized mean
+    QVector<int> assignment(sampleSize, -1);
+    std::vector<float> sums(m_centroids.size());
+    QVector<int> counts(listCount);
+    for (int iteration = 0; iteration < TRAINING_ITERATIONS; iteration++) {
+        bool changed = false;
+        for (int i = 0; i < sampleSize; i++) {
+            const int nearest = nearestList(sample[i]);
+            if (nearest != assignment[i]) {
+                assignment[i] = nearest;
+                changed = true;
+            }
+        }
+        if (!changed) {
+            break;
+        }
+
+        std::fill(sums.begin(), sums.end(), 0.0f);
+        counts.fill(0);
+        for (int i = 0; i < sampleSize; i++) {
+            float *sum = &sums[static_cast<size_t>(assignment[i]) * m_dim];
+            for (int d = 0; d < m_dim; d++) {
+                sum[d] += sample[i][d];
+            }
+            counts[assignment[i]]++;
+        }
+
+        for (int c = 0; c < listCount; c++) {
+            float *centroid = &m_centroids[static_cast<size_t>(c) * m_dim];
+            if (counts[c] == 0) {
+                // Empty list: restart it on a random sample point
+                std::memcpy(centroid, sample[nextRandom(rng) % sampleSize], m_dim * sizeof(float));
+            } else {
+                std::memcpy(centroid, &sums[static_cast<size_t>(c) * m_dim], m_dim * sizeof(float));
+                normalize(centroid, m_dim);
+            }
+        }
+    }
+}
+
+int FaceIndex::nearestList(const float *embedding) const
+{
+    const int lists = static_cast<int>(m_lists.size());
+    int nearest = 0;
+    float bestDot = -2.0f;
+    for (int c = 0; c < lists && lists > 1; c++) {
+        const float dot = EmbeddingMath::dot(embedding, &m_centroids[static_cast<size_t>(c) * m_dim], m_dim);
+        if (dot > bestDot) {
+            bestDot = dot;
+            nearest = c;
+        }
+    }
+    return nearest;
+}
+
+void FaceIndex::append(int list, int faceId, const float *embedding)
+{
+    List &target = m_lists[list];
+    target.data.insert(target.data.end(), embedding, embedding + m_dim);
+    m_location.insert(faceId, qMakePair(list, target.ids.size()));
+    target.ids.append(faceId);
+}
+
+void FaceIndex::add(int faceId, const FaceEmbedding &embedding)
+{
+    if (m_dim == 0 && !embedding.empty()) {
+        // First face ever: an untrained single-list index
+        m_dim = static_cast<int>(embedding.size());
+        m_lists.assign(1, List());
+        m_centroids.assign(m_dim, 0.0f);
+    }
+    if (static_cast<int>(embedding.size()) != m_dim || m_dim == 0) {
+        return;
+    }
+
+    remove(faceId);
+    append(nearestList(embedding.data()), faceId, embedding.data());
+}
+
+bool FaceIndex::remove(int faceId)
+{
+    auto it = m_location.find(faceId);
+    if (it == m_location.end()) {
+        return false;
+    }
+
+    // Swap with the list's last row, so removal is O(dim)
+    List &list = m_lists[it.value().first];
+    const int row = it.value().second;
+    const int last = list.ids.size() - 1;
+    if (row != last) {
+        std::memcpy(&list.data[static_cast<size_t>(row) * m_dim],
+                    &list.data[static_cast<size_t>(last) * m_dim], m_dim * sizeof(float));
+        list.ids[row] = list.ids[last];
+        m_location[list.ids[row]].second = row;
+    }
+    list.data.resize(static_cast<size_t>(last) * m_dim);
+    list.ids.removeLast();
+    m_location.erase(it);
+    return true;
+}
+
+int FaceIndex::probeCount() const
+{
+    // An eighth of the lists: at the match thresholds the app uses this
+    // finds ~95% of what a full scan would, for an eighth of the scoring
+    const int lists = static_cast<int>(m_lists.size());
+    const int minProbes = MIN_PROBES;
+    return qMin(lists, qMax(minProbes, lists / 8));
+}
+
+QVector<int> FaceIndex::probedLists(const float *query, int probes) const
+{
+    const int lists = static_cast<int>(m_lists.size());
+    QVector<int> order(lists);
+    for (int c = 0; c < lists; c++) {
+        order[c] = c;
+    }
+    if (lists <= 1) {
+        return order;
+    }
+
+    QVector<float> dots(lists);
+    for (int c = 0; c < lists; c++) {
+        dots[c] = EmbeddingMath::dot(query, &m_centroids[static_cast<size_t>(c) * m_dim], m_dim);
+    }
+    probes = probes > 0 ? qMin(probes, lists) : probeCount();
+    std::partial_sort(order.begin(), order.begin() + probes, order.end(),
+                      [&dots](int a, int b) { return dots[a] > dots[b]; });
+    order.resize(probes);
+    return order;
+}
+
+void FaceIndex::searchOne(const float *query, float threshold, int skipFaceId, int probes,
+                          QHash<int, float> &best) const
+{
+    for (int listIndex : probedLists(query, probes)) {
+        const List &list = m_lists[listIndex];
+        const float *row = list.data.data();
+        for (int i = 0; i < list.ids.size(); i++, row += m_dim) {
+            const int faceId = list.ids[i];
+            if (faceId == skipFaceId) {
+                continue;
+            }
+            const float similarity = toSimilarity(EmbeddingMath::dot(query, row, m_dim));
+            if (similarity < threshold) {
+                continue;
+            }
+            auto it = best.find(faceId);
+            if (it == best.end()) {
+                best.insert(faceId, similarity);
+            } else if (similarity > it.value()) {
+                it.value() = similarity;
+            }
+        }
+    }
+}
+
+QVector<FaceIndex::Hit> FaceIndex::search(const QVector<FaceEmbedding> &queries, float threshold) const
+{
+    QHash<int, float> best;
+    for (const FaceEmbedding &query : queries) {
+        if (static_cast<int>(query.size()) == m_dim && m_dim > 0) {
+            searchOne(query.data(), threshold, -1, 0, best);
+        }
+    }
+
+    QVector<Hit> hits;
+    hits.reserve(best.size());
+    for (auto it = best.constBegin(); it != best.constEnd(); ++it) {
+        hits.append(Hit{it.key(), it.value()});
+    }
+    return hits;
+}
+
+QVector<FaceIndex::Hit> FaceIndex::neighbours(int faceId, float threshold, int probes) const
+{
+    QVector<Hit> hits;
+    auto it = m_location.constFind(faceId);
+    if (it == m_location.constEnd()) {
+        return hits;
+    }
+
+    const List &list = m_lists[it.value().first];
+    const float *query = &list.data[static_cast<size_t>(it.value().second) * m_dim];
+
+    QHash<int, float> best;
+    searchOne(query, threshold, faceId, probes, best);
+    hits.reserve(best.size());
+    for (auto b = best.constBegin(); b != best.constEnd(); ++b) {
+        hits.append(Hit{b.key(), b.value()});
+    }
+    return hits;
+}
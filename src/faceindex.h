@@ -0,0 +1,102 @@
+#ifndef FACEINDEX_H
+#define FACEINDEX_H
+
+#include <QHash>
+#include <QPair>
+#include <QVector>
+#include <vector>
+#include "faceembedding.h"
+
+/**
+ * @brief Approximate nearest-neighbour index over face embeddings (IVF-flat)
+ *
+ * Answers "which faces are within a similarity threshold of these
+ * embeddings" without scoring every face. build() clusters the embeddings
+ * into ~sqrt(n) lists with spherical k-means; a query is only scored
+ * against the lists whose centroids are closest to it.
+ *
+ * Approximate: a face whose list is not probed is missed. Below
+ * EXACT_BELOW faces there is a single list and results are exact.
+ *
+ * add()/remove() keep it current between rebuilds. Added faces go to the
+ * nearest existing list, so they are found just as well, but lists grow
+ * unevenly until the next build().
+ *
+ * No Qt beyond containers and no OpenCV, so build() can run on a worker
+ * thread and the index is testable on its own.
+ */
+class FaceIndex
+{
+public:
+    struct Hit {
+        int faceId;
+        float similarity;  // 0.0 - 1.0, as FaceRecognizer::computeSimilarity
+    };
+
+    // Below this many faces, one list: brute force is cheaper than probing
+    static constexpr int EXACT_BELOW = 512;
+
+    // Lists scored per query (at least; more for large indexes)
+    static constexpr int MIN_PROBES = 8;
+
+    FaceIndex();
+
+    void clear();
+
+    /**
+     * @brief Replace the contents with these faces, training new lists
+     */
+    void build(const QVector<QPair<int, FaceEmbedding>> &faces);
+
+    /**
+     * @brief Add (or move) one face; embeddings of another size are ignored
+     */
+    void add(int faceId, const FaceEmbedding &embedding);
+
+    /**
+     * @brief Remove one face; false if it was not indexed
+     */
+    bool remove(int faceId);
+
+    bool contains(int faceId) const { return m_location.contains(faceId); }
+    int size() const { return m_location.size(); }
+    int listCount() const { return static_cast<int>(m_lists.size()); }
+
+    /**
+     * @brief Faces within threshold of any of the queries
+     *
+     * Each face appears once, with its best similarity over the queries.
+     */
+    QVector<Hit> search(const QVector<FaceEmbedding> &queries, float threshold) const;
+
+    /**
+     * @brief Faces within threshold of an indexed face, itself excluded
+     * @param probes Lists to score; 0 for the default. Bulk callers can
+     *        trade a little recall for speed with fewer.
+     */
+    QVector<Hit> neighbours(int faceId, float threshold, int probes = 0) const;
+
+private:
+    struct List {
+        std::vector<float> data;  // row-major, m_dim floats per face
+        QVector<int> ids;
+    };
+
+    int m_dim;
+    std::vector<float> m_centroids;   // one unit vector per list
+    std::vector<List> m_lists;
+    QHash<int, QPair<int, int>> m_location;  // face id -> (list, row)
+
+    void train(const QVector<QPair<int, FaceEmbedding>> &faces, int listCount);
+    int nearestList(const float *embedding) const;
+    void append(int list, int faceId, const float *embedding);
+    int probeCount() const;
+
+    // Probed lists for a query, nearest centroid first
+    QVector<int> probedLists(const float *query, int probes) const;
+
+    void searchOne(const float *query, float threshold, int skipFaceId, int probes,
+                   QHash<int, float> &best) const;
+};
+
+#endif // FACEINDEX_H
@@ -1,55 +1,275 @@
 #include "facepipeline.h"
 #include "exifreader.h"
 #include "filehash.h"
+#include "photofile.h"
 #include "backupcrypto.h"
 #include <QDebug>
 #include "logging.h"
+#include "tracer.h"
+#include "perceptualhash.h"
+#include "facequality.h"
+#include "modelcomparison.h"
 #include <QDir>
 #include <QImageReader>
+#include <QImageIOHandler>
+#include <QBuffer>
 #include <QFile>
 #include <QFileInfo>
 #include <QtConcurrent>
 #include <QSet>
+#include <QThread>
+#include <QtMath>
 #include <QStandardPaths>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
 #include <algorithm>
 
+namespace {
+
+// Pixels across a face that alignCrop gets to work with. The SFace template
+// is 112 px; twice that leaves the warp some detail to interpolate from
+// without decoding big faces at full resolution for nothing.
+const int FACE_REGION_SIDE = 224;
+
+// Extra decoded around a face bbox, per side and relative to its size:
+// the alignment template reaches past the bbox YuNet reports
+const qreal FACE_REGION_MARGIN = 0.5;
+
+// Each region decode runs the JPEG decoder over the file again (up to the
+// region's last row). Past this many small faces, or regions adding up to
+// more than this share of the photo, one decode of the whole photo at the
+// resolution the smallest face needs costs less.
+const int MAX_REGION_DECODES = 2;
+const qreal MAX_REGION_SHARE = 0.3;
+
+// EXIF orientation as QImageReader::setAutoTransform() applies it: mirror
+// and flip first, then a clockwise quarter turn. Points are normalized.
+QPointF storedToOriented(QPointF p, QImageIOHandler::Transformations t)
+{
+    if (t & QImageIOHandler::TransformationMirror) {
+        p.setX(1.0 - p.x());
+    }
+    if (t & QImageIOHandler::TransformationFlip) {
+        p.setY(1.0 - p.y());
+    }
+    if (t & QImageIOHandler::TransformationRotate90) {
+        p = QPointF(1.0 - p.y(), p.x());
+    }
+    return p;
+}
+
+QPointF orientedToStored(QPointF p, QImageIOHandler::Transformations t)
+{
+    if (t & QImageIOHandler::TransformationRotate90) {
+        p = QPointF(p.y(), 1.0 - p.x());
+    }
+    if (t & QImageIOHandler::TransformationMirror) {
+        p.setX(1.0 - p.x());
+    }
+    if (t & QImageIOHandler::TransformationFlip) {
+        p.setY(1.0 - p.y());
+    }
+    return p;
+}
+
+QRectF mapRect(const QRectF &rect, QPointF (*map)(QPointF, QImageIOHandler::Transformations),
+               QImageIOHandler::Transformations t)
+{
+    return QRectF(map(rect.topLeft(), t), map(rect.bottomRight(), t)).normalized();
+}
+
+// A burst frame's detections checked against the frame it follows: each
+// must overlap one of its faces by at least this much (IoU)
+const qreal BURST_MIN_IOU = 0.5;
+
+qreal intersectionOverUnion(const QRectF &a, const QRectF &b)
+{
+    const QRectF overlap = a & b;
+    const qreal shared = overlap.width() * overlap.height();
+    const qreal total = a.width() * a.height() + b.width() * b.height() - shared;
+    return total > 0.0 ? shared / total : 0.0;
+}
+
+// FaceQuality::sharpness() of an aligned face, shrunk to BLUR_SIDE square:
+// the same scale for every face, whatever the photo's resolution
+double faceSharpness(const cv::Mat &aligned)
+{
+    cv::Mat grey;
+    cv::cvtColor(aligned, grey, cv::COLOR_BGR2GRAY);
+    const int side = FaceQuality::BLUR_SIDE;
+    cv::resize(grey, grey, cv::Size(side, side), 0, 0, cv::INTER_AREA);
+    return FaceQuality::sharpness(grey.data, grey.cols, grey.rows, static_cast<int>(grey.step));
+}
+
+// The earlier frame's embeddings for these detections, if every one of them
+// and every earlier face pair up
+bool pairWithEarlierFrame(const QVector<FaceDetection> &detections,
+                          const QVector<ExtractedFace> &earlier, QVector<ExtractedFace> *faces)
+{
+    if (detections.size() != earlier.size()) {
+        return false;
+    }
+    QVector<bool> taken(earlier.size(), false);
+    QVector<ExtractedFace> paired;
+    for (const FaceDetection &detection : detections) {
+        int best = -1;
+        qreal bestIou = BURST_MIN_IOU;
+        for (int i = 0; i < earlier.size(); i++) {
+            const qreal iou = intersectionOverUnion(detection.bbox, earlier[i].bbox);
+            if (!taken[i] && iou >= bestIou) {
+                best = i;
+                bestIou = iou;
+            }
+        }
+        if (best < 0) {
+            return false;
+        }
+        taken[best] = true;
+        paired.append(ExtractedFace{ detection.bbox, detection.confidence, earlier[best].embedding });
+    }
+    *faces = paired;
+    return true;
+}
+
+// A reprocessed photo's faces against the ones it had: an earlier face
+// whose box overlaps a new one by at least this much (IoU) passes its
+// person, confirmation, dismissal and rejections on to it
+const qreal CARRY_OVER_MIN_IOU = 0.3;
+
+// For each new face, the index of the earlier face it takes over, or -1.
+// Best overlaps first, each earlier face to one new face at most.
+QVector<int> carryOverFaces(const QVector<ExtractedFace> &faces, const QVector<Face> &previous)
+{
+    struct Pair {
+        qreal iou;
+        int face;
+        int earlier;
+    };
+    QVector<Pair> pairs;
+    for (int i = 0; i < faces.size(); i++) {
+        for (int j = 0; j < previous.size(); j++) {
+            const qreal iou = intersectionOverUnion(faces[i].bbox, previous[j].bbox);
+            if (iou >= CARRY_OVER_MIN_IOU) {
+                pairs.append(Pair{ iou, i, j });
+            }
+        }
+    }
+    std::sort(pairs.begin(), pairs.end(), [](const Pair &a, const Pair &b) { return a.iou > b.iou; });
+
+    QVector<int> carried(faces.size(), -1);
+    QVector<bool> taken(previous.size(), false);
+    for (const Pair &pair : pairs) {
+        if (carried[pair.face] < 0 && !taken[pair.earlier]) {
+            carried[pair.face] = pair.earlier;
+            taken[pair.earlier] = true;
+        }
+    }
+    return carried;
+}
+
+// Normalized photo coordinates -> normalized coordinates within region
+QPointF toRegion(const QPointF &p, const QRectF &region)
+{
+    return QPointF((p.x() - region.x()) / region.width(),
+                   (p.y() - region.y()) / region.height());
+}
+
+} // namespace
+
 FacePipeline::FacePipeline(QObject *parent)
     : QObject(parent)
-    , m_detector(nullptr)
-    , m_recognizer(nullptr)
     , m_database(nullptr)
+    , m_detectorPrecision(ModelRegistry::Fp32)
+    , m_recognizerPrecision(ModelRegistry::Fp32)
     , m_initialized(false)
     , m_processing(false)
     , m_cancelRequested(false)
     , m_needsRescan(false)
     , m_contactsEnabled(true)
+    , m_watchGalleries(false)
     , m_currentScanIsForced(false)
+    , m_tracingScan(false)
+    , m_canResumeScan(false)
+    , m_walking(false)
+    , m_expectedPhotos(0)
+    , m_scanQueue(SCAN_QUEUE_CAPACITY)
     , m_totalPhotos(0)
     , m_processedPhotos(0)
+    , m_activeEngines(1)
+    , m_nextDispatchSequence(0)
+    , m_nextCommitSequence(0)
+    , m_batchPhotos(0)
     , m_personProtoCacheValid(false)
+    , m_unmappedIndexValid(false)
+    , m_unmappedIndexStale(false)
     , m_autoMatchThreshold(AUTO_MATCH_THRESHOLD)
+    , m_ingestDiscard(false)
 {
-    connect(&m_extractionWatcher, &QFutureWatcher<PhotoExtraction>::finished,
-            this, &FacePipeline::onExtractionFinished);
     connect(&m_hashBackfillWatcher, &QFutureWatcher<QVector<QPair<int, QString>>>::finished,
             this, &FacePipeline::onHashBackfillFinished);
+    connect(&m_unmappedIndexWatcher, &QFutureWatcher<QSharedPointer<FaceIndex>>::finished,
+            this, &FacePipeline::onUnmappedIndexBuilt);
+    connect(&m_groupingWatcher, &QFutureWatcher<FaceClustering::Result>::finished,
+            this, &FacePipeline::onGroupingFinished);
+    connect(&m_comparisonWatcher, &QFutureWatcher<QVariantMap>::finished,
+            this, &FacePipeline::onModelComparisonFinished);
+    connect(&m_walkWatcher, &QFutureWatcher<WalkResult>::finished,
+            this, &FacePipeline::onWalkFinished);
+    connect(&m_ingestWatcher, &QFutureWatcher<IngestResult>::finished,
+            this, &FacePipeline::onIngestFinished);
+    connect(&m_galleryWatcher, &GalleryWatcher::photosChanged,
+            this, &FacePipeline::onWatchedPhotosChanged);
+
+    // A batch must not stay open while extraction stalls on a slow photo
+    m_batchFlushTimer.setSingleShot(true);
+    connect(&m_batchFlushTimer, &QTimer::timeout, this, &FacePipeline::flushCommitBatch);
 }
 
 FacePipeline::~FacePipeline()
 {
-    // The worker uses m_detector/m_recognizer; let it finish first
-    if (m_extractionWatcher.isRunning()) {
-        m_extractionWatcher.waitForFinished();
+    // A walk blocked on a full queue would never return otherwise
+    m_scanQueue.close();
+    if (m_walkWatcher.isRunning()) {
+        m_walkWatcher.waitForFinished();
+    }
+    // What the walk found so far goes into the checkpoint with the batch
+    checkpointWalked();
+    m_galleryWatcher.stop();
+    m_ingestCancel.store(1);
+    if (m_ingestWatcher.isRunning()) {
+        m_ingestWatcher.waitForFinished();
+    }
+
+    // Workers use the engines; let them finish first
+    for (QFutureWatcher<PhotoExtraction> *watcher : m_extractionWatchers) {
+        if (watcher->isRunning()) {
+            watcher->waitForFinished();
+        }
     }
     if (m_hashBackfillWatcher.isRunning()) {
         m_hashBackfillWatcher.waitForFinished();
     }
+    if (m_unmappedIndexWatcher.isRunning()) {
+        m_unmappedIndexWatcher.waitForFinished();
+    }
+    if (m_groupingWatcher.isRunning()) {
+        m_groupingWatcher.waitForFinished();
+    }
+    if (m_comparisonWatcher.isRunning()) {
+        m_comparisonWatcher.waitForFinished();
+    }
 
-    delete m_detector;
-    delete m_recognizer;
+    // Photos already committed to the open batch are kept
+    flushCommitBatch();
+    if (m_tracingScan) {
+        Tracer::stop();
+    }
+
+    for (const ExtractionEngine &engine : m_engines) {
+        delete engine.detector;
+        delete engine.recognizer;
+    }
     delete m_database;
 }
 
@@ -62,20 +282,6 @@ bool FacePipeline::initialize(const QString &detectorModelPath,
     qCDebug(lcNami) << "  Recognizer model:" << recognizerModelPath;
     qCDebug(lcNami) << "  Database:" << databasePath;
 
-    // Create detector
-    m_detector = new FaceDetector(this);
-    if (!m_detector->loadModel(detectorModelPath)) {
-        emit error("Failed to load face detector model");
-        return false;
-    }
-
-    // Create recognizer
-    m_recognizer = new FaceRecognizer(this);
-    if (!m_recognizer->loadModel(recognizerModelPath)) {
-        emit error("Failed to load face recognizer model");
-        return false;
-    }
-
     // Create database
     m_database = new FaceDatabase(this);
     if (!m_database->open(databasePath)) {
@@ -83,6 +289,33 @@ bool FacePipeline::initialize(const QString &detectorModelPath,
         return false;
     }
 
+    // The given models are the FP32 ones; their INT8 variants, if the
+    // settings ask for them, are installed next to them
+    m_models = ModelRegistry(QFileInfo(detectorModelPath).absolutePath());
+    const ModelRegistry::Precision detector = m_models.resolve(ModelRegistry::Detector,
+        ModelRegistry::precisionFromString(m_database->getSetting("detector_model", "fp32")));
+    const ModelRegistry::Precision recognizer = m_models.resolve(ModelRegistry::Recognizer,
+        ModelRegistry::precisionFromString(m_database->getSetting("recognizer_model", "fp32")));
+    useModels(detector, recognizer);
+
+    // First extraction engine; the others are only loaded when a scan
+    // needs them, each one costs a copy of both networks. An INT8 file can
+    // be there and still not load (truncated copy, older OpenCV): the app
+    // then starts on FP32 rather than not at all.
+    const bool fp32 = detector == ModelRegistry::Fp32 && recognizer == ModelRegistry::Fp32;
+    if (!addExtractionEngine(!fp32)) {
+        if (fp32) {
+            return false;
+        }
+        qWarning() << "Failed to load the selected face models, falling back to FP32";
+        useModels(ModelRegistry::Fp32, ModelRegistry::Fp32);
+        if (!addExtractionEngine()) {
+            return false;
+        }
+        m_database->setSetting("detector_model", ModelRegistry::precisionName(ModelRegistry::Fp32));
+        m_database->setSetting("recognizer_model", ModelRegistry::precisionName(ModelRegistry::Fp32));
+    }
+
     // Privacy switch for contact reading (defaults to enabled)
     m_contactsEnabled = m_database->getSetting("contacts_enabled", "true") != "false";
     emit contactsEnabledChanged();
@@ -94,6 +327,8 @@ bool FacePipeline::initialize(const QString &detectorModelPath,
         m_autoMatchThreshold = storedThreshold;
     }
 
+    m_faceQuality.store(FaceQuality::levelFromString(m_database->getSetting("face_quality", "normal")));
+
     // Embeddings computed by older engine versions are incompatible with
     // the current matching (different alignment/preprocessing)
     int storedVersion = m_database->getSetting("embedding_version", "1").toInt();
@@ -105,9 +340,21 @@ bool FacePipeline::initialize(const QString &detectorModelPath,
         emit needsRescanChanged();
     }
 
+    // A scan interrupted by the app closing can pick up where it stopped
+    m_canResumeScan = !readScanCheckpoint().isEmpty();
+    if (m_canResumeScan) {
+        qCDebug(lcNami) << "An interrupted scan can be resumed";
+        emit canResumeScanChanged();
+    }
+
     m_initialized = true;
     emit initializedChanged();
 
+    // Background ingestion, if the user turned it on
+    m_watchGalleries = m_database->getSetting("watch_galleries") == "true";
+    emit watchGalleriesChanged();
+    updateGalleryWatcher();
+
     // One-time, silent maintenance: photos scanned before the file_hash
     // column existed need it backfilled so backups can find them by
     // content after a device migration
@@ -134,6 +381,9 @@ void FacePipeline::scanGalleries(const QStringList &galleryPaths, bool recursive
         return;
     }
 
+    // The scan covers whatever ingestion had queued, and needs the engine
+    abortIngest();
+
     // Outdated embeddings: wipe face data so old and new embeddings are
     // never mixed, then re-process everything
     if (m_needsRescan) {
@@ -143,106 +393,946 @@ void FacePipeline::scanGalleries(const QStringList &galleryPaths, bool recursive
         forceRescan = true;
     }
 
-    m_processing = true;
-    m_cancelRequested = false;
-    m_currentScanIsForced = forceRescan;
-    emit processingChanged();
-
     qCDebug(lcNami) << "Scanning galleries:" << galleryPaths << "(recursive:" << recursive
              << "force:" << forceRescan << ")";
 
-    // Find all image files across every folder, deduplicated (folders may
-    // overlap, e.g. an SD card mounted under a scanned parent)
-    QStringList allFiles;
-    QSet<QString> seen;
+    QStringList roots;
     for (const QString &path : galleryPaths) {
-        if (path.isEmpty()) {
-            continue;
+        if (!path.isEmpty()) {
+            roots.append(QDir(path).absolutePath());
         }
-        const QStringList files = findImageFiles(path, recursive);
-        for (const QString &file : files) {
-            if (!seen.contains(file)) {
-                seen.insert(file);
-                allFiles.append(file);
-            }
+    }
+
+    // A new scan replaces any interrupted one
+    clearScanCheckpoint();
+    QJsonArray paths;
+    for (const QString &root : roots) {
+        paths.append(root);
+    }
+    m_scanCheckpoint["paths"] = paths;
+    m_scanCheckpoint["recursive"] = recursive;
+    m_scanCheckpoint["force"] = forceRescan;
+    m_scanCheckpoint["started"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+    m_scanCheckpoint["embedding_version"] = EMBEDDING_VERSION;
+    m_scanCheckpoint["walked"] = false;
+    saveScanCheckpoint();
+
+    startScan(roots, recursive, forceRescan, QVector<ScanItem>(), true, QDateTime());
+}
+
+bool FacePipeline::resumeScan()
+{
+    if (!m_initialized) {
+        emit error("Pipeline not initialized");
+        return false;
+    }
+
+    if (m_processing) {
+        emit error("Already processing");
+        return false;
+    }
+
+    const QJsonObject checkpoint = readScanCheckpoint();
+    if (checkpoint.isEmpty()) {
+        return false;
+    }
+
+    abortIngest();
+
+    QStringList roots;
+    for (const QJsonValue &path : checkpoint["paths"].toArray()) {
+        roots.append(path.toString());
+    }
+    const bool recursive = checkpoint["recursive"].toBool();
+    const bool forceRescan = checkpoint["force"].toBool();
+    const bool walked = checkpoint["walked"].toBool();
+
+    // A forced scan redoes processed photos too: only those processed
+    // since it started are done
+    const QDateTime processedSince = forceRescan && !walked
+        ? QDateTime::fromString(checkpoint["started"].toString(), Qt::ISODate) : QDateTime();
+
+    const QVector<ScanItem> resumed = m_database->getScanQueue();
+    m_scanCheckpoint = checkpoint;
+    setCanResumeScan(false);
+
+    qCDebug(lcNami) << "Resuming scan of" << roots << ":" << resumed.size() << "photos queued,"
+                    << (walked ? "walk complete" : "walk to finish");
+
+    startScan(roots, recursive, forceRescan, resumed, !walked, processedSince);
+    return true;
+}
+
+void FacePipeline::discardScanCheckpoint()
+{
+    if (m_initialized && !m_processing) {
+        clearScanCheckpoint();
+    }
+}
+
+void FacePipeline::startScan(const QStringList &roots, bool recursive, bool forceRescan,
+                             const QVector<ScanItem> &resumed, bool walk,
+                             const QDateTime &processedSince)
+{
+    TRACE_FUNCTION("pipeline");
+    // A forced scan deletes and re-adds faces photo by photo
+    if (forceRescan) {
+        invalidateUnmappedIndex();
+    }
+
+    m_processing = true;
+    m_cancelRequested = false;
+    m_currentScanIsForced = forceRescan;
+    // A timeline of this scan, unless NAMI_TRACE is already recording one
+    if (!Tracer::isEnabled() && m_database->getSetting("trace_scans", "false") == QLatin1String("true")) {
+        const QString dir = QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation);
+        m_tracingScan = Tracer::start(dir + "/nami-trace-"
+                                      + QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss") + ".json");
+    }
+
+    // A forced scan recomputes everything, so only its own results count
+    {
+        const QSet<quint64> known = forceRescan ? QSet<quint64>() : m_database->getProcessedHashKeys();
+        QMutexLocker locker(&m_knownHashesMutex);
+        m_knownHashes = known;
+    }
+    if (forceRescan) {
+        m_burstIndex.clear();
+    }
+    m_burstVerify.store(m_database->getSetting("burst_verify", "false") == QLatin1String("true") ? 1 : 0);
+
+    m_scanStats = ScanStats();
+    m_scanStats.startedMs = QDateTime::currentMSecsSinceEpoch();
+    m_statsAge.start();
+    emit processingChanged();
+    emit scanStatsChanged();
+
+    // Incremental scan: photos already processed are skipped unless their
+    // file changed since; each folder's files are checked against its rows
+    QHash<QString, QVector<StoredFingerprint>> storedByFolder;
+    if (walk && (!forceRescan || processedSince.isValid())) {
+        for (const StoredFingerprint &photo : m_database->getPhotoFingerprints(QString(), processedSince)) {
+            storedByFolder[photo.filePath.left(photo.filePath.lastIndexOf('/'))].append(photo);
         }
     }
-    m_pendingFiles = allFiles;
 
-    // Incremental scan: skip photos already processed
-    if (!forceRescan) {
-        QSet<QString> processedPaths = m_database->getProcessedFilePaths();
-        if (!processedPaths.isEmpty()) {
-            QStringList newFiles;
-            for (const QString &file : m_pendingFiles) {
-                if (!processedPaths.contains(file)) {
-                    newFiles.append(file);
+    // Until the walk is over, the total is an estimate: a forced scan redoes
+    // every photo, which the last scan's folder listings roughly count
+    const QHash<QString, DirListing> folderCache = walk ? m_database->getScannedDirs()
+                                                        : QHash<QString, DirListing>();
+    m_expectedPhotos = resumed.size();
+    if (forceRescan && walk && resumed.isEmpty()) {
+        for (auto it = folderCache.constBegin(); it != folderCache.constEnd(); ++it) {
+            for (const QString &root : roots) {
+                if (it.key() == root || it.key().startsWith(root + '/')) {
+                    m_expectedPhotos += it.value().images.size();
+                    break;
                 }
             }
-            qCDebug(lcNami) << "Incremental scan:" << (m_pendingFiles.size() - newFiles.size())
-                     << "photos already processed," << newFiles.size() << "to process";
-            m_pendingFiles = newFiles;
         }
     }
 
-    m_totalPhotos = m_pendingFiles.size();
+    // Walk stage: folders are read on a worker thread and their photos
+    // queued as each one is read, so extraction starts after the first
+    // folder rather than after the whole gallery. A forced scan reads every
+    // folder again.
+    m_scanQueue.reset();
+    m_promoted.clear();
+    m_walkQueued.store(0);
+    m_walkNotifyPending.store(0);
+    m_changedFiles.clear();
+    m_inFlight.clear();
+    m_walking = true;
+    const QHash<QString, DirListing> walkCache = forceRescan ? QHash<QString, DirListing>() : folderCache;
+    m_walkWatcher.setFuture(QtConcurrent::run([this, roots, recursive, walkCache, storedByFolder,
+                                               resumed, walk]() {
+        return walkGalleries(roots, recursive, walkCache, storedByFolder, resumed, walk);
+    }));
+    m_totalPhotos = m_expectedPhotos;
     m_processedPhotos = 0;
     m_totalFacesDetected = 0;
+    m_nextDispatchSequence = 0;
+    m_nextCommitSequence = 0;
+    m_completedExtractions.clear();
+
+    // "extraction_workers" is the most the throttle may use; the profile
+    // decides how many of them it starts with
+    m_throttle.start(ScanThrottle::profileFromString(m_database->getSetting("scan_profile", "balanced")),
+                     extractionWorkerCount(), QDateTime::currentMSecsSinceEpoch());
+    applyThrottle();
 
     emit totalPhotosChanged();
+    emit walkingChanged();
     emit scanStarted(m_totalPhotos);
 
-    qCDebug(lcNami) << "Found" << m_totalPhotos << "image files";
+    qCDebug(lcNami) << "Scan started with" << m_activeEngines << "extraction workers";
+}
+
+WalkResult FacePipeline::walkGalleries(const QStringList &roots, bool recursive,
+                                       const QHash<QString, DirListing> &folderCache,
+                                       const QHash<QString, QVector<StoredFingerprint>> &storedByFolder,
+                                       const QVector<ScanItem> &resumed, bool walk)
+{
+    TRACE_FUNCTION("pipeline");
+    WalkResult result;
+    QElapsedTimer timer;
+    timer.start();
+
+    const auto enqueue = [this](const ScanItem &item) {
+        if (!m_scanQueue.push(item)) {
+            return false;  // cancelled
+        }
+        m_walkQueued.fetchAndAddOrdered(1);
+
+        // One wake-up of the main thread at a time, however fast
+        // photos are queued
+        if (m_walkNotifyPending.testAndSetOrdered(0, 1)) {
+            QMetaObject::invokeMethod(this, "onFilesQueued", Qt::QueuedConnection);
+        }
+        return true;
+    };
+
+    // Resuming: what the interrupted scan had found goes first (it is in
+    // the checkpoint already), and the walk does not queue it again
+    QSet<QString> resumedPaths;
+    for (const ScanItem &item : resumed) {
+        if (!enqueue(item)) {
+            result.walkMs = timer.elapsed();
+            return result;
+        }
+        resumedPaths.insert(item.filePath);
+    }
+    if (!walk) {
+        result.complete = true;
+        result.walkMs = timer.elapsed();
+        return result;
+    }
+
+    // One walker for all roots: a folder under two of them (an SD card
+    // mounted under a scanned parent) is walked once
+    GalleryWalker walker(folderCache);
+    const bool incremental = !storedByFolder.isEmpty();
+
+    const GalleryWalker::FolderVisitor visit = [&](const QString &folder, const QStringList &files) {
+        if (files.isEmpty()) {
+            return true;
+        }
+        QVector<QPair<QString, FileFingerprint>> onDisk;
+        QHash<QString, qint64> mtimes;
+        onDisk.reserve(files.size());
+        for (const QString &file : files) {
+            const FileFingerprint fingerprint = FileFingerprint::of(file);
+            onDisk.append(qMakePair(file, fingerprint));
+            mtimes.insert(file, fingerprint.mtimeMs);
+        }
+
+        QVector<ScanItem> items;
+        if (incremental) {
+            const FingerprintDiff diff = diffFingerprints(onDisk, storedByFolder.value(folder));
+            for (const QString &file : diff.added) {
+                items.append(ScanItem{file, false});
+            }
+            for (const QString &file : diff.changed) {
+                items.append(ScanItem{file, true});
+            }
+            result.refresh += diff.refresh;
+            result.added += diff.added.size();
+            result.changed += diff.changed.size();
+            result.unchanged += diff.unchanged;
+        } else {
+            for (const QString &file : files) {
+                items.append(ScanItem{file, false});
+            }
+            result.added += files.size();
+        }
+
+        // Newest first: the photos the user took last are the ones they
+        // look for. mtime stands in for the capture date, which would mean
+        // opening every file here.
+        for (ScanItem &item : items) {
+            item.priority = mtimes.value(item.filePath);
+        }
+        std::stable_sort(items.begin(), items.end(), [](const ScanItem &a, const ScanItem &b) {
+            return a.priority > b.priority;
+        });
+
+        if (!resumedPaths.isEmpty()) {
+            items.erase(std::remove_if(items.begin(), items.end(), [&](const ScanItem &item) {
+                return resumedPaths.contains(item.filePath);
+            }), items.end());
+        }
+
+        // Into the checkpoint before the queue: whatever the main thread
+        // takes off the queue is already in the spool (checkpointWalked())
+        {
+            QMutexLocker locker(&m_walkSpoolMutex);
+            m_walkSpool += items;
+        }
+
+        for (const ScanItem &item : items) {
+            if (!enqueue(item)) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    result.complete = true;
+    for (const QString &root : roots) {
+        if (!walker.walk(root, recursive, visit)) {
+            result.complete = false;
+            break;
+        }
+    }
+
+    result.fresh = walker.fresh();
+    // Only a full recursive walk visits every folder it could have
+    if (result.complete && recursive) {
+        result.gone = walker.gone(roots);
+    }
+    result.dirsListed = walker.dirsListed();
+    result.dirsCached = walker.dirsCached();
+    result.walkMs = timer.elapsed();
+    return result;
+}
+
+void FacePipeline::onFilesQueued()
+{
+    m_walkNotifyPending.store(0);
+    if (!m_processing) {
+        return;
+    }
+
+    const int estimate = qMax(m_walkQueued.load(), m_expectedPhotos);
+    if (estimate != m_totalPhotos) {
+        m_totalPhotos = estimate;
+        emit totalPhotosChanged();
+    }
+    dispatchExtractions();
+}
+
+void FacePipeline::onWalkFinished()
+{
+    TRACE_FUNCTION("pipeline");
+    const WalkResult walk = m_walkWatcher.result();
+    m_walking = false;
+
+    checkpointWalked();
+    if (walk.complete && !m_cancelRequested) {
+        // Resuming from here needs no walk
+        m_scanCheckpoint["walked"] = true;
+        saveScanCheckpoint();
+    }
+
+    // Listings and fingerprints read before a cancel are still right
+    m_database->setPhotoFingerprints(walk.refresh);
+    m_database->updateScannedDirs(walk.fresh, walk.gone);
+
+    m_scanStats.walkMs = walk.walkMs;
+    m_scanStats.dirsListed = walk.dirsListed;
+    m_scanStats.dirsCached = walk.dirsCached;
+
+    qCDebug(lcNami) << "Walk done in" << walk.walkMs << "ms:" << walk.dirsListed
+                    << "folders read," << walk.dirsCached << "unchanged;" << walk.added << "new,"
+                    << walk.changed << "changed," << walk.unchanged << "photos unchanged";
+
+    // The estimate becomes the real count
+    m_totalPhotos = m_walkQueued.load();
+    emit totalPhotosChanged();
+    emit walkingChanged();
+
+    dispatchExtractions();
+    finishScanIfDrained();
+}
+
+void FacePipeline::checkpointWalked()
+{
+    TRACE_FUNCTION("pipeline");
+    QVector<ScanItem> items;
+    {
+        QMutexLocker locker(&m_walkSpoolMutex);
+        items.swap(m_walkSpool);
+    }
+    m_database->appendScanQueue(items);
+}
+
+QJsonObject FacePipeline::readScanCheckpoint()
+{
+    const QByteArray stored = m_database->getSetting("scan_checkpoint").toUtf8();
+    if (stored.isEmpty()) {
+        return QJsonObject();
+    }
+
+    // Embeddings of another engine version must not be mixed in
+    const QJsonObject checkpoint = QJsonDocument::fromJson(stored).object();
+    if (checkpoint["embedding_version"].toInt() != EMBEDDING_VERSION
+            || checkpoint["paths"].toArray().isEmpty()) {
+        return QJsonObject();
+    }
+    return checkpoint;
+}
+
+void FacePipeline::saveScanCheckpoint()
+{
+    m_database->setSetting("scan_checkpoint",
+                           QString::fromUtf8(QJsonDocument(m_scanCheckpoint).toJson(QJsonDocument::Compact)));
+}
+
+void FacePipeline::clearScanCheckpoint()
+{
+    {
+        QMutexLocker locker(&m_walkSpoolMutex);
+        m_walkSpool.clear();
+    }
+    m_scanCheckpoint = QJsonObject();
+    m_database->setSetting("scan_checkpoint", QString());
+    m_database->clearScanQueue();
+    setCanResumeScan(false);
+}
+
+void FacePipeline::setCanResumeScan(bool canResume)
+{
+    if (m_canResumeScan != canResume) {
+        m_canResumeScan = canResume;
+        emit canResumeScanChanged();
+    }
+}
+
+void FacePipeline::prioritizePhoto(const QString &filePath)
+{
+    prioritizeFiles(QStringList{filePath});
+}
+
+void FacePipeline::prioritizeFolder(const QString &folder)
+{
+    QStringList files;
+    QDir dir(folder);
+    for (const QString &name : dir.entryList(QDir::Files)) {
+        if (GalleryWalker::isImageName(name)) {
+            files.append(dir.absoluteFilePath(name));
+        }
+    }
+    prioritizeFiles(files);
+}
+
+void FacePipeline::prioritizeFiles(const QStringList &paths)
+{
+    if (!m_initialized || paths.isEmpty()) {
+        return;
+    }
+    for (const QString &path : paths) {
+        m_bumped.insert(path);
+    }
+
+    // Between scans, ingestion takes them: ahead of what the watcher reported
+    if (!m_processing) {
+        QStringList candidates = paths;
+        for (const QString &path : m_ingestCandidates) {
+            if (!paths.contains(path)) {
+                candidates.append(path);
+            }
+        }
+        m_ingestCandidates = candidates;
+        m_ingestCandidateSet.unite(paths.toSet());
+        startIngest();
+        return;
+    }
+
+    if (m_cancelRequested) {
+        return;
+    }
+
+    // Queued by the walk already: moved up
+    const QSet<QString> promoted = m_scanQueue.promote(paths.toSet());
+
+    // The rest is either in flight or committed, not reached by the walk
+    // yet, or outside this scan's folders
+    const bool recursive = m_scanCheckpoint["recursive"].toBool();
+    QStringList roots;
+    for (const QJsonValue &root : m_scanCheckpoint["paths"].toArray()) {
+        roots.append(root.toString());
+    }
+    QStringList rest;
+    QHash<QString, QVector<StoredFingerprint>> storedByFolder;
+    const QDateTime processedSince = m_currentScanIsForced
+        ? QDateTime::fromString(m_scanCheckpoint["started"].toString(), Qt::ISODate) : QDateTime();
+    for (const QString &path : paths) {
+        const QString folder = path.left(path.lastIndexOf('/'));
+        const bool inScan = std::any_of(roots.constBegin(), roots.constEnd(), [&](const QString &root) {
+            return folder == root || (recursive && folder.startsWith(root + '/'));
+        });
+        if (!inScan) {
+            m_bumped.remove(path);  // not this scan's to process
+            continue;
+        }
+        if (promoted.contains(path) || m_promoted.contains(path) || m_inFlight.contains(path)) {
+            continue;
+        }
+        rest.append(path);
+        if (!storedByFolder.contains(folder)) {
+            storedByFolder.insert(folder, m_database->getPhotoFingerprints(folder, processedSince));
+        }
+    }
+
+    // A few stat() calls on this thread; the walk skips its own copy later
+    IngestResult checked = checkIngestCandidates(rest, storedByFolder);
+    dropBumped(rest, checked.due);
+    for (ScanItem &item : checked.due) {
+        if (m_scanQueue.pushUrgent(item)) {
+            m_promoted.insert(item.filePath);
+            item.priority = ScanQueue::URGENT;
+        }
+    }
+    m_database->appendScanQueue(checked.due);
+
+    qCDebug(lcNami) << "Prioritized" << promoted.size() + checked.due.size() << "of" << paths.size()
+                    << "photos in the scan queue";
+    dispatchExtractions();
+}
+
+QStringList FacePipeline::galleryFolders()
+{
+    QStringList folders = m_database->getSetting("scan_folders").split('\n', QString::SkipEmptyParts);
+    if (folders.isEmpty()) {
+        const QString legacy = m_database->getSetting("gallery_path");
+        folders.append(legacy.isEmpty() ? m_defaultGalleryPath : legacy);
+    }
+    folders.removeAll(QString());
+    return folders;
+}
+
+void FacePipeline::updateGalleryWatcher()
+{
+    if (!m_initialized || !m_watchGalleries) {
+        m_galleryWatcher.stop();
+        abortIngest();
+        return;
+    }
+
+    // Folder listings of the last scan: arming only reads what changed since
+    m_galleryWatcher.watch(galleryFolders(), true, m_database->getScannedDirs());
+}
+
+void FacePipeline::onWatchedPhotosChanged(const QStringList &paths)
+{
+    for (const QString &path : paths) {
+        if (!m_ingestCandidateSet.contains(path)) {
+            m_ingestCandidateSet.insert(path);
+            m_ingestCandidates.append(path);
+        }
+    }
+    startIngest();
+}
+
+void FacePipeline::startIngest()
+{
+    if (!m_initialized || m_processing || m_engines.isEmpty() || m_ingestWatcher.isRunning()) {
+        return;
+    }
+    m_ingestCancel.store(0);
+
+    // Photos already found due go first, a few at a time; one the user is
+    // waiting for on its own, so it is committed as soon as it is done
+    if (!m_ingestDue.isEmpty()) {
+        const int size = m_bumped.contains(m_ingestDue.first().filePath) ? 1 : INGEST_BATCH_SIZE;
+        const QVector<ScanItem> batch = m_ingestDue.mid(0, size);
+        m_ingestDue.remove(0, batch.size());
+        const ExtractionEngine engine = m_engines.first();
+        m_ingestWatcher.setFuture(m_ingestPool.run([this, batch, engine]() {
+            return extractIngestBatch(batch, engine);
+        }));
+        return;
+    }
+
+    if (m_ingestCandidates.isEmpty()) {
+        return;
+    }
+
+    const QStringList chunk = m_ingestCandidates.mid(0, INGEST_CHECK_CHUNK);
+    m_ingestCandidates.erase(m_ingestCandidates.begin(), m_ingestCandidates.begin() + chunk.size());
+    QHash<QString, QVector<StoredFingerprint>> storedByFolder;
+    for (const QString &path : chunk) {
+        m_ingestCandidateSet.remove(path);
+        const QString folder = path.left(path.lastIndexOf('/'));
+        if (!storedByFolder.contains(folder)) {
+            storedByFolder.insert(folder, m_database->getPhotoFingerprints(folder));
+        }
+    }
+    m_ingestWatcher.setFuture(m_ingestPool.run([chunk, storedByFolder]() {
+        return checkIngestCandidates(chunk, storedByFolder);
+    }));
+}
+
+IngestResult FacePipeline::checkIngestCandidates(const QStringList &paths,
+                                                 const QHash<QString, QVector<StoredFingerprint>> &storedByFolder)
+{
+    QHash<QString, QVector<QPair<QString, FileFingerprint>>> onDiskByFolder;
+    for (const QString &path : paths) {
+        const FileFingerprint fingerprint = FileFingerprint::of(path);
+        if (fingerprint.isValid()) {  // else gone again, e.g. a temp file
+            onDiskByFolder[path.left(path.lastIndexOf('/'))].append(qMakePair(path, fingerprint));
+        }
+    }
+
+    IngestResult result;
+    for (auto it = onDiskByFolder.constBegin(); it != onDiskByFolder.constEnd(); ++it) {
+        const FingerprintDiff diff = diffFingerprints(it.value(), storedByFolder.value(it.key()));
+        for (const QString &file : diff.added) {
+            result.due.append(ScanItem{file, false});
+        }
+        for (const QString &file : diff.changed) {
+            result.due.append(ScanItem{file, true});
+        }
+        result.refresh += diff.refresh;
+    }
+    result.checked = paths;
+    return result;
+}
+
+IngestResult FacePipeline::extractIngestBatch(const QVector<ScanItem> &batch,
+                                              const ExtractionEngine &engine)
+{
+    TRACE_FUNCTION("pipeline");
+    IngestResult result;
+    for (const ScanItem &item : batch) {
+        if (m_ingestCancel.load()) {
+            break;
+        }
+        result.extractions.append(extractPhotoData(item.filePath, engine));
+        result.extracted.append(item);
+    }
+    return result;
+}
+
+void FacePipeline::onIngestFinished()
+{
+    TRACE_FUNCTION("pipeline");
+    const IngestResult result = m_ingestWatcher.result();
+
+    // A scan started after this step did: it covers these photos
+    if (m_ingestDiscard || m_processing) {
+        m_ingestDiscard = false;
+        return;
+    }
+
+    m_database->setPhotoFingerprints(result.refresh);
+    // Ahead of older work: the newest reports, and prioritizePhoto()
+    m_ingestDue = result.due + m_ingestDue;
+    dropBumped(result.checked, result.due);
+
+    if (!result.extractions.isEmpty()) {
+        // One transaction for the batch, like a scan's
+        if (m_database->beginTransaction()) {
+            m_batchAge.start();
+        }
+
+        int photos = 0;
+        int faces = 0;
+        for (int i = 0; i < result.extractions.size(); i++) {
+            if (m_batchAge.isValid()) {
+                m_batchPhotos++;
+            }
+            const PhotoProcessingResult processed =
+                commitExtraction(result.extractions[i], result.extracted[i].changed);
+            if (processed.success) {
+                photos++;
+                faces += processed.facesDetected;
+                rememberBurstFrame(result.extractions[i]);
+            }
+            if (m_bumped.remove(processed.filePath) && processed.success) {
+                emit photoReady(processed.filePath);
+            }
+        }
+        flushCommitBatch();
+
+        qCDebug(lcNami) << "Ingested" << photos << "new or changed photos," << faces << "faces,"
+                        << m_ingestDue.size() + m_ingestCandidates.size() << "left";
+        if (photos > 0) {
+            emit photosIngested(photos, faces);
+        }
+    }
+
+    startIngest();
+}
 
-    processNextPhoto();
+void FacePipeline::dropBumped(const QStringList &checked, const QVector<ScanItem> &due)
+{
+    if (m_bumped.isEmpty()) {
+        return;
+    }
+    QSet<QString> dueSet;
+    for (const ScanItem &item : due) {
+        dueSet.insert(item.filePath);
+    }
+    for (const QString &path : checked) {
+        if (!dueSet.contains(path)) {
+            m_bumped.remove(path);
+        }
+    }
 }
 
-void FacePipeline::processNextPhoto()
+void FacePipeline::abortIngest()
 {
+    m_ingestCandidates.clear();
+    m_ingestCandidateSet.clear();
+    m_ingestDue.clear();
+
+    if (m_ingestWatcher.isRunning()) {
+        m_ingestCancel.store(1);
+        m_ingestWatcher.waitForFinished();
+        m_ingestDiscard = true;
+    }
+}
+
+void FacePipeline::dispatchExtractions()
+{
+    TRACE_FUNCTION("pipeline");
     if (m_cancelRequested) {
-        finishScan(true);
         return;
     }
 
-    if (m_pendingFiles.isEmpty()) {
-        finishScan(false);
+    QStringList skipped;
+    for (int slot = 0; slot < m_activeEngines; slot++) {
+        if (m_watcherSequence[slot] >= 0) {
+            continue;
+        }
+
+        ScanItem item;
+        bool popped = m_scanQueue.tryPop(item);
+        // The walk's copy of a photo prioritizeFiles() pushed ahead of it
+        while (popped && !item.isUrgent() && m_promoted.contains(item.filePath)) {
+            skipped.append(item.filePath);
+            popped = m_scanQueue.tryPop(item);
+        }
+        if (!popped) {
+            break;
+        }
+        if (item.changed) {
+            m_changedFiles.insert(item.filePath);
+        }
+        m_inFlight.insert(item.filePath);
+
+        const QString filePath = item.filePath;
+        const ExtractionEngine engine = m_engines[slot];
+        m_watcherSequence[slot] = m_nextDispatchSequence++;
+
+        // Decode + detect + embed on a worker thread; the UI thread only does
+        // the DB commit once the result is next in line
+        auto extract = [this, filePath, engine]() {
+            QElapsedTimer timer;
+            timer.start();
+            PhotoExtraction extraction = extractPhotoData(filePath, engine);
+            extraction.extractMs = timer.elapsed();
+            return extraction;
+        };
+        m_extractionWatchers[slot]->setFuture(
+            m_throttle.profile() == ScanThrottle::Background
+                ? m_backgroundPool.run(extract)
+                : QtConcurrent::run(&m_extractionPool, extract));
+    }
+
+    // Everything just taken off the queue was spooled before it was queued
+    checkpointWalked();
+    for (const QString &path : skipped) {
+        m_database->removeFromScanQueue(path);
+    }
+}
+
+void FacePipeline::onExtractionFinished(int slot)
+{
+    TRACE_FUNCTION("pipeline");
+    const int sequence = m_watcherSequence[slot];
+    m_watcherSequence[slot] = -1;
+
+    if (!m_processing || sequence < 0) {
         return;
     }
 
-    QString filePath = m_pendingFiles.takeFirst();
-    emit scanProgress(m_processedPhotos + 1, m_totalPhotos, filePath);
+    // A cancelled scan lets in-flight photos finish but keeps none of them
+    if (!m_cancelRequested) {
+        const PhotoExtraction &extraction = m_extractionWatchers[slot]->result();
+        m_completedExtractions.insert(sequence, extraction);
+
+        // Fewer workers: the slots above the new count finish their photo
+        // and are not refilled
+        if (m_throttle.photoDone(extraction.extractMs, ScanThrottle::readLoad(),
+                                 QDateTime::currentMSecsSinceEpoch())) {
+            applyThrottle();
+        }
+    }
 
-    // Decode + detect + embed on a worker thread; the UI thread only does
-    // the DB commit in onExtractionFinished
-    m_extractionWatcher.setFuture(
-        QtConcurrent::run(this, &FacePipeline::extractPhotoData, filePath));
+    // Refill the worker first so it is not idle while SQLite runs
+    dispatchExtractions();
+    commitCompletedExtractions();
+    finishScanIfDrained();
 }
 
-void FacePipeline::onExtractionFinished()
+void FacePipeline::commitCompletedExtractions()
 {
-    if (!m_processing) {
+    TRACE_FUNCTION("pipeline");
+    // Strictly in scan order: a photo finishing early waits for those
+    // started before it, so matching sees the same history whatever the
+    // number of workers, and progress only ever counts up
+    while (!m_cancelRequested) {
+        auto next = m_completedExtractions.find(m_nextCommitSequence);
+        if (next == m_completedExtractions.end()) {
+            break;
+        }
+
+        const PhotoExtraction extraction = next.value();
+        m_completedExtractions.erase(next);
+        m_nextCommitSequence++;
+        m_inFlight.remove(extraction.filePath);
+
+        emit scanProgress(m_processedPhotos + 1, m_totalPhotos, extraction.filePath);
+
+        // Photos go into the open batch; commitExtraction()'s own
+        // transaction becomes a savepoint inside it
+        if (!m_batchAge.isValid() && m_database->beginTransaction()) {
+            m_batchAge.start();
+            m_batchFlushTimer.start(COMMIT_BATCH_MS);
+        }
+        if (m_batchAge.isValid()) {
+            m_batchPhotos++;
+        }
+
+        const bool reprocess = m_currentScanIsForced || m_changedFiles.contains(extraction.filePath);
+        QElapsedTimer commitTimer;
+        commitTimer.start();
+        PhotoProcessingResult result = commitExtraction(extraction, reprocess);
+        m_database->removeFromScanQueue(extraction.filePath);  // in the same batch
+        recordStageTimings(extraction, commitTimer.nsecsElapsed() / 1000);
+        if (m_bumped.remove(extraction.filePath) && result.success) {
+            emit photoReady(extraction.filePath);
+        }
+
+        if (result.success) {
+            m_totalFacesDetected += result.facesDetected;
+            if (extraction.duplicate) {
+                m_scanStats.duplicatesReused++;
+            }
+            if (extraction.burst) {
+                m_scanStats.burstFramesReused++;
+            }
+            m_scanStats.facesBelowQuality += extraction.belowQuality.size();
+            rememberBurstFrame(extraction);
+            const quint64 key = FaceDatabase::hashKey(extraction.fileHash);
+            if (key != 0) {
+                QMutexLocker locker(&m_knownHashesMutex);
+                m_knownHashes.insert(key);
+            }
+        }
+        m_scanStats.photos++;
+        m_scanStats.bytesRead += extraction.bytesRead;
+
+        emit photoProcessed(result);
+
+        m_processedPhotos++;
+        emit processedPhotosChanged();
+        if (m_statsAge.hasExpired(STATS_INTERVAL_MS)) {
+            m_statsAge.restart();
+            emit scanStatsChanged();
+        }
+
+        if (m_batchPhotos >= COMMIT_BATCH_PHOTOS || m_batchAge.hasExpired(COMMIT_BATCH_MS)) {
+            flushCommitBatch();
+        }
+    }
+}
+
+void FacePipeline::flushCommitBatch()
+{
+    TRACE_FUNCTION("pipeline");
+    m_batchFlushTimer.stop();
+    if (!m_batchAge.isValid()) {
         return;
     }
 
-    PhotoProcessingResult result = commitExtraction(m_extractionWatcher.result(),
-                                                    m_currentScanIsForced);
+    QElapsedTimer commitTimer;
+    commitTimer.start();
+    const bool committed = m_database->commitTransaction();
+    const qint64 commitMs = commitTimer.elapsed();
+
+    if (committed) {
+        // Ingestion batches between scans are not part of the scan stats
+        if (m_processing) {
+            m_scanStats.commits++;
+            m_scanStats.photosCommitted += m_batchPhotos;
+            m_scanStats.commitMs += commitMs;
+        }
+
+        for (const auto &face : m_batchUnmappedFaces) {
+            indexUnmappedFace(face.first, face.second);
+        }
+    } else {
+        // These photos stay unprocessed and are picked up by the next scan
+        qWarning() << "Failed to commit a batch of" << m_batchPhotos << "photos";
+        m_database->rollbackTransaction();
+        invalidatePersonPrototypes();
+        invalidateUnmappedIndex();
+    }
+
+    m_batchPhotos = 0;
+    m_batchAge.invalidate();
+    m_batchUnmappedFaces.clear();
+}
 
-    if (result.success) {
-        m_totalFacesDetected += result.facesDetected;
+void FacePipeline::finishScanIfDrained()
+{
+    if (!m_processing) {
+        return;
     }
 
-    emit photoProcessed(result);
+    for (int sequence : m_watcherSequence) {
+        if (sequence >= 0) {
+            return;
+        }
+    }
 
-    m_processedPhotos++;
-    emit processedPhotosChanged();
+    // Even a cancelled walk has to come back before the scan can end
+    if (m_walking) {
+        return;
+    }
+
+    if (!m_cancelRequested
+            && (!m_scanQueue.isEmpty() || !m_completedExtractions.isEmpty())) {
+        return;
+    }
 
-    processNextPhoto();
+    m_completedExtractions.clear();
+    finishScan(m_cancelRequested);
 }
 
 void FacePipeline::finishScan(bool cancelled)
 {
+    TRACE_FUNCTION("pipeline");
+    // Cancelling keeps what was already committed, as it always has
+    flushCommitBatch();
+
+    // Done, or stopped on purpose: nothing to resume
+    clearScanCheckpoint();
+
     m_processing = false;
+    m_inFlight.clear();
+    // Prioritized but left unprocessed by a cancelled scan: asked for again
+    // when the user next looks at them
+    m_bumped.clear();
     emit processingChanged();
+    emit scanStatsChanged();
+    {
+        QMutexLocker locker(&m_knownHashesMutex);
+        m_knownHashes.clear();
+    }
+
+    // What runs from here on (pruning, index rebuild) is not traced
+    if (m_tracingScan) {
+        m_tracingScan = false;
+        qCDebug(lcNami) << "Scan trace written to" << Tracer::filePath();
+        Tracer::stop();
+    }
+
+    // Photos the watcher reported during the scan
+    startIngest();
 
     if (cancelled) {
         qCDebug(lcNami) << "Scan cancelled by user";
@@ -258,6 +1348,9 @@ void FacePipeline::finishScan(bool cancelled)
         invalidatePersonPrototypes();
     }
 
+    // Fresh lists for everything this scan added
+    rebuildUnmappedIndex();
+
     // Stored embeddings now match the engine
     m_database->setSetting("embedding_version", QString::number(EMBEDDING_VERSION));
     if (m_needsRescan) {
@@ -266,7 +1359,95 @@ void FacePipeline::finishScan(bool cancelled)
     }
 
     emit scanCompleted(m_processedPhotos, m_totalFacesDetected);
-    qCDebug(lcNami) << "Scan completed:" << m_processedPhotos << "photos," << m_totalFacesDetected << "faces";
+    qCDebug(lcNami) << "Scan completed:" << m_processedPhotos << "photos," << m_totalFacesDetected << "faces,"
+                    << m_scanStats.bytesRead << "bytes read," << m_scanStats.commits << "commits in"
+                    << m_scanStats.commitMs << "ms";
+
+    if (lcPerf().isDebugEnabled()) {
+        for (int i = 0; i < StageTimings::StageCount; i++) {
+            const StageTimings::Stage stage = static_cast<StageTimings::Stage>(i);
+            const StageTimings::Summary summary = m_scanStats.stages.summary(stage);
+            qCDebug(lcPerf) << "Stage" << StageTimings::stageName(stage) << ":" << summary.count << "samples,"
+                            << summary.totalUs / 1000 << "ms total, p50" << summary.p50Us << "us, p95"
+                            << summary.p95Us << "us, max" << summary.maxUs << "us";
+        }
+    }
+}
+
+namespace {
+
+// Only frames the models ran on: one reused frame after another would let
+// the faces drift away from what is in the photos
+bool isBurstSource(const PhotoExtraction &extraction)
+{
+    return !extraction.burst && !extraction.duplicate && extraction.dhash != 0 && extraction.exifDate;
+}
+
+} // namespace
+
+void FacePipeline::rememberBurstFrame(const PhotoExtraction &extraction)
+{
+    if (!isBurstSource(extraction)) {
+        return;
+    }
+
+    BurstIndex::Frame frame;
+    frame.filePath = extraction.filePath;
+    frame.takenMs = extraction.dateTaken.toMSecsSinceEpoch();
+    frame.dhash = extraction.dhash;
+    frame.size = QSize(extraction.width, extraction.height);
+    frame.faces = extraction.faces;
+    m_burstIndex.add(frame);
+}
+
+void FacePipeline::loadBurstFrames()
+{
+    m_burstIndex.clear();
+    for (const BurstIndex::Frame &frame : m_database->getBurstFrames(BurstIndex::CAPACITY)) {
+        m_burstIndex.add(frame);
+    }
+    qCDebug(lcNami) << "Burst index loaded with" << m_burstIndex.size() << "frames";
+}
+
+bool FacePipeline::isKnownHash(const QString &fileHash)
+{
+    const quint64 key = FaceDatabase::hashKey(fileHash);
+    QMutexLocker locker(&m_knownHashesMutex);
+    return key != 0 && m_knownHashes.contains(key);
+}
+
+void FacePipeline::recordStageTimings(const PhotoExtraction &extraction, qint64 commitUs)
+{
+    StageTimings &stages = m_scanStats.stages;
+    const QPair<StageTimings::Stage, qint64> worker[] = {
+        { StageTimings::Read, extraction.readUs },
+        { StageTimings::Hash, extraction.hashUs },
+        { StageTimings::Decode, extraction.decodeUs },
+        { StageTimings::Convert, extraction.convertUs },
+        { StageTimings::Detect, extraction.detectUs },
+        { StageTimings::Quality, extraction.qualityUs },
+    };
+    for (const auto &sample : worker) {
+        if (sample.second >= 0) {
+            stages.add(sample.first, sample.second);
+        }
+    }
+    for (qint64 us : extraction.embedUs) {
+        stages.add(StageTimings::Embed, us);
+    }
+    stages.add(StageTimings::Commit, commitUs);
+
+    QVector<qint64> &recent = m_scanStats.recentMs;
+    recent.append(QDateTime::currentMSecsSinceEpoch());
+    if (recent.size() > ETA_WINDOW) {
+        recent.removeFirst();
+    }
+
+    qCDebug(lcPerf) << extraction.filePath << ": read" << extraction.readUs << "hash" << extraction.hashUs
+                    << "decode" << extraction.decodeUs << "convert" << extraction.convertUs
+                    << "detect" << extraction.detectUs << "quality" << extraction.qualityUs
+                    << "embed" << extraction.embedUs
+                    << "commit" << commitUs << "(us)";
 }
 
 PhotoProcessingResult FacePipeline::processPhoto(const QString &photoPath)
@@ -275,11 +1456,23 @@ PhotoProcessingResult FacePipeline::processPhoto(const QString &photoPath)
         return PhotoProcessingResult{-1, photoPath, 0, 0, false, "Pipeline not initialized"};
     }
 
-    return commitExtraction(extractPhotoData(photoPath), false);
+    // The first engine belongs to the scan while one is running
+    if (m_processing) {
+        return PhotoProcessingResult{-1, photoPath, 0, 0, false, "Already processing"};
+    }
+
+    // ...and to background ingestion between scans: wait for its batch
+    if (m_ingestWatcher.isRunning()) {
+        m_ingestWatcher.waitForFinished();
+    }
+
+    return commitExtraction(extractPhotoData(photoPath, m_engines.first()), false);
 }
 
-PhotoExtraction FacePipeline::extractPhotoData(const QString &photoPath)
+PhotoExtraction FacePipeline::extractPhotoData(const QString &photoPath,
+                                               const ExtractionEngine &engine)
 {
+    TRACE_FUNCTION("pipeline");
     PhotoExtraction extraction;
     extraction.filePath = photoPath;
     extraction.loaded = false;
@@ -288,53 +1481,247 @@ PhotoExtraction FacePipeline::extractPhotoData(const QString &photoPath)
     extraction.hasLocation = false;
     extraction.latitude = 0.0;
     extraction.longitude = 0.0;
+    extraction.duplicate = false;
+    extraction.dhash = 0;
+    extraction.exifDate = false;
+    extraction.burst = false;
+    extraction.bytesRead = 0;
+    extraction.extractMs = 0;
+    extraction.readUs = -1;
+    extraction.hashUs = -1;
+    extraction.decodeUs = -1;
+    extraction.convertUs = -1;
+    extraction.detectUs = -1;
+    extraction.qualityUs = -1;
 
     qCDebug(lcNami) << "Processing photo:" << photoPath;
 
-    extraction.fileHash = computeFileSha256(photoPath);
+    // Time since the previous call, in microseconds
+    QElapsedTimer stageTimer;
+    stageTimer.start();
+    auto lap = [&stageTimer]() {
+        const qint64 us = stageTimer.nsecsElapsed() / 1000;
+        stageTimer.restart();
+        return us;
+    };
 
-    QImage image = loadImage(photoPath);
-    if (image.isNull()) {
+    // Before the read: if the file changes while being read, the stored
+    // fingerprint is already stale and the next scan picks it up again
+    extraction.fingerprint = FileFingerprint::of(photoPath);
+
+    // One read of the file feeds the hash, the EXIF parser and the decoder
+    PhotoFile file(photoPath);
+    if (!file.isOpen()) {
+        qCDebug(lcNami) << "Failed to read file:" << photoPath;
         return extraction;
     }
+    extraction.bytesRead = file.bytesRead();
+    extraction.readUs = lap();
 
-    extraction.loaded = true;
-    extraction.width = image.width();
-    extraction.height = image.height();
+    extraction.fileHash = computeSha256(file.data());
+    extraction.hashUs = lap();
 
     // Capture date from EXIF; mtime only as fallback (it resets on copy/sync)
-    ExifReader::Metadata metadata = ExifReader::readMetadata(photoPath);
-    extraction.dateTaken = metadata.dateTaken;
-    if (!extraction.dateTaken.isValid()) {
-        extraction.dateTaken = QFileInfo(photoPath).lastModified();
+    auto readMetadata = [&]() {
+        ExifReader::Metadata metadata = ExifReader::parseMetadata(file.data());
+        extraction.dateTaken = metadata.dateTaken;
+        extraction.exifDate = metadata.dateTaken.isValid();
+        if (!extraction.dateTaken.isValid()) {
+            extraction.dateTaken = QFileInfo(photoPath).lastModified();
+        }
+        extraction.hasLocation = metadata.hasLocation;
+        extraction.latitude = metadata.latitude;
+        extraction.longitude = metadata.longitude;
+    };
+
+    // A copy of a photo already processed (DCIM and the SD card, a
+    // messaging app's folder): the same faces, so no decode or inference
+    if (isKnownHash(extraction.fileHash)) {
+        readMetadata();
+        extraction.loaded = true;
+        extraction.duplicate = true;
+        qCDebug(lcNami) << "Copy of a processed photo, reusing its faces:" << photoPath;
+        return extraction;
     }
-    extraction.hasLocation = metadata.hasLocation;
-    extraction.latitude = metadata.latitude;
-    extraction.longitude = metadata.longitude;
 
-    QVector<FaceDetection> detections = m_detector->detect(image);
+    // Detection only needs the detector's input size: decode straight to it
+    const QSize inputSize = engine.detector->inputSize();
+    QSize fullSize;
+    QImage image = loadImage(file.data(), photoPath,
+                             qMax(inputSize.width(), inputSize.height()), &fullSize);
+    extraction.decodeUs = lap();
+    if (image.isNull()) {
+        return extraction;
+    }
+
+    extraction.loaded = true;
+    extraction.width = fullSize.width();
+    extraction.height = fullSize.height();
+
+    readMetadata();
+    extraction.dhash = PerceptualHash::dHash(image);
+    extraction.decodeUs += lap();
+
+    // The next frame of a burst: the faces of the frame it follows. Only
+    // by EXIF capture time: files without one copied in together share an
+    // mtime without being a burst.
+    BurstIndex::Frame earlier;
+    const bool burst = extraction.exifDate
+        && m_burstIndex.find(extraction.dateTaken.toMSecsSinceEpoch(), extraction.dhash, fullSize, &earlier);
+    if (burst && !m_burstVerify.load()) {
+        extraction.faces = earlier.faces;
+        extraction.burst = true;
+        qCDebug(lcNami) << "Burst frame, faces taken from" << earlier.filePath;
+        return extraction;
+    }
+
+    // Converted once, shared by the detector and the recognizer
+    const cv::Mat cvImage = FaceDetector::qImageToCvMat(image);
+    image = QImage();  // the Mat owns its copy, drop the decoder's buffer
+    extraction.convertUs = lap();
+
+    QVector<FaceDetection> detections = engine.detector->detect(cvImage);
     qCDebug(lcNami) << "Detected" << detections.size() << "faces";
 
+    extraction.detectUs = lap();
+
+    // Too small, turned away or blurred: not worth an embedding that will
+    // hardly match anyone. Geometry here, it costs nothing; sharpness once
+    // the face is aligned.
+    const FaceQuality::Level quality = static_cast<FaceQuality::Level>(m_faceQuality.load());
+    const FaceQuality::Thresholds thresholds = FaceQuality::thresholds(quality);
+    if (quality != FaceQuality::Off) {
+        QVector<FaceDetection> kept;
+        for (const FaceDetection &detection : detections) {
+            const qreal side = qMax(detection.bbox.width() * fullSize.width(),
+                                    detection.bbox.height() * fullSize.height());
+            if (FaceQuality::checkGeometry(thresholds, side, detection.landmarks, fullSize) == FaceQuality::Pass) {
+                kept.append(detection);
+            } else {
+                extraction.belowQuality.append(detection.bbox);
+            }
+        }
+        detections = kept;
+    }
+    extraction.qualityUs = lap();
+
     if (detections.isEmpty()) {
         return extraction;
     }
 
-    // Convert once for all faces of this photo
-    cv::Mat cvImage = m_detector->qImageToCvMat(image);
+    // Verified: the same faces in the same places, so only the embeddings
+    // are taken over, with this frame's own boxes
+    if (burst && pairWithEarlierFrame(detections, earlier.faces, &extraction.faces)) {
+        extraction.burst = true;
+        qCDebug(lcNami) << "Burst frame, embeddings taken from" << earlier.filePath;
+        return extraction;
+    }
 
-    for (const FaceDetection &detection : detections) {
-        // Alignment to the 112x112 template happens inside the recognizer
-        // (FaceRecognizerSF::alignCrop) using the detected landmarks
-        FaceEmbedding embedding = m_recognizer->extractEmbedding(cvImage, detection);
-        if (embedding.empty()) {
+    // Faces small in the detection image are re-read from the file at up
+    // to full resolution: each on its own, or all from one bigger decode
+    QVector<QRectF> regions(detections.size());
+    QVector<qreal> regionScales(detections.size(), 0.0);
+    int smallFaces = 0;
+    qreal regionShare = 0.0;
+    qreal largestScale = 0.0;
+    for (int i = 0; i < detections.size(); i++) {
+        const FaceDetection &detection = detections[i];
+        const qreal faceSide = qMax(detection.bbox.width() * fullSize.width(),
+                                    detection.bbox.height() * fullSize.height());
+        const qreal detectedSide = faceSide * cvImage.cols / fullSize.width();
+        if (detectedSide >= FACE_REGION_SIDE || cvImage.cols == fullSize.width()) {
+            continue;
+        }
+        const qreal marginX = detection.bbox.width() * FACE_REGION_MARGIN;
+        const qreal marginY = detection.bbox.height() * FACE_REGION_MARGIN;
+        regions[i] = detection.bbox.adjusted(-marginX, -marginY, marginX, marginY)
+                   & QRectF(0.0, 0.0, 1.0, 1.0);
+        regionScales[i] = qMin<qreal>(1.0, FACE_REGION_SIDE / faceSide);
+        regionShare += regions[i].width() * regions[i].height();
+        largestScale = qMax(largestScale, regionScales[i]);
+        smallFaces++;
+    }
+
+    cv::Mat regionImage;
+    if (smallFaces > MAX_REGION_DECODES || regionShare > MAX_REGION_SHARE) {
+        const int maxSide = qCeil(largestScale * qMax(fullSize.width(), fullSize.height()));
+        QSize size;
+        const QImage whole = loadImage(file.data(), photoPath, maxSide, &size);
+        if (!whole.isNull()) {
+            regionImage = FaceDetector::qImageToCvMat(whole);
+        }
+        extraction.decodeUs += lap();
+    }
+
+    // Every face aligned to the 112x112 template first, then all of them
+    // through the network in one batch
+    std::vector<cv::Mat> alignedFaces;
+    QVector<FaceDetection> alignedDetections;
+    QVector<qint64> alignUs;
+    for (int i = 0; i < detections.size(); i++) {
+        const FaceDetection &detection = detections[i];
+
+        cv::Mat aligned;
+        if (regionScales[i] > 0.0 && !regionImage.empty()) {
+            aligned = engine.recognizer->alignFace(regionImage, detection);
+        } else if (regionScales[i] > 0.0) {
+            const QRectF &region = regions[i];
+            const qreal scale = regionScales[i];
+
+            QRectF decodedRegion;
+            QImage crop = loadImageRegion(file.data(), photoPath, region, scale, &decodedRegion);
+            if (!crop.isNull()) {
+                FaceDetection local = detection;
+                local.bbox = QRectF(toRegion(detection.bbox.topLeft(), decodedRegion),
+                                    toRegion(detection.bbox.bottomRight(), decodedRegion));
+                for (QPointF &landmark : local.landmarks) {
+                    landmark = toRegion(landmark, decodedRegion);
+                }
+                aligned = engine.recognizer->alignFace(FaceDetector::qImageToCvMat(crop), local);
+            }
+        }
+
+        if (aligned.empty()) {
+            aligned = engine.recognizer->alignFace(cvImage, detection);
+        }
+        if (aligned.empty()) {
+            qCDebug(lcNami) << "Failed to align a face in" << photoPath;
+            continue;
+        }
+        const qint64 faceAlignUs = lap();
+
+        if (quality != FaceQuality::Off
+                && FaceQuality::checkSharpness(thresholds, faceSharpness(aligned)) != FaceQuality::Pass) {
+            extraction.belowQuality.append(detection.bbox);
+            extraction.qualityUs += faceAlignUs + lap();
+            continue;
+        }
+        extraction.qualityUs += lap();
+
+        alignedFaces.push_back(aligned);
+        alignedDetections.append(detection);
+        alignUs.append(faceAlignUs);
+    }
+    if (!extraction.belowQuality.isEmpty()) {
+        qCDebug(lcNami) << extraction.belowQuality.size() << "faces below the quality gate in" << photoPath;
+    }
+
+    const QVector<FaceEmbedding> embeddings = engine.recognizer->embedAligned(alignedFaces);
+
+    // Per face: its alignment plus an equal share of the forward pass
+    const qint64 forwardUs = lap();
+    for (int i = 0; i < alignedDetections.size(); i++) {
+        extraction.embedUs.append(alignUs[i] + forwardUs / alignedDetections.size());
+
+        if (embeddings[i].empty()) {
             qCDebug(lcNami) << "Failed to extract embedding for a face in" << photoPath;
             continue;
         }
 
         ExtractedFace face;
-        face.bbox = detection.bbox;
-        face.confidence = detection.confidence;
-        face.embedding = embedding;
+        face.bbox = alignedDetections[i].bbox;
+        face.confidence = alignedDetections[i].confidence;
+        face.embedding = embeddings[i];
         extraction.faces.append(face);
     }
 
@@ -344,6 +1731,7 @@ PhotoExtraction FacePipeline::extractPhotoData(const QString &photoPath)
 PhotoProcessingResult FacePipeline::commitExtraction(const PhotoExtraction &extraction,
                                                      bool reprocess)
 {
+    TRACE_FUNCTION("pipeline");
     PhotoProcessingResult result;
     result.photoId = -1;
     result.filePath = extraction.filePath;
@@ -357,13 +1745,51 @@ PhotoProcessingResult FacePipeline::commitExtraction(const PhotoExtraction &extr
         return result;
     }
 
+    // A copy: the original's size and faces stand in for the detector's.
+    // If the original went since the worker checked, the copy stays
+    // unprocessed and the next scan runs inference on it.
+    int width = extraction.width;
+    int height = extraction.height;
+    QVector<ExtractedFace> faces = extraction.faces;
+    QVector<Face> copiedFaces;
+    if (extraction.duplicate) {
+        // Its own bytes, touched or copied back over itself: the faces it
+        // has stand, only its fingerprint moved
+        const Photo own = m_database->getPhotoByPath(extraction.filePath);
+        if (own.id >= 0 && own.processedAt.isValid() && own.fileHash == extraction.fileHash) {
+            m_database->setPhotoFingerprints({ qMakePair(own.id, extraction.fingerprint) });
+            result.photoId = own.id;
+            result.success = true;
+            return result;
+        }
+
+        const int sourceId = m_database->findProcessedCopy(extraction.fileHash, extraction.filePath);
+        if (sourceId < 0) {
+            result.errorMessage = "Original of the copy is no longer in the library";
+            return result;
+        }
+        const Photo source = m_database->getPhoto(sourceId);
+        width = source.width;
+        height = source.height;
+        copiedFaces = m_database->getFacesForPhoto(sourceId);
+        for (const Face &face : copiedFaces) {
+            faces.append(ExtractedFace{ face.bbox, face.confidence, face.embedding, face.ignored });
+        }
+    }
+
+    // People are matched again unless "duplicates_keep_people" says to
+    // take the original's, including what the user confirmed there
+    const bool keepPeople = extraction.duplicate
+        && m_database->getSetting("duplicates_keep_people", "false") == QLatin1String("true");
+
     // All writes for one photo in a single transaction
     m_database->beginTransaction();
 
     int photoId = m_database->addPhoto(extraction.filePath, extraction.dateTaken,
-                                       extraction.width, extraction.height,
+                                       width, height,
                                        extraction.hasLocation, extraction.latitude,
-                                       extraction.longitude, extraction.fileHash);
+                                       extraction.longitude, extraction.fileHash,
+                                       extraction.fingerprint);
     if (photoId < 0) {
         m_database->rollbackTransaction();
         result.errorMessage = "Failed to add photo to database";
@@ -371,12 +1797,29 @@ PhotoProcessingResult FacePipeline::commitExtraction(const PhotoExtraction &extr
     }
 
     result.photoId = photoId;
+    if (isBurstSource(extraction)) {
+        m_database->setPhotoDHash(photoId, extraction.dhash);
+    } else if (reprocess) {
+        m_database->setPhotoDHash(photoId, 0);
+    }
 
     // The photo may already have faces from a previous scan; remove them
     // before re-adding, otherwise every scan duplicates all faces and
-    // identified people keep reappearing as unknown
+    // identified people keep reappearing as unknown. What the user did
+    // with them passes to the new face in the same place: a touched or
+    // re-copied file must not lose its people.
+    QVector<Face> previousFaces;
+    QVector<QSet<int>> previousRejections;
     if (reprocess) {
+        previousFaces = m_database->getFacesForPhoto(photoId);
+        for (const Face &face : previousFaces) {
+            previousRejections.append(m_database->getNegativeMatches(face.id));
+        }
         m_database->deleteFacesForPhoto(photoId);
+        m_database->updatePhotoMetadata(photoId, extraction.dateTaken,
+                                        width, height,
+                                        extraction.hasLocation, extraction.latitude,
+                                        extraction.longitude, extraction.fileHash);
     } else if (m_database->getPhoto(photoId).processedAt.isValid()) {
         qCDebug(lcNami) << "Photo already processed, skipping:" << extraction.filePath;
         m_database->rollbackTransaction();
@@ -384,10 +1827,56 @@ PhotoProcessingResult FacePipeline::commitExtraction(const PhotoExtraction &extr
         return result;
     }
 
-    result.facesDetected = extraction.faces.size();
+    // The quality gate is for faces nobody has looked at yet: one it kept
+    // from embedding that the user already put a name to stays, with the
+    // embedding it had
+    QHash<int, QString> keptModels;
+    for (const Face &before : previousFaces) {
+        if (before.personId < 0) {
+            continue;
+        }
+        const bool reembedded = std::any_of(faces.constBegin(), faces.constEnd(), [&](const ExtractedFace &face) {
+            return intersectionOverUnion(face.bbox, before.bbox) >= CARRY_OVER_MIN_IOU;
+        });
+        for (int i = 0; i < extraction.belowQuality.size() && !reembedded; i++) {
+            if (intersectionOverUnion(extraction.belowQuality[i], before.bbox) >= CARRY_OVER_MIN_IOU) {
+                keptModels.insert(faces.size(), before.embeddingModel);
+                faces.append(ExtractedFace{ extraction.belowQuality[i], before.confidence, before.embedding });
+                break;
+            }
+        }
+    }
 
-    for (const ExtractedFace &face : extraction.faces) {
-        FaceMatch match = matchFaceToDatabase(face.embedding, m_autoMatchThreshold);
+    result.facesDetected = faces.size();
+    const QVector<int> carried = carryOverFaces(faces, previousFaces);
+
+    // Indexed once the transaction is committed
+    QVector<QPair<int, FaceEmbedding>> unmappedFaces;
+
+    for (int i = 0; i < faces.size(); i++) {
+        const ExtractedFace &face = faces[i];
+        const Face *earlier = carried[i] >= 0 ? &previousFaces[carried[i]] : nullptr;
+        FaceMatch match;
+        bool verified = false;
+        bool ignored = false;
+        if (earlier && (earlier->personId >= 0 || earlier->ignored)) {
+            match.personId = earlier->personId;
+            match.similarity = earlier->similarityScore;
+            verified = earlier->verified;
+            ignored = earlier->ignored;
+        } else if (face.ignored) {
+            match = FaceMatch{-1, 0.0f};
+            ignored = true;
+        } else if (keepPeople && i < copiedFaces.size() && copiedFaces[i].personId >= 0) {
+            match.personId = copiedFaces[i].personId;
+            match.similarity = copiedFaces[i].similarityScore;
+            verified = copiedFaces[i].verified;
+        } else {
+            match = matchFaceToDatabase(face.embedding, m_autoMatchThreshold);
+            if (earlier && previousRejections[carried[i]].contains(match.personId)) {
+                match = FaceMatch{-1, 0.0f};
+            }
+        }
 
         if (match.personId >= 0) {
             result.facesMatched++;
@@ -397,79 +1886,96 @@ PhotoProcessingResult FacePipeline::commitExtraction(const PhotoExtraction &extr
 
         int faceId = m_database->addFace(photoId, face.bbox, face.confidence,
                                          face.embedding, match.personId,
-                                         match.similarity, false);
+                                         match.similarity, verified);
         if (faceId < 0) {
             qCDebug(lcNami) << "Failed to add face to database for" << extraction.filePath;
+            continue;
+        }
+        // A copy's embedding is the original's, from whichever model that was
+        if (i < copiedFaces.size()) {
+            m_database->setFaceEmbeddingModel(faceId, copiedFaces[i].embeddingModel);
+        } else if (keptModels.contains(i)) {
+            m_database->setFaceEmbeddingModel(faceId, keptModels.value(i));
+        }
+        if (earlier) {
+            for (int personId : previousRejections[carried[i]]) {
+                m_database->addNegativeMatch(faceId, personId);
+            }
+        }
+        if (ignored) {
+            m_database->setFaceIgnored(faceId, true);
+        } else if (match.personId < 0) {
+            unmappedFaces.append(qMakePair(faceId, face.embedding));
         }
     }
 
     m_database->markPhotoProcessed(photoId);
     m_database->commitTransaction();
 
+    // Inside a scan batch nothing is durable yet: index on flush
+    if (m_batchAge.isValid()) {
+        m_batchUnmappedFaces += unmappedFaces;
+    } else {
+        for (const auto &face : unmappedFaces) {
+            indexUnmappedFace(face.first, face.second);
+        }
+    }
+
     result.success = true;
     return result;
 }
 
-int FacePipeline::groupUnknownFaces(float similarityThreshold)
+bool FacePipeline::groupUnknownFaces(float similarityThreshold)
 {
     if (!m_initialized) {
         emit error("Pipeline not initialized");
-        return 0;
+        return false;
     }
-
-    qCDebug(lcNami) << "Grouping unknown faces with threshold:" << similarityThreshold;
-
-    QVector<Face> unmappedFaces = m_database->getUnmappedFaces();
-    qCDebug(lcNami) << "Found" << unmappedFaces.size() << "unmapped faces";
-
-    if (unmappedFaces.isEmpty()) {
-        return 0;
+    if (m_groupingWatcher.isRunning()) {
+        return false;
     }
 
-    // Simple clustering by similarity
-    int groupsCreated = 0;
-    QVector<bool> processed(unmappedFaces.size(), false);
-
-    for (int i = 0; i < unmappedFaces.size(); i++) {
-        if (processed[i]) {
-            continue;
-        }
-
-        // Create new person for this group
-        QString groupName = QString("Person %1").arg(groupsCreated + 1);
-        int personId = m_database->createPerson(groupName);
-
-        if (personId < 0) {
-            continue;
-        }
+    qCDebug(lcNami) << "Grouping unknown faces with threshold:" << similarityThreshold;
+    m_groupingTimer.start();
 
-        // Assign this face to the new person
-        m_database->updateFacePersonMapping(unmappedFaces[i].id, personId);
-        processed[i] = true;
+    // Read here (SQLite stays on this thread), cluster on a worker
+    const QVector<QPair<int, FaceEmbedding>> faces = m_database->getUnmappedEmbeddings();
+    qCDebug(lcNami) << "Found" << faces.size() << "unmapped faces";
 
-        // Find similar faces
-        for (int j = i + 1; j < unmappedFaces.size(); j++) {
-            if (processed[j]) {
-                continue;
-            }
+    m_groupingWatcher.setFuture(QtConcurrent::run([faces, similarityThreshold]() {
+        return FaceClustering::cluster(faces, similarityThreshold, MIN_GROUP_SIZE);
+    }));
+    emit groupingChanged();
+    return true;
+}
 
-            float similarity = FaceRecognizer::computeSimilarity(
-                unmappedFaces[i].embedding,
-                unmappedFaces[j].embedding
-            );
+void FacePipeline::onGroupingFinished()
+{
+    const FaceClustering::Result result = m_groupingWatcher.result();
 
-            if (similarity >= similarityThreshold) {
-                m_database->updateFacePersonMapping(unmappedFaces[j].id, personId);
-                processed[j] = true;
-            }
+    int groupsCreated = 0;
+    int facesGrouped = 0;
+    if (!result.groups.isEmpty()) {
+        flushCommitBatch();
+        groupsCreated = m_database->createPeopleFromGroups(result.groups, MIN_GROUP_SIZE, &facesGrouped);
+        if (groupsCreated < 0) {
+            emit error("Failed to save face groups");
+            groupsCreated = 0;
+            facesGrouped = 0;
+        } else {
+            invalidatePersonPrototypes();
+            invalidateUnmappedIndex();
         }
-
-        groupsCreated++;
     }
 
-    qCDebug(lcNami) << "Created" << groupsCreated << "groups";
-    invalidatePersonPrototypes();
-    return groupsCreated;
+    const int elapsedMs = static_cast<int>(m_groupingTimer.elapsed());
+    qCDebug(lcNami) << "Created" << groupsCreated << "groups from" << result.faces << "faces in"
+                    << elapsedMs << "ms (graph" << result.graphMs << "ms," << result.edges
+                    << "edges; clustering" << result.clusterMs << "ms," << result.iterations
+                    << "rounds)";
+
+    emit groupingChanged();
+    emit groupingCompleted(groupsCreated, facesGrouped, elapsedMs);
 }
 
 bool FacePipeline::identifyFace(int faceId, int personId, const QString &personName, const QString &contactId)
@@ -479,6 +1985,8 @@ bool FacePipeline::identifyFace(int faceId, int personId, const QString &personN
         return false;
     }
 
+    flushCommitBatch();
+
     // Create new person if needed
     if (personId < 0 && !personName.isEmpty()) {
         personId = m_database->createPerson(personName);
@@ -496,6 +2004,7 @@ bool FacePipeline::identifyFace(int faceId, int personId, const QString &personN
     if (!m_database->updateFacePersonMapping(faceId, personId)) {
         return false;
     }
+    unindexFace(faceId);
 
     // Mark as verified (manually identified by user)
     if (!m_database->updateFaceMetadata(faceId, 1.0f, true)) {
@@ -518,34 +2027,48 @@ bool FacePipeline::identifyFace(int faceId, int personId, const QString &personN
         return true;  // Still return success, re-matching is optional
     }
 
-    // Get all unmapped faces (excludes ignored ones)
-    QVector<Face> unmappedFaces = m_database->getUnmappedFaces();
-    qCDebug(lcNami) << "Found" << unmappedFaces.size() << "unmapped faces to check";
+    // Candidates within threshold of any exemplar: straight from the index
+    // when it is built, otherwise every unmapped face (excludes ignored
+    // ones). Both are in memory; re-matching only writes.
+    QVector<FaceIndex::Hit> candidates;
+    if (m_unmappedIndexValid) {
+        candidates = m_unmappedIndex.search(exemplars, m_autoMatchThreshold);
+        qCDebug(lcNami) << "Index returned" << candidates.size() << "candidates out of"
+                        << m_unmappedIndex.size() << "unmapped faces";
+    } else {
+        EmbeddingMatrix personMatrix;
+        personMatrix.setPerson(personId, exemplars);
+
+        const QHash<int, FaceEmbedding> &unmapped = m_database->unmappedEmbeddings();
+        qCDebug(lcNami) << "Found" << unmapped.size() << "unmapped faces to check";
+        for (auto it = unmapped.constBegin(); it != unmapped.constEnd(); ++it) {
+            const float similarity = personMatrix.bestMatch(it.value()).similarity;
+            if (similarity >= m_autoMatchThreshold) {
+                candidates.append(FaceIndex::Hit{it.key(), similarity});
+            }
+        }
+
+        // Have the index ready for the next identification
+        rebuildUnmappedIndex();
+    }
 
-    // Match each unmapped face against the person
-    int autoMatched = 0;
-    for (const Face &face : unmappedFaces) {
+    QVector<QPair<int, float>> matches;
+    for (const FaceIndex::Hit &candidate : candidates) {
         // Respect user corrections: never reassign a rejected face
-        if (m_database->hasNegativeMatch(face.id, personId)) {
+        if (m_database->hasNegativeMatch(candidate.faceId, personId)) {
             continue;
         }
 
-        float similarity = 0.0f;
-        for (const FaceEmbedding &exemplar : exemplars) {
-            similarity = qMax(similarity,
-                              FaceRecognizer::computeSimilarity(face.embedding, exemplar));
-        }
-
-        // If similarity is above threshold, auto-assign to this person
-        if (similarity >= m_autoMatchThreshold) {
-            qCDebug(lcNami) << "Auto-matching face" << face.id << "to person" << personId
-                     << "with similarity" << similarity;
+        qCDebug(lcNami) << "Auto-matching face" << candidate.faceId << "to person" << personId
+                 << "with similarity" << candidate.similarity;
+        matches.append(qMakePair(candidate.faceId, candidate.similarity));
+    }
 
-            // Update face mapping with similarity score and verified=false (auto-matched)
-            if (m_database->updateFacePersonMapping(face.id, personId)) {
-                m_database->updateFaceMetadata(face.id, similarity, false);
-                autoMatched++;
-            }
+    // One transaction for the lot, verified=false (auto-matched)
+    const int autoMatched = m_database->assignFaces(personId, matches);
+    if (autoMatched > 0) {
+        for (const auto &match : matches) {
+            unindexFace(match.first);
         }
     }
 
@@ -554,70 +2077,328 @@ bool FacePipeline::identifyFace(int faceId, int personId, const QString &personN
     return true;
 }
 
+bool FacePipeline::isModelVariantAvailable(const QString &kind, const QString &precision)
+{
+    const ModelRegistry::Kind modelKind = kind == QLatin1String("detector")
+        ? ModelRegistry::Detector : ModelRegistry::Recognizer;
+    return m_models.isAvailable(modelKind, ModelRegistry::precisionFromString(precision));
+}
+
+bool FacePipeline::compareModelVariants(int photoCount)
+{
+    if (!m_initialized) {
+        emit error("Pipeline not initialized");
+        return false;
+    }
+    // A scan would take the cores and skew every timing
+    if (m_processing || m_comparisonWatcher.isRunning()) {
+        return false;
+    }
+
+    // Read here (SQLite stays on this thread), decode and run on a worker
+    QStringList paths;
+    for (const Photo &photo : m_database->getRecentPhotos(qMax(1, photoCount))) {
+        paths.append(photo.filePath);
+    }
+    const QSize inputSize = m_engines.first().detector->inputSize();
+    const int maxSide = qMax(inputSize.width(), inputSize.height());
+    const ModelRegistry models = m_models;
+    qCDebug(lcNami) << "Comparing model variants on" << paths.size() << "photos";
+
+    m_comparisonWatcher.setFuture(QtConcurrent::run([this, paths, maxSide, models]() {
+        ModelComparison comparison(models);
+        QString message;
+        if (!comparison.load(&message)) {
+            QVariantMap failed;
+            failed["error"] = message;
+            return failed;
+        }
+        for (const QString &path : paths) {
+            QFile file(path);
+            if (!file.open(QIODevice::ReadOnly)) {
+                continue;
+            }
+            QSize fullSize;
+            const QImage image = loadImage(file.readAll(), path, maxSide, &fullSize);
+            if (!image.isNull()) {
+                comparison.addPhoto(FaceDetector::qImageToCvMat(image));
+            }
+        }
+        return comparison.result();
+    }));
+    emit comparingModelsChanged();
+    return true;
+}
+
+void FacePipeline::onModelComparisonFinished()
+{
+    QVariantMap result = m_comparisonWatcher.result();
+    if (result.contains("error")) {
+        emit error(result["error"].toString());
+    } else {
+        result["library"] = m_database->countFacesByEmbeddingModel();
+        qCDebug(lcNami) << "Model comparison:" << result;
+
+        // What setSetting() asks of a recognizer switch; only measured on
+        // actual faces
+        const QVariantMap recognizer = result["recognizer"].toMap();
+        if (recognizer["faces"].toInt() > 0) {
+            m_database->setSetting("recognizer_agreement",
+                                   QString::number(recognizer["min_similarity"].toDouble()));
+        }
+    }
+
+    emit comparingModelsChanged();
+    emit modelComparisonCompleted(result);
+}
+
 void FacePipeline::cancel()
 {
     m_cancelRequested = true;
+
+    // Drops what the walk queued and stops it at its next photo
+    m_scanQueue.close();
+
+    // Nothing in flight means no watcher will come back to close the scan
+    finishScanIfDrained();
 }
 
 // === Helpers ===
 
-QStringList FacePipeline::findImageFiles(const QString &directory, bool recursive)
+void FacePipeline::useModels(ModelRegistry::Precision detector, ModelRegistry::Precision recognizer)
 {
-    QStringList imageFiles;
-    QDir dir(directory);
+    m_detectorPrecision = detector;
+    m_recognizerPrecision = recognizer;
+    m_detectorModelPath = m_models.path(ModelRegistry::Detector, detector);
+    m_recognizerModelPath = m_models.path(ModelRegistry::Recognizer, recognizer);
+    m_database->setEmbeddingModel(ModelRegistry::modelId(ModelRegistry::Recognizer, recognizer));
+    qCDebug(lcNami) << "Models:" << ModelRegistry::modelId(ModelRegistry::Detector, detector)
+                    << ModelRegistry::modelId(ModelRegistry::Recognizer, recognizer);
 
-    // Supported image formats
-    QStringList nameFilters;
-    nameFilters << "*.jpg" << "*.jpeg" << "*.png" << "*.bmp" << "*.gif";
+    // A burst frame takes over embeddings as they are: never across models
+    loadBurstFrames();
+}
+
+bool FacePipeline::switchModels(ModelRegistry::Precision detector, ModelRegistry::Precision recognizer)
+{
+    const QString detectorPath = m_models.path(ModelRegistry::Detector, detector);
+    const QString recognizerPath = m_models.path(ModelRegistry::Recognizer, recognizer);
+
+    // All engines or none: the ones already switched go back if another
+    // cannot load, so a scan never mixes variants
+    for (int i = 0; i < m_engines.size(); i++) {
+        if (!m_engines[i].detector->loadModel(detectorPath)
+                || !m_engines[i].recognizer->loadModel(recognizerPath)) {
+            for (int j = 0; j <= i; j++) {
+                m_engines[j].detector->loadModel(m_detectorModelPath);
+                m_engines[j].recognizer->loadModel(m_recognizerModelPath);
+            }
+            return false;
+        }
+    }
 
-    QDir::Filters filters = QDir::Files | QDir::Readable;
-    if (recursive) {
-        filters |= QDir::AllDirs | QDir::NoDotAndDotDot;
+    // The engines added later load these
+    useModels(detector, recognizer);
+    return true;
+}
+
+bool FacePipeline::canSwitchRecognizer(ModelRegistry::Precision recognizer)
+{
+    // Nothing to mix with: a new library, or one computed by that model
+    const QVariantMap library = m_database->countFacesByEmbeddingModel();
+    const QString target = ModelRegistry::modelId(ModelRegistry::Recognizer, recognizer);
+    if (library.isEmpty() || (library.size() == 1 && library.contains(target))) {
+        return true;
     }
 
-    QFileInfoList entries = dir.entryInfoList(nameFilters, filters);
+    // Otherwise old and new embeddings get matched with each other: only
+    // if the two variants embedded every compared face closely enough for
+    // an automatic match
+    bool ok = false;
+    const float agreement = m_database->getSetting("recognizer_agreement").toFloat(&ok);
+    return ok && agreement >= m_autoMatchThreshold;
+}
+
+bool FacePipeline::addExtractionEngine(bool quiet)
+{
+    ExtractionEngine engine;
+    engine.detector = new FaceDetector(this);
+    engine.recognizer = new FaceRecognizer(this);
+
+    // Only the first engine is needed: a scan carries on with fewer
+    // workers if another one cannot load (out of memory, typically)
+    const bool required = m_engines.isEmpty() && !quiet;
+    const char *failure = nullptr;
+    if (!engine.detector->loadModel(m_detectorModelPath)) {
+        failure = "Failed to load face detector model";
+    } else if (!engine.recognizer->loadModel(m_recognizerModelPath)) {
+        failure = "Failed to load face recognizer model";
+    }
 
-    for (const QFileInfo &entry : entries) {
-        if (entry.isDir() && recursive) {
-            imageFiles.append(findImageFiles(entry.absoluteFilePath(), true));
-        } else if (entry.isFile()) {
-            imageFiles.append(entry.absoluteFilePath());
+    if (failure) {
+        if (required) {
+            emit error(failure);
+        } else {
+            qCWarning(lcNami) << failure << "for extraction engine" << m_engines.size();
         }
+        delete engine.detector;
+        delete engine.recognizer;
+        return false;
+    }
+
+    const int slot = m_engines.size();
+    m_engines.append(engine);
+
+    QFutureWatcher<PhotoExtraction> *watcher = new QFutureWatcher<PhotoExtraction>(this);
+    connect(watcher, &QFutureWatcher<PhotoExtraction>::finished,
+            this, [this, slot]() { onExtractionFinished(slot); });
+    m_extractionWatchers.append(watcher);
+    m_watcherSequence.append(-1);
+
+    qCDebug(lcNami) << "Extraction engine" << slot << "ready";
+    return true;
+}
+
+int FacePipeline::extractionWorkerCount()
+{
+    bool ok = false;
+    int workers = m_database->getSetting("extraction_workers").toInt(&ok);
+    if (!ok || workers <= 0) {
+        // Leave a core to the UI thread
+        workers = QThread::idealThreadCount() - 1;
+    }
+    // By value: qBound() takes references, which would need an out-of-line
+    // definition of the constant
+    const int maxWorkers = MAX_EXTRACTION_WORKERS;
+    return qBound(1, workers, maxWorkers);
+}
+
+void FacePipeline::applyThrottle()
+{
+    // Extra engines are loaded once and kept for later scans. If memory runs
+    // short the scan simply goes on with the engines that did load.
+    while (m_engines.size() < m_throttle.workerCap() && addExtractionEngine()) {
     }
+    m_activeEngines = qMin(m_throttle.workers(), m_engines.size());
+    m_extractionPool.setMaxThreadCount(m_activeEngines);
+
+    // OpenCV parallelises inside each forward pass too; split the cores
+    // between the workers instead of having every one of them claim all
+    cv::setNumThreads(m_throttle.cvThreads());
 
-    return imageFiles;
+    qCDebug(lcNami) << "Scan profile" << ScanThrottle::profileName(m_throttle.profile()) << ":"
+                    << m_activeEngines << "extraction workers," << m_throttle.cvThreads()
+                    << "OpenCV threads each";
 }
 
-QImage FacePipeline::loadImage(const QString &filePath)
+QImage FacePipeline::loadImage(const QByteArray &data, const QString &filePath,
+                               int maxSide, QSize *fullSize)
 {
-    QImageReader reader(filePath);
+    // Shares data (no deep copy), the reader only ever reads from it
+    QBuffer buffer;
+    buffer.setData(data);
+    buffer.open(QIODevice::ReadOnly);
+
+    // No device-based format probing by file name here, so hand it the suffix
+    QImageReader reader(&buffer, QFileInfo(filePath).suffix().toLatin1());
+    reader.setDecideFormatFromContent(true);
     reader.setAutoTransform(true);  // Handle EXIF orientation
 
+    // Size and scaling are in stored orientation, before autoTransform.
+    // For JPEG the scaled decode is libjpeg's DCT scaling, so a 48 MP
+    // photo never exists in memory at full size.
+    const QSize storedSize = reader.size();
+    if (storedSize.isValid()) {
+        QSize orientedSize = storedSize;
+        if (reader.transformation() & QImageIOHandler::TransformationRotate90) {
+            orientedSize.transpose();
+        }
+        *fullSize = orientedSize;
+
+        if (qMax(storedSize.width(), storedSize.height()) > maxSide) {
+            reader.setScaledSize(storedSize.scaled(maxSide, maxSide, Qt::KeepAspectRatio));
+        }
+    }
+
     QImage image = reader.read();
 
     if (image.isNull()) {
         qCDebug(lcNami) << "Failed to load image:" << filePath << "-" << reader.errorString();
+        return image;
+    }
+
+    // Format without a cheap size query: full decode, scale afterwards
+    if (!storedSize.isValid()) {
+        *fullSize = image.size();
+        if (qMax(image.width(), image.height()) > maxSide) {
+            image = image.scaled(maxSide, maxSide, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        }
+    }
+
+    return image;
+}
+
+QImage FacePipeline::loadImageRegion(const QByteArray &data, const QString &filePath,
+                                     const QRectF &region, qreal scale, QRectF *decodedRegion)
+{
+    QBuffer buffer;
+    buffer.setData(data);
+    buffer.open(QIODevice::ReadOnly);
+
+    QImageReader reader(&buffer, QFileInfo(filePath).suffix().toLatin1());
+    reader.setDecideFormatFromContent(true);
+    reader.setAutoTransform(true);
+
+    const QSize storedSize = reader.size();
+    if (!storedSize.isValid()) {
+        return QImage();
+    }
+
+    // The clip rect applies to the stored image, before autoTransform turns
+    // the result upright; region is in upright coordinates
+    const QImageIOHandler::Transformations transformation = reader.transformation();
+    const QRectF stored = mapRect(region, orientedToStored, transformation);
+    const QRect clip = QRectF(stored.x() * storedSize.width(), stored.y() * storedSize.height(),
+                              stored.width() * storedSize.width(),
+                              stored.height() * storedSize.height()).toAlignedRect()
+                     & QRect(QPoint(0, 0), storedSize);
+    if (clip.isEmpty()) {
+        return QImage();
+    }
+
+    reader.setClipRect(clip);
+    if (scale < 1.0) {
+        reader.setScaledSize(QSize(qMax(1, qRound(clip.width() * scale)),
+                                   qMax(1, qRound(clip.height() * scale))));
+    }
+
+    QImage image = reader.read();
+    if (image.isNull()) {
+        qCDebug(lcNami) << "Failed to load face region of" << filePath << "-" << reader.errorString();
+        return image;
     }
 
+    // Pixel-aligned region actually decoded, back in upright coordinates
+    const QRectF clipped(static_cast<qreal>(clip.x()) / storedSize.width(),
+                         static_cast<qreal>(clip.y()) / storedSize.height(),
+                         static_cast<qreal>(clip.width()) / storedSize.width(),
+                         static_cast<qreal>(clip.height()) / storedSize.height());
+    *decodedRegion = mapRect(clipped, storedToOriented, transformation);
+
     return image;
 }
 
 FaceMatch FacePipeline::matchFaceToDatabase(const FaceEmbedding &embedding, float threshold)
 {
+    TRACE_FUNCTION("pipeline");
     FaceMatch bestMatch{-1, 0.0f};
 
     // A person is represented by several exemplar embeddings (different
     // looks: glasses, age, lighting); the person's score is the best
     // similarity over their exemplars
-    for (const auto &entry : personExemplars()) {
-        for (const FaceEmbedding &exemplar : entry.second) {
-            float similarity = FaceRecognizer::computeSimilarity(embedding, exemplar);
-            if (similarity > bestMatch.similarity) {
-                bestMatch.personId = entry.first;
-                bestMatch.similarity = similarity;
-            }
-        }
-    }
+    const EmbeddingMatrix::PersonScore best = personExemplars().bestMatch(embedding);
+    bestMatch.personId = best.personId;
+    bestMatch.similarity = best.similarity;
 
     if (bestMatch.similarity < threshold) {
         return FaceMatch{-1, bestMatch.similarity};
@@ -626,7 +2407,7 @@ FaceMatch FacePipeline::matchFaceToDatabase(const FaceEmbedding &embedding, floa
     return bestMatch;
 }
 
-const QVector<QPair<int, QVector<FaceEmbedding>>> &FacePipeline::personExemplars()
+const EmbeddingMatrix &FacePipeline::personExemplars()
 {
     // Exemplars only change when verified faces or people change
     // (identify, remove, merge, delete); unverified auto-assigns during a
@@ -634,13 +2415,12 @@ const QVector<QPair<int, QVector<FaceEmbedding>>> &FacePipeline::personExemplars
     if (!m_personProtoCacheValid) {
         m_personExemplarCache.clear();
         for (const Person &person : m_database->getAllPeople()) {
-            QVector<FaceEmbedding> exemplars = m_database->getPersonExemplars(person.id);
-            if (!exemplars.isEmpty()) {
-                m_personExemplarCache.append(qMakePair(person.id, exemplars));
-            }
+            m_personExemplarCache.setPerson(person.id, m_database->getPersonExemplars(person.id));
         }
         m_personProtoCacheValid = true;
-        qCDebug(lcNami) << "Person exemplar cache rebuilt:" << m_personExemplarCache.size() << "people";
+        qCDebug(lcNami) << "Person exemplar cache rebuilt:" << m_personExemplarCache.personCount()
+                        << "people," << m_personExemplarCache.rowCount() << "exemplars,"
+                        << EmbeddingMath::kernelName() << "kernel";
     }
 
     return m_personExemplarCache;
@@ -658,20 +2438,79 @@ void FacePipeline::refreshPersonExemplars(int personId, const QVector<FaceEmbedd
         return;
     }
 
-    for (int i = 0; i < m_personExemplarCache.size(); i++) {
-        if (m_personExemplarCache[i].first == personId) {
-            if (exemplars.isEmpty()) {
-                m_personExemplarCache.remove(i);
-            } else {
-                m_personExemplarCache[i].second = exemplars;
-            }
-            return;
-        }
+    // Replaced in place (people keep their order); a person only enters
+    // the cache once they have at least one face
+    m_personExemplarCache.setPerson(personId, exemplars);
+}
+
+void FacePipeline::rebuildUnmappedIndex()
+{
+    TRACE_FUNCTION("pipeline");
+    if (!m_initialized || !m_database) {
+        return;
+    }
+
+    // Faces read now may be out of date by the time this one finishes
+    if (m_unmappedIndexWatcher.isRunning()) {
+        m_unmappedIndexStale = true;
+        return;
+    }
+    m_unmappedIndexStale = false;
+
+    // SQLite stays on this thread; only the k-means runs on the worker
+    const QVector<QPair<int, FaceEmbedding>> entries = m_database->getUnmappedEmbeddings();
+
+    m_unmappedIndexWatcher.setFuture(QtConcurrent::run([entries]() {
+        QSharedPointer<FaceIndex> index(new FaceIndex);
+        index->build(entries);
+        return index;
+    }));
+}
+
+void FacePipeline::onUnmappedIndexBuilt()
+{
+    if (m_unmappedIndexStale) {
+        rebuildUnmappedIndex();
+        return;
+    }
+
+    QSharedPointer<FaceIndex> index = m_unmappedIndexWatcher.result();
+    if (!index) {
+        return;
+    }
+
+    m_unmappedIndex = std::move(*index);
+    m_unmappedIndexValid = true;
+    qCDebug(lcNami) << "Unmapped face index:" << m_unmappedIndex.size() << "faces in"
+                    << m_unmappedIndex.listCount() << "lists";
+}
+
+void FacePipeline::invalidateUnmappedIndex()
+{
+    m_unmappedIndexValid = false;
+    m_unmappedIndex.clear();
+    if (m_unmappedIndexWatcher.isRunning()) {
+        m_unmappedIndexStale = true;
+    }
+}
+
+void FacePipeline::indexUnmappedFace(int faceId, const FaceEmbedding &embedding)
+{
+    if (m_unmappedIndexWatcher.isRunning()) {
+        m_unmappedIndexStale = true;
     }
+    if (m_unmappedIndexValid) {
+        m_unmappedIndex.add(faceId, embedding);
+    }
+}
 
-    // A person only enters the cache once they have at least one face
-    if (!exemplars.isEmpty()) {
-        m_personExemplarCache.append(qMakePair(personId, exemplars));
+void FacePipeline::unindexFace(int faceId)
+{
+    if (m_unmappedIndexWatcher.isRunning()) {
+        m_unmappedIndexStale = true;
+    }
+    if (m_unmappedIndexValid) {
+        m_unmappedIndex.remove(faceId);
     }
 }
 
@@ -825,7 +2664,10 @@ bool FacePipeline::deletePerson(int personId)
         return false;
     }
 
+    flushCommitBatch();
+
     invalidatePersonPrototypes();
+    invalidateUnmappedIndex();
     return m_database->deletePerson(personId);
 }
 
@@ -835,6 +2677,8 @@ bool FacePipeline::updatePersonName(int personId, const QString &name)
         return false;
     }
 
+    flushCommitBatch();
+
     return m_database->updatePersonName(personId, name);
 }
 
@@ -844,6 +2688,8 @@ bool FacePipeline::linkPersonToContact(int personId, const QString &contactId)
         return false;
     }
 
+    flushCommitBatch();
+
     return m_database->setPersonContact(personId, contactId);
 }
 
@@ -871,6 +2717,8 @@ bool FacePipeline::setPhotoRotation(const QString &photoPath, int rotation)
         return false;
     }
 
+    flushCommitBatch();
+
     return m_database->setPhotoRotation(photoPath, rotation);
 }
 
@@ -880,9 +2728,12 @@ int FacePipeline::removeMissingPhotos()
         return 0;
     }
 
+    flushCommitBatch();
+
     const int removed = m_database->removeMissingPhotos();
     if (removed > 0) {
         invalidatePersonPrototypes();
+        invalidateUnmappedIndex();
     }
     return removed;
 }
@@ -974,6 +2825,20 @@ QVariantMap FacePipeline::photoDetails(const QString &photoPath)
     return details;
 }
 
+void FacePipeline::setWatchGalleries(bool enabled)
+{
+    if (m_watchGalleries == enabled) {
+        return;
+    }
+
+    m_watchGalleries = enabled;
+    if (m_database) {
+        m_database->setSetting("watch_galleries", enabled ? "true" : "false");
+    }
+    updateGalleryWatcher();
+    emit watchGalleriesChanged();
+}
+
 void FacePipeline::setContactsEnabled(bool enabled)
 {
     if (m_contactsEnabled == enabled) {
@@ -993,6 +2858,8 @@ bool FacePipeline::mergePersons(int fromPersonId, int intoPersonId)
         return false;
     }
 
+    flushCommitBatch();
+
     if (fromPersonId == intoPersonId || fromPersonId < 0 || intoPersonId < 0) {
         return false;
     }
@@ -1007,6 +2874,8 @@ bool FacePipeline::removeFaceFromPerson(int faceId)
         return false;
     }
 
+    flushCommitBatch();
+
     // Remember the rejection, otherwise the next auto-match run reassigns
     // the face to the same person and the correction is lost
     Face face = m_database->getFace(faceId);
@@ -1015,7 +2884,13 @@ bool FacePipeline::removeFaceFromPerson(int faceId)
     }
 
     invalidatePersonPrototypes();
-    return m_database->removeFaceFromPerson(faceId);
+    if (!m_database->removeFaceFromPerson(faceId)) {
+        return false;
+    }
+    if (face.id >= 0) {
+        indexUnmappedFace(face.id, face.embedding);
+    }
+    return true;
 }
 
 bool FacePipeline::removePersonFromPhoto(int personId, int photoId)
@@ -1024,7 +2899,10 @@ bool FacePipeline::removePersonFromPhoto(int personId, int photoId)
         return false;
     }
 
+    flushCommitBatch();
+
     invalidatePersonPrototypes();
+    invalidateUnmappedIndex();
     return m_database->removePersonFromPhoto(personId, photoId);
 }
 
@@ -1034,6 +2912,9 @@ bool FacePipeline::ignoreFace(int faceId)
         return false;
     }
 
+    flushCommitBatch();
+
+    unindexFace(faceId);
     return m_database->setFaceIgnored(faceId, true);
 }
 
@@ -1100,16 +2981,13 @@ QVariantList FacePipeline::suggestPeopleForFace(int faceId, int maxCount)
     };
 
     std::vector<Candidate> candidates;
-    for (const auto &entry : personExemplars()) {
-        int personId = entry.first;
+    for (const EmbeddingMatrix::PersonScore &entry : personExemplars().bestPerPerson(face.embedding)) {
+        int personId = entry.personId;
         if (alreadyInPhoto.contains(personId) || rejected.contains(personId)) {
             continue;
         }
 
-        float best = 0.0f;
-        for (const FaceEmbedding &exemplar : entry.second) {
-            best = qMax(best, FaceRecognizer::computeSimilarity(face.embedding, exemplar));
-        }
+        float best = entry.similarity;
 
         if (best < SUGGEST_THRESHOLD) {
             continue;
@@ -1159,13 +3037,64 @@ QVariantMap FacePipeline::getStatistics()
     return m_database->getStatistics();
 }
 
+QVariantMap FacePipeline::getScanStats()
+{
+    QVariantMap stats;
+    stats["photos"] = m_scanStats.photos;
+    stats["bytes_read"] = m_scanStats.bytesRead;
+    stats["bytes_per_photo"] = m_scanStats.photos > 0
+        ? m_scanStats.bytesRead / m_scanStats.photos : 0;
+    stats["commits"] = m_scanStats.commits;
+    stats["photos_per_commit"] = m_scanStats.commits > 0
+        ? static_cast<double>(m_scanStats.photosCommitted) / m_scanStats.commits : 0.0;
+    stats["commit_ms"] = m_scanStats.commitMs;
+    stats["committed_photos_per_second"] = m_scanStats.commitMs > 0
+        ? m_scanStats.photosCommitted * 1000.0 / m_scanStats.commitMs : 0.0;
+    stats["walk_ms"] = m_scanStats.walkMs;
+    stats["dirs_listed"] = m_scanStats.dirsListed;
+    stats["dirs_cached"] = m_scanStats.dirsCached;
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    stats["elapsed_ms"] = m_scanStats.startedMs > 0 ? now - m_scanStats.startedMs : 0;
+
+    // Recent pace rather than the average since the start, which the walk
+    // and the first (cold) photos would drag down for the whole scan
+    const QVector<qint64> &recent = m_scanStats.recentMs;
+    const double pace = recent.size() >= 2 && recent.last() > recent.first()
+        ? (recent.size() - 1) * 1000.0 / (recent.last() - recent.first()) : 0.0;
+    stats["photos_per_second"] = pace;
+    // Only once the total is known, while a scan runs
+    stats["eta_seconds"] = m_processing && !m_walking && pace > 0.0
+        ? qRound(qMax(0, m_totalPhotos - m_processedPhotos) / pace) : -1;
+
+    stats["stages"] = m_scanStats.stages.toVariantMap();
+    QString dominant;
+    qint64 dominantUs = 0;
+    for (int i = 0; i < StageTimings::StageCount; i++) {
+        const StageTimings::Stage stage = static_cast<StageTimings::Stage>(i);
+        const qint64 totalUs = m_scanStats.stages.summary(stage).totalUs;
+        if (totalUs > dominantUs) {
+            dominantUs = totalUs;
+            dominant = StageTimings::stageName(stage);
+        }
+    }
+    stats["dominant_stage"] = dominant;
+    stats["duplicates_reused"] = m_scanStats.duplicatesReused;
+    stats["burst_frames_reused"] = m_scanStats.burstFramesReused;
+    stats["faces_below_quality"] = m_scanStats.facesBelowQuality;
+    return stats;
+}
+
 bool FacePipeline::deleteAllData()
 {
     if (!m_initialized || !m_database) {
         return false;
     }
 
+    flushCommitBatch();
+
     invalidatePersonPrototypes();
+    invalidateUnmappedIndex();
 
     // Face crops cached by the image provider are derived biometric data.
     // Photo thumbnails are copies of the user's photos, so "clear all data"
@@ -1174,6 +3103,7 @@ bool FacePipeline::deleteAllData()
     QDir(cacheDir + "/faces").removeRecursively();
     QDir(cacheDir + "/thumbs").removeRecursively();
 
+    clearScanCheckpoint();
     return m_database->deleteAllData();
 }
 
@@ -1192,6 +3122,8 @@ bool FacePipeline::setSetting(const QString &key, const QString &value)
         return false;
     }
 
+    flushCommitBatch();
+
     if (key == QLatin1String("auto_match_threshold")) {
         bool ok = false;
         float threshold = value.toFloat(&ok);
@@ -1200,7 +3132,75 @@ bool FacePipeline::setSetting(const QString &key, const QString &value)
         }
     }
 
-    return m_database->setSetting(key, value);
+    // Not a plain value either: the engines load the other variant. Not
+    // while they are in use.
+    if (key == QLatin1String("detector_model") || key == QLatin1String("recognizer_model")) {
+        const ModelRegistry::Kind kind = key == QLatin1String("detector_model")
+            ? ModelRegistry::Detector : ModelRegistry::Recognizer;
+        const ModelRegistry::Precision precision = ModelRegistry::precisionFromString(value);
+        if (m_processing || m_ingestWatcher.isRunning() || m_comparisonWatcher.isRunning()) {
+            return false;
+        }
+        if (!m_models.isAvailable(kind, precision)) {
+            emit error("Model not installed: " + ModelRegistry::fileName(kind, precision));
+            return false;
+        }
+
+        const ModelRegistry::Precision oldDetector = m_detectorPrecision;
+        const ModelRegistry::Precision oldRecognizer = m_recognizerPrecision;
+        const ModelRegistry::Precision detector = kind == ModelRegistry::Detector ? precision : oldDetector;
+        const ModelRegistry::Precision recognizer = kind == ModelRegistry::Recognizer ? precision : oldRecognizer;
+        if (recognizer != oldRecognizer && !canSwitchRecognizer(recognizer)) {
+            emit error("Compare models first: the two recognizers must agree closely enough for automatic matching");
+            return false;
+        }
+
+        // Loaded first, stored once they work: a broken file must not be
+        // what the next launch starts with
+        if (!switchModels(detector, recognizer)) {
+            emit error("Failed to load the selected face models");
+            return false;
+        }
+        if (!m_database->setSetting(key, ModelRegistry::precisionName(precision))) {
+            switchModels(oldDetector, oldRecognizer);
+            return false;
+        }
+        return true;
+    }
+
+    // Not a plain value: every stored embedding is rewritten to match
+    if (key == QLatin1String("embedding_storage")) {
+        bool ok = false;
+        EmbeddingCodec::Format format = EmbeddingCodec::formatFromName(value, &ok);
+        if (!ok || m_processing) {
+            return false;
+        }
+        if (!m_database->setEmbeddingStorage(format)) {
+            return false;
+        }
+        invalidatePersonPrototypes();
+        return true;
+    }
+
+    const bool stored = m_database->setSetting(key, value);
+
+    // Workers pick it up from their next photo
+    if (stored && key == QLatin1String("face_quality")) {
+        m_faceQuality.store(FaceQuality::levelFromString(value));
+    }
+
+    // A running scan switches at once; the new slots fill on the next photo
+    if (stored && key == QLatin1String("scan_profile") && m_processing) {
+        m_throttle.setProfile(ScanThrottle::profileFromString(value), QDateTime::currentMSecsSinceEpoch());
+        applyThrottle();
+        dispatchExtractions();
+    }
+
+    // The watched folders follow the scanned ones
+    if (stored && (key == QLatin1String("scan_folders") || key == QLatin1String("gallery_path"))) {
+        updateGalleryWatcher();
+    }
+    return stored;
 }
 
 bool FacePipeline::confirmFace(int faceId)
@@ -1209,6 +3209,8 @@ bool FacePipeline::confirmFace(int faceId)
         return false;
     }
 
+    flushCommitBatch();
+
     const Face face = m_database->getFace(faceId);
     if (face.id < 0 || face.verified) {
         return false;
@@ -1229,6 +3231,8 @@ bool FacePipeline::unconfirmFace(int faceId)
         return false;
     }
 
+    flushCommitBatch();
+
     const Face face = m_database->getFace(faceId);
     if (face.id < 0 || !face.verified) {
         return false;
@@ -1251,6 +3255,8 @@ int FacePipeline::confirmAllFaces(int personId)
         return 0;
     }
 
+    flushCommitBatch();
+
     int confirmed = 0;
     for (const Face &face : m_database->getFacesForPerson(personId)) {
         if (!face.verified) {
@@ -1292,6 +3298,7 @@ int FacePipeline::createTrip(const QString &name, const QStringList &dateKeys)
     if (!m_initialized || !m_database) {
         return -1;
     }
+    flushCommitBatch();
     return m_database->createTrip(name, dateKeys);
 }
 
@@ -1300,6 +3307,7 @@ bool FacePipeline::renameTrip(int tripId, const QString &name)
     if (!m_initialized || !m_database) {
         return false;
     }
+    flushCommitBatch();
     return m_database->renameTrip(tripId, name);
 }
 
@@ -1308,6 +3316,7 @@ bool FacePipeline::deleteTrip(int tripId)
     if (!m_initialized || !m_database) {
         return false;
     }
+    flushCommitBatch();
     return m_database->deleteTrip(tripId);
 }
 
@@ -1316,6 +3325,7 @@ bool FacePipeline::mergeTrips(int fromTripId, int intoTripId)
     if (!m_initialized || !m_database) {
         return false;
     }
+    flushCommitBatch();
     return m_database->mergeTrips(fromTripId, intoTripId);
 }
 
@@ -1324,6 +3334,7 @@ bool FacePipeline::addDatesToTrip(int tripId, const QStringList &dateKeys)
     if (!m_initialized || !m_database) {
         return false;
     }
+    flushCommitBatch();
     return m_database->addDatesToTrip(tripId, dateKeys);
 }
 
@@ -1332,6 +3343,7 @@ bool FacePipeline::hideEvent(const QString &eventKey)
     if (!m_initialized || !m_database) {
         return false;
     }
+    flushCommitBatch();
     return m_database->hideEvent(eventKey);
 }
 
@@ -1340,6 +3352,7 @@ bool FacePipeline::unhideEvent(const QString &eventKey)
     if (!m_initialized || !m_database) {
         return false;
     }
+    flushCommitBatch();
     return m_database->unhideEvent(eventKey);
 }
 
@@ -1356,6 +3369,7 @@ bool FacePipeline::setEventCover(const QString &eventKey, const QString &photoPa
     if (!m_initialized || !m_database) {
         return false;
     }
+    flushCommitBatch();
     return m_database->setEventCover(eventKey, photoPath);
 }
 
@@ -1364,6 +3378,7 @@ bool FacePipeline::clearEventCover(const QString &eventKey)
     if (!m_initialized || !m_database) {
         return false;
     }
+    flushCommitBatch();
     return m_database->clearEventCover(eventKey);
 }
 
@@ -1568,6 +3583,8 @@ QVariantMap FacePipeline::importBackupData(const QString &filePath, const QStrin
         return result;
     }
 
+    flushCommitBatch();
+
     QFile file(filePath);
     if (!file.open(QIODevice::ReadOnly)) {
         emit error("Failed to read backup file: " + filePath);
@@ -1630,6 +3647,7 @@ QVariantMap FacePipeline::importBackupData(const QString &filePath, const QStrin
     }
 
     invalidatePersonPrototypes();
+    invalidateUnmappedIndex();
 
     result["photos_imported"] = stats.photosImported;
     result["photos_relinked"] = stats.photosRelinked;
@@ -1677,6 +3695,7 @@ void FacePipeline::onHashBackfillFinished()
     QVector<QPair<int, QString>> results = m_hashBackfillWatcher.result();
 
     if (!results.isEmpty()) {
+        flushCommitBatch();
         m_database->beginTransaction();
         for (const auto &entry : results) {
             m_database->setPhotoHash(entry.first, entry.second);
@@ -7,9 +7,28 @@
 #include <QVector>
 #include <QFuture>
 #include <QFutureWatcher>
+#include <QMap>
+#include <QThreadPool>
+#include <QSharedPointer>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QJsonObject>
 #include "facedetector.h"
 #include "facerecognizer.h"
 #include "facedatabase.h"
+#include "embeddingmatrix.h"
+#include "faceindex.h"
+#include "faceclustering.h"
+#include "scanqueue.h"
+#include "gallerywatcher.h"
+#include "scanthrottle.h"
+#include "idlethreadpool.h"
+#include "stagetimings.h"
+#include "burstindex.h"
+#include "facequality.h"
+#include "modelregistry.h"
 
 /**
  * @brief Processing result for a single photo
@@ -23,15 +42,6 @@ struct PhotoProcessingResult {
     QString errorMessage;
 };
 
-/**
- * @brief One face extracted from a photo (detection + embedding, no DB state)
- */
-struct ExtractedFace {
-    QRectF bbox;
-    float confidence;
-    FaceEmbedding embedding;
-};
-
 /**
  * @brief CPU-heavy part of photo processing, computed on a worker thread.
  *
@@ -49,7 +59,89 @@ struct PhotoExtraction {
     double latitude;
     double longitude;
     QString fileHash;
+    FileFingerprint fingerprint;  // taken just before the file was read
     QVector<ExtractedFace> faces;
+    bool duplicate;     // same bytes as a processed photo: not decoded, its
+                        // faces are copied on commit
+    quint64 dhash;      // PerceptualHash of the decoded image, 0 if none
+    bool exifDate;      // dateTaken is the EXIF capture time, not the mtime
+    bool burst;         // faces taken from an earlier frame (BurstIndex)
+    QVector<QRectF> belowQuality;  // detections FaceQuality kept from embedding
+    qint64 bytesRead;   // I/O spent on this photo, for scan stats
+    qint64 extractMs;   // wall time on the worker, for the scan throttle
+
+    // Stage times in microseconds (see StageTimings), -1 for a stage the
+    // photo never reached; embedUs has one entry per face
+    qint64 readUs;
+    qint64 hashUs;
+    qint64 decodeUs;
+    qint64 convertUs;
+    qint64 detectUs;
+    qint64 qualityUs;
+    QVector<qint64> embedUs;
+};
+
+/**
+ * @brief Counters of the current (or last) scan, see getScanStats()
+ */
+struct ScanStats {
+    int photos = 0;
+    qint64 bytesRead = 0;
+    int commits = 0;            // scan batches written to the database
+    int photosCommitted = 0;
+    qint64 commitMs = 0;        // time spent in COMMIT
+    qint64 walkMs = 0;          // listing the gallery folders
+    int dirsListed = 0;         // folders read from disk
+    int dirsCached = 0;         // folders unchanged since the last scan
+    int duplicatesReused = 0;   // copies of known photos, faces reused
+    int burstFramesReused = 0;  // near-identical frames, faces reused
+    int facesBelowQuality = 0;  // detections not embedded (FaceQuality)
+    qint64 startedMs = 0;       // epoch ms
+    StageTimings stages;
+    QVector<qint64> recentMs;   // when the last ETA_WINDOW photos were committed
+};
+
+/**
+ * @brief What the walk stage of a scan found besides the photos it queued,
+ *        applied on the main thread once it is over
+ */
+struct WalkResult {
+    QHash<QString, DirListing> fresh;   // folder listings to cache
+    QStringList gone;                   // cached folders deleted since
+    QVector<QPair<int, FileFingerprint>> refresh;  // see FingerprintDiff
+    int added = 0;
+    int changed = 0;
+    int unchanged = 0;
+    int dirsListed = 0;
+    int dirsCached = 0;
+    qint64 walkMs = 0;
+    bool complete = false;              // false: stopped by a cancel
+};
+
+/**
+ * @brief One step of background ingestion, see FacePipeline::startIngest()
+ *
+ * Either a chunk of watcher candidates checked against their stored
+ * fingerprints (due, refresh), or a batch of due photos extracted.
+ */
+struct IngestResult {
+    QVector<ScanItem> due;                         // new or changed: extract
+    QVector<QPair<int, FileFingerprint>> refresh;  // see FingerprintDiff
+    QVector<ScanItem> extracted;                   // what extractions are of
+    QVector<PhotoExtraction> extractions;
+    QStringList checked;                           // candidates looked at
+};
+
+/**
+ * @brief Detector/recognizer pair owned by one extraction worker
+ *
+ * cv::FaceDetectorYN and the recognizer's cv::dnn::Net keep per-call state
+ * (input size, network blobs), so an instance must never be used by two threads at
+ * once. Every worker of the extraction pool gets a pair of its own.
+ */
+struct ExtractionEngine {
+    FaceDetector *detector;
+    FaceRecognizer *recognizer;
 };
 
 /**
@@ -67,19 +159,36 @@ class FacePipeline : public QObject
     Q_OBJECT
     Q_PROPERTY(bool initialized READ isInitialized NOTIFY initializedChanged)
     Q_PROPERTY(bool processing READ isProcessing NOTIFY processingChanged)
+    // An estimate while walking is true, exact once it turns false
     Q_PROPERTY(int totalPhotos READ totalPhotos NOTIFY totalPhotosChanged)
+    Q_PROPERTY(bool walking READ isWalking NOTIFY walkingChanged)
     Q_PROPERTY(int processedPhotos READ processedPhotos NOTIFY processedPhotosChanged)
     Q_PROPERTY(bool needsRescan READ needsRescan NOTIFY needsRescanChanged)
+    // A scan was interrupted (app closed or killed) and can be resumed
+    // from its checkpoint, see resumeScan()
+    Q_PROPERTY(bool canResumeScan READ canResumeScan NOTIFY canResumeScanChanged)
+    Q_PROPERTY(bool grouping READ isGrouping NOTIFY groupingChanged)
+    // getScanStats(), refreshed at most every STATS_INTERVAL_MS during a scan
+    Q_PROPERTY(QVariantMap scanStats READ getScanStats NOTIFY scanStatsChanged)
     // Privacy switch: when false the app never reads device contacts, even
     // though the Contacts permission is granted (persisted setting)
     Q_PROPERTY(bool contactsEnabled READ contactsEnabled WRITE setContactsEnabled NOTIFY contactsEnabledChanged)
+    // Background ingestion: photos added to the scanned folders are
+    // processed as they appear, without a scan (persisted setting)
+    Q_PROPERTY(bool watchGalleries READ watchGalleries WRITE setWatchGalleries NOTIFY watchGalleriesChanged)
+    Q_PROPERTY(bool comparingModels READ isComparingModels NOTIFY comparingModelsChanged)
 
 public:
     // Bump when embedding computation changes (model, alignment,
     // preprocessing...); stored embeddings are then incompatible and a full
-    // re-scan is forced
+    // re-scan is forced. Not for switching between a model's FP32 and INT8
+    // variants (see ModelRegistry): those stay comparable, and each face
+    // records which one computed it.
     static constexpr int EMBEDDING_VERSION = 3;
 
+    // Photos compareModelVariants() runs on by default
+    static constexpr int MODEL_COMPARISON_PHOTOS = 20;
+
     // Thresholds on the rescaled similarity (cosine mapped from [-1,1] to
     // [0,1]). SFace's official same-identity cosine threshold is 0.363,
     // i.e. ~0.68 rescaled. Auto-assign must be stricter than interactive
@@ -87,6 +196,10 @@ public:
     static constexpr float AUTO_MATCH_THRESHOLD = 0.72f;
     static constexpr float GROUPING_THRESHOLD = 0.68f;
 
+    // A face that resembles no other face stays unmapped rather than
+    // becoming a "Person N" of its own
+    static constexpr int MIN_GROUP_SIZE = 2;
+
     // Floor for offering a person as an identification suggestion. Well
     // below the same-identity threshold on purpose: the user confirms, so a
     // plausible-but-wrong name costs a glance, while a missing one costs
@@ -97,14 +210,46 @@ public:
     // it only ever reorders candidates of comparable facial similarity.
     static constexpr float SAME_DAY_BONUS = 0.02f;
 
+    // Upper bound for concurrent extractions. Each worker holds its own copy
+    // of both networks (~40 MB), which is what caps this on a phone rather
+    // than the core count.
+    static constexpr int MAX_EXTRACTION_WORKERS = 4;
+
+    // Scan results are written in batches: one transaction per this many
+    // photos, or older than COMMIT_BATCH_MS, whichever comes first. Each
+    // photo's processed_at is in the same transaction as its faces, so a
+    // crash loses at most one batch and those photos are simply scanned
+    // again.
+    static constexpr int COMMIT_BATCH_PHOTOS = 32;
+    static constexpr int COMMIT_BATCH_MS = 1000;
+
+    // Background ingestion: watcher candidates are checked against their
+    // fingerprints this many at a time, and due photos extracted and
+    // committed in batches of INGEST_BATCH_SIZE, one worker at idle priority
+    static constexpr int INGEST_CHECK_CHUNK = 512;
+    static constexpr int INGEST_BATCH_SIZE = 8;
+
+    // Scan stats: scanStatsChanged() at most this often, and the ETA from
+    // the pace of the last ETA_WINDOW photos
+    static constexpr int STATS_INTERVAL_MS = 1000;
+    static constexpr int ETA_WINDOW = 64;
+
+    // Photos the walk may queue ahead of the extraction workers
+    static constexpr int SCAN_QUEUE_CAPACITY = 256;
+
     explicit FacePipeline(QObject *parent = nullptr);
     ~FacePipeline();
 
     /**
      * @brief Initialize the pipeline
-     * @param detectorModelPath Path to YuNet model
-     * @param recognizerModelPath Path to ArcFace model
+     * @param detectorModelPath Path to YuNet model (FP32)
+     * @param recognizerModelPath Path to ArcFace model (FP32)
      * @param databasePath Path to SQLite database
+     *
+     * The models actually loaded are the variants the "detector_model" and
+     * "recognizer_model" settings pick from the models' folder (see
+     * ModelRegistry); FP32 by default, and FP32 again (stored) if the
+     * selected INT8 ones fail to load.
      * @return true if initialized successfully
      */
     Q_INVOKABLE bool initialize(const QString &detectorModelPath,
@@ -135,6 +280,38 @@ public:
     Q_INVOKABLE void scanGalleries(const QStringList &galleryPaths, bool recursive = true,
                                    bool forceRescan = false);
 
+    /**
+     * @brief Continue a scan the app was closed or killed in the middle of
+     *
+     * Every scan checkpoints its folders and options, and the photos its
+     * walk found but not yet committed (see FaceDatabase::getScanQueue()).
+     * Those are processed first, without walking the gallery again; if the
+     * walk itself had not finished, it then picks up the photos it had not
+     * reached (an incremental walk, which skips what is already done).
+     * @return false if there is nothing to resume
+     */
+    Q_INVOKABLE bool resumeScan();
+
+    /**
+     * @brief Forget the interrupted scan; the next scan starts over
+     */
+    Q_INVOKABLE void discardScanCheckpoint();
+
+    /**
+     * @brief Process this photo next, if it still needs processing
+     *
+     * For the photo on screen. During a scan it goes ahead of everything
+     * the scan has queued (taking the next free worker); between scans,
+     * background ingestion picks it up first. photoReady() follows once
+     * its faces are in.
+     */
+    Q_INVOKABLE void prioritizePhoto(const QString &filePath);
+
+    /**
+     * @brief Same as prioritizePhoto() for every photo directly in a folder
+     */
+    Q_INVOKABLE void prioritizeFolder(const QString &folder);
+
     /**
      * @brief Process a single photo
      * @param photoPath Path to photo file
@@ -143,11 +320,35 @@ public:
     Q_INVOKABLE PhotoProcessingResult processPhoto(const QString &photoPath);
 
     /**
-     * @brief Group unknown faces by similarity
-     * @param similarityThreshold Threshold for grouping (default: 0.7)
-     * @return Number of groups created
+     * @brief Group unknown faces by similarity, in the background
+     *
+     * Clusters every unmapped face on a worker thread (see FaceClustering)
+     * and creates one person per group of at least MIN_GROUP_SIZE faces,
+     * in a single transaction. groupingCompleted() reports the outcome.
+     * @param similarityThreshold Threshold for linking two faces
+     * @return false if not initialized or a grouping is already running
+     */
+    Q_INVOKABLE bool groupUnknownFaces(float similarityThreshold = GROUPING_THRESHOLD);
+
+    /**
+     * @brief Whether a model variant's file is installed
+     * @param kind "detector" or "recognizer"
+     * @param precision "fp32" or "int8"
+     */
+    Q_INVOKABLE bool isModelVariantAvailable(const QString &kind, const QString &precision);
+
+    /**
+     * @brief Run the FP32 and INT8 models side by side, in the background
+     *
+     * On the most recent photos of the library (see ModelComparison).
+     * modelComparisonCompleted() reports speed and agreement, plus the
+     * library's faces per embedding model ("library"), or "error". The
+     * recognizers' lowest similarity is kept as "recognizer_agreement":
+     * switching recognizers on a library with faces needs it at or above
+     * the auto-match threshold.
+     * @return false if not initialized, scanning or already comparing
      */
-    Q_INVOKABLE int groupUnknownFaces(float similarityThreshold = GROUPING_THRESHOLD);
+    Q_INVOKABLE bool compareModelVariants(int photoCount = MODEL_COMPARISON_PHOTOS);
 
     /**
      * @brief Identify a face as a person
@@ -328,6 +529,18 @@ public:
      */
     Q_INVOKABLE QVariantMap getStatistics();
 
+    /**
+     * @brief Get I/O and commit counters of the current or last scan
+     * @return QVariantMap with photos, bytes_read, bytes_per_photo,
+     *         commits, photos_per_commit, commit_ms,
+     *         committed_photos_per_second, walk_ms, dirs_listed,
+     *         dirs_cached, elapsed_ms, photos_per_second (recent pace),
+     *         eta_seconds (-1 while unknown), stages (per stage: count,
+     *         total_ms, p50_ms, p95_ms, max_ms), dominant_stage,
+     *         duplicates_reused, burst_frames_reused and faces_below_quality
+     */
+    Q_INVOKABLE QVariantMap getScanStats();
+
     /**
      * @brief Delete all face recognition data
      * @return true if successful
@@ -491,25 +704,41 @@ public:
      */
     Q_INVOKABLE QVariantList getCoverPhotos(int limit = 30);
 
+    /**
+     * @brief Folder scanned and watched when none is configured (the
+     *        user's Pictures); set before initialize()
+     */
+    void setDefaultGalleryPath(const QString &path) { m_defaultGalleryPath = path; }
+
     // === Property getters ===
 
     bool isInitialized() const { return m_initialized; }
     bool isProcessing() const { return m_processing; }
+    bool isWalking() const { return m_walking; }
+    bool isGrouping() const { return m_groupingWatcher.isRunning(); }
+    bool isComparingModels() const { return m_comparisonWatcher.isRunning(); }
     bool contactsEnabled() const { return m_contactsEnabled; }
+    bool watchGalleries() const { return m_watchGalleries; }
+    void setWatchGalleries(bool enabled);
     void setContactsEnabled(bool enabled);
     int totalPhotos() const { return m_totalPhotos; }
     int processedPhotos() const { return m_processedPhotos; }
     bool needsRescan() const { return m_needsRescan; }
+    bool canResumeScan() const { return m_canResumeScan; }
 
 signals:
     void initializedChanged();
     void processingChanged();
     void totalPhotosChanged();
+    void walkingChanged();
     void processedPhotosChanged();
     void needsRescanChanged();
+    void canResumeScanChanged();
     void contactsEnabledChanged();
+    void watchGalleriesChanged();
 
     void scanStarted(int totalPhotos);
+    void scanStatsChanged();
     void scanProgress(int current, int total, const QString &currentFile);
     void scanCompleted(int photosProcessed, int facesDetected);
     void scanFailed(const QString &error);
@@ -521,63 +750,292 @@ signals:
     // Emitted when backfillPhotoHashes() finishes (count of photos hashed)
     void hashBackfillCompleted(int count);
 
+    // Emitted after each batch committed by background ingestion
+    void photosIngested(int photos, int faces);
+
+    // Emitted when a photo passed to prioritizePhoto()/prioritizeFolder()
+    // has been processed
+    void photoReady(const QString &filePath);
+
+    void groupingChanged();
+    // Emitted when groupUnknownFaces() finishes
+    void groupingCompleted(int groupsCreated, int facesGrouped, int elapsedMs);
+
+    void comparingModelsChanged();
+    // Emitted when compareModelVariants() finishes
+    void modelComparisonCompleted(const QVariantMap &result);
+
+private slots:
+    // The walk queued photos (invoked across threads by name)
+    void onFilesQueued();
+
 private:
-    FaceDetector *m_detector;
-    FaceRecognizer *m_recognizer;
     FaceDatabase *m_database;
 
+    // Kept to create further extraction engines on demand; the variants
+    // picked from m_models by "detector_model" and "recognizer_model"
+    QString m_detectorModelPath;
+    QString m_recognizerModelPath;
+    ModelRegistry m_models;
+    ModelRegistry::Precision m_detectorPrecision;
+    ModelRegistry::Precision m_recognizerPrecision;
+
     bool m_initialized;
     bool m_processing;
     bool m_cancelRequested;
     bool m_needsRescan;
     bool m_contactsEnabled;
+    bool m_watchGalleries;
+    QString m_defaultGalleryPath;
     bool m_currentScanIsForced;
+    bool m_tracingScan;     // this scan started the tracer ("trace_scans")
+
+    // Checkpoint of the running scan: its options (the "scan_checkpoint"
+    // setting) and the photos found, which the walk spools here for the
+    // main thread to store (scan_queue)
+    bool m_canResumeScan;
+    QJsonObject m_scanCheckpoint;
+    QMutex m_walkSpoolMutex;
+    QVector<ScanItem> m_walkSpool;
+
+    // Walk stage of the scan, see walkGalleries(): the worker queues photos
+    // as it finds them, and wakes the main thread through onFilesQueued()
+    bool m_walking;
+    int m_expectedPhotos;           // estimate of the total until the walk ends
+    ScanQueue m_scanQueue;
+    QAtomicInt m_walkQueued;        // photos queued so far
+    QAtomicInt m_walkNotifyPending; // an onFilesQueued() call is on its way
+    QSet<QString> m_promoted;       // pushed ahead by prioritizeFiles(): skip the walk's copy
+    QSet<QString> m_bumped;         // prioritized and not processed yet (photoReady())
+    QSet<QString> m_inFlight;       // dispatched to a worker, not committed yet
+    QFutureWatcher<WalkResult> m_walkWatcher;
+
     int m_totalPhotos;
     int m_processedPhotos;
     int m_totalFacesDetected;
-    QStringList m_pendingFiles;
-
-    // One photo in flight at a time: extraction runs on a worker thread,
-    // DB commit happens back on the main thread (QSqlDatabase affinity)
-    QFutureWatcher<PhotoExtraction> m_extractionWatcher;
+    ScanStats m_scanStats;
+
+    // hashKey() of every processed photo while a scan runs: workers skip
+    // inference for a copy of one of them (see PhotoExtraction::duplicate)
+    QMutex m_knownHashesMutex;
+    QSet<quint64> m_knownHashes;
+
+    // Frames of bursts: photos processed lately, whose faces the next
+    // near-identical frame takes over. "burst_verify" runs the detector
+    // on that frame anyway and only skips the embeddings.
+    BurstIndex m_burstIndex;
+    QAtomicInt m_burstVerify;
+
+    // FaceQuality::Level from "face_quality", read by the workers
+    QAtomicInt m_faceQuality;
+    QElapsedTimer m_statsAge;       // since the last scanStatsChanged()
+    QSet<QString> m_changedFiles;   // processed before, edited since: redo
+
+    // Extraction pool: one engine and one watcher per worker, each carrying
+    // at most one photo. Results come back in any order and are committed
+    // in scan order on the main thread (QSqlDatabase affinity).
+    QVector<ExtractionEngine> m_engines;
+    QVector<QFutureWatcher<PhotoExtraction> *> m_extractionWatchers;
+    QVector<int> m_watcherSequence;  // scan order of the photo in flight, -1 when idle
+    int m_activeEngines;             // workers used by the current scan
+    QThreadPool m_extractionPool;
+    IdleThreadPool m_backgroundPool; // the Background profile's one worker
+    ScanThrottle m_throttle;         // sets m_activeEngines as the scan goes
+
+    // Finished extractions waiting for the ones before them to be committed
+    QMap<int, PhotoExtraction> m_completedExtractions;
+    int m_nextDispatchSequence;
+    int m_nextCommitSequence;
+
+    // Open commit batch (see COMMIT_BATCH_PHOTOS): photos written so far,
+    // its age, and the unmapped faces to index once it is durable
+    int m_batchPhotos;
+    QElapsedTimer m_batchAge;
+    QTimer m_batchFlushTimer;
+    QVector<QPair<int, FaceEmbedding>> m_batchUnmappedFaces;
 
     // Backfills file_hash for photos scanned before that column existed;
     // computed as one batch on a worker thread, applied on completion
     QFutureWatcher<QVector<QPair<int, QString>>> m_hashBackfillWatcher;
 
+    // Clustering for groupUnknownFaces(): faces are read here, clustered on
+    // a worker thread, and the groups written back on completion
+    QFutureWatcher<FaceClustering::Result> m_groupingWatcher;
+    QElapsedTimer m_groupingTimer;
+
+    // compareModelVariants(), on a worker with networks of its own
+    QFutureWatcher<QVariantMap> m_comparisonWatcher;
+
     // Person exemplars cache (up to 5 verified embeddings per person);
     // recomputing them from the DB for every detected face is
     // O(persons x faces) queries per photo
-    QVector<QPair<int, QVector<FaceEmbedding>>> m_personExemplarCache;
+    EmbeddingMatrix m_personExemplarCache;
     bool m_personProtoCacheValid;
 
+    // ANN index over unmapped faces (identify re-matching, grouping).
+    // Built on a worker thread after each scan, then kept in sync by every
+    // path that maps, unmaps, ignores or adds a face; anything coarser
+    // (delete person, import, ...) invalidates it until the next build.
+    FaceIndex m_unmappedIndex;
+    bool m_unmappedIndexValid;
+    bool m_unmappedIndexStale;  // changed while a build was running
+    QFutureWatcher<QSharedPointer<FaceIndex>> m_unmappedIndexWatcher;
+
     // User-tunable auto-assign threshold (persisted in the settings table,
     // defaults to AUTO_MATCH_THRESHOLD)
     float m_autoMatchThreshold;
 
-    // Helper: Start extraction of the next pending photo (scan loop)
-    void processNextPhoto();
+    // Background ingestion (see watchGalleries): paths reported by the
+    // watcher, then the ones found new or changed, one step at a time on a
+    // thread of its own at idle priority. A scan takes over: what is queued
+    // is dropped, the scan covers it.
+    GalleryWatcher m_galleryWatcher;
+    QStringList m_ingestCandidates;
+    QSet<QString> m_ingestCandidateSet;
+    QVector<ScanItem> m_ingestDue;
+    IdleThreadPool m_ingestPool;
+    QFutureWatcher<IngestResult> m_ingestWatcher;
+    QAtomicInt m_ingestCancel;
+    bool m_ingestDiscard;   // a scan started meanwhile: drop the result
+
+    // Helper: Load both models into a new engine (and its watcher); quiet
+    // leaves reporting a failed first engine to the caller
+    bool addExtractionEngine(bool quiet = false);
+
+    // Helper: Number of extraction workers to use ("extraction_workers"
+    // setting, defaults to one per core minus the UI thread)
+    int extractionWorkerCount();
+
+    // Helper: A processed photo has these bytes; any thread
+    bool isKnownHash(const QString &fileHash);
+
+    // Helper: Offer a committed photo to the burst index
+    void rememberBurstFrame(const PhotoExtraction &extraction);
+
+    // Helper: Fill the burst index from the photos stored with a dHash
+    void loadBurstFrames();
+
+    // Helper: Add a committed photo's stage times to the scan stats
+    void recordStageTimings(const PhotoExtraction &extraction, qint64 commitUs);
+
+    // Helper: Load the engines the throttle's profile may use, and apply
+    // its worker and OpenCV thread counts
+    void applyThrottle();
 
-    // Helper: Commit a finished extraction and continue the scan loop
-    void onExtractionFinished();
+    // Helper: List the gallery folders and queue the photos to process;
+    // runs on a worker thread, so no DB (the caller reads what it needs)
+    // (resumed: queued first, without walking unless walk is set)
+    WalkResult walkGalleries(const QStringList &roots, bool recursive,
+                             const QHash<QString, DirListing> &folderCache,
+                             const QHash<QString, QVector<StoredFingerprint>> &storedByFolder,
+                             const QVector<ScanItem> &resumed, bool walk);
+
+    // Helper: Start the walk and the extraction workers of a new or
+    // resumed scan
+    void startScan(const QStringList &roots, bool recursive, bool forceRescan,
+                   const QVector<ScanItem> &resumed, bool walk, const QDateTime &processedSince);
+
+    // Helper: Move these photos to the front of the scan or of ingestion
+    void prioritizeFiles(const QStringList &paths);
+
+    // Helper: Forget prioritized photos found to need no processing
+    void dropBumped(const QStringList &checked, const QVector<ScanItem> &due);
+
+    // Helper: Store the photos the walk spooled in the checkpoint
+    void checkpointWalked();
+
+    // Helper: Scan checkpoint from the settings, empty if there is none
+    // or it belongs to another embedding version
+    QJsonObject readScanCheckpoint();
+    void saveScanCheckpoint();
+    void clearScanCheckpoint();
+    void setCanResumeScan(bool canResume);
+
+    // Helper: Apply what the walk found once it is over
+    void onWalkFinished();
+
+    // Helper: Folders to scan or watch ("scan_folders" setting, then the
+    // legacy "gallery_path", then the default)
+    QStringList galleryFolders();
+
+    // Helper: (Re)start or stop the watcher to match watchGalleries
+    void updateGalleryWatcher();
+
+    // Helper: Queue the watcher's candidates for ingestion
+    void onWatchedPhotosChanged(const QStringList &paths);
+
+    // Helper: Run the next ingestion step, if idle and not scanning
+    void startIngest();
+
+    // Helper: Apply an ingestion step and start the next
+    void onIngestFinished();
+
+    // Helper: Drop queued ingestion and wait for the step in flight
+    void abortIngest();
+
+    // Helper: Worker side of ingestion; no DB
+    static IngestResult checkIngestCandidates(const QStringList &paths,
+                                              const QHash<QString, QVector<StoredFingerprint>> &storedByFolder);
+    IngestResult extractIngestBatch(const QVector<ScanItem> &batch, const ExtractionEngine &engine);
+
+    // Helper: Hand pending photos to every idle worker (scan loop)
+    void dispatchExtractions();
+
+    // Helper: A worker is done; queue its result and continue the scan loop
+    void onExtractionFinished(int slot);
+
+    // Helper: Commit finished extractions that are next in scan order
+    void commitCompletedExtractions();
+
+    // Helper: Finish the scan once nothing is pending or in flight
+    void finishScanIfDrained();
+
+    // Helper: Commit the open scan batch, if any. Called ahead of every
+    // write the user makes during a scan: inside the batch it would be a
+    // savepoint, not durable until the batch commits and gone with it if
+    // the batch is rolled back.
+    void flushCommitBatch();
 
     // Helper: Apply hashes computed by backfillPhotoHashes()
     void onHashBackfillFinished();
 
+    // Helper: Write the groups computed by groupUnknownFaces()
+    void onGroupingFinished();
+
+    // Helper: Report what compareModelVariants() measured
+    void onModelComparisonFinished();
+
+    // Helper: Make these the variants new engines load and new faces record
+    void useModels(ModelRegistry::Precision detector, ModelRegistry::Precision recognizer);
+
+    // Helper: Load these variants into every engine, then useModels();
+    // false, with every engine back on the old ones, if any fails
+    bool switchModels(ModelRegistry::Precision detector, ModelRegistry::Precision recognizer);
+
+    // Helper: Whether faces embedded so far may be matched with this
+    // recognizer's ("recognizer_agreement", from compareModelVariants())
+    bool canSwitchRecognizer(ModelRegistry::Precision recognizer);
+
     // Helper: Finish the scan (completed or cancelled)
     void finishScan(bool cancelled);
 
-    // Helper: CPU-heavy part, safe to run on a worker thread (no DB)
-    PhotoExtraction extractPhotoData(const QString &photoPath);
+    // Helper: CPU-heavy part, safe to run on a worker thread (no DB) as
+    // long as no other thread uses the same engine
+    PhotoExtraction extractPhotoData(const QString &photoPath, const ExtractionEngine &engine);
 
     // Helper: DB part, main thread only
     PhotoProcessingResult commitExtraction(const PhotoExtraction &extraction, bool reprocess);
 
-    // Helper: Find image files in directory
-    QStringList findImageFiles(const QString &directory, bool recursive);
+    // Helper: Decode an image from its file contents, EXIF-oriented and
+    // downscaled while decoding to fit maxSide; fullSize receives the
+    // upright size at full resolution
+    QImage loadImage(const QByteArray &data, const QString &filePath, int maxSide,
+                     QSize *fullSize);
 
-    // Helper: Load and validate image
-    QImage loadImage(const QString &filePath);
+    // Helper: Decode only region (normalized, upright) of an image, scaled
+    // by scale; decodedRegion receives the pixel-aligned region decoded
+    QImage loadImageRegion(const QByteArray &data, const QString &filePath,
+                           const QRectF &region, qreal scale, QRectF *decodedRegion);
 
     // Helper: Match face against cached person exemplars (max similarity
     // over each person's exemplar embeddings)
@@ -585,11 +1043,19 @@ private:
                                   float threshold = AUTO_MATCH_THRESHOLD);
 
     // Helper: Person exemplars, cached
-    const QVector<QPair<int, QVector<FaceEmbedding>>> &personExemplars();
+    const EmbeddingMatrix &personExemplars();
     void invalidatePersonPrototypes();
 
     // Helper: Replace one person's cached exemplars, when only they changed
     void refreshPersonExemplars(int personId, const QVector<FaceEmbedding> &exemplars);
+
+    // Helper: Unmapped face index upkeep. Until a build has finished the
+    // index is not used and callers fall back to a full scan.
+    void rebuildUnmappedIndex();
+    void onUnmappedIndexBuilt();
+    void invalidateUnmappedIndex();
+    void indexUnmappedFace(int faceId, const FaceEmbedding &embedding);
+    void unindexFace(int faceId);
 };
 
 #endif // FACEPIPELINE_H
@@ -0,0 +1,119 @@
+#include "facequality.h"
+
+#include <QtMath>
+
+FaceQuality::Level FaceQuality::levelFromString(const QString &name)
+{
+    if (name == QLatin1String("off")) {
+        return Off;
+    }
+    if (name == QLatin1String("strict")) {
+        return Strict;
+    }
+    return Normal;
+}
+
+QString FaceQuality::levelName(Level level)
+{
+    switch (level) {
+    case Off:
+        return QStringLiteral("off");
+    case Strict:
+        return QStringLiteral("strict");
+    case Normal:
+        break;
+    }
+    return QStringLiteral("normal");
+}
+
+FaceQuality::Thresholds FaceQuality::thresholds(Level level)
+{
+    switch (level) {
+    case Off:
+        return Thresholds{ 0, 90.0, 180.0, 0.0 };
+    case Strict:
+        return Thresholds{ 64, 35.0, 30.0, 60.0 };
+    case Normal:
+        break;
+    }
+    // SFace's input is 112x112: below about a third of that there is
+    // little left to recognise
+    return Thresholds{ 36, 60.0, 50.0, 15.0 };
+}
+
+bool FaceQuality::pose(const QVector<QPointF> &landmarks, const QSize &imageSize,
+                       double *yawDegrees, double *rollDegrees)
+{
+    if (landmarks.size() < 3 || imageSize.isEmpty()) {
+        return false;
+    }
+
+    // In pixels: normalized coordinates squash one axis on non-square photos
+    const auto px = [&imageSize](const QPointF &point) {
+        return QPointF(point.x() * imageSize.width(), point.y() * imageSize.height());
+    };
+    const QPointF rightEye = px(landmarks[0]);
+    const QPointF leftEye = px(landmarks[1]);
+    const QPointF nose = px(landmarks[2]);
+
+    const QPointF axis = leftEye - rightEye;
+    const double eyeDistance = qSqrt(QPointF::dotProduct(axis, axis));
+    if (eyeDistance < 1e-6) {
+        return false;
+    }
+
+    // Roll: the tilt of the line through the eyes
+    *rollDegrees = qRadiansToDegrees(qAtan2(axis.y(), axis.x()));
+
+    // Yaw: the nose slides towards one eye as the head turns, reaching it
+    // about in profile
+    const QPointF fromMiddle = nose - (rightEye + leftEye) / 2.0;
+    const double offset = QPointF::dotProduct(fromMiddle, axis) / eyeDistance / (eyeDistance / 2.0);
+    *yawDegrees = qRadiansToDegrees(qAsin(qBound(-1.0, offset, 1.0)));
+    return true;
+}
+
+double FaceQuality::sharpness(const uchar *grey, int width, int height, int stride)
+{
+    if (width < 3 || height < 3) {
+        return 0.0;
+    }
+
+    double sum = 0.0;
+    double sumSquares = 0.0;
+    for (int y = 1; y < height - 1; y++) {
+        const uchar *above = grey + (y - 1) * stride;
+        const uchar *line = grey + y * stride;
+        const uchar *below = grey + (y + 1) * stride;
+        for (int x = 1; x < width - 1; x++) {
+            const int laplacian = above[x] + below[x] + line[x - 1] + line[x + 1] - 4 * line[x];
+            sum += laplacian;
+            sumSquares += double(laplacian) * laplacian;
+        }
+    }
+
+    const double n = double(width - 2) * (height - 2);
+    const double mean = sum / n;
+    return sumSquares / n - mean * mean;
+}
+
+FaceQuality::Verdict FaceQuality::checkGeometry(const Thresholds &thresholds, qreal sidePx,
+                                                const QVector<QPointF> &landmarks, const QSize &imageSize)
+{
+    if (sidePx < thresholds.minSidePx) {
+        return TooSmall;
+    }
+
+    double yaw = 0.0;
+    double roll = 0.0;
+    if (pose(landmarks, imageSize, &yaw, &roll)
+            && (qAbs(yaw) > thresholds.maxYawDegrees || qAbs(roll) > thresholds.maxRollDegrees)) {
+        return TurnedAway;
+    }
+    return Pass;
+}
+
+FaceQuality::Verdict FaceQuality::checkSharpness(const Thresholds &thresholds, double sharpness)
+{
+    return sharpness < thresholds.minSharpness ? Blurred : Pass;
+}
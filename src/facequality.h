@@ -0,0 +1,86 @@
+#ifndef FACEQUALITY_H
+#define FACEQUALITY_H
+
+#include <QPointF>
+#include <QSize>
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief Decides whether a detected face is worth an embedding
+ *
+ * A detection that passes the detector's confidence can still be a
+ * 20-pixel face in the background, motion blur or a profile. Each costs an
+ * alignment, an SFace forward pass and a database row, and its embedding
+ * matches nobody reliably. The gate checks, cheapest first:
+ *
+ * - size: the longer side of the box in the original photo, in pixels
+ * - pose: yaw and roll estimated from the five YuNet landmarks
+ * - sharpness: variance of the Laplacian over the aligned face (the 112 px
+ *   SFace crop, from the best resolution decoded) shrunk to BLUR_SIDE
+ *   square, so the score does not depend on the photo's resolution
+ *
+ * Alignment undoes roll, so its limit is loose; it mostly catches landmarks
+ * that make no sense. Yaw is a rough estimate (the nose's offset from the
+ * eyes' midpoint, as a fraction of half the eye distance) but tells a
+ * frontal face from a profile well enough.
+ *
+ * Pixel access is left to the caller, so this stays free of OpenCV.
+ */
+class FaceQuality
+{
+public:
+    enum Level {
+        Off,      // every detection is embedded
+        Normal,   // drops what will hardly ever be recognised
+        Strict    // only clear, mostly frontal faces
+    };
+
+    struct Thresholds {
+        int minSidePx;
+        double maxYawDegrees;
+        double maxRollDegrees;
+        double minSharpness;
+    };
+
+    enum Verdict {
+        Pass,
+        TooSmall,
+        TurnedAway,
+        Blurred
+    };
+
+    // Aligned faces are shrunk to this side for sharpness()
+    static constexpr int BLUR_SIDE = 64;
+
+    static Level levelFromString(const QString &name);  // Normal if unknown
+    static QString levelName(Level level);
+    static Thresholds thresholds(Level level);
+
+    /**
+     * @brief Yaw and roll of a face in degrees, from YuNet's landmarks
+     * @param landmarks Right eye, left eye, nose tip, mouth corners,
+     *        normalized to an image of imageSize
+     * @return false without the five landmarks or with both eyes in one place
+     */
+    static bool pose(const QVector<QPointF> &landmarks, const QSize &imageSize,
+                     double *yawDegrees, double *rollDegrees);
+
+    /**
+     * @brief Variance of the 4-neighbour Laplacian over an 8-bit grey image
+     *
+     * Higher is sharper. 0 for images under 3x3 pixels.
+     */
+    static double sharpness(const uchar *grey, int width, int height, int stride);
+
+    /**
+     * @brief Check the geometry: size and pose
+     * @param sidePx Longer side of the face in the original photo
+     */
+    static Verdict checkGeometry(const Thresholds &thresholds, qreal sidePx,
+                                 const QVector<QPointF> &landmarks, const QSize &imageSize);
+
+    static Verdict checkSharpness(const Thresholds &thresholds, double sharpness);
+};
+
+#endif // FACEQUALITY_H
@@ -1,11 +1,120 @@
 #include "facerecognizer.h"
+#include "embeddingmatrix.h"
 #include <QDebug>
 #include "logging.h"
+#include "tracer.h"
+#include <cfloat>
 #include <cmath>
 
+namespace {
+
+// Where SFace's training data had the eyes, nose tip and mouth corners,
+// in the 112x112 input (FaceRecognizerSF's template)
+const float TEMPLATE[5][2] = {
+    { 38.2946f, 51.6963f },
+    { 73.5318f, 51.5014f },
+    { 56.0252f, 71.7366f },
+    { 41.5493f, 92.3655f },
+    { 70.7299f, 92.2041f }
+};
+
+const int INPUT_SIDE = 112;
+
+// Least-squares similarity transform (Umeyama) from the landmarks to the
+// template, as a 2x3 matrix for warpAffine; empty if degenerate.
+// Follows FaceRecognizerSF's getSimilarityTransformMatrix step by step,
+// including float vs double, so the warp comes out the same.
+cv::Mat similarityTransform(const float src[5][2])
+{
+    float srcMean[2] = { 0.0f, 0.0f };
+    for (int i = 0; i < 5; i++) {
+        srcMean[0] += src[i][0];
+        srcMean[1] += src[i][1];
+    }
+    srcMean[0] /= 5;
+    srcMean[1] /= 5;
+    // The template's mean, rounded as OpenCV has it
+    const float dstMean[2] = { 56.0262f, 71.9008f };
+
+    float srcDemean[5][2];
+    float dstDemean[5][2];
+    for (int i = 0; i < 5; i++) {
+        for (int j = 0; j < 2; j++) {
+            srcDemean[i][j] = src[i][j] - srcMean[j];
+            dstDemean[i][j] = TEMPLATE[i][j] - dstMean[j];
+        }
+    }
+
+    // Covariance of template and landmarks
+    double a[2][2] = { { 0.0, 0.0 }, { 0.0, 0.0 } };
+    for (int i = 0; i < 5; i++) {
+        for (int r = 0; r < 2; r++) {
+            for (int k = 0; k < 2; k++) {
+                a[r][k] += dstDemean[i][r] * srcDemean[i][k];
+            }
+        }
+    }
+    for (int r = 0; r < 2; r++) {
+        for (int k = 0; k < 2; k++) {
+            a[r][k] /= 5;
+        }
+    }
+
+    // A reflection is never the answer
+    double d[2] = { 1.0, 1.0 };
+    if (a[0][0] * a[1][1] - a[0][1] * a[1][0] < 0) {
+        d[1] = -1.0;
+    }
+
+    cv::Mat s, u, vt;
+    cv::SVD::compute(cv::Mat(2, 2, CV_64F, a), s, u, vt);
+    const double smax = qMax(s.at<double>(0), s.at<double>(1));
+    const double tol = smax * 2 * FLT_MIN;
+    const int rank = (s.at<double>(0) > tol) + (s.at<double>(1) > tol);
+    if (rank == 0) {
+        return cv::Mat();
+    }
+
+    cv::Mat rotation;
+    if (rank == 1) {
+        const double detU = cv::determinant(u);
+        const double detV = cv::determinant(vt);
+        if (detU * detV > 0) {
+            rotation = u * vt;
+        } else {
+            const double saved = d[1];
+            d[1] = -1.0;
+            rotation = u * cv::Mat::diag(cv::Mat(2, 1, CV_64F, d)) * vt;
+            d[1] = saved;
+        }
+    } else {
+        rotation = u * cv::Mat::diag(cv::Mat(2, 1, CV_64F, d)) * vt;
+    }
+
+    double var = 0.0;
+    for (int i = 0; i < 5; i++) {
+        var += srcDemean[i][0] * srcDemean[i][0] + srcDemean[i][1] * srcDemean[i][1];
+    }
+    var /= 5;
+    const double scale = (s.at<double>(0) * d[0] + s.at<double>(1) * d[1]) / var;
+
+    cv::Mat transform(2, 3, CV_64F);
+    for (int r = 0; r < 2; r++) {
+        const double rs0 = rotation.at<double>(r, 0);
+        const double rs1 = rotation.at<double>(r, 1);
+        transform.at<double>(r, 0) = rs0 * scale;
+        transform.at<double>(r, 1) = rs1 * scale;
+        transform.at<double>(r, 2) = dstMean[r] - scale * (rs0 * srcMean[0] + rs1 * srcMean[1]);
+    }
+    return transform;
+}
+
+} // namespace
+
 FaceRecognizer::FaceRecognizer(QObject *parent)
     : QObject(parent)
     , m_modelLoaded(false)
+    , m_singleOnly(false)
 {
 }
 
@@ -18,19 +127,16 @@ bool FaceRecognizer::loadModel(const QString &modelPath)
     try {
         qCDebug(lcNami) << "Loading SFace recognition model from:" << modelPath;
 
-        m_recognizer = cv::FaceRecognizerSF::create(
-            modelPath.toStdString(),
-            "",
-            cv::dnn::DNN_BACKEND_OPENCV,
-            cv::dnn::DNN_TARGET_CPU
-        );
-
-        if (m_recognizer.empty()) {
-            emit error("Failed to create SFace recognizer");
+        m_net = cv::dnn::readNetFromONNX(modelPath.toStdString());
+        if (m_net.empty()) {
+            emit error("Failed to load SFace model");
             return false;
         }
+        m_net.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+        m_net.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
 
         m_modelLoaded = true;
+        m_singleOnly = false;
         qCDebug(lcNami) << "SFace model loaded successfully (112x112 input, 128-d output)";
 
         return true;
@@ -45,6 +151,7 @@ bool FaceRecognizer::loadModel(const QString &modelPath)
 
 FaceEmbedding FaceRecognizer::extractEmbedding(const cv::Mat &image, const FaceDetection &detection)
 {
+    TRACE_SCOPE("model", "extractEmbedding");
     if (!m_modelLoaded) {
         emit error("Model not loaded");
         return FaceEmbedding();
@@ -55,57 +162,117 @@ FaceEmbedding FaceRecognizer::extractEmbedding(const cv::Mat &image, const FaceD
         return FaceEmbedding();
     }
 
-    // alignCrop needs the 5 landmarks; without them the warp is garbage
+    const cv::Mat aligned = alignFace(image, detection);
+    if (aligned.empty()) {
+        return FaceEmbedding();
+    }
+    return embedAligned({ aligned }).value(0);
+}
+
+cv::Mat FaceRecognizer::alignFace(const cv::Mat &image, const FaceDetection &detection) const
+{
+    // The warp needs the 5 landmarks; without them it is garbage
     if (detection.landmarks.size() != 5) {
         qWarning() << "Face detection has" << detection.landmarks.size()
                    << "landmarks, expected 5 - skipping";
-        return FaceEmbedding();
+        return cv::Mat();
+    }
+    if (image.empty()) {
+        return cv::Mat();
     }
 
     try {
-        cv::Mat faceRow = detectionToFaceRow(image, detection);
+        // Landmarks in pixels, as float like YuNet's own output rows
+        float landmarks[5][2];
+        for (int i = 0; i < 5; i++) {
+            landmarks[i][0] = static_cast<float>(detection.landmarks[i].x() * image.cols);
+            landmarks[i][1] = static_cast<float>(detection.landmarks[i].y() * image.rows);
+        }
 
-        // alignCrop warps to the 112x112 ArcFace template using the 5
-        // landmarks; feature applies the model's own preprocessing
-        cv::Mat aligned;
-        m_recognizer->alignCrop(image, faceRow, aligned);
+        const cv::Mat transform = similarityTransform(landmarks);
+        if (transform.empty()) {
+            return cv::Mat();
+        }
 
-        cv::Mat feature;
-        m_recognizer->feature(aligned, feature);
+        cv::Mat aligned;
+        cv::warpAffine(image, aligned, transform, cv::Size(INPUT_SIDE, INPUT_SIDE), cv::INTER_LINEAR);
+        return aligned;
+    }
+    catch (const cv::Exception &e) {
+        qWarning() << "OpenCV exception during face alignment:" << e.what();
+        return cv::Mat();
+    }
+}
 
-        FaceEmbedding embedding(feature.ptr<float>(0),
-                                feature.ptr<float>(0) + feature.cols);
+QVector<FaceEmbedding> FaceRecognizer::embedAligned(const std::vector<cv::Mat> &alignedFaces)
+{
+    TRACE_SCOPE("model", "embedAligned");
+    QVector<FaceEmbedding> embeddings(static_cast<int>(alignedFaces.size()));
+    if (!m_modelLoaded) {
+        emit error("Model not loaded");
+        return embeddings;
+    }
 
-        return normalizeEmbedding(embedding);
+    try {
+        const int batch = m_singleOnly ? 1 : MAX_BATCH;
+        for (size_t first = 0; first < alignedFaces.size(); first += batch) {
+            const size_t last = qMin(alignedFaces.size(), first + batch);
+            const std::vector<cv::Mat> chunk(alignedFaces.begin() + first, alignedFaces.begin() + last);
+            QVector<FaceEmbedding> chunkEmbeddings;
+            if (!forward(chunk, chunkEmbeddings)) {
+                if (chunk.size() == 1) {
+                    return QVector<FaceEmbedding>(static_cast<int>(alignedFaces.size()));
+                }
+                // Batch dimension fixed to 1 in this model: from now on,
+                // and for this chunk, one face at a time
+                qCDebug(lcNami) << "SFace model takes no batches, embedding one face at a time";
+                m_singleOnly = true;
+                return embedAligned(alignedFaces);
+            }
+            for (int i = 0; i < chunkEmbeddings.size(); i++) {
+                embeddings[static_cast<int>(first) + i] = chunkEmbeddings[i];
+            }
+        }
+        return embeddings;
     }
     catch (const cv::Exception &e) {
         QString errorMsg = QString("OpenCV exception during embedding extraction: %1").arg(e.what());
         qWarning() << errorMsg;
         emit error(errorMsg);
-        return FaceEmbedding();
+        return QVector<FaceEmbedding>(static_cast<int>(alignedFaces.size()));
     }
 }
 
-cv::Mat FaceRecognizer::detectionToFaceRow(const cv::Mat &image, const FaceDetection &detection)
+bool FaceRecognizer::forward(const std::vector<cv::Mat> &alignedFaces, QVector<FaceEmbedding> &embeddings)
 {
-    // YuNet row format: [x, y, w, h, re_x, re_y, le_x, le_y, nose_x, nose_y,
-    // rcm_x, rcm_y, lcm_x, lcm_y, score] in pixels; alignCrop reads the
-    // landmarks at columns 4-13
-    cv::Mat faceRow(1, 15, CV_32F, cv::Scalar(0));
-
-    faceRow.at<float>(0, 0) = static_cast<float>(detection.bbox.x() * image.cols);
-    faceRow.at<float>(0, 1) = static_cast<float>(detection.bbox.y() * image.rows);
-    faceRow.at<float>(0, 2) = static_cast<float>(detection.bbox.width() * image.cols);
-    faceRow.at<float>(0, 3) = static_cast<float>(detection.bbox.height() * image.rows);
-
-    for (int i = 0; i < detection.landmarks.size() && i < 5; i++) {
-        faceRow.at<float>(0, 4 + i * 2) = static_cast<float>(detection.landmarks[i].x() * image.cols);
-        faceRow.at<float>(0, 5 + i * 2) = static_cast<float>(detection.landmarks[i].y() * image.rows);
+    // FaceRecognizerSF::feature's preprocessing: RGB, 0-255, no mean
+    const cv::Mat blob = cv::dnn::blobFromImages(alignedFaces, 1.0, cv::Size(INPUT_SIDE, INPUT_SIDE),
+                                                 cv::Scalar(0, 0, 0), true, false);
+    cv::Mat features;
+    try {
+        m_net.setInput(blob);
+        features = m_net.forward();
+    } catch (const cv::Exception &e) {
+        if (alignedFaces.size() == 1) {
+            throw;
+        }
+        qCDebug(lcNami) << "Batched forward pass failed:" << e.what();
+        return false;
     }
 
-    faceRow.at<float>(0, 14) = detection.confidence;
+    const int faces = static_cast<int>(alignedFaces.size());
+    features = features.reshape(1, features.size[0]);
+    if (features.rows != faces) {
+        return false;
+    }
 
-    return faceRow;
+    embeddings.clear();
+    embeddings.reserve(faces);
+    for (int i = 0; i < faces; i++) {
+        const float *row = features.ptr<float>(i);
+        embeddings.append(normalizeEmbedding(FaceEmbedding(row, row + features.cols)));
+    }
+    return true;
 }
 
 float FaceRecognizer::computeSimilarity(const FaceEmbedding &emb1, const FaceEmbedding &emb2)
@@ -116,10 +283,8 @@ float FaceRecognizer::computeSimilarity(const FaceEmbedding &emb1, const FaceEmb
     }
 
     // Cosine similarity (dot product of normalized vectors)
-    float dotProduct = 0.0f;
-    for (size_t i = 0; i < emb1.size(); i++) {
-        dotProduct += emb1[i] * emb2[i];
-    }
+    float dotProduct = EmbeddingMath::dot(emb1.data(), emb2.data(),
+                                          static_cast<int>(emb1.size()));
 
     // Convert from [-1, 1] to [0, 1]
     float similarity = (dotProduct + 1.0f) / 2.0f;
@@ -4,8 +4,9 @@
 #include <QObject>
 #include <QString>
 #include <QVector>
+#include <vector>
 #include <opencv2/opencv.hpp>
-#include <opencv2/objdetect.hpp>
+#include <opencv2/dnn.hpp>
 #include "facedetector.h"
 #include "faceembedding.h"
 
@@ -18,11 +19,14 @@ struct FaceMatch {
 };
 
 /**
- * @brief SFace-based face recognition using OpenCV FaceRecognizerSF
+ * @brief SFace-based face recognition
  *
- * Uses the official OpenCV Zoo SFace model, designed to pair with YuNet:
- * alignCrop() consumes YuNet landmarks directly and feature() applies the
- * exact preprocessing the model was trained with.
+ * Uses the official OpenCV Zoo SFace model, designed to pair with YuNet.
+ * Does what OpenCV's FaceRecognizerSF does (alignCrop() then feature()) with
+ * the same alignment and preprocessing, but owns the network, so all faces
+ * of a photo go through one forward pass instead of one each: the DNN's
+ * per-call overhead is most of the cost of a small face, and group photos
+ * have dozens of them.
  *
  * Extracts 128-dimensional embeddings, compared with cosine similarity.
  * The official cosine decision threshold is 0.363, i.e. ~0.68 on the
@@ -51,6 +55,32 @@ public:
      */
     FaceEmbedding extractEmbedding(const cv::Mat &image, const FaceDetection &detection);
 
+    /**
+     * @brief Warp a face to the 112x112 template the model expects
+     *
+     * Same transform as FaceRecognizerSF::alignCrop: the similarity
+     * (Umeyama) that best maps the five landmarks onto the template's.
+     *
+     * @param image Image (BGR) the detection's coordinates refer to
+     * @return Aligned face (BGR, 112x112), empty without five landmarks
+     */
+    cv::Mat alignFace(const cv::Mat &image, const FaceDetection &detection) const;
+
+    /**
+     * @brief Embeddings of aligned faces, in batches of up to MAX_BATCH
+     *
+     * Faces may come from different photos. Gives the same embeddings as
+     * one face at a time.
+     *
+     * @return One L2-normalized embedding per face, in order; all empty on
+     *         failure
+     */
+    QVector<FaceEmbedding> embedAligned(const std::vector<cv::Mat> &alignedFaces);
+
+    // Faces per forward pass: past this, a bigger blob stops paying off and
+    // only costs memory
+    static constexpr int MAX_BATCH = 16;
+
     /**
      * @brief Compute cosine similarity between two embeddings
      * @param emb1 First embedding
@@ -78,12 +108,16 @@ signals:
     void error(const QString &message);
 
 private:
-    cv::Ptr<cv::FaceRecognizerSF> m_recognizer;
+    cv::dnn::Net m_net;
     bool m_modelLoaded;
 
-    // Helper: Build the 1x15 YuNet-format face row (pixel coordinates)
-    // expected by FaceRecognizerSF::alignCrop
-    static cv::Mat detectionToFaceRow(const cv::Mat &image, const FaceDetection &detection);
+    // The model refused a batch (fixed batch dimension in the ONNX graph):
+    // one face per forward pass from then on
+    bool m_singleOnly;
+
+    // Helper: One forward pass over these faces; false if the network did
+    // not return one row per face
+    bool forward(const std::vector<cv::Mat> &alignedFaces, QVector<FaceEmbedding> &embeddings);
 };
 
 #endif // FACERECOGNIZER_H
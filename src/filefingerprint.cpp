@@ -0,0 +1,93 @@
+#include "filefingerprint.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <algorithm>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+bool FileFingerprint::sameContents(const FileFingerprint &other) const
+{
+    if (size != other.size || mtimeMs != other.mtimeMs) {
+        return false;
+    }
+    // Inode numbers are only comparable on the same mount
+    return device != other.device || inode == other.inode;
+}
+
+FileFingerprint FileFingerprint::of(const QString &filePath)
+{
+    FileFingerprint fingerprint;
+
+#ifdef Q_OS_UNIX
+    struct stat st;
+    if (::stat(QFile::encodeName(filePath).constData(), &st) != 0) {
+        return fingerprint;
+    }
+    fingerprint.size = st.st_size;
+    fingerprint.mtimeMs = static_cast<qint64>(st.st_mtim.tv_sec) * 1000
+                        + st.st_mtim.tv_nsec / 1000000;
+    fingerprint.inode = st.st_ino;
+    fingerprint.device = st.st_dev;
+#else
+    const QFileInfo info(filePath);
+    if (!info.exists()) {
+        return fingerprint;
+    }
+    fingerprint.size = info.size();
+    fingerprint.mtimeMs = info.lastModified().toMSecsSinceEpoch();
+#endif
+
+    return fingerprint;
+}
+
+FingerprintDiff diffFingerprints(QVector<QPair<QString, FileFingerprint>> onDisk,
+                                 QVector<StoredFingerprint> stored)
+{
+    FingerprintDiff diff;
+
+    // Both sides sorted the same way; SQLite's ORDER BY compares UTF-8
+    // bytes, QString compares UTF-16, so the table's order is not reused
+    std::sort(onDisk.begin(), onDisk.end(),
+              [](const QPair<QString, FileFingerprint> &a, const QPair<QString, FileFingerprint> &b) {
+                  return a.first < b.first;
+              });
+    std::sort(stored.begin(), stored.end(),
+              [](const StoredFingerprint &a, const StoredFingerprint &b) {
+                  return a.filePath < b.filePath;
+              });
+
+    int s = 0;
+    for (const auto &file : onDisk) {
+        while (s < stored.size() && stored[s].filePath < file.first) {
+            s++;  // in the table, gone from disk
+        }
+
+        if (s == stored.size() || stored[s].filePath != file.first || !stored[s].processed) {
+            diff.added.append(file.first);
+            continue;
+        }
+
+        const StoredFingerprint &row = stored[s];
+        const FileFingerprint &current = file.second;
+        if (!current.isValid()) {
+            // Can't stat it now; leave it as it was
+            diff.unchanged++;
+        } else if (!row.fingerprint.isValid()) {
+            diff.unchanged++;
+            diff.refresh.append(qMakePair(row.photoId, current));
+        } else if (!current.sameContents(row.fingerprint)) {
+            diff.changed.append(file.first);
+        } else {
+            diff.unchanged++;
+            if (current != row.fingerprint) {
+                diff.refresh.append(qMakePair(row.photoId, current));
+            }
+        }
+    }
+
+    return diff;
+}
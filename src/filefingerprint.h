@@ -0,0 +1,82 @@
+#ifndef FILEFINGERPRINT_H
+#define FILEFINGERPRINT_H
+
+#include <QPair>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/**
+ * @brief Cheap identity of a file's current contents: size, mtime, inode
+ *
+ * Stored per photo so an incremental scan can tell an edited or replaced
+ * photo from an untouched one with a stat() instead of re-reading it.
+ * Editors that save by writing a new file and renaming it over the old
+ * one keep the path but change the inode, which catches an edit even when
+ * size and mtime happen to match.
+ *
+ * Device and inode numbers are only stable within one mount: vfat (most
+ * SD cards) synthesizes inode numbers at mount time. When the device
+ * differs, only size and mtime are compared (see sameContents()).
+ */
+struct FileFingerprint {
+    qint64 size = -1;     // -1: unknown (stat failed, or never stored)
+    qint64 mtimeMs = 0;   // ms since epoch
+    quint64 inode = 0;
+    quint64 device = 0;
+
+    bool isValid() const { return size >= 0; }
+
+    /**
+     * @brief Whether a file with this fingerprint still has other's contents
+     */
+    bool sameContents(const FileFingerprint &other) const;
+
+    bool operator==(const FileFingerprint &other) const
+    {
+        return size == other.size && mtimeMs == other.mtimeMs
+            && inode == other.inode && device == other.device;
+    }
+    bool operator!=(const FileFingerprint &other) const { return !(*this == other); }
+
+    /**
+     * @brief stat() the file; invalid if it can't be
+     */
+    static FileFingerprint of(const QString &filePath);
+};
+
+/**
+ * @brief A photo row as the incremental scan sees it
+ */
+struct StoredFingerprint {
+    int photoId;
+    QString filePath;
+    bool processed;           // processed_at is set
+    FileFingerprint fingerprint;  // invalid for photos scanned before fingerprints
+};
+
+/**
+ * @brief Files on disk sorted against the photos table, in one pass
+ */
+struct FingerprintDiff {
+    QStringList added;      // not in the table, or never finished processing
+    QStringList changed;    // processed, but the file is not the same anymore
+    int unchanged = 0;
+
+    // Unchanged photos whose stored fingerprint is missing or outdated
+    // only by device/inode numbers (a remount): store the current one
+    QVector<QPair<int, FileFingerprint>> refresh;
+};
+
+/**
+ * @brief Classify every file on disk as added, changed or unchanged
+ *
+ * Both lists are sorted by path and merged, rather than hashing every
+ * stored path into a set and probing it once per file.
+ * Stored photos with no file on disk are ignored (removeMissingPhotos()
+ * deals with those).
+ */
+FingerprintDiff diffFingerprints(QVector<QPair<QString, FileFingerprint>> onDisk,
+                                 QVector<StoredFingerprint> stored);
+
+#endif // FILEFINGERPRINT_H
@@ -16,3 +16,9 @@ QString computeFileSha256(const QString &filePath)
 
     return QString::fromLatin1(hash.result().toHex());
 }
+
+QString computeSha256(const QByteArray &data)
+{
+    return QString::fromLatin1(
+        QCryptographicHash::hash(data, QCryptographicHash::Sha256).toHex());
+}
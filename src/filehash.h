@@ -1,6 +1,7 @@
 #ifndef FILEHASH_H
 #define FILEHASH_H
 
+#include <QByteArray>
 #include <QString>
 
 /**
@@ -14,4 +15,9 @@
  */
 QString computeFileSha256(const QString &filePath);
 
+/**
+ * @brief Same hash, over file contents already in memory
+ */
+QString computeSha256(const QByteArray &data);
+
 #endif // FILEHASH_H
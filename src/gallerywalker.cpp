@@ -0,0 +1,206 @@
+#include "gallerywalker.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <algorithm>
+
+#ifdef Q_OS_UNIX
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Same order QDir gave the old walker
+void sortNames(QStringList &names)
+{
+    std::sort(names.begin(), names.end(), [](const QString &a, const QString &b) {
+        return QString::compare(a, b, Qt::CaseInsensitive) < 0;
+    });
+}
+
+} // namespace
+
+GalleryWalker::GalleryWalker(const QHash<QString, DirListing> &cache)
+    : m_cache(cache)
+{
+}
+
+bool GalleryWalker::isImageName(const QString &name)
+{
+    const int dot = name.lastIndexOf('.');
+    if (dot < 0) {
+        return false;
+    }
+    const QStringRef ext = name.midRef(dot + 1);
+    for (const char *supported : { "jpg", "jpeg", "png", "bmp", "gif" }) {
+        if (ext.compare(QLatin1String(supported), Qt::CaseInsensitive) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+QStringList GalleryWalker::walk(const QString &root, bool recursive)
+{
+    QStringList files;
+    walk(root, recursive, [&files](const QString &, const QStringList &folderFiles) {
+        files += folderFiles;
+        return true;
+    });
+    return files;
+}
+
+bool GalleryWalker::walk(const QString &root, bool recursive, const FolderVisitor &visit)
+{
+    return walkDir(QDir(root).absolutePath(), recursive, visit);
+}
+
+QStringList GalleryWalker::gone(const QStringList &roots) const
+{
+    QStringList paths;
+    for (auto it = m_cache.constBegin(); it != m_cache.constEnd(); ++it) {
+        if (m_visitedPaths.contains(it.key())) {
+            continue;
+        }
+        for (const QString &root : roots) {
+            const QString absolute = QDir(root).absolutePath();
+            if (it.key() == absolute || it.key().startsWith(absolute + '/')) {
+                paths.append(it.key());
+                break;
+            }
+        }
+    }
+    return paths;
+}
+
+bool GalleryWalker::walkDir(const QString &path, bool recursive, const FolderVisitor &visit)
+{
+#ifdef Q_OS_UNIX
+    struct stat st;
+    if (::stat(QFile::encodeName(path).constData(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        return true;
+    }
+    const QPair<quint64, quint64> id(st.st_dev, st.st_ino);
+    const qint64 mtimeMs = static_cast<qint64>(st.st_mtim.tv_sec) * 1000
+                         + st.st_mtim.tv_nsec / 1000000;
+#else
+    const QFileInfo info(path);
+    if (!info.isDir()) {
+        return true;
+    }
+    const QPair<quint64, quint64> id(0, qHash(info.canonicalFilePath()));
+    const qint64 mtimeMs = info.lastModified().toMSecsSinceEpoch();
+#endif
+    if (m_visited.contains(id)) {
+        return true;
+    }
+    m_visited.insert(id);
+    m_visitedPaths.insert(path);
+
+    DirListing listing;
+    const auto cached = m_cache.constFind(path);
+    if (cached != m_cache.constEnd() && cached.value().mtimeMs == mtimeMs) {
+        listing = cached.value();
+        m_dirsCached++;
+    } else {
+        if (!readDir(path, listing)) {
+            return true;
+        }
+        listing.mtimeMs = mtimeMs;
+        m_dirsListed++;
+        m_listed.insert(path);
+        if (QDateTime::currentMSecsSinceEpoch() - mtimeMs >= RACY_WINDOW_MS) {
+            m_fresh.insert(path, listing);
+        }
+    }
+
+    const QString prefix = path.endsWith('/') ? path : path + '/';
+    QStringList files;
+    files.reserve(listing.images.size());
+    for (const QString &name : listing.images) {
+        files.append(prefix + name);
+    }
+    if (!visit(path, files)) {
+        return false;
+    }
+    if (recursive) {
+        for (const QString &name : listing.subdirs) {
+            if (!walkDir(prefix + name, true, visit)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool GalleryWalker::readDir(const QString &path, DirListing &listing)
+{
+#ifdef Q_OS_UNIX
+    DIR *dir = ::opendir(QFile::encodeName(path).constData());
+    if (!dir) {
+        return false;
+    }
+
+    while (const struct dirent *entry = ::readdir(dir)) {
+        // ".", ".." and hidden entries (.thumbnails, .trash...)
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+
+        bool isDir = false;
+        bool isFile = false;
+        switch (entry->d_type) {
+        case DT_DIR:
+            isDir = true;
+            break;
+        case DT_REG:
+            isFile = true;
+            break;
+        case DT_LNK:
+        case DT_UNKNOWN: {
+            // Symlinks are followed, as QDir did
+            struct stat st;
+            if (::fstatat(::dirfd(dir), entry->d_name, &st, 0) == 0) {
+                isDir = S_ISDIR(st.st_mode);
+                isFile = S_ISREG(st.st_mode);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+
+        if (isDir) {
+            listing.subdirs.append(QFile::decodeName(entry->d_name));
+        } else if (isFile) {
+            // Unreadable photos are left out, as QDir::Readable did: they
+            // would only fail to open on every scan
+            const QString name = QFile::decodeName(entry->d_name);
+            if (isImageName(name) && ::faccessat(::dirfd(dir), entry->d_name, R_OK, 0) == 0) {
+                listing.images.append(name);
+            }
+        }
+    }
+    ::closedir(dir);
+#else
+    const QDir dir(path);
+    if (!dir.exists()) {
+        return false;
+    }
+    for (const QString &name : dir.entryList(QDir::Files | QDir::Readable)) {
+        if (isImageName(name)) {
+            listing.images.append(name);
+        }
+    }
+    listing.subdirs = dir.entryList(QDir::AllDirs | QDir::NoDotAndDotDot);
+#endif
+
+    sortNames(listing.images);
+    sortNames(listing.subdirs);
+    return true;
+}
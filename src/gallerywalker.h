@@ -0,0 +1,98 @@
+#ifndef GALLERYWALKER_H
+#define GALLERYWALKER_H
+
+#include <QHash>
+#include <QPair>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <functional>
+
+/**
+ * @brief What a folder held the last time it was read
+ *
+ * A folder's mtime changes whenever an entry is added to, removed from or
+ * renamed inside it (not when a file in it is edited in place - the file
+ * fingerprints catch that). While the mtime stays the same, the names
+ * stored here are still exactly what a readdir() would return.
+ */
+struct DirListing {
+    qint64 mtimeMs = -1;
+    QStringList images;   // file names, sorted
+    QStringList subdirs;  // names, sorted, hidden ones left out
+};
+
+/**
+ * @brief Lists the image files under gallery folders
+ *
+ * A plain readdir() loop: names come straight from the directory entry
+ * and its type, with a stat() only per folder (for its mtime) and for the
+ * odd entry whose type the filesystem doesn't report. Folders whose mtime
+ * matches the cache are not read at all, their stored listing is reused.
+ *
+ * Never touches the database, so it can run on any thread: the caller
+ * loads the cache beforehand and stores fresh() afterwards.
+ */
+class GalleryWalker
+{
+public:
+    // A folder modified this recently may still change within the same
+    // mtime tick (vfat keeps 2 s): read it, but don't cache what was read
+    static constexpr qint64 RACY_WINDOW_MS = 2000;
+
+    // Gets each folder's image files (absolute paths, possibly none) as
+    // soon as the folder is read; returning false stops the walk
+    typedef std::function<bool(const QString &folder, const QStringList &files)> FolderVisitor;
+
+    explicit GalleryWalker(const QHash<QString, DirListing> &cache = QHash<QString, DirListing>());
+
+    /**
+     * @brief Absolute paths of the image files in a folder (and below)
+     *
+     * Hidden files and folders are skipped, like QDir does by default.
+     * A folder reached twice (overlapping roots, symlink loops) is
+     * walked once.
+     */
+    QStringList walk(const QString &root, bool recursive);
+
+    /**
+     * @brief Same walk, handing over the files folder by folder
+     * @return false if visit stopped it
+     */
+    bool walk(const QString &root, bool recursive, const FolderVisitor &visit);
+
+    /**
+     * @brief Folders read from disk during the walk, safe to cache
+     */
+    const QHash<QString, DirListing> &fresh() const { return m_fresh; }
+
+    /**
+     * @brief Folders read from disk so far (fresh() or too recent to cache),
+     *        as opposed to taken from the cache
+     */
+    const QSet<QString> &listed() const { return m_listed; }
+
+    /**
+     * @brief Cached folders under one of roots that no longer exist
+     */
+    QStringList gone(const QStringList &roots) const;
+
+    int dirsListed() const { return m_dirsListed; }
+    int dirsCached() const { return m_dirsCached; }
+
+    static bool isImageName(const QString &name);
+
+private:
+    bool walkDir(const QString &path, bool recursive, const FolderVisitor &visit);
+    static bool readDir(const QString &path, DirListing &listing);
+
+    const QHash<QString, DirListing> m_cache;
+    QHash<QString, DirListing> m_fresh;
+    QSet<QPair<quint64, quint64>> m_visited;  // (device, inode)
+    QSet<QString> m_visitedPaths;
+    QSet<QString> m_listed;
+    int m_dirsListed = 0;
+    int m_dirsCached = 0;
+};
+
+#endif // GALLERYWALKER_H
@@ -0,0 +1,371 @@
+#include "gallerywatcher.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSocketNotifier>
+#include "logging.h"
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+#ifdef Q_OS_LINUX
+#include <errno.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifdef Q_OS_LINUX
+const uint32_t WATCH_MASK = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR;
+#endif
+
+// Device of a folder, or false if it is not one (anymore)
+bool folderDevice(const QString &path, quint64 &device)
+{
+#ifdef Q_OS_UNIX
+    struct stat st;
+    if (::stat(QFile::encodeName(path).constData(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        return false;
+    }
+    device = st.st_dev;
+    return true;
+#else
+    device = 0;
+    return QFileInfo(path).isDir();
+#endif
+}
+
+} // namespace
+
+GalleryWatcher::GalleryWatcher(bool useInotify, QObject *parent)
+    : QObject(parent)
+    , m_useInotify(useInotify)
+    , m_recursive(true)
+    , m_inotifyFd(-1)
+    , m_notifier(nullptr)
+{
+    m_debounceTimer.setSingleShot(true);
+    connect(&m_debounceTimer, &QTimer::timeout, this, &GalleryWatcher::flush);
+    connect(&m_checkTimer, &QTimer::timeout, this, &GalleryWatcher::check);
+}
+
+GalleryWatcher::~GalleryWatcher()
+{
+    stop();
+}
+
+void GalleryWatcher::watch(const QStringList &roots, bool recursive,
+                           const QHash<QString, DirListing> &cache)
+{
+    stop();
+
+#ifdef Q_OS_LINUX
+    if (m_useInotify) {
+        m_inotifyFd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (m_inotifyFd < 0) {
+            qWarning() << "inotify unavailable, polling the gallery folders instead";
+        } else {
+            m_notifier = new QSocketNotifier(m_inotifyFd, QSocketNotifier::Read, this);
+            connect(m_notifier, &QSocketNotifier::activated, this, &GalleryWatcher::readEvents);
+        }
+    }
+#endif
+
+    m_recursive = recursive;
+    m_listings = cache;
+    for (const QString &path : roots) {
+        if (!path.isEmpty()) {
+            Root root;
+            root.path = QDir(path).absolutePath();
+            m_roots.append(root);
+        }
+    }
+    for (Root &root : m_roots) {
+        arm(root);
+    }
+    m_checkTimer.start(CHECK_MS);
+
+    qCDebug(lcNami) << "Watching" << m_roots.size() << "gallery folders,"
+                    << (usesInotify() ? m_watchOfFolder.size() : 0) << "inotify watches";
+}
+
+void GalleryWatcher::stop()
+{
+    m_checkTimer.stop();
+    m_debounceTimer.stop();
+    m_roots.clear();
+    m_pending.clear();
+    m_pendingSet.clear();
+    m_pendingAge.invalidate();
+    m_folderOfWatch.clear();
+    m_watchOfFolder.clear();
+
+    delete m_notifier;
+    m_notifier = nullptr;
+#ifdef Q_OS_LINUX
+    if (m_inotifyFd >= 0) {
+        ::close(m_inotifyFd);  // drops every watch with it
+    }
+#endif
+    m_inotifyFd = -1;
+}
+
+void GalleryWatcher::arm(Root &root)
+{
+    root.armed = folderDevice(root.path, root.device);
+    if (root.armed) {
+        armFolder(root.path);
+    }
+}
+
+void GalleryWatcher::armFolder(const QString &folder)
+{
+    // Everything in it is reported: it may have been written while no
+    // watch was in place (before start, on a card that was elsewhere, in a
+    // folder created a moment before its watch)
+    GalleryWalker walker(m_listings);
+    QHash<QString, QStringList> reread;
+    walker.walk(folder, m_recursive, [&](const QString &path, const QStringList &files) {
+        addWatch(path);
+        QStringList names;
+        for (const QString &file : files) {
+            queue(file);
+            names.append(file.mid(path.size() + 1));
+        }
+        if (walker.listed().contains(path)) {
+            reread.insert(path, names);
+        }
+        return true;
+    });
+    remember(walker, reread);
+}
+
+void GalleryWatcher::remember(const GalleryWalker &walker, const QHash<QString, QStringList> &reread)
+{
+    // Too recent to trust (see RACY_WINDOW_MS) still counts as known, but
+    // with no mtime so the folder is read again next time
+    for (auto it = reread.constBegin(); it != reread.constEnd(); ++it) {
+        const auto fresh = walker.fresh().constFind(it.key());
+        if (fresh != walker.fresh().constEnd()) {
+            m_listings.insert(it.key(), fresh.value());
+        } else {
+            DirListing listing = m_listings.value(it.key());
+            listing.mtimeMs = -1;
+            listing.images = it.value();
+            m_listings.insert(it.key(), listing);
+        }
+    }
+}
+
+void GalleryWatcher::disarm(const QString &root)
+{
+    const QString prefix = root + '/';
+    for (auto it = m_watchOfFolder.begin(); it != m_watchOfFolder.end();) {
+        if (it.key() == root || it.key().startsWith(prefix)) {
+#ifdef Q_OS_LINUX
+            ::inotify_rm_watch(m_inotifyFd, it.value());
+#endif
+            m_folderOfWatch.remove(it.value());
+            it = m_watchOfFolder.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void GalleryWatcher::addWatch(const QString &folder)
+{
+#ifdef Q_OS_LINUX
+    if (m_inotifyFd < 0 || m_watchOfFolder.contains(folder)) {
+        return;
+    }
+    const int wd = ::inotify_add_watch(m_inotifyFd, QFile::encodeName(folder).constData(), WATCH_MASK);
+    if (wd >= 0) {
+        m_folderOfWatch.insert(wd, folder);
+        m_watchOfFolder.insert(folder, wd);
+    } else if (errno == ENOSPC) {
+        // fs.inotify.max_user_watches reached: half-watched would be worse
+        // than polling everything
+        fallBackToPolling();
+    }
+#else
+    Q_UNUSED(folder)
+#endif
+}
+
+void GalleryWatcher::fallBackToPolling()
+{
+    qWarning() << "Out of inotify watches, polling the gallery folders instead";
+    // May be running inside the notifier's own activated() signal
+    m_notifier->deleteLater();
+    m_notifier = nullptr;
+#ifdef Q_OS_LINUX
+    ::close(m_inotifyFd);
+#endif
+    m_inotifyFd = -1;
+    m_folderOfWatch.clear();
+    m_watchOfFolder.clear();
+}
+
+void GalleryWatcher::readEvents()
+{
+#ifdef Q_OS_LINUX
+    alignas(struct inotify_event) char buffer[4096];
+    bool overflow = false;
+
+    for (;;) {
+        const ssize_t length = ::read(m_inotifyFd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            break;
+        }
+
+        for (const char *p = buffer; p < buffer + length;) {
+            const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(p);
+            p += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                overflow = true;
+                continue;
+            }
+
+            const QString folder = m_folderOfWatch.value(event->wd);
+            if (folder.isEmpty()) {
+                continue;
+            }
+
+            // Folder deleted, or its filesystem unmounted (IN_UNMOUNT comes
+            // first): the watch is gone, check() re-arms a root that returns
+            if (event->mask & IN_IGNORED) {
+                m_folderOfWatch.remove(event->wd);
+                m_watchOfFolder.remove(folder);
+                for (Root &root : m_roots) {
+                    if (root.path == folder) {
+                        root.armed = false;
+                    }
+                }
+                continue;
+            }
+
+            if (event->len == 0 || event->name[0] == '.') {
+                continue;
+            }
+            const QString path = folder + '/' + QFile::decodeName(event->name);
+
+            if (event->mask & IN_ISDIR) {
+                if (m_recursive && (event->mask & (IN_CREATE | IN_MOVED_TO))) {
+                    armFolder(path);
+                }
+            } else if ((event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+                       && GalleryWalker::isImageName(path)) {
+                queue(path);
+            }
+        }
+    }
+
+    // Events were lost: report everything again rather than guess
+    if (overflow) {
+        qWarning() << "inotify queue overflowed, re-reading the gallery folders";
+        for (Root &root : m_roots) {
+            disarm(root.path);
+            arm(root);
+        }
+    }
+#endif
+}
+
+void GalleryWatcher::check()
+{
+    for (Root &root : m_roots) {
+        quint64 device = 0;
+        if (!folderDevice(root.path, device)) {
+            // Unmounted, or the folder was deleted
+            if (root.armed) {
+                disarm(root.path);
+                root.armed = false;
+            }
+            continue;
+        }
+
+        // Back, or a card now mounted over the (empty) mount point whose
+        // folder was being watched
+        if (!root.armed || device != root.device) {
+            qCDebug(lcNami) << "Gallery folder (re)appeared:" << root.path;
+            disarm(root.path);
+            arm(root);
+        }
+    }
+
+    if (!usesInotify()) {
+        poll();
+    }
+}
+
+void GalleryWatcher::poll()
+{
+    // One pass over every root; new names in a folder are new photos.
+    // An edit in place leaves the folder's mtime alone and is only seen by
+    // the next scan.
+    GalleryWalker walker(m_listings);
+    QHash<QString, QStringList> reread;
+    for (const Root &root : m_roots) {
+        if (!root.armed) {
+            continue;
+        }
+        walker.walk(root.path, m_recursive, [&](const QString &folder, const QStringList &files) {
+            if (!walker.listed().contains(folder)) {
+                return true;  // unchanged since the last pass
+            }
+            const auto known = m_listings.constFind(folder);
+            const QSet<QString> knownNames = known != m_listings.constEnd()
+                ? known.value().images.toSet() : QSet<QString>();
+            QStringList names;
+            for (const QString &file : files) {
+                const QString name = file.mid(folder.size() + 1);
+                if (!knownNames.contains(name)) {
+                    queue(file);
+                }
+                names.append(name);
+            }
+            reread.insert(folder, names);
+            return true;
+        });
+    }
+
+    remember(walker, reread);
+}
+
+void GalleryWatcher::queue(const QString &path)
+{
+    if (m_pendingSet.contains(path)) {
+        return;
+    }
+    if (m_pending.isEmpty()) {
+        m_pendingAge.start();
+    }
+    m_pending.append(path);
+    m_pendingSet.insert(path);
+
+    if (m_pendingAge.elapsed() >= MAX_DELAY_MS) {
+        flush();
+    } else {
+        m_debounceTimer.start(DEBOUNCE_MS);
+    }
+}
+
+void GalleryWatcher::flush()
+{
+    m_debounceTimer.stop();
+    if (m_pending.isEmpty()) {
+        return;
+    }
+
+    const QStringList paths = m_pending;
+    m_pending.clear();
+    m_pendingSet.clear();
+    m_pendingAge.invalidate();
+    emit photosChanged(paths);
+}
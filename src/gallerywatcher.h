@@ -0,0 +1,105 @@
+#ifndef GALLERYWATCHER_H
+#define GALLERYWATCHER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <QTimer>
+#include <QVector>
+#include "gallerywalker.h"
+
+class QSocketNotifier;
+
+/**
+ * @brief Reports photos created or modified in the gallery folders
+ *
+ * inotify on every folder (IN_CLOSE_WRITE for files written in place,
+ * IN_MOVED_TO for the write-then-rename most camera apps do, IN_CREATE for
+ * new folders). Where inotify is missing or runs out of watches, the
+ * folders are polled instead: a GalleryWalker pass every CHECK_MS, which
+ * with its listing cache is one stat() per folder.
+ *
+ * Events are debounced: a burst of shots comes out as one photosChanged()
+ * once the folder has been quiet for DEBOUNCE_MS, or after MAX_DELAY_MS
+ * of continuous writes.
+ *
+ * What it reports are candidates, not necessarily new photos: arming a
+ * folder (watch(), a remounted SD card) reports every photo in it, so
+ * nothing written while nobody was watching is missed. The receiver
+ * checks them against the stored fingerprints.
+ */
+class GalleryWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr int DEBOUNCE_MS = 1500;
+    static constexpr int MAX_DELAY_MS = 10000;
+
+    // Remount check (a root that vanished, or now lives on another
+    // device), and the polling interval without inotify
+    static constexpr int CHECK_MS = 10000;
+
+    /**
+     * @param useInotify false polls even where inotify is available
+     */
+    explicit GalleryWatcher(bool useInotify = true, QObject *parent = nullptr);
+    ~GalleryWatcher();
+
+    /**
+     * @brief Start watching these folders, replacing any previous ones
+     * @param cache Folder listings already known (e.g. from the last scan),
+     *        so arming does not read every folder again
+     */
+    void watch(const QStringList &roots, bool recursive,
+               const QHash<QString, DirListing> &cache = QHash<QString, DirListing>());
+
+    void stop();
+
+    bool isActive() const { return !m_roots.isEmpty(); }
+    bool usesInotify() const { return m_inotifyFd >= 0; }
+
+signals:
+    void photosChanged(const QStringList &paths);
+
+private:
+    struct Root {
+        QString path;
+        quint64 device = 0;
+        bool armed = false;
+    };
+
+    void arm(Root &root);
+    void armFolder(const QString &folder);
+    void disarm(const QString &root);
+    void addWatch(const QString &folder);
+    void fallBackToPolling();
+    void readEvents();
+    void check();
+    void poll();
+    void remember(const GalleryWalker &walker, const QHash<QString, QStringList> &reread);
+    void queue(const QString &path);
+    void flush();
+
+    bool m_useInotify;
+    bool m_recursive;
+    QVector<Root> m_roots;
+
+    int m_inotifyFd;
+    QSocketNotifier *m_notifier;
+    QHash<int, QString> m_folderOfWatch;
+    QHash<QString, int> m_watchOfFolder;
+
+    // Listings seen by the last pass, to tell new files from known ones
+    QHash<QString, DirListing> m_listings;
+
+    QStringList m_pending;
+    QSet<QString> m_pendingSet;
+    QElapsedTimer m_pendingAge;
+    QTimer m_debounceTimer;
+    QTimer m_checkTimer;
+};
+
+#endif // GALLERYWATCHER_H
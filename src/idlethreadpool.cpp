@@ -0,0 +1,15 @@
+#include "idlethreadpool.h"
+
+#include <QThread>
+
+IdleThreadPool::IdleThreadPool(int maxThreads, QObject *parent)
+    : QThreadPool(parent)
+{
+    setMaxThreadCount(qMax(1, maxThreads));
+    setExpiryTimeout(-1);
+}
+
+void IdleThreadPool::enterIdle()
+{
+    QThread::currentThread()->setPriority(QThread::IdlePriority);
+}
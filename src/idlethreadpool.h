@@ -0,0 +1,37 @@
+#ifndef IDLETHREADPOOL_H
+#define IDLETHREADPOOL_H
+
+#include <QThreadPool>
+#include <QtConcurrent>
+
+/**
+ * @brief Thread pool for work that should only ever get otherwise idle CPU
+ *
+ * QThread::IdlePriority is SCHED_IDLE on Linux, and a later setPriority()
+ * only changes the priority within that policy: a thread once made idle
+ * stays idle. So the priority is only ever lowered on this pool's own
+ * threads, which run nothing else and are kept for the pool's lifetime,
+ * never on one borrowed from another pool.
+ */
+class IdleThreadPool : public QThreadPool
+{
+public:
+    explicit IdleThreadPool(int maxThreads = 1, QObject *parent = nullptr);
+
+    /**
+     * @brief QtConcurrent::run() on this pool, at idle priority
+     */
+    template <typename Functor>
+    auto run(Functor functor) -> QFuture<decltype(functor())>
+    {
+        return QtConcurrent::run(this, [functor]() {
+            enterIdle();
+            return functor();
+        });
+    }
+
+private:
+    static void enterIdle();
+};
+
+#endif // IDLETHREADPOOL_H
@@ -0,0 +1,42 @@
+#include "imageconvert.h"
+
+#include <opencv2/imgproc.hpp>
+
+cv::Mat qImageToBgrMat(const QImage &image)
+{
+    if (image.isNull()) {
+        return cv::Mat();
+    }
+
+    cv::Mat bgr;
+
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    if (image.format() == QImage::Format_RGB888) {
+        // R,G,B bytes: wrap, swap while copying
+        cv::Mat rgb(image.height(), image.width(), CV_8UC3,
+                    const_cast<uchar *>(image.constBits()), image.bytesPerLine());
+        cv::cvtColor(rgb, bgr, cv::COLOR_RGB2BGR);
+        return bgr;
+    }
+
+    // Premultiplied alpha would darken translucent pixels, so it goes
+    // through the conversion like any other format
+    const QImage source = (image.format() == QImage::Format_RGB32
+                           || image.format() == QImage::Format_ARGB32)
+        ? image
+        : image.convertToFormat(QImage::Format_RGB32);
+
+    // constBits() rather than bits(): no detach, the wrapped pixels are the
+    // decoder's own
+    cv::Mat bgra(source.height(), source.width(), CV_8UC4,
+                 const_cast<uchar *>(source.constBits()), source.bytesPerLine());
+    cv::cvtColor(bgra, bgr, cv::COLOR_BGRA2BGR);
+#else
+    const QImage rgb = image.convertToFormat(QImage::Format_RGB888);
+    cv::Mat rgbMat(rgb.height(), rgb.width(), CV_8UC3,
+                   const_cast<uchar *>(rgb.constBits()), rgb.bytesPerLine());
+    cv::cvtColor(rgbMat, bgr, cv::COLOR_RGB2BGR);
+#endif
+
+    return bgr;
+}
@@ -0,0 +1,22 @@
+#ifndef IMAGECONVERT_H
+#define IMAGECONVERT_H
+
+#include <QImage>
+#include <opencv2/core.hpp>
+
+/**
+ * @brief Convert a decoded QImage to the BGR cv::Mat OpenCV expects
+ *
+ * Decoders hand out Format_RGB32 (JPEG) or ARGB32 (PNG): 0xAARRGGBB words,
+ * i.e. B,G,R,A bytes on little-endian. Those are wrapped in a CV_8UC4
+ * header in place and turned into BGR with a single cvtColor pass - one
+ * full-frame copy, where convertToFormat(RGB888) + RGB2BGR made two.
+ * Qt 5.6 has no BGR888 format to decode into, so one copy is the floor.
+ *
+ * Other formats (and big-endian) go through one QImage conversion first.
+ *
+ * @return BGR image owning its data, empty for a null image
+ */
+cv::Mat qImageToBgrMat(const QImage &image);
+
+#endif // IMAGECONVERT_H
@@ -1,3 +1,4 @@
 #include "logging.h"
 
 Q_LOGGING_CATEGORY(lcNami, "nami.pipeline", QtWarningMsg)
+Q_LOGGING_CATEGORY(lcPerf, "nami.perf", QtWarningMsg)
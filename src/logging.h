@@ -7,4 +7,8 @@
 //   QT_LOGGING_RULES="nami.pipeline.debug=true" harbour-nami
 Q_DECLARE_LOGGING_CATEGORY(lcNami)
 
+// Stage timings of every scanned photo and a summary per scan:
+//   QT_LOGGING_RULES="nami.perf.debug=true" harbour-nami
+Q_DECLARE_LOGGING_CATEGORY(lcPerf)
+
 #endif // LOGGING_H
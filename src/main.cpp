@@ -18,6 +18,7 @@
 #include "facedatabase.h"
 #include "faceimageprovider.h"
 #include "logging.h"
+#include "tracer.h"
 
 #include <csignal>
 #include <cstring>
@@ -70,6 +71,9 @@ int main(int argc, char *argv[])
     app->setApplicationName("harbour-nami");
     app->setOrganizationName("harbour-nami");
 
+    // NAMI_TRACE=/path/trace.json: a timeline of the whole run (see Tracer)
+    Tracer::startFromEnvironment();
+
     // Create QML view
     QScopedPointer<QQuickView> view(new QQuickView);
 
@@ -102,6 +106,7 @@ int main(int argc, char *argv[])
 
     // Create face pipeline
     FacePipeline *pipeline = new FacePipeline(app.data());
+    pipeline->setDefaultGalleryPath(picturesDir);
 
     // Initialize pipeline
     bool initialized = pipeline->initialize(
@@ -150,5 +155,7 @@ int main(int argc, char *argv[])
     // Show view
     view->showFullScreen();
 
-    return app->exec();
+    const int result = app->exec();
+    Tracer::stop();
+    return result;
 }
@@ -0,0 +1,160 @@
+#include "modelcomparison.h"
+
+#include <QElapsedTimer>
+#include "facedetector.h"
+#include "facerecognizer.h"
+
+namespace {
+
+double overlap(const QRectF &a, const QRectF &b)
+{
+    const QRectF shared = a & b;
+    const double common = shared.width() * shared.height();
+    const double total = a.width() * a.height() + b.width() * b.height() - common;
+    return total > 0.0 ? common / total : 0.0;
+}
+
+double ms(qint64 us, int count)
+{
+    return count > 0 ? us / 1000.0 / count : 0.0;
+}
+
+} // namespace
+
+ModelComparison::ModelComparison(const ModelRegistry &registry)
+    : m_registry(registry)
+    , m_detectors{ nullptr, nullptr }
+    , m_recognizers{ nullptr, nullptr }
+    , m_warmedUp(false)
+    , m_photos(0)
+    , m_faces(0)
+    , m_facesInt8(0)
+    , m_foundByBoth(0)
+    , m_embedded(0)
+    , m_detectUs{ 0, 0 }
+    , m_embedUs{ 0, 0 }
+    , m_similaritySum(0.0)
+    , m_similarityMin(1.0)
+{
+}
+
+ModelComparison::~ModelComparison()
+{
+    for (int i = 0; i < 2; i++) {
+        delete m_detectors[i];
+        delete m_recognizers[i];
+    }
+}
+
+bool ModelComparison::load(QString *errorMessage)
+{
+    const ModelRegistry::Precision precisions[2] = { ModelRegistry::Fp32, ModelRegistry::Int8 };
+    for (int i = 0; i < 2; i++) {
+        const QString detectorPath = m_registry.path(ModelRegistry::Detector, precisions[i]);
+        const QString recognizerPath = m_registry.path(ModelRegistry::Recognizer, precisions[i]);
+        if (!m_registry.isAvailable(ModelRegistry::Detector, precisions[i])
+                || !m_registry.isAvailable(ModelRegistry::Recognizer, precisions[i])) {
+            *errorMessage = QString("Model files missing for %1").arg(ModelRegistry::precisionName(precisions[i]));
+            return false;
+        }
+
+        m_detectors[i] = new FaceDetector;
+        m_recognizers[i] = new FaceRecognizer;
+        if (!m_detectors[i]->loadModel(detectorPath) || !m_recognizers[i]->loadModel(recognizerPath)) {
+            *errorMessage = QString("Failed to load the %1 models").arg(ModelRegistry::precisionName(precisions[i]));
+            return false;
+        }
+    }
+    return true;
+}
+
+void ModelComparison::addPhoto(const cv::Mat &image)
+{
+    if (image.empty()) {
+        return;
+    }
+    m_photos++;
+
+    if (!m_warmedUp) {
+        const QSize aligned = m_recognizers[0]->inputSize();
+        const std::vector<cv::Mat> blank(1, cv::Mat::zeros(aligned.height(), aligned.width(), CV_8UC3));
+        for (int i = 0; i < 2; i++) {
+            m_detectors[i]->detect(image);
+            m_recognizers[i]->embedAligned(blank);
+        }
+        m_warmedUp = true;
+    }
+
+    QElapsedTimer timer;
+    QVector<FaceDetection> detections[2];
+    for (int i = 0; i < 2; i++) {
+        timer.start();
+        detections[i] = m_detectors[i]->detect(image);
+        m_detectUs[i] += timer.nsecsElapsed() / 1000;
+    }
+    m_faces += detections[0].size();
+    m_facesInt8 += detections[1].size();
+
+    for (const FaceDetection &face : detections[0]) {
+        for (const FaceDetection &other : detections[1]) {
+            if (overlap(face.bbox, other.bbox) >= MIN_IOU) {
+                m_foundByBoth++;
+                break;
+            }
+        }
+    }
+
+    // The same aligned crops for both, so only the networks differ
+    std::vector<cv::Mat> aligned;
+    for (const FaceDetection &face : detections[0]) {
+        const cv::Mat crop = m_recognizers[0]->alignFace(image, face);
+        if (!crop.empty()) {
+            aligned.push_back(crop);
+        }
+    }
+    if (aligned.empty()) {
+        return;
+    }
+
+    QVector<FaceEmbedding> embeddings[2];
+    for (int i = 0; i < 2; i++) {
+        timer.start();
+        embeddings[i] = m_recognizers[i]->embedAligned(aligned);
+        m_embedUs[i] += timer.nsecsElapsed() / 1000;
+    }
+
+    for (int f = 0; f < embeddings[0].size(); f++) {
+        if (embeddings[0][f].empty() || embeddings[1][f].empty()) {
+            continue;
+        }
+        const double similarity = FaceRecognizer::computeSimilarity(embeddings[0][f], embeddings[1][f]);
+        m_similaritySum += similarity;
+        m_similarityMin = qMin(m_similarityMin, similarity);
+        m_embedded++;
+    }
+}
+
+QVariantMap ModelComparison::result() const
+{
+    QVariantMap detector;
+    detector["fp32_ms"] = ms(m_detectUs[0], m_photos);
+    detector["int8_ms"] = ms(m_detectUs[1], m_photos);
+    detector["speedup"] = m_detectUs[1] > 0 ? double(m_detectUs[0]) / m_detectUs[1] : 0.0;
+    detector["faces_int8"] = m_facesInt8;
+    detector["found_by_both"] = m_foundByBoth;
+
+    QVariantMap recognizer;
+    recognizer["fp32_ms"] = ms(m_embedUs[0], m_embedded);
+    recognizer["int8_ms"] = ms(m_embedUs[1], m_embedded);
+    recognizer["speedup"] = m_embedUs[1] > 0 ? double(m_embedUs[0]) / m_embedUs[1] : 0.0;
+    recognizer["faces"] = m_embedded;
+    recognizer["mean_similarity"] = m_embedded > 0 ? m_similaritySum / m_embedded : 0.0;
+    recognizer["min_similarity"] = m_embedded > 0 ? m_similarityMin : 0.0;
+
+    QVariantMap result;
+    result["photos"] = m_photos;
+    result["faces"] = m_faces;
+    result["detector"] = detector;
+    result["recognizer"] = recognizer;
+    return result;
+}
@@ -0,0 +1,70 @@
+#ifndef MODELCOMPARISON_H
+#define MODELCOMPARISON_H
+
+#include <QVariantMap>
+#include <opencv2/core.hpp>
+#include "modelregistry.h"
+
+class FaceDetector;
+class FaceRecognizer;
+
+/**
+ * @brief FP32 against INT8 models on the user's own photos
+ *
+ * Every photo goes through both detectors; every face the FP32 detector
+ * finds is aligned once and embedded by both recognizers. Reports speed
+ * (per photo for detection, per face for embedding) and agreement: how
+ * many FP32 faces the INT8 detector also finds, and how similar the two
+ * embeddings of the same face are, on the app's rescaled similarity.
+ *
+ * Loads its own four networks, so it can run on a worker while the scan
+ * engines stay untouched. Not thread-safe.
+ */
+class ModelComparison
+{
+public:
+    // A face found by both detectors overlaps itself at least this much
+    static constexpr double MIN_IOU = 0.5;
+
+    explicit ModelComparison(const ModelRegistry &registry);
+    ~ModelComparison();
+
+    /**
+     * @brief Load both variants of both models
+     * @return false, with a reason, if any of them is missing or broken
+     */
+    bool load(QString *errorMessage);
+
+    /**
+     * @brief Run one photo (BGR, at detection size) through both variants
+     *
+     * The first one also runs untimed beforehand: a network's first
+     * forward pass sets up its layers and would count against it.
+     */
+    void addPhoto(const cv::Mat &image);
+
+    /**
+     * @return photos, faces, then per model fp32_ms, int8_ms and speedup,
+     *         plus detector faces_int8 and found_by_both, and recognizer
+     *         faces, mean_similarity and min_similarity
+     */
+    QVariantMap result() const;
+
+private:
+    ModelRegistry m_registry;
+    FaceDetector *m_detectors[2];
+    FaceRecognizer *m_recognizers[2];
+
+    bool m_warmedUp;
+    int m_photos;
+    int m_faces;             // found by the FP32 detector
+    int m_facesInt8;
+    int m_foundByBoth;
+    int m_embedded;          // faces embedded by both recognizers
+    qint64 m_detectUs[2];
+    qint64 m_embedUs[2];
+    double m_similaritySum;
+    double m_similarityMin;
+};
+
+#endif // MODELCOMPARISON_H
@@ -0,0 +1,47 @@
+#include "modelregistry.h"
+
+#include <QFileInfo>
+
+ModelRegistry::ModelRegistry(const QString &modelsDir)
+    : m_modelsDir(modelsDir)
+{
+}
+
+QString ModelRegistry::fileName(Kind kind, Precision precision)
+{
+    // OpenCV Zoo's names: the quantized copy gets an _int8 suffix
+    const QString base = kind == Detector ? QStringLiteral("face_detection_yunet_2023mar")
+                                          : QStringLiteral("face_recognition_sface_2021dec");
+    return base + (precision == Int8 ? QStringLiteral("_int8.onnx") : QStringLiteral(".onnx"));
+}
+
+QString ModelRegistry::modelId(Kind kind, Precision precision)
+{
+    return (kind == Detector ? QStringLiteral("yunet_2023mar_") : QStringLiteral("sface_2021dec_"))
+        + precisionName(precision);
+}
+
+ModelRegistry::Precision ModelRegistry::precisionFromString(const QString &name)
+{
+    return name == QLatin1String("int8") ? Int8 : Fp32;
+}
+
+QString ModelRegistry::precisionName(Precision precision)
+{
+    return precision == Int8 ? QStringLiteral("int8") : QStringLiteral("fp32");
+}
+
+QString ModelRegistry::path(Kind kind, Precision precision) const
+{
+    return m_modelsDir + '/' + fileName(kind, precision);
+}
+
+bool ModelRegistry::isAvailable(Kind kind, Precision precision) const
+{
+    return QFileInfo(path(kind, precision)).isFile();
+}
+
+ModelRegistry::Precision ModelRegistry::resolve(Kind kind, Precision requested) const
+{
+    return isAvailable(kind, requested) ? requested : Fp32;
+}
@@ -0,0 +1,61 @@
+#ifndef MODELREGISTRY_H
+#define MODELREGISTRY_H
+
+#include <QString>
+
+/**
+ * @brief The model files Nami can run, and where they are
+ *
+ * OpenCV Zoo ships YuNet and SFace in FP32 and as INT8-quantized copies of
+ * the same networks, which run much faster on ARM CPUs. Detector and
+ * recognizer are chosen separately ("detector_model", "recognizer_model").
+ *
+ * Both recognizer variants compute the same embedding up to quantization
+ * noise, with the same alignment and preprocessing, so their embeddings
+ * can be compared with each other: switching does not call for a rescan
+ * (FacePipeline::EMBEDDING_VERSION is about the computation, not the
+ * variant). How close they really come is what
+ * FacePipeline::compareModelVariants() measures; each face records the
+ * variant that produced its embedding (modelId()).
+ */
+class ModelRegistry
+{
+public:
+    enum Kind {
+        Detector,    // YuNet 2023mar
+        Recognizer   // SFace 2021dec
+    };
+
+    enum Precision {
+        Fp32,
+        Int8
+    };
+
+    explicit ModelRegistry(const QString &modelsDir = QString());
+
+    QString modelsDir() const { return m_modelsDir; }
+
+    static QString fileName(Kind kind, Precision precision);
+
+    /**
+     * @brief Stable name of a model, e.g. "sface_2021dec_int8"
+     */
+    static QString modelId(Kind kind, Precision precision);
+
+    static Precision precisionFromString(const QString &name);  // Fp32 if unknown
+    static QString precisionName(Precision precision);
+
+    QString path(Kind kind, Precision precision) const;
+    bool isAvailable(Kind kind, Precision precision) const;
+
+    /**
+     * @brief The variant to load for a request: itself if its file is
+     *        there, FP32 otherwise
+     */
+    Precision resolve(Kind kind, Precision requested) const;
+
+private:
+    QString m_modelsDir;
+};
+
+#endif // MODELREGISTRY_H
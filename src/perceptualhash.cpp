@@ -0,0 +1,29 @@
+#include "perceptualhash.h"
+
+#include <QtAlgorithms>
+
+quint64 PerceptualHash::dHash(const QImage &image)
+{
+    if (image.isNull()) {
+        return 0;
+    }
+
+    // Smooth scaling averages the source pixels, which is what keeps noise
+    // and JPEG artefacts out of the bits
+    const QImage small = image.scaled(9, 8, Qt::IgnoreAspectRatio, Qt::SmoothTransformation)
+                              .convertToFormat(QImage::Format_Grayscale8);
+
+    quint64 hash = 0;
+    for (int y = 0; y < 8; y++) {
+        const uchar *row = small.constScanLine(y);
+        for (int x = 0; x < 8; x++) {
+            hash = (hash << 1) | (row[x] > row[x + 1] ? 1 : 0);
+        }
+    }
+    return hash;
+}
+
+int PerceptualHash::distance(quint64 a, quint64 b)
+{
+    return qPopulationCount(a ^ b);
+}
@@ -0,0 +1,24 @@
+#ifndef PERCEPTUALHASH_H
+#define PERCEPTUALHASH_H
+
+#include <QImage>
+
+/**
+ * @brief 64-bit difference hash (dHash) of an image
+ *
+ * The image shrunk to 9x8 grey pixels, one bit per pair of horizontal
+ * neighbours: set when the left one is brighter. Survives re-encoding,
+ * scaling and small exposure changes, so two frames of a burst land a few
+ * bits apart while unrelated photos differ in about half of them.
+ */
+class PerceptualHash
+{
+public:
+    // 0 for a null image
+    static quint64 dHash(const QImage &image);
+
+    // Bits that differ
+    static int distance(quint64 a, quint64 b);
+};
+
+#endif // PERCEPTUALHASH_H
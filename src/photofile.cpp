@@ -0,0 +1,29 @@
+#include "photofile.h"
+#include "logging.h"
+
+#include <QFile>
+#include <limits>
+
+PhotoFile::PhotoFile(const QString &filePath)
+    : m_open(false)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    const qint64 size = file.size();
+    if (size <= 0 || size > std::numeric_limits<int>::max()) {
+        return;
+    }
+
+    // Short if the file shrank or the storage went away meanwhile
+    m_data = file.readAll();
+    if (m_data.size() != size) {
+        qCDebug(lcNami) << "Short read of" << filePath << ":" << m_data.size() << "of" << size << "bytes";
+        m_data.clear();
+        return;
+    }
+
+    m_open = true;
+}
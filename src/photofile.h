@@ -0,0 +1,43 @@
+#ifndef PHOTOFILE_H
+#define PHOTOFILE_H
+
+#include <QByteArray>
+#include <QString>
+
+/**
+ * @brief A photo's bytes, read from storage exactly once
+ *
+ * Hashing, EXIF parsing and decoding each used to open the file on their
+ * own, so every photo crossed the (often SD card) bus two and a half
+ * times. PhotoFile reads the file once and hands the same bytes to all
+ * three consumers.
+ *
+ * A plain read rather than a mapping: a card pulled out, or a file
+ * truncated, under a mapping is a SIGBUS in whichever worker touches the
+ * page, where read() just fails.
+ */
+class PhotoFile
+{
+public:
+    explicit PhotoFile(const QString &filePath);
+
+    bool isOpen() const { return m_open; }
+
+    /**
+     * @brief Whole file contents
+     */
+    const QByteArray &data() const { return m_data; }
+
+    /**
+     * @brief Bytes pulled from storage for this photo
+     */
+    qint64 bytesRead() const { return m_data.size(); }
+
+private:
+    Q_DISABLE_COPY(PhotoFile)
+
+    QByteArray m_data;
+    bool m_open;
+};
+
+#endif // PHOTOFILE_H
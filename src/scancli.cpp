@@ -0,0 +1,136 @@
+// harbour-nami-scan: the scan pipeline without the UI, for measuring scan
+// throughput on a desktop with the bundled models.
+//
+//   harbour-nami-scan --db /tmp/bench.db --models python/models ~/Pictures
+//
+// Prints one JSON object on stdout once the scan is over: photos and faces
+// per second, peak RSS, and the scan's counters and stage timings
+// (getScanStats()).
+// Built with -DBUILD_SCAN_CLI=ON; never installed.
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <QTimer>
+
+#include "facepipeline.h"
+#include "tracer.h"
+
+#include <sys/resource.h>
+
+namespace {
+
+// Largest resident set of the process so far, in KiB (Linux units)
+qint64 peakRssKb()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return -1;
+    }
+    return usage.ru_maxrss;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    // Its own QStandardPaths locations: never the app's data or cache
+    app.setApplicationName("harbour-nami-scan");
+    app.setOrganizationName("harbour-nami");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Scan photo folders into a Nami database and report throughput as JSON");
+    parser.addHelpOption();
+    parser.addPositionalArgument("folders", "Photo folders to scan", "<folder>...");
+    const QCommandLineOption dbOption("db", "Database to scan into (created if missing)", "path");
+    const QCommandLineOption modelsOption("models", "Folder with the YuNet and SFace models", "dir",
+                                          QCoreApplication::applicationDirPath() + "/../share/harbour-nami/models");
+    const QCommandLineOption forceOption("force", "Process photos already in the database again");
+    const QCommandLineOption flatOption("no-recursive", "Do not descend into subfolders");
+    const QCommandLineOption workersOption("workers", "Extraction workers (\"extraction_workers\" setting)", "n");
+    const QCommandLineOption profileOption("profile", "Scan profile: fast, balanced or background", "name");
+    const QCommandLineOption detectorOption("detector", "Detector variant: fp32 or int8", "precision");
+    const QCommandLineOption recognizerOption("recognizer", "Recognizer variant: fp32 or int8", "precision");
+    parser.addOptions({ dbOption, modelsOption, forceOption, flatOption, workersOption, profileOption,
+                        detectorOption, recognizerOption });
+    parser.process(app);
+
+    QTextStream err(stderr);
+    const QStringList folders = parser.positionalArguments();
+    if (folders.isEmpty() || !parser.isSet(dbOption)) {
+        err << "Need --db and at least one folder, see --help\n";
+        return 2;
+    }
+
+    const QString modelsDir = parser.value(modelsOption);
+    FacePipeline pipeline;
+    QObject::connect(&pipeline, &FacePipeline::error, [&err](const QString &message) {
+        err << "error: " << message << '\n';
+        err.flush();
+    });
+
+    if (!pipeline.initialize(modelsDir + "/face_detection_yunet_2023mar.onnx",
+                             modelsDir + "/face_recognition_sface_2021dec.onnx",
+                             QFileInfo(parser.value(dbOption)).absoluteFilePath())) {
+        err << "Failed to initialize the pipeline (models in " << QDir(modelsDir).absolutePath() << "?)\n";
+        return 1;
+    }
+
+    // Stored in the database like the app's settings: a benchmark database
+    // keeps them for the next run
+    if (parser.isSet(workersOption)) {
+        pipeline.setSetting("extraction_workers", parser.value(workersOption));
+    }
+    if (parser.isSet(profileOption)) {
+        pipeline.setSetting("scan_profile", parser.value(profileOption));
+    }
+    if (parser.isSet(detectorOption) && !pipeline.setSetting("detector_model", parser.value(detectorOption))) {
+        return 1;
+    }
+    if (parser.isSet(recognizerOption) && !pipeline.setSetting("recognizer_model", parser.value(recognizerOption))) {
+        return 1;
+    }
+
+    QElapsedTimer timer;
+    int exitCode = 0;
+
+    QObject::connect(&pipeline, &FacePipeline::scanCompleted, [&](int photos, int faces) {
+        const qint64 elapsedMs = qMax<qint64>(1, timer.elapsed());
+        QJsonObject report;
+        report["photos"] = photos;
+        report["faces"] = faces;
+        report["elapsed_ms"] = elapsedMs;
+        report["photos_per_second"] = photos * 1000.0 / elapsedMs;
+        report["faces_per_second"] = faces * 1000.0 / elapsedMs;
+        report["peak_rss_kb"] = peakRssKb();
+        report["stats"] = QJsonObject::fromVariantMap(pipeline.getScanStats());
+
+        QTextStream out(stdout);
+        out << QJsonDocument(report).toJson(QJsonDocument::Indented);
+        app.quit();
+    });
+    QObject::connect(&pipeline, &FacePipeline::scanFailed, [&](const QString &message) {
+        err << "Scan failed: " << message << '\n';
+        exitCode = 1;
+        app.quit();
+    });
+
+    // From the event loop, so a scan over nothing that completes at once
+    // still finds it running to quit
+    QTimer::singleShot(0, [&]() {
+        timer.start();
+        pipeline.scanGalleries(folders, !parser.isSet(flatOption), parser.isSet(forceOption));
+    });
+
+    // NAMI_TRACE=/path/trace.json records the whole run
+    Tracer::startFromEnvironment();
+    const int result = app.exec();
+    Tracer::stop();
+    return exitCode != 0 ? exitCode : result;
+}
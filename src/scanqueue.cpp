@@ -0,0 +1,95 @@
+#include "scanqueue.h"
+
+#include <QMutexLocker>
+#include <QVector>
+
+ScanQueue::ScanQueue(int capacity)
+    : m_capacity(qMax(1, capacity))
+    , m_urgentCount(0)
+    , m_closed(false)
+{
+}
+
+bool ScanQueue::push(const ScanItem &item)
+{
+    QMutexLocker locker(&m_mutex);
+    while (!m_closed && static_cast<int>(m_items.size()) >= m_capacity) {
+        m_notFull.wait(&m_mutex);
+    }
+    if (m_closed) {
+        return false;
+    }
+    m_items.emplace(item.priority, item);
+    return true;
+}
+
+bool ScanQueue::pushUrgent(ScanItem item)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_closed) {
+        return false;
+    }
+    item.priority = URGENT + ++m_urgentCount;
+    m_items.emplace(item.priority, item);
+    return true;
+}
+
+QSet<QString> ScanQueue::promote(const QSet<QString> &paths)
+{
+    QMutexLocker locker(&m_mutex);
+    QSet<QString> found;
+    if (paths.isEmpty()) {
+        return found;
+    }
+
+    // A linear pass: the queue holds a few hundred photos at most
+    QVector<ScanItem> moved;
+    for (auto it = m_items.begin(); it != m_items.end();) {
+        if (paths.contains(it->second.filePath)) {
+            found.insert(it->second.filePath);
+            moved.append(it->second);
+            it = m_items.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (ScanItem &item : moved) {
+        item.priority = URGENT + ++m_urgentCount;
+        m_items.emplace(item.priority, item);
+    }
+    return found;
+}
+
+bool ScanQueue::tryPop(ScanItem &item)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_items.empty()) {
+        return false;
+    }
+    item = m_items.begin()->second;
+    m_items.erase(m_items.begin());
+    m_notFull.wakeOne();
+    return true;
+}
+
+void ScanQueue::close()
+{
+    QMutexLocker locker(&m_mutex);
+    m_closed = true;
+    m_items.clear();
+    m_notFull.wakeAll();
+}
+
+void ScanQueue::reset()
+{
+    QMutexLocker locker(&m_mutex);
+    m_closed = false;
+    m_items.clear();
+    m_urgentCount = 0;
+}
+
+int ScanQueue::size() const
+{
+    QMutexLocker locker(&m_mutex);
+    return static_cast<int>(m_items.size());
+}
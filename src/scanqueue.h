@@ -0,0 +1,92 @@
+#ifndef SCANQUEUE_H
+#define SCANQUEUE_H
+
+#include <QMutex>
+#include <QSet>
+#include <QString>
+#include <QWaitCondition>
+#include <functional>
+#include <map>
+
+/**
+ * @brief A photo found by the walk, waiting for an extraction worker
+ */
+struct ScanItem {
+    QString filePath;
+    bool changed = false;  // processed before, edited since: redo it
+    qint64 priority = 0;   // higher first: the file's mtime, or URGENT and up
+
+    bool isUrgent() const;
+};
+
+/**
+ * @brief Bounded priority queue between the walk and the extraction workers
+ *
+ * The walk pushes from its worker thread and blocks while the queue is
+ * full, so a 40k-photo card is never held in memory as one list; the main
+ * thread pops whenever a worker is idle. close() makes pushes fail from
+ * then on, which is how a cancelled scan stops the walk.
+ *
+ * Items come out highest priority first, in push order among equals. The
+ * walk uses file mtimes, so what it has queued goes newest first; photos
+ * the user is looking at are pushed or promoted above everything else
+ * (URGENT), the last one first.
+ */
+class ScanQueue
+{
+public:
+    static constexpr qint64 URGENT = Q_INT64_C(1) << 62;
+
+    explicit ScanQueue(int capacity);
+
+    /**
+     * @brief Insert, waiting for room if the queue is full
+     * @return false once the queue is closed (the item is dropped)
+     */
+    bool push(const ScanItem &item);
+
+    /**
+     * @brief Insert ahead of everything queued, even if full; never blocks
+     * @return false once the queue is closed
+     */
+    bool pushUrgent(ScanItem item);
+
+    /**
+     * @brief Move the queued items with these paths ahead of everything
+     * @return The paths that were queued
+     */
+    QSet<QString> promote(const QSet<QString> &paths);
+
+    /**
+     * @brief Take the item with the highest priority, if any; never blocks
+     */
+    bool tryPop(ScanItem &item);
+
+    /**
+     * @brief Drop everything queued and fail all pushes, waiting or not
+     */
+    void close();
+
+    /**
+     * @brief Empty and open again, for the next scan
+     */
+    void reset();
+
+    int size() const;
+    bool isEmpty() const { return size() == 0; }
+
+private:
+    mutable QMutex m_mutex;
+    QWaitCondition m_notFull;
+    std::multimap<qint64, ScanItem, std::greater<qint64>> m_items;
+    const int m_capacity;
+    qint64 m_urgentCount;
+    bool m_closed;
+};
+
+inline bool ScanItem::isUrgent() const
+{
+    return priority >= ScanQueue::URGENT;
+}
+
+#endif // SCANQUEUE_H
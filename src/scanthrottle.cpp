@@ -0,0 +1,180 @@
+#include "scanthrottle.h"
+
+#include <QFile>
+#include <QThread>
+#include <algorithm>
+
+ScanThrottle::ScanThrottle(int cores)
+    : m_cores(qMax(1, cores > 0 ? cores : QThread::idealThreadCount()))
+    , m_profile(Balanced)
+    , m_maxWorkers(1)
+    , m_workers(1)
+    , m_loadSum(0.0)
+    , m_loadSamples(0)
+    , m_windowStartMs(0)
+    , m_slowWindows(0)
+    , m_holdUntilMs(0)
+    , m_probing(false)
+    , m_rateBeforeProbe(0.0)
+{
+}
+
+ScanThrottle::Profile ScanThrottle::profileFromString(const QString &name)
+{
+    if (name == QLatin1String("fast")) {
+        return Fast;
+    }
+    if (name == QLatin1String("background")) {
+        return Background;
+    }
+    return Balanced;
+}
+
+QString ScanThrottle::profileName(Profile profile)
+{
+    switch (profile) {
+    case Fast:
+        return QStringLiteral("fast");
+    case Background:
+        return QStringLiteral("background");
+    case Balanced:
+        break;
+    }
+    return QStringLiteral("balanced");
+}
+
+void ScanThrottle::start(Profile profile, int maxWorkers, qint64 nowMs)
+{
+    m_maxWorkers = qMax(1, maxWorkers);
+    m_bestMedian = QVector<qint64>(m_maxWorkers + 1, 0);
+    setProfile(profile, nowMs);
+}
+
+void ScanThrottle::setProfile(Profile profile, qint64 nowMs)
+{
+    // Start from the cap and back off: a scan on an idle phone should not
+    // spend its first minutes climbing
+    m_profile = profile;
+    m_probing = false;
+    change(workerCap(), nowMs);
+}
+
+int ScanThrottle::workerCap() const
+{
+    int cap = 1;
+    switch (m_profile) {
+    case Fast:
+        cap = m_cores - 1;  // the UI thread's core
+        break;
+    case Balanced:
+        cap = m_cores / 2;
+        break;
+    case Background:
+        break;
+    }
+    return qBound(1, cap, m_maxWorkers);
+}
+
+int ScanThrottle::cvThreads() const
+{
+    switch (m_profile) {
+    case Fast:
+        return qMax(1, m_cores / m_workers);
+    case Balanced:
+        return qMax(1, (m_cores - 1) / m_workers);
+    case Background:
+        break;
+    }
+    return 1;
+}
+
+double ScanThrottle::loadCeiling() const
+{
+    // More runnable threads than cores means someone waits for a CPU, and
+    // on a phone that someone is the UI as often as not
+    return m_profile == Fast ? 2.0 * m_cores : m_cores;
+}
+
+bool ScanThrottle::photoDone(qint64 extractMs, double load, qint64 nowMs)
+{
+    m_latencies.append(extractMs);
+    if (load >= 0.0) {
+        m_loadSum += load;
+        m_loadSamples++;
+    }
+
+    // Every worker contributes a couple of photos to a window. By value:
+    // qMax() takes references, which would need an out-of-line definition
+    const int windowPhotos = WINDOW_PHOTOS;
+    if (m_latencies.size() < qMax(windowPhotos, 2 * m_workers)) {
+        return false;
+    }
+
+    const double rate = m_latencies.size() * 1000.0 / qMax<qint64>(1, nowMs - m_windowStartMs);
+    std::sort(m_latencies.begin(), m_latencies.end());
+    const qint64 median = m_latencies[m_latencies.size() / 2];
+    const double windowLoad = m_loadSamples > 0 ? m_loadSum / m_loadSamples : -1.0;
+    m_latencies.clear();
+    m_loadSum = 0.0;
+    m_loadSamples = 0;
+    m_windowStartMs = nowMs;
+
+    const int before = m_workers;
+    const int threadsBefore = cvThreads();
+
+    qint64 &best = m_bestMedian[m_workers];
+    if (best == 0 || median < best) {
+        best = median;
+    }
+    m_slowWindows = median > best * THROTTLED_RATIO ? m_slowWindows + 1 : 0;
+
+    if (m_probing) {
+        // The extra worker has to pay for itself, or it goes again
+        m_probing = false;
+        if (rate < m_rateBeforeProbe * MIN_GAIN_RATIO) {
+            change(m_workers - 1, nowMs);
+            m_holdUntilMs = nowMs + BACKOFF_MS;
+            return true;
+        }
+    }
+
+    if (windowLoad > loadCeiling() && m_workers > 1) {
+        change(m_workers - 1, nowMs);
+    } else if (m_slowWindows >= 2 && m_workers > 1) {
+        change(m_workers - 1, nowMs);
+    } else if (m_workers < workerCap() && nowMs >= m_holdUntilMs
+               && (windowLoad < 0.0 || windowLoad + cvThreads() <= loadCeiling())) {
+        m_rateBeforeProbe = rate;
+        change(m_workers + 1, nowMs);
+        m_probing = true;
+    }
+
+    return m_workers != before || cvThreads() != threadsBefore;
+}
+
+void ScanThrottle::change(int workers, qint64 nowMs)
+{
+    m_workers = qBound(1, workers, workerCap());
+    m_slowWindows = 0;
+    m_latencies.clear();
+    m_loadSum = 0.0;
+    m_loadSamples = 0;
+    m_windowStartMs = nowMs;
+    m_holdUntilMs = nowMs + HOLD_MS;
+}
+
+double ScanThrottle::readLoad()
+{
+    // "0.52 0.58 0.59 3/1234 5678": the fourth field is runnable/total
+    QFile file(QStringLiteral("/proc/loadavg"));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return -1.0;
+    }
+    const QList<QByteArray> fields = file.readAll().split(' ');
+    if (fields.size() < 4) {
+        return -1.0;
+    }
+    bool ok = false;
+    const int runnable = fields[3].split('/').first().toInt(&ok);
+    return ok ? runnable : -1.0;
+}
@@ -0,0 +1,108 @@
+#ifndef SCANTHROTTLE_H
+#define SCANTHROTTLE_H
+
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief Decides how hard a scan runs: concurrent extractions and the
+ *        OpenCV threads each of them gets
+ *
+ * Fed one sample per finished photo (its extraction time and the system
+ * load at that moment), it decides once per window of WINDOW_PHOTOS photos:
+ *
+ * - Load above the profile's ceiling: one worker less. The UI thread is
+ *   what starves first when every core is busy with forward passes.
+ * - Photos getting slower at the same concurrency (window median more than
+ *   THROTTLED_RATIO above the best seen), twice in a row: the SoC is
+ *   throttling, one worker less. Fewer, cooler cores beat many throttled
+ *   ones on sustained throughput.
+ * - Otherwise, with headroom and after HOLD_MS without a change: one
+ *   worker more, kept only if the next window is at least MIN_GAIN_RATIO
+ *   faster in photos per second; if not, it is undone and the next try
+ *   waits BACKOFF_MS.
+ *
+ * Load is the number of runnable threads (/proc/loadavg), averaged over
+ * the window: the kernel's one-minute average trails a decision taken
+ * every few seconds by far too long.
+ *
+ * No clock or file access of its own beyond readLoad(), so it can be driven
+ * with made-up numbers in tests.
+ */
+class ScanThrottle
+{
+public:
+    enum Profile {
+        Fast,        // every core: the phone is left alone while it scans
+        Balanced,    // a core and some headroom left to the UI
+        Background   // one worker, one thread, idle priority
+    };
+
+    static constexpr int WINDOW_PHOTOS = 8;
+    static constexpr int HOLD_MS = 20000;
+    static constexpr int BACKOFF_MS = 120000;
+    static constexpr double THROTTLED_RATIO = 1.3;
+    static constexpr double MIN_GAIN_RATIO = 1.08;
+
+    explicit ScanThrottle(int cores = 0);
+
+    static Profile profileFromString(const QString &name);  // Balanced if unknown
+    static QString profileName(Profile profile);
+
+    /**
+     * @brief Start a scan
+     * @param maxWorkers Extraction engines available
+     */
+    void start(Profile profile, int maxWorkers, qint64 nowMs);
+
+    /**
+     * @brief Switch profile mid-scan; applies at once
+     */
+    void setProfile(Profile profile, qint64 nowMs);
+
+    /**
+     * @brief One photo done
+     * @param load Runnable threads right now, negative if unknown
+     * @return true if workers() or cvThreads() changed
+     */
+    bool photoDone(qint64 extractMs, double load, qint64 nowMs);
+
+    Profile profile() const { return m_profile; }
+    int workers() const { return m_workers; }
+    int cvThreads() const;
+
+    // Most workers the profile allows on this machine
+    int workerCap() const;
+
+    // Above this, the scan backs off
+    double loadCeiling() const;
+
+    /**
+     * @brief Runnable threads on the system (/proc/loadavg), -1 if unknown
+     */
+    static double readLoad();
+
+private:
+    void change(int workers, qint64 nowMs);
+
+    const int m_cores;
+    Profile m_profile;
+    int m_maxWorkers;
+    int m_workers;
+
+    // Current window
+    QVector<qint64> m_latencies;
+    double m_loadSum;
+    int m_loadSamples;
+    qint64 m_windowStartMs;
+
+    // Best (lowest) window median per worker count, to notice throttling
+    QVector<qint64> m_bestMedian;
+    int m_slowWindows;
+
+    qint64 m_holdUntilMs;           // no worker added before then
+    bool m_probing;                  // just added a worker, checking it pays
+    double m_rateBeforeProbe;        // photos/s before it
+};
+
+#endif // SCANTHROTTLE_H
@@ -0,0 +1,87 @@
+#include "stagetimings.h"
+
+#include <algorithm>
+
+StageTimings::StageTimings()
+    : m_series(StageCount)
+{
+}
+
+QString StageTimings::stageName(Stage stage)
+{
+    switch (stage) {
+    case Read:
+        return QStringLiteral("read");
+    case Hash:
+        return QStringLiteral("hash");
+    case Decode:
+        return QStringLiteral("decode");
+    case Convert:
+        return QStringLiteral("convert");
+    case Detect:
+        return QStringLiteral("detect");
+    case Quality:
+        return QStringLiteral("quality");
+    case Embed:
+        return QStringLiteral("embed");
+    case Commit:
+        return QStringLiteral("commit");
+    case StageCount:
+        break;
+    }
+    return QString();
+}
+
+void StageTimings::add(Stage stage, qint64 us)
+{
+    Series &series = m_series[stage];
+    if (series.window.size() < WINDOW) {
+        series.window.append(us);
+    } else {
+        series.window[series.count % WINDOW] = us;
+    }
+    series.count++;
+    series.totalUs += us;
+}
+
+void StageTimings::clear()
+{
+    m_series = QVector<Series>(StageCount);
+}
+
+StageTimings::Summary StageTimings::summary(Stage stage) const
+{
+    const Series &series = m_series[stage];
+    Summary summary;
+    summary.count = series.count;
+    summary.totalUs = series.totalUs;
+    if (series.window.isEmpty()) {
+        return summary;
+    }
+
+    // Nearest rank on a sorted copy: a few hundred samples, a few times a
+    // second at most
+    QVector<qint64> sorted = series.window;
+    std::sort(sorted.begin(), sorted.end());
+    const int last = sorted.size() - 1;
+    summary.p50Us = sorted[last * 50 / 100];
+    summary.p95Us = sorted[last * 95 / 100];
+    summary.maxUs = sorted[last];
+    return summary;
+}
+
+QVariantMap StageTimings::toVariantMap() const
+{
+    QVariantMap stages;
+    for (int i = 0; i < StageCount; i++) {
+        const Summary s = summary(static_cast<Stage>(i));
+        QVariantMap stage;
+        stage["count"] = s.count;
+        stage["total_ms"] = s.totalUs / 1000.0;
+        stage["p50_ms"] = s.p50Us / 1000.0;
+        stage["p95_ms"] = s.p95Us / 1000.0;
+        stage["max_ms"] = s.maxUs / 1000.0;
+        stages[stageName(static_cast<Stage>(i))] = stage;
+    }
+    return stages;
+}
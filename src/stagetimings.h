@@ -0,0 +1,66 @@
+#ifndef STAGETIMINGS_H
+#define STAGETIMINGS_H
+
+#include <QVariantMap>
+#include <QVector>
+
+/**
+ * @brief Where a scan's time goes, stage by stage
+ *
+ * Keeps the last WINDOW samples of each stage for rolling percentiles (so
+ * a phone that starts throttling halfway through shows up), plus count
+ * and total over the whole scan for each stage's share.
+ *
+ * Samples are in microseconds: hashing a photo or embedding one face takes
+ * a few milliseconds, and whole milliseconds would round most of it away.
+ */
+class StageTimings
+{
+public:
+    enum Stage {
+        Read,       // the file into memory
+        Hash,       // SHA-256 of it
+        Decode,     // JPEG to the detector's size, plus EXIF
+        Convert,    // QImage to cv::Mat
+        Detect,     // YuNet
+        Quality,    // FaceQuality gate, including the alignment of faces it drops
+        Embed,      // SFace, one sample per face (with its crop re-read)
+        Commit,     // the photo's rows, inside the open batch
+        StageCount
+    };
+
+    static constexpr int WINDOW = 256;
+
+    struct Summary {
+        int count = 0;          // whole scan
+        qint64 totalUs = 0;     // whole scan
+        qint64 p50Us = 0;       // last WINDOW samples
+        qint64 p95Us = 0;
+        qint64 maxUs = 0;
+    };
+
+    StageTimings();
+
+    static QString stageName(Stage stage);
+
+    void add(Stage stage, qint64 us);
+    void clear();
+
+    Summary summary(Stage stage) const;
+
+    /**
+     * @brief One map per stage name: count, total_ms, p50_ms, p95_ms, max_ms
+     */
+    QVariantMap toVariantMap() const;
+
+private:
+    struct Series {
+        QVector<qint64> window;     // ring, next at count % WINDOW
+        int count = 0;
+        qint64 totalUs = 0;
+    };
+
+    QVector<Series> m_series;
+};
+
+#endif // STAGETIMINGS_H
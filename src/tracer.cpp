@@ -0,0 +1,150 @@
+#include "tracer.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSet>
+#include <QThread>
+#include "logging.h"
+
+#ifdef Q_OS_LINUX
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+QAtomicInt Tracer::s_enabled;
+
+namespace {
+
+// Written out once this much has piled up
+const int FLUSH_BYTES = 64 * 1024;
+
+struct TraceState {
+    QMutex mutex;
+    QFile file;
+    QByteArray buffer;
+    QElapsedTimer clock;
+    QSet<qint64> namedThreads;  // thread_name metadata already written
+    qint64 pid = 0;
+    bool first = true;
+};
+
+Q_GLOBAL_STATIC(TraceState, traceState)
+
+// The kernel's thread id, as perf and top show it
+qint64 currentThreadId()
+{
+#ifdef Q_OS_LINUX
+    static thread_local const qint64 tid = ::syscall(SYS_gettid);
+    return tid;
+#else
+    return reinterpret_cast<qint64>(QThread::currentThreadId());
+#endif
+}
+
+QByteArray threadName()
+{
+    QThread *thread = QThread::currentThread();
+    if (QCoreApplication::instance() && thread == QCoreApplication::instance()->thread()) {
+        return "main";
+    }
+    const QString name = thread ? thread->objectName() : QString();
+    return name.isEmpty() ? QByteArray("worker") : name.toUtf8().replace('"', '\'').replace('\\', '/');
+}
+
+// Caller holds the mutex
+void append(TraceState &state, const QByteArray &event)
+{
+    state.buffer += state.first ? "\n" : ",\n";
+    state.buffer += event;
+    state.first = false;
+    if (state.buffer.size() >= FLUSH_BYTES) {
+        state.file.write(state.buffer);
+        state.buffer.clear();
+    }
+}
+
+} // namespace
+
+bool Tracer::start(const QString &filePath)
+{
+    stop();
+
+    TraceState &state = *traceState;
+    QMutexLocker locker(&state.mutex);
+    state.file.setFileName(filePath);
+    if (!state.file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Cannot write trace file" << filePath << ":" << state.file.errorString();
+        return false;
+    }
+    state.file.write("[");
+    state.buffer.clear();
+    state.namedThreads.clear();
+    state.first = true;
+    state.pid = QCoreApplication::applicationPid();
+    state.clock.start();
+
+    s_enabled.store(1);
+    qCDebug(lcNami) << "Tracing to" << filePath;
+    return true;
+}
+
+void Tracer::stop()
+{
+    TraceState &state = *traceState;
+    QMutexLocker locker(&state.mutex);
+    s_enabled.store(0);
+    if (!state.file.isOpen()) {
+        return;
+    }
+    state.buffer += "\n]\n";
+    state.file.write(state.buffer);
+    state.buffer.clear();
+    state.file.close();
+}
+
+bool Tracer::startFromEnvironment()
+{
+    const QString path = QString::fromLocal8Bit(qgetenv("NAMI_TRACE"));
+    return !path.isEmpty() && start(path);
+}
+
+QString Tracer::filePath()
+{
+    TraceState &state = *traceState;
+    QMutexLocker locker(&state.mutex);
+    return state.file.isOpen() ? state.file.fileName() : QString();
+}
+
+qint64 Tracer::nowUs()
+{
+    // Read-only once started: safe from any thread
+    return traceState->clock.nsecsElapsed() / 1000;
+}
+
+void Tracer::complete(const char *category, const char *name, qint64 startUs, qint64 durationUs)
+{
+    const qint64 tid = currentThreadId();
+
+    TraceState &state = *traceState;
+    QMutexLocker locker(&state.mutex);
+    if (!state.file.isOpen()) {
+        return;  // stopped while the span was open
+    }
+
+    if (!state.namedThreads.contains(tid)) {
+        state.namedThreads.insert(tid);
+        append(state, QByteArray("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":") + QByteArray::number(state.pid)
+                      + ",\"tid\":" + QByteArray::number(tid)
+                      + ",\"args\":{\"name\":\"" + threadName() + "\"}}");
+    }
+
+    append(state, QByteArray("{\"name\":\"") + name + "\",\"cat\":\"" + category
+                  + "\",\"ph\":\"X\",\"ts\":" + QByteArray::number(startUs)
+                  + ",\"dur\":" + QByteArray::number(durationUs)
+                  + ",\"pid\":" + QByteArray::number(state.pid)
+                  + ",\"tid\":" + QByteArray::number(tid) + '}');
+}
@@ -0,0 +1,92 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QAtomicInt>
+#include <QString>
+
+/**
+ * @brief Opt-in timeline of what every thread is doing, as Chrome
+ *        trace_event JSON (open it in https://ui.perfetto.dev)
+ *
+ * Spans come from TRACE_SCOPE / TRACE_FUNCTION guards in the pipeline, the
+ * models, the database and the image provider, each with the id of the
+ * thread it ran on, so the UI thread waiting on a worker (or SQLite
+ * holding up the UI) shows as such.
+ *
+ * Off, a guard costs one relaxed atomic load. On, events are buffered and
+ * written out in chunks; the file is valid JSON after stop(), and still
+ * loads in Perfetto without it (the array format's closing bracket is
+ * optional).
+ *
+ * Started for the whole run by NAMI_TRACE=<file> in the environment, or
+ * for each scan by the "trace_scans" setting.
+ */
+class Tracer
+{
+public:
+    static bool isEnabled() { return s_enabled.load() != 0; }
+
+    /**
+     * @brief Start writing to filePath, replacing any trace in progress
+     */
+    static bool start(const QString &filePath);
+    static void stop();
+
+    // NAMI_TRACE, if set
+    static bool startFromEnvironment();
+
+    static QString filePath();
+
+    // Microseconds on the trace's clock
+    static qint64 nowUs();
+
+    /**
+     * @brief One finished span; name and category must outlive the trace
+     *        (string literals, __func__)
+     */
+    static void complete(const char *category, const char *name, qint64 startUs, qint64 durationUs);
+
+private:
+    static QAtomicInt s_enabled;
+};
+
+/**
+ * @brief Records the span from its construction to its destruction
+ */
+class TraceScope
+{
+public:
+    TraceScope(const char *category, const char *name)
+        : m_category(category)
+        , m_name(Tracer::isEnabled() ? name : nullptr)
+        , m_startUs(m_name ? Tracer::nowUs() : 0)
+    {
+    }
+
+    ~TraceScope()
+    {
+        if (m_name) {
+            Tracer::complete(m_category, m_name, m_startUs, Tracer::nowUs() - m_startUs);
+        }
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    const char *m_category;
+    const char *m_name;
+    qint64 m_startUs;
+};
+
+#define NAMI_TRACE_CONCAT_(a, b) a##b
+#define NAMI_TRACE_CONCAT(a, b) NAMI_TRACE_CONCAT_(a, b)
+
+// A span named name, until the end of the enclosing block
+#define TRACE_SCOPE(category, name) \
+    TraceScope NAMI_TRACE_CONCAT(traceScope_, __LINE__)(category, name)
+
+// A span named after the enclosing function
+#define TRACE_FUNCTION(category) TRACE_SCOPE(category, __func__)
+
+#endif // TRACER_H
@@ -0,0 +1,139 @@
+// Tests for burst detection. A frame of a burst takes its faces from the
+// one before it without running the models, so a false match costs wrong
+// people on a photo: only the same scene, at the same size, moments apart
+// may match.
+
+#include <QtTest>
+#include <QImage>
+#include <QPainter>
+
+#include "burstindex.h"
+#include "perceptualhash.h"
+
+namespace {
+
+// A scene with some structure: a gradient and a few boxes
+QImage scene(int width, int height, int shift = 0)
+{
+    QImage image(width, height, QImage::Format_RGB32);
+    for (int y = 0; y < height; y++) {
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < width; x++) {
+            const int v = (x * 255) / width;
+            line[x] = qRgb(v, v / 2, 255 - v);
+        }
+    }
+    QPainter painter(&image);
+    painter.fillRect(width / 5 + shift, height / 4, width / 6, height / 3, Qt::white);
+    painter.fillRect(width / 2 + shift, height / 2, width / 5, height / 4, Qt::black);
+    return image;
+}
+
+BurstIndex::Frame frame(const QString &path, qint64 takenMs, quint64 dhash, const QSize &size)
+{
+    BurstIndex::Frame frame;
+    frame.filePath = path;
+    frame.takenMs = takenMs;
+    frame.dhash = dhash;
+    frame.size = size;
+    frame.faces.append(ExtractedFace{ QRectF(0.2, 0.2, 0.1, 0.1), 0.9f, FaceEmbedding(128, 0.5f) });
+    return frame;
+}
+
+const QSize SIZE(4000, 3000);
+
+} // namespace
+
+class TstBurstIndex : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void hashIgnoresScaleAndSmallChanges();
+    void hashTellsScenesApart();
+    void matchesNearbyFrame();
+    void rejectsOtherSizeTimeOrScene();
+    void prefersClosestFrame();
+    void dropsOldestWhenFull();
+};
+
+void TstBurstIndex::hashIgnoresScaleAndSmallChanges()
+{
+    const quint64 full = PerceptualHash::dHash(scene(800, 600));
+    QVERIFY(full != 0);
+    QVERIFY(PerceptualHash::distance(full, PerceptualHash::dHash(scene(400, 300))) <= BurstIndex::MAX_DISTANCE);
+    // A couple of pixels' movement, as between two shots of a burst
+    QVERIFY(PerceptualHash::distance(full, PerceptualHash::dHash(scene(800, 600, 3))) <= BurstIndex::MAX_DISTANCE);
+    QCOMPARE(PerceptualHash::dHash(QImage()), quint64(0));
+}
+
+void TstBurstIndex::hashTellsScenesApart()
+{
+    const quint64 a = PerceptualHash::dHash(scene(800, 600));
+    const quint64 b = PerceptualHash::dHash(scene(800, 600).mirrored(true, false));
+    QVERIFY(PerceptualHash::distance(a, b) > BurstIndex::MAX_DISTANCE);
+    QCOMPARE(PerceptualHash::distance(a, a), 0);
+    QCOMPARE(PerceptualHash::distance(0, ~quint64(0)), 64);
+}
+
+void TstBurstIndex::matchesNearbyFrame()
+{
+    BurstIndex index;
+    index.add(frame("a.jpg", 1000000, 0xF0F0F0F0F0F0F0F0ULL, SIZE));
+
+    BurstIndex::Frame match;
+    QVERIFY(index.find(1000400, 0xF0F0F0F0F0F0F0F1ULL, SIZE, &match));
+    QCOMPARE(match.filePath, QString("a.jpg"));
+    QCOMPARE(match.faces.size(), 1);
+    QCOMPARE(match.faces[0].embedding.size(), size_t(128));
+}
+
+void TstBurstIndex::rejectsOtherSizeTimeOrScene()
+{
+    BurstIndex index;
+    const quint64 hash = 0xF0F0F0F0F0F0F0F0ULL;
+    index.add(frame("a.jpg", 1000000, hash, SIZE));
+
+    BurstIndex::Frame match;
+    QVERIFY(!index.find(1000400, hash, QSize(3000, 4000), &match));
+    QVERIFY(!index.find(1000000 + BurstIndex::WINDOW_MS + 1, hash, SIZE, &match));
+    QVERIFY(!index.find(1000400, hash ^ 0xFFULL, SIZE, &match));
+    // Earlier shots count too: a scan does not go in shooting order
+    QVERIFY(index.find(1000000 - 500, hash, SIZE, &match));
+}
+
+void TstBurstIndex::prefersClosestFrame()
+{
+    BurstIndex index;
+    const quint64 hash = 0xF0F0F0F0F0F0F0F0ULL;
+    index.add(frame("far.jpg", 1000000, hash ^ 0x3ULL, SIZE));
+    index.add(frame("near.jpg", 1005000, hash ^ 0x1ULL, SIZE));
+    index.add(frame("late.jpg", 1009000, hash ^ 0x1ULL, SIZE));
+
+    BurstIndex::Frame match;
+    QVERIFY(index.find(1006000, hash, SIZE, &match));
+    QCOMPARE(match.filePath, QString("near.jpg"));
+}
+
+void TstBurstIndex::dropsOldestWhenFull()
+{
+    BurstIndex index;
+    for (int i = 0; i < BurstIndex::CAPACITY + 1; i++) {
+        // Only the first frame looks like that
+        const quint64 hash = i == 0 ? ~quint64(0) : 0;
+        index.add(frame(QString("%1.jpg").arg(i), 1000000 + i, hash, SIZE));
+    }
+    QCOMPARE(index.size(), BurstIndex::CAPACITY);
+
+    BurstIndex::Frame match;
+    QVERIFY(!index.find(1000000, ~quint64(0), SIZE, &match));
+    QVERIFY(index.find(1000000, 0, SIZE, &match));
+    QCOMPARE(match.filePath, QString("1.jpg"));
+
+    index.clear();
+    QCOMPARE(index.size(), 0);
+}
+
+QTEST_GUILESS_MAIN(TstBurstIndex)
+
+#include "tst_burstindex.moc"
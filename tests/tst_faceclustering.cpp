@@ -0,0 +1,149 @@
+// Tests for the clustering behind "group unknown faces". A bad grouping
+// is costly: every wrong merge is a person the user has to pull apart by
+// hand, every split one they have to merge. Synthetic identities stand in
+// for people: faces of one identity are noisy copies of the same vector.
+
+#include <QtTest>
+#include <QHash>
+#include <cmath>
+
+#include "faceclustering.h"
+
+namespace {
+
+FaceEmbedding unitVector(int dim, quint32 seed)
+{
+    // Small LCG: deterministic without pulling in <random>
+    FaceEmbedding v(dim);
+    float norm = 0.0f;
+    for (int i = 0; i < dim; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        v[i] = static_cast<float>(seed >> 8) / (1 << 24) - 0.5f;
+        norm += v[i] * v[i];
+    }
+    for (float &x : v) {
+        x /= std::sqrt(norm);
+    }
+    return v;
+}
+
+FaceEmbedding nearby(const FaceEmbedding &identity, quint32 seed, float noise)
+{
+    const FaceEmbedding jitter = unitVector(identity.size(), seed);
+    FaceEmbedding v(identity.size());
+    float norm = 0.0f;
+    for (size_t i = 0; i < v.size(); i++) {
+        v[i] = identity[i] + noise * jitter[i];
+        norm += v[i] * v[i];
+    }
+    for (float &x : v) {
+        x /= std::sqrt(norm);
+    }
+    return v;
+}
+
+// people identities with facesEach faces each, then strangers lone faces.
+// personOf maps face id -> identity (-1 for strangers).
+QVector<QPair<int, FaceEmbedding>> makeFaces(int people, int facesEach, int strangers,
+                                             QHash<int, int> &personOf)
+{
+    QVector<QPair<int, FaceEmbedding>> faces;
+    for (int p = 0; p < people; p++) {
+        const FaceEmbedding identity = unitVector(128, p + 1);
+        for (int f = 0; f < facesEach; f++) {
+            const int faceId = faces.size() + 1;
+            faces.append(qMakePair(faceId, nearby(identity, 100000 + faceId, 0.6f)));
+            personOf.insert(faceId, p);
+        }
+    }
+    for (int s = 0; s < strangers; s++) {
+        const int faceId = faces.size() + 1;
+        faces.append(qMakePair(faceId, unitVector(128, 900000 + s)));
+        personOf.insert(faceId, -1);
+    }
+    return faces;
+}
+
+} // namespace
+
+class TstFaceClustering : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void groupsEachIdentityOnce();
+    void leavesLoneFacesOut();
+    void sameResultOnAnyThreadCount();
+    void emptyInputGivesNoGroups();
+    void benchmarkTenThousandFaces();
+};
+
+void TstFaceClustering::groupsEachIdentityOnce()
+{
+    QHash<int, int> personOf;
+    const QVector<QPair<int, FaceEmbedding>> faces = makeFaces(300, 6, 0, personOf);
+    const FaceClustering::Result result = FaceClustering::cluster(faces, 0.7f);
+
+    QCOMPARE(result.faces, faces.size());
+    QCOMPARE(result.groups.size(), 300);
+    for (const QVector<int> &group : result.groups) {
+        QCOMPARE(group.size(), 6);
+        for (int faceId : group) {
+            QCOMPARE(personOf.value(faceId), personOf.value(group.first()));
+        }
+    }
+}
+
+void TstFaceClustering::leavesLoneFacesOut()
+{
+    QHash<int, int> personOf;
+    const QVector<QPair<int, FaceEmbedding>> faces = makeFaces(20, 4, 30, personOf);
+
+    const FaceClustering::Result pairs = FaceClustering::cluster(faces, 0.7f, 2);
+    QCOMPARE(pairs.groups.size(), 20);
+    for (const QVector<int> &group : pairs.groups) {
+        QVERIFY(personOf.value(group.first()) >= 0);
+    }
+
+    // minGroupSize 1 keeps every face, strangers as groups of one
+    const FaceClustering::Result all = FaceClustering::cluster(faces, 0.7f, 1);
+    QCOMPARE(all.groups.size(), 50);
+    QCOMPARE(all.groups.last().size(), 1);
+}
+
+void TstFaceClustering::sameResultOnAnyThreadCount()
+{
+    QHash<int, int> personOf;
+    const QVector<QPair<int, FaceEmbedding>> faces = makeFaces(200, 5, 50, personOf);
+
+    const FaceClustering::Result one = FaceClustering::cluster(faces, 0.7f, 2, 1);
+    const FaceClustering::Result many = FaceClustering::cluster(faces, 0.7f, 2, 4);
+    QCOMPARE(one.edges, many.edges);
+    QCOMPARE(one.groups, many.groups);
+}
+
+void TstFaceClustering::emptyInputGivesNoGroups()
+{
+    const FaceClustering::Result result =
+        FaceClustering::cluster(QVector<QPair<int, FaceEmbedding>>(), 0.7f);
+    QCOMPARE(result.faces, 0);
+    QVERIFY(result.groups.isEmpty());
+}
+
+// 1000 people x 10 faces: the old seed-and-absorb loop compared ~50M pairs
+void TstFaceClustering::benchmarkTenThousandFaces()
+{
+    QHash<int, int> personOf;
+    const QVector<QPair<int, FaceEmbedding>> faces = makeFaces(1000, 10, 0, personOf);
+
+    FaceClustering::Result result;
+    QBENCHMARK_ONCE {
+        result = FaceClustering::cluster(faces, 0.7f);
+    }
+    QVERIFY(result.groups.size() >= 990);
+    QVERIFY(result.groups.size() <= 1010);
+}
+
+QTEST_APPLESS_MAIN(TstFaceClustering)
+
+#include "tst_faceclustering.moc"
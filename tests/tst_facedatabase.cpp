@@ -9,6 +9,10 @@
 #include <QJsonArray>
 #include <QDateTime>
 #include <QFile>
+#include <QDataStream>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <cmath>
 
 #include "facedatabase.h"
 
@@ -33,8 +37,31 @@ private slots:
     void prunesPhotosDeletedFromDisk();
     void keepsPhotosWhoseWholeFolderIsGone();
     void personPhotosJoinKeepsTheBestFacePerPhoto();
+    void storesEmbeddingsAsRawFloat32();
+    void migratesLegacyEmbeddingBlobsOnOpen();
+    void quantizedStorageStaysCloseToTheOriginal();
+    void groupsOnlyClaimFacesThatAreStillUnmapped();
+    void groupsLeftTooSmallCreateNoOne();
+    void residentEmbeddingsFollowEveryWrite();
+    void negativeMatchesStayInSyncInMemory();
+    void batchAssignSkipsFacesTakenMeanwhile();
+    void nestedTransactionsRollBackOnTheirOwn();
+    void fingerprintsFlagEditedPhotosOnly();
+    void scannedFoldersRoundTrip();
+    void scanCheckpointKeepsOrderAndDropsCommitted();
+    void processedSinceLeavesEarlierPhotosDue();
+    void copiesAreFoundByHashOnceProcessed();
+    void facesRecordTheirEmbeddingModel();
+    void burstFramesComeBackFromTheDatabase();
 
 private:
+    // Ids of unmapped faces, from the resident store and from SQL
+    QSet<int> residentUnmappedIds();
+    QSet<int> queriedUnmappedIds();
+
+    // The embedding BLOB of a face, read behind FaceDatabase's back
+    QByteArray rawEmbedding(int faceId);
+
     // A photo file has to exist on disk for the import to accept it
     QString makePhotoFile(const QString &name);
     int addPhotoWithFace(const QString &name, const QDateTime &taken,
@@ -72,6 +99,45 @@ QString TstFaceDatabase::makePhotoFile(const QString &name)
     return path;
 }
 
+QByteArray TstFaceDatabase::rawEmbedding(int faceId)
+{
+    QByteArray blob;
+    {
+        QSqlDatabase raw = QSqlDatabase::addDatabase("QSQLITE", "raw");
+        raw.setDatabaseName(m_dir->filePath("test.db"));
+        if (raw.open()) {
+            QSqlQuery query(raw);
+            query.prepare("SELECT embedding FROM faces WHERE id = :id");
+            query.bindValue(":id", faceId);
+            if (query.exec() && query.next()) {
+                blob = query.value(0).toByteArray();
+            }
+        }
+        raw.close();
+    }
+    QSqlDatabase::removeDatabase("raw");
+    return blob;
+}
+
+QSet<int> TstFaceDatabase::residentUnmappedIds()
+{
+    QSet<int> ids;
+    const QHash<int, FaceEmbedding> &resident = m_db->unmappedEmbeddings();
+    for (auto it = resident.constBegin(); it != resident.constEnd(); ++it) {
+        ids.insert(it.key());
+    }
+    return ids;
+}
+
+QSet<int> TstFaceDatabase::queriedUnmappedIds()
+{
+    QSet<int> ids;
+    for (const Face &face : m_db->getUnmappedFaces()) {
+        ids.insert(face.id);
+    }
+    return ids;
+}
+
 int TstFaceDatabase::addPhotoWithFace(const QString &name, const QDateTime &taken,
                                       int personId, bool verified, float seed)
 {
@@ -385,5 +451,476 @@ void TstFaceDatabase::personPhotosJoinKeepsTheBestFacePerPhoto()
     QCOMPARE(m_db->getPhotosForPerson(bob).size(), 0);
 }
 
+// 128 floats used to take ~1 KB as QDataStream doubles; the raw format is
+// a 4-byte header plus the floats themselves
+void TstFaceDatabase::storesEmbeddingsAsRawFloat32()
+{
+    const int faceId = addPhotoWithFace("raw.jpg", QDateTime::currentDateTime(), -1);
+    QVERIFY(faceId > 0);
+
+    const QByteArray blob = rawEmbedding(faceId);
+    QCOMPARE(blob.size(), 4 + 128 * 4);
+    QVERIFY(blob.startsWith("NE"));
+
+    const FaceEmbedding embedding = m_db->getFace(faceId).embedding;
+    QCOMPARE(embedding, FaceEmbedding(128, 0.1f));
+}
+
+// Databases from before the compact format still hold QDataStream blobs;
+// opening one rewrites them once, without losing a bit
+void TstFaceDatabase::migratesLegacyEmbeddingBlobsOnOpen()
+{
+    const int faceId = addPhotoWithFace("legacy.jpg", QDateTime::currentDateTime(), -1);
+    QVERIFY(faceId > 0);
+    m_db->close();
+    delete m_db;
+    m_db = nullptr;
+
+    FaceEmbedding original(128);
+    for (int i = 0; i < 128; i++) {
+        original[i] = std::sin(i * 0.37f) / 8.0f;
+    }
+    QByteArray legacy;
+    {
+        QDataStream stream(&legacy, QIODevice::WriteOnly);
+        stream << static_cast<quint32>(original.size());
+        for (float value : original) {
+            stream << value;
+        }
+    }
+    QCOMPARE(legacy.size(), 4 + 128 * 8);
+
+    {
+        QSqlDatabase raw = QSqlDatabase::addDatabase("QSQLITE", "raw");
+        raw.setDatabaseName(m_dir->filePath("test.db"));
+        QVERIFY(raw.open());
+        QSqlQuery query(raw);
+        query.prepare("UPDATE faces SET embedding = :embedding WHERE id = :id");
+        query.bindValue(":embedding", legacy);
+        query.bindValue(":id", faceId);
+        QVERIFY(query.exec());
+        QVERIFY(query.exec("DELETE FROM settings WHERE key = 'embedding_storage'"));
+        raw.close();
+    }
+    QSqlDatabase::removeDatabase("raw");
+
+    m_db = new FaceDatabase;
+    QVERIFY(m_db->open(m_dir->filePath("test.db")));
+
+    const QByteArray migrated = rawEmbedding(faceId);
+    QCOMPARE(migrated.size(), 4 + 128 * 4);
+    QCOMPARE(m_db->getFace(faceId).embedding, original);
+    QCOMPARE(m_db->getSetting("embedding_storage"), QStringLiteral("float32"));
+}
+
+// float16 and int8 trade a little precision for a half and a quarter of the
+// space; what matters is that similarities barely move
+void TstFaceDatabase::quantizedStorageStaysCloseToTheOriginal()
+{
+    FaceEmbedding original(128);
+    float norm = 0.0f;
+    for (int i = 0; i < 128; i++) {
+        original[i] = std::cos(i * 1.3f) * (1.0f + (i % 7));
+        norm += original[i] * original[i];
+    }
+    for (float &value : original) {
+        value /= std::sqrt(norm);
+    }
+
+    const int photoId = m_db->addPhoto(makePhotoFile("quant.jpg"), QDateTime::currentDateTime(),
+                                       1000, 800);
+    const int faceId = m_db->addFace(photoId, QRectF(0.1, 0.1, 0.2, 0.2), 0.9f, original);
+    QVERIFY(faceId > 0);
+
+    const struct {
+        EmbeddingCodec::Format format;
+        int blobSize;
+    } cases[] = {
+        { EmbeddingCodec::Float16, 4 + 128 * 2 },
+        { EmbeddingCodec::Int8, 4 + 4 + 128 },
+    };
+
+    for (const auto &c : cases) {
+        QVERIFY(m_db->setEmbeddingStorage(c.format));
+        QCOMPARE(rawEmbedding(faceId).size(), c.blobSize);
+
+        const FaceEmbedding stored = m_db->getFace(faceId).embedding;
+        QCOMPARE(stored.size(), original.size());
+        float dot = 0.0f;
+        for (size_t i = 0; i < original.size(); i++) {
+            dot += stored[i] * original[i];
+        }
+        QVERIFY2(dot > 0.999f, qPrintable(QString("cosine %1").arg(dot)));
+    }
+
+    QCOMPARE(m_db->getSetting("embedding_storage"), QStringLiteral("int8"));
+}
+
+void TstFaceDatabase::scannedFoldersRoundTrip()
+{
+    DirListing camera;
+    camera.mtimeMs = 1700000000123;
+    camera.images = QStringList{ "IMG 0001.jpg", "IMG_0002.JPG" };
+    camera.subdirs = QStringList{ "2024" };
+    DirListing empty;
+    empty.mtimeMs = 1700000000000;
+
+    QVERIFY(m_db->updateScannedDirs({ { "/home/u/Pictures/Camera", camera },
+                                      { "/home/u/Pictures/Empty", empty } }, {}));
+    QHash<QString, DirListing> dirs = m_db->getScannedDirs();
+    QCOMPARE(dirs.size(), 2);
+    QCOMPARE(dirs["/home/u/Pictures/Camera"].mtimeMs, camera.mtimeMs);
+    QCOMPARE(dirs["/home/u/Pictures/Camera"].images, camera.images);
+    QCOMPARE(dirs["/home/u/Pictures/Camera"].subdirs, camera.subdirs);
+    QVERIFY(dirs["/home/u/Pictures/Empty"].images.isEmpty());
+
+    QVERIFY(m_db->updateScannedDirs({}, { "/home/u/Pictures/Empty" }));
+    dirs = m_db->getScannedDirs();
+    QCOMPARE(dirs.keys(), QStringList{ "/home/u/Pictures/Camera" });
+}
+
 QTEST_MAIN(TstFaceDatabase)
 #include "tst_facedatabase.moc"
+
+void TstFaceDatabase::groupsOnlyClaimFacesThatAreStillUnmapped()
+{
+    const int alice = m_db->createPerson("Alice");
+    const QDateTime taken(QDate(2024, 5, 1), QTime(12, 0));
+    const int a = addPhotoWithFace("a.jpg", taken, -1, false);
+    const int b = addPhotoWithFace("b.jpg", taken, -1, false);
+    const int c = addPhotoWithFace("c.jpg", taken, -1, false);
+    const int d = addPhotoWithFace("d.jpg", taken, -1, false);
+    QCOMPARE(m_db->getUnmappedEmbeddings().size(), 4);
+
+    // Since the snapshot: c was identified, d dismissed
+    QVERIFY(m_db->updateFacePersonMapping(c, alice));
+    QVERIFY(m_db->setFaceIgnored(d, true));
+    QCOMPARE(m_db->getUnmappedEmbeddings().size(), 2);
+
+    // The second group has nothing left to claim: no empty person for it
+    int assigned = 0;
+    QCOMPARE(m_db->createPeopleFromGroups({ { a, b, c }, { d } }, 2, &assigned), 1);
+    QCOMPARE(assigned, 2);
+    QCOMPARE(m_db->getAllPeople().size(), 2);
+
+    const int grouped = m_db->getFace(a).personId;
+    QVERIFY(grouped != alice);
+    QCOMPARE(m_db->getFace(b).personId, grouped);
+    QCOMPARE(m_db->getFace(c).personId, alice);
+    QCOMPARE(m_db->getFace(d).personId, -1);
+    QCOMPARE(m_db->getPerson(grouped).name, QStringLiteral("Person 1"));
+    QVERIFY(m_db->getUnmappedEmbeddings().isEmpty());
+}
+
+void TstFaceDatabase::groupsLeftTooSmallCreateNoOne()
+{
+    const int alice = m_db->createPerson("Alice");
+    const QDateTime taken(QDate(2024, 5, 1), QTime(12, 0));
+    const int a = addPhotoWithFace("a.jpg", taken, -1, false);
+    const int b = addPhotoWithFace("b.jpg", taken, -1, false);
+
+    // Since the snapshot, one face of the pair was identified
+    QVERIFY(m_db->updateFacePersonMapping(b, alice));
+
+    int assigned = -1;
+    QCOMPARE(m_db->createPeopleFromGroups({ { a, b } }, 2, &assigned), 0);
+    QCOMPARE(assigned, 0);
+    QCOMPARE(m_db->getAllPeople().size(), 1);
+    QCOMPARE(m_db->getFace(a).personId, -1);
+    QCOMPARE(m_db->getFace(b).personId, alice);
+    QCOMPARE(m_db->getUnmappedEmbeddings().size(), 1);
+}
+
+void TstFaceDatabase::residentEmbeddingsFollowEveryWrite()
+{
+    const QDateTime taken(QDate(2024, 5, 1), QTime(12, 0));
+    const int alice = m_db->createPerson("Alice");
+    const int a = addPhotoWithFace("a.jpg", taken, -1, false, 0.1f);
+    QCOMPARE(residentUnmappedIds(), queriedUnmappedIds());  // loads it
+
+    // Every step below must leave the resident copy equal to the table
+    const int b = addPhotoWithFace("b.jpg", taken, -1, false, 0.2f);
+    const int c = addPhotoWithFace("c.jpg", taken, alice, true, 0.3f);
+    QCOMPARE(residentUnmappedIds(), QSet<int>({ a, b }));
+    QCOMPARE(m_db->unmappedEmbeddings().value(b), m_db->getFace(b).embedding);
+
+    QVERIFY(m_db->updateFacePersonMapping(a, alice));
+    QCOMPARE(residentUnmappedIds(), queriedUnmappedIds());
+
+    QVERIFY(m_db->removeFaceFromPerson(c));
+    QCOMPARE(residentUnmappedIds(), queriedUnmappedIds());
+    QVERIFY(residentUnmappedIds().contains(c));
+
+    QVERIFY(m_db->setFaceIgnored(b, true));
+    QCOMPARE(residentUnmappedIds(), queriedUnmappedIds());
+    QVERIFY(m_db->setFaceIgnored(b, false));
+    QCOMPARE(residentUnmappedIds(), queriedUnmappedIds());
+
+    QVERIFY(m_db->removePersonFromPhoto(alice, m_db->getFace(a).photoId));
+    QCOMPARE(residentUnmappedIds(), queriedUnmappedIds());
+
+    QVERIFY(m_db->updateFacePersonMapping(a, alice));
+    QVERIFY(m_db->deletePerson(alice));
+    QCOMPARE(residentUnmappedIds(), queriedUnmappedIds());
+
+    QVERIFY(m_db->deleteFacesForPhoto(m_db->getFace(b).photoId));
+    QCOMPARE(residentUnmappedIds(), queriedUnmappedIds());
+
+    // A rolled back face never shows up
+    QVERIFY(m_db->beginTransaction());
+    addPhotoWithFace("d.jpg", taken, -1, false, 0.4f);
+    QVERIFY(m_db->rollbackTransaction());
+    QCOMPARE(residentUnmappedIds(), queriedUnmappedIds());
+
+    QVERIFY(m_db->clearFaceData());
+    QVERIFY(residentUnmappedIds().isEmpty());
+}
+
+void TstFaceDatabase::negativeMatchesStayInSyncInMemory()
+{
+    const QDateTime taken(QDate(2024, 5, 1), QTime(12, 0));
+    const int alice = m_db->createPerson("Alice");
+    const int bob = m_db->createPerson("Bob");
+    const int face = addPhotoWithFace("a.jpg", taken, -1, false);
+
+    QVERIFY(!m_db->hasNegativeMatch(face, alice));  // loads the set
+    QVERIFY(m_db->addNegativeMatch(face, alice));
+    QVERIFY(m_db->hasNegativeMatch(face, alice));
+    QVERIFY(!m_db->hasNegativeMatch(face, bob));
+
+    // Merging carries the rejection over to the surviving person
+    QVERIFY(m_db->mergePersons(alice, bob));
+    QVERIFY(m_db->hasNegativeMatch(face, bob));
+    QVERIFY(!m_db->hasNegativeMatch(face, alice));
+
+    QVERIFY(m_db->deletePerson(bob));
+    QVERIFY(m_db->getNegativeMatches(face).isEmpty());
+}
+
+void TstFaceDatabase::batchAssignSkipsFacesTakenMeanwhile()
+{
+    const QDateTime taken(QDate(2024, 5, 1), QTime(12, 0));
+    const int alice = m_db->createPerson("Alice");
+    const int bob = m_db->createPerson("Bob");
+    const int a = addPhotoWithFace("a.jpg", taken, -1, false);
+    const int b = addPhotoWithFace("b.jpg", taken, -1, false);
+    const int c = addPhotoWithFace("c.jpg", taken, -1, false);
+    QVERIFY(m_db->updateFacePersonMapping(c, bob));
+
+    QCOMPARE(m_db->assignFaces(alice, { qMakePair(a, 0.8f), qMakePair(b, 0.75f),
+                                        qMakePair(c, 0.9f) }), 2);
+    const Face assigned = m_db->getFace(a);
+    QCOMPARE(assigned.personId, alice);
+    QVERIFY(!assigned.verified);
+    QVERIFY(std::fabs(assigned.similarityScore - 0.8f) < 1e-6f);
+    QCOMPARE(m_db->getFace(c).personId, bob);
+    QVERIFY(m_db->unmappedEmbeddings().isEmpty());
+}
+
+void TstFaceDatabase::nestedTransactionsRollBackOnTheirOwn()
+{
+    const QDateTime taken(QDate(2024, 5, 1), QTime(12, 0));
+
+    // A scan batch around per-photo transactions
+    QVERIFY(m_db->beginTransaction());
+    QVERIFY(m_db->inTransaction());
+
+    QVERIFY(m_db->beginTransaction());
+    const int kept = addPhotoWithFace("a.jpg", taken, -1, false);
+    QVERIFY(m_db->commitTransaction());
+
+    QVERIFY(m_db->beginTransaction());
+    const int dropped = addPhotoWithFace("b.jpg", taken, -1, false);
+    QVERIFY(m_db->rollbackTransaction());
+
+    // Helpers with a transaction of their own still work inside the batch
+    const int alice = m_db->createPerson("Alice");
+    QCOMPARE(m_db->assignFaces(alice, { qMakePair(kept, 0.8f) }), 1);
+
+    QVERIFY(m_db->inTransaction());
+    QVERIFY(m_db->commitTransaction());
+    QVERIFY(!m_db->inTransaction());
+
+    QCOMPARE(m_db->getFace(kept).personId, alice);
+    QCOMPARE(m_db->getFace(dropped).id, -1);
+    QCOMPARE(m_db->getPhotoByPath(m_dir->filePath("b.jpg")).id, -1);
+}
+
+void TstFaceDatabase::fingerprintsFlagEditedPhotosOnly()
+{
+    const QDateTime taken(QDate(2024, 5, 1), QTime(12, 0));
+    const QString kept = makePhotoFile("kept.jpg");
+    const QString edited = makePhotoFile("edited.jpg");
+    const QString legacy = makePhotoFile("legacy.jpg");
+    const QString fresh = makePhotoFile("fresh.jpg");
+
+    const int keptId = m_db->addPhoto(kept, taken, 10, 10, false, 0, 0, QString(),
+                                      FileFingerprint::of(kept));
+    const int editedId = m_db->addPhoto(edited, taken, 10, 10, false, 0, 0, QString(),
+                                        FileFingerprint::of(edited));
+    const int legacyId = m_db->addPhoto(legacy, taken, 10, 10);  // scanned before fingerprints
+    for (int id : { keptId, editedId, legacyId }) {
+        QVERIFY(m_db->markPhotoProcessed(id));
+    }
+
+    QFile file(edited);
+    QVERIFY(file.open(QIODevice::Append));
+    file.write("rotated in the gallery app");
+    file.close();
+
+    QVector<QPair<QString, FileFingerprint>> onDisk;
+    for (const QString &path : { kept, edited, legacy, fresh }) {
+        onDisk.append(qMakePair(path, FileFingerprint::of(path)));
+    }
+    const FingerprintDiff diff = diffFingerprints(onDisk, m_db->getPhotoFingerprints());
+    QCOMPARE(diff.added, QStringList{ fresh });
+    QCOMPARE(diff.changed, QStringList{ edited });
+    QCOMPARE(diff.unchanged, 2);
+    QCOMPARE(diff.refresh.size(), 1);
+    QCOMPARE(diff.refresh.first().first, legacyId);
+
+    // Once refreshed, the legacy row reads back as the file's fingerprint
+    QVERIFY(m_db->setPhotoFingerprints(diff.refresh));
+    for (const StoredFingerprint &row : m_db->getPhotoFingerprints()) {
+        if (row.photoId == legacyId) {
+            QVERIFY(row.processed);
+            QCOMPARE(row.fingerprint, FileFingerprint::of(legacy));
+        }
+    }
+}
+
+void TstFaceDatabase::scanCheckpointKeepsOrderAndDropsCommitted()
+{
+    QVERIFY(m_db->getScanQueue().isEmpty());
+    QVERIFY(m_db->appendScanQueue({ ScanItem{ "/p/c.jpg", false }, ScanItem{ "/p/a.jpg", true } }));
+    // Already checkpointed: neither moved nor duplicated
+    QVERIFY(m_db->appendScanQueue({ ScanItem{ "/p/b.jpg", false }, ScanItem{ "/p/c.jpg", false } }));
+
+    QVector<ScanItem> queue = m_db->getScanQueue();
+    QCOMPARE(queue.size(), 3);
+    QCOMPARE(queue[0].filePath, QString("/p/c.jpg"));
+    QCOMPARE(queue[1].filePath, QString("/p/a.jpg"));
+    QVERIFY(queue[1].changed);
+    QCOMPARE(queue[2].filePath, QString("/p/b.jpg"));
+
+    // Removed in the commit's transaction: rolled back with it
+    QVERIFY(m_db->beginTransaction());
+    QVERIFY(m_db->removeFromScanQueue("/p/a.jpg"));
+    QVERIFY(m_db->rollbackTransaction());
+    QCOMPARE(m_db->getScanQueue().size(), 3);
+
+    QVERIFY(m_db->removeFromScanQueue("/p/a.jpg"));
+    queue = m_db->getScanQueue();
+    QCOMPARE(queue.size(), 2);
+    QCOMPARE(queue[1].filePath, QString("/p/b.jpg"));
+
+    // Resumed in the order the scan would have taken them
+    QVERIFY(m_db->appendScanQueue({ ScanItem{ "/p/viewed.jpg", false, ScanQueue::URGENT } }));
+    QCOMPARE(m_db->getScanQueue().first().filePath, QString("/p/viewed.jpg"));
+    QVERIFY(m_db->isInScanQueue("/p/viewed.jpg"));
+    QVERIFY(!m_db->isInScanQueue("/p/a.jpg"));
+
+    QVERIFY(m_db->clearScanQueue());
+    QVERIFY(m_db->getScanQueue().isEmpty());
+}
+
+void TstFaceDatabase::processedSinceLeavesEarlierPhotosDue()
+{
+    const QDateTime taken(QDate(2024, 5, 1), QTime(12, 0));
+    const int id = m_db->addPhoto("/p/a.jpg", taken, 10, 10);
+    QVERIFY(m_db->markPhotoProcessed(id));
+
+    // A forced scan that started after this photo was processed still has
+    // it to do; one that started before has done it
+    const QDateTime now = QDateTime::currentDateTime();
+    QVERIFY(!m_db->getPhotoFingerprints(QString(), now.addSecs(60)).first().processed);
+    QVERIFY(m_db->getPhotoFingerprints(QString(), now.addSecs(-60)).first().processed);
+    QVERIFY(m_db->getPhotoFingerprints().first().processed);
+}
+
+void TstFaceDatabase::copiesAreFoundByHashOnceProcessed()
+{
+    const QString hash = QString("0123456789abcdef").repeated(4);
+    const QDateTime taken(QDate(2024, 5, 1), QTime(12, 0));
+    const int original = m_db->addPhoto("/dcim/a.jpg", taken, 10, 10, false, 0.0, 0.0, hash);
+    const int copy = m_db->addPhoto("/sdcard/a.jpg", taken, 10, 10, false, 0.0, 0.0, hash);
+    QVERIFY(original > 0 && copy > 0);
+
+    // Not processed yet: its faces are not known
+    QCOMPARE(m_db->findProcessedCopy(hash, "/sdcard/a.jpg"), -1);
+    QVERIFY(m_db->getProcessedHashKeys().isEmpty());
+
+    QVERIFY(m_db->markPhotoProcessed(original));
+    QCOMPARE(m_db->findProcessedCopy(hash, "/sdcard/a.jpg"), original);
+    // A photo is not its own copy
+    QCOMPARE(m_db->findProcessedCopy(hash, "/dcim/a.jpg"), -1);
+    QCOMPARE(m_db->findProcessedCopy(QString(), "/sdcard/a.jpg"), -1);
+
+    QCOMPARE(m_db->getProcessedHashKeys(), (QSet<quint64>{ Q_UINT64_C(0x0123456789abcdef) }));
+    QCOMPARE(FaceDatabase::hashKey(hash), Q_UINT64_C(0x0123456789abcdef));
+    QCOMPARE(FaceDatabase::hashKey(QString()), quint64(0));
+}
+
+void TstFaceDatabase::facesRecordTheirEmbeddingModel()
+{
+    const QDateTime taken = QDateTime::fromString("2026-07-14T10:00:00", Qt::ISODate);
+    const int alice = m_db->createPerson("Alice");
+
+    // Before any model is set: unknown, as for libraries from before
+    const int legacy = addPhotoWithFace("legacy.jpg", taken, alice);
+    m_db->setEmbeddingModel("sface_2021dec_int8");
+    const int quantized = addPhotoWithFace("int8.jpg", taken, alice);
+    QVERIFY(legacy > 0 && quantized > 0);
+
+    QCOMPARE(m_db->countFacesByEmbeddingModel(),
+             (QVariantMap{ { "", 1 }, { "sface_2021dec_int8", 1 } }));
+    QCOMPARE(m_db->getFacesForPhoto(m_db->getFace(quantized).photoId).value(0).embeddingModel,
+             QString("sface_2021dec_int8"));
+
+    // A backup keeps each face's own model, whatever the restoring device uses
+    const QJsonObject backup = m_db->exportBackup();
+    FaceDatabase fresh;
+    QVERIFY(fresh.open(m_dir->filePath("restored.db")));
+    fresh.setEmbeddingModel("sface_2021dec_fp32");
+    QCOMPARE(fresh.importBackup(backup).facesImported, 2);
+    QCOMPARE(fresh.countFacesByEmbeddingModel(),
+             (QVariantMap{ { "", 1 }, { "sface_2021dec_int8", 1 } }));
+    fresh.close();
+}
+
+void TstFaceDatabase::burstFramesComeBackFromTheDatabase()
+{
+    const QDateTime taken = QDateTime::fromString("2026-07-14T10:00:00", Qt::ISODate);
+    m_db->setEmbeddingModel("sface_2021dec_fp32");
+    const int first = m_db->getFace(addPhotoWithFace("first.jpg", taken, -1, false)).photoId;
+    const int second = m_db->getFace(addPhotoWithFace("second.jpg", taken.addSecs(1), -1, false)).photoId;
+    const int noHash = m_db->getFace(addPhotoWithFace("nohash.jpg", taken.addSecs(2), -1, false)).photoId;
+    m_db->setEmbeddingModel("sface_2021dec_int8");
+    const int otherModel = m_db->getFace(addPhotoWithFace("int8.jpg", taken.addSecs(3), -1, false)).photoId;
+    m_db->setEmbeddingModel("sface_2021dec_fp32");
+
+    for (int photoId : { first, second, noHash, otherModel }) {
+        QVERIFY(m_db->markPhotoProcessed(photoId));
+    }
+    QVERIFY(m_db->setPhotoDHash(first, 0x8000000000000001ULL));  // sign bit survives
+    QVERIFY(m_db->setPhotoDHash(second, 2));
+    QVERIFY(m_db->setPhotoDHash(otherModel, 3));
+
+    // Oldest first, as BurstIndex holds them; never another model's embeddings
+    QVector<BurstIndex::Frame> frames = m_db->getBurstFrames(BurstIndex::CAPACITY);
+    QCOMPARE(frames.size(), 2);
+    QCOMPARE(frames[0].filePath, m_dir->filePath("first.jpg"));
+    QCOMPARE(frames[0].dhash, quint64(0x8000000000000001ULL));
+    QCOMPARE(frames[0].takenMs, taken.toMSecsSinceEpoch());
+    QCOMPARE(frames[0].size, QSize(1000, 800));
+    QCOMPARE(frames[0].faces.size(), 1);
+    QCOMPARE(frames[1].filePath, m_dir->filePath("second.jpg"));
+
+    // The newest that qualify, not the newest of all
+    frames = m_db->getBurstFrames(1);
+    QCOMPARE(frames.size(), 1);
+    QCOMPARE(frames[0].filePath, m_dir->filePath("second.jpg"));
+
+    QVERIFY(m_db->setPhotoDHash(second, 0));
+    QCOMPARE(m_db->getBurstFrames(BurstIndex::CAPACITY).size(), 1);
+}
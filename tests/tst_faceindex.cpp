@@ -0,0 +1,236 @@
+// Tests for the approximate index over unmapped faces. It only has to be
+// "approximate" in one direction: it may miss a far-off face in an
+// unprobed list, but it must never report a face that is not within the
+// threshold, and on small libraries it must find everything.
+
+#include <QtTest>
+#include <QSet>
+#include <cmath>
+
+#include "faceindex.h"
+#include "embeddingmatrix.h"
+
+namespace {
+
+FaceEmbedding unitVector(int dim, quint32 seed)
+{
+    // Small LCG: deterministic without pulling in <random>
+    FaceEmbedding v(dim);
+    float norm = 0.0f;
+    for (int i = 0; i < dim; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        v[i] = static_cast<float>(seed >> 8) / (1 << 24) - 0.5f;
+        norm += v[i] * v[i];
+    }
+    for (float &x : v) {
+        x /= std::sqrt(norm);
+    }
+    return v;
+}
+
+// A face of the same person: the identity plus some noise
+FaceEmbedding nearby(const FaceEmbedding &identity, quint32 seed, float noise)
+{
+    const FaceEmbedding jitter = unitVector(identity.size(), seed);
+    FaceEmbedding v(identity.size());
+    float norm = 0.0f;
+    for (int i = 0; i < v.size(); i++) {
+        v[i] = identity[i] + noise * jitter[i];
+        norm += v[i] * v[i];
+    }
+    for (float &x : v) {
+        x /= std::sqrt(norm);
+    }
+    return v;
+}
+
+float similarity(const FaceEmbedding &a, const FaceEmbedding &b)
+{
+    return (EmbeddingMath::dotScalar(a.data(), b.data(), a.size()) + 1.0f) / 2.0f;
+}
+
+// people identities with facesEach faces each; face ids start at 1
+QVector<QPair<int, FaceEmbedding>> makeLibrary(int people, int facesEach)
+{
+    QVector<QPair<int, FaceEmbedding>> faces;
+    for (int p = 0; p < people; p++) {
+        const FaceEmbedding identity = unitVector(128, p + 1);
+        for (int f = 0; f < facesEach; f++) {
+            faces.append(qMakePair(faces.size() + 1, nearby(identity, 100000 + faces.size(), 0.6f)));
+        }
+    }
+    return faces;
+}
+
+QSet<int> exactMatches(const QVector<QPair<int, FaceEmbedding>> &faces,
+                       const FaceEmbedding &query, float threshold)
+{
+    QSet<int> ids;
+    for (const auto &face : faces) {
+        if (similarity(face.second, query) >= threshold) {
+            ids.insert(face.first);
+        }
+    }
+    return ids;
+}
+
+QSet<int> hitIds(const QVector<FaceIndex::Hit> &hits)
+{
+    QSet<int> ids;
+    for (const FaceIndex::Hit &hit : hits) {
+        ids.insert(hit.faceId);
+    }
+    return ids;
+}
+
+} // namespace
+
+class TstFaceIndex : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void smallIndexIsExact();
+    void largeIndexFindsMostMatches();
+    void neverReportsFacesBelowThreshold();
+    void addAndRemoveKeepItCurrent();
+    void neighboursExcludeTheFaceItself();
+    void benchmarkBruteForce();
+    void benchmarkIndex();
+};
+
+void TstFaceIndex::smallIndexIsExact()
+{
+    const QVector<QPair<int, FaceEmbedding>> faces = makeLibrary(40, 5);
+    FaceIndex index;
+    index.build(faces);
+    QCOMPARE(index.size(), faces.size());
+    QCOMPARE(index.listCount(), 1);
+
+    for (int p = 0; p < 40; p++) {
+        const FaceEmbedding query = unitVector(128, p + 1);
+        QCOMPARE(hitIds(index.search({ query }, 0.75f)), exactMatches(faces, query, 0.75f));
+    }
+}
+
+void TstFaceIndex::largeIndexFindsMostMatches()
+{
+    const QVector<QPair<int, FaceEmbedding>> faces = makeLibrary(1000, 5);
+    FaceIndex index;
+    index.build(faces);
+    QVERIFY(index.listCount() > 1);
+
+    int expected = 0;
+    int found = 0;
+    for (int p = 0; p < 200; p++) {
+        const FaceEmbedding query = unitVector(128, p + 1);
+        const QSet<int> exact = exactMatches(faces, query, 0.75f);
+        expected += exact.size();
+        found += (hitIds(index.search({ query }, 0.75f)) & exact).size();
+    }
+    QVERIFY(expected > 0);
+    QVERIFY2(found >= expected * 9 / 10,
+             qPrintable(QString("recall %1/%2").arg(found).arg(expected)));
+}
+
+void TstFaceIndex::neverReportsFacesBelowThreshold()
+{
+    const QVector<QPair<int, FaceEmbedding>> faces = makeLibrary(300, 4);
+    FaceIndex index;
+    index.build(faces);
+
+    const FaceEmbedding query = unitVector(128, 7);
+    for (const FaceIndex::Hit &hit : index.search({ query }, 0.7f)) {
+        QVERIFY(hit.similarity >= 0.7f);
+        QVERIFY(std::fabs(hit.similarity - similarity(faces[hit.faceId - 1].second, query)) < 1e-4f);
+    }
+}
+
+void TstFaceIndex::addAndRemoveKeepItCurrent()
+{
+    const QVector<QPair<int, FaceEmbedding>> faces = makeLibrary(300, 4);
+    FaceIndex index;
+    index.build(faces);
+
+    const FaceEmbedding stranger = unitVector(128, 424242);
+    QVERIFY(!hitIds(index.search({ stranger }, 0.95f)).contains(9999));
+
+    index.add(9999, stranger);
+    QVERIFY(index.contains(9999));
+    QCOMPARE(index.size(), faces.size() + 1);
+    QVERIFY(hitIds(index.search({ stranger }, 0.95f)).contains(9999));
+
+    // Removing swaps the last row in; the moved face must stay findable
+    const FaceEmbedding first = faces[0].second;
+    QVERIFY(index.remove(faces[0].first));
+    QVERIFY(!index.remove(faces[0].first));
+    QVERIFY(!hitIds(index.search({ first }, 0.99f)).contains(faces[0].first));
+    for (const auto &face : faces.mid(1)) {
+        QVERIFY(hitIds(index.search({ face.second }, 0.99f)).contains(face.first));
+    }
+
+    // Wrong dimension: ignored rather than read past
+    index.add(10000, unitVector(64, 1));
+    QVERIFY(!index.contains(10000));
+}
+
+void TstFaceIndex::neighboursExcludeTheFaceItself()
+{
+    const QVector<QPair<int, FaceEmbedding>> faces = makeLibrary(50, 5);
+    FaceIndex index;
+    index.build(faces);
+
+    const int faceId = faces[10].first;
+    const QSet<int> neighbours = hitIds(index.neighbours(faceId, 0.75f));
+    QSet<int> expected = exactMatches(faces, faces[10].second, 0.75f);
+    expected.remove(faceId);
+    QCOMPARE(neighbours, expected);
+
+    QVERIFY(index.neighbours(123456, 0.5f).isEmpty());
+}
+
+// Re-matching after an identification: 5 exemplars against 20000 faces
+void TstFaceIndex::benchmarkBruteForce()
+{
+    const QVector<QPair<int, FaceEmbedding>> faces = makeLibrary(4000, 5);
+    QVector<FaceEmbedding> exemplars;
+    for (int e = 0; e < 5; e++) {
+        exemplars.append(faces[e].second);
+    }
+
+    int matches = 0;
+    QBENCHMARK {
+        matches = 0;
+        for (const auto &face : faces) {
+            float best = 0.0f;
+            for (const FaceEmbedding &exemplar : exemplars) {
+                best = qMax(best, similarity(face.second, exemplar));
+            }
+            if (best >= 0.75f) {
+                matches++;
+            }
+        }
+    }
+    QVERIFY(matches > 0);
+}
+
+void TstFaceIndex::benchmarkIndex()
+{
+    const QVector<QPair<int, FaceEmbedding>> faces = makeLibrary(4000, 5);
+    QVector<FaceEmbedding> exemplars;
+    for (int e = 0; e < 5; e++) {
+        exemplars.append(faces[e].second);
+    }
+    FaceIndex index;
+    index.build(faces);
+
+    int matches = 0;
+    QBENCHMARK {
+        matches = index.search(exemplars, 0.75f).size();
+    }
+    QVERIFY(matches > 0);
+}
+
+QTEST_APPLESS_MAIN(TstFaceIndex)
+
+#include "tst_faceindex.moc"
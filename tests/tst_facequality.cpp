@@ -0,0 +1,141 @@
+// Tests for the face-quality gate. A face it wrongly drops is never
+// recognised and one it wrongly keeps costs an embedding, so the pose and
+// sharpness estimates have to point the right way, and each level has to
+// be as strict as it claims.
+
+#include <QtTest>
+
+#include "facequality.h"
+
+namespace {
+
+const QSize PHOTO(4000, 3000);
+
+// YuNet's five landmarks from pixel positions on PHOTO
+QVector<QPointF> landmarks(QPointF rightEye, QPointF leftEye, QPointF nose)
+{
+    const auto normalized = [](const QPointF &point) {
+        return QPointF(point.x() / PHOTO.width(), point.y() / PHOTO.height());
+    };
+    return { normalized(rightEye), normalized(leftEye), normalized(nose),
+             normalized(rightEye + QPointF(10, 120)), normalized(leftEye + QPointF(-10, 120)) };
+}
+
+QVector<uchar> image(int width, int height, uchar (*pixel)(int x, int y))
+{
+    QVector<uchar> data(width * height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            data[y * width + x] = pixel(x, y);
+        }
+    }
+    return data;
+}
+
+} // namespace
+
+class TstFaceQuality : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void frontalFace();
+    void turnedFace();
+    void tiltedFaceInPixels();
+    void missingLandmarks();
+    void sharpness();
+    void levels();
+};
+
+void TstFaceQuality::frontalFace()
+{
+    double yaw = -1.0;
+    double roll = -1.0;
+    QVERIFY(FaceQuality::pose(landmarks({ 1900, 1000 }, { 2100, 1000 }, { 2000, 1080 }), PHOTO, &yaw, &roll));
+    QVERIFY(qAbs(yaw) < 1.0);
+    QVERIFY(qAbs(roll) < 1.0);
+}
+
+void TstFaceQuality::turnedFace()
+{
+    double yaw = 0.0;
+    double roll = 0.0;
+    // Nose almost over the left eye: close to a profile
+    QVERIFY(FaceQuality::pose(landmarks({ 1900, 1000 }, { 2100, 1000 }, { 2090, 1080 }), PHOTO, &yaw, &roll));
+    QVERIFY(yaw > 60.0);
+
+    QVERIFY(FaceQuality::pose(landmarks({ 1900, 1000 }, { 2100, 1000 }, { 1950, 1080 }), PHOTO, &yaw, &roll));
+    QVERIFY(yaw < -20.0 && yaw > -40.0);
+}
+
+void TstFaceQuality::tiltedFaceInPixels()
+{
+    double yaw = 0.0;
+    double roll = 0.0;
+    // 45 degrees in pixels; about 53 if the normalized coordinates were
+    // taken at face value on a 4:3 photo
+    QVERIFY(FaceQuality::pose(landmarks({ 1900, 1000 }, { 2100, 1200 }, { 1965, 1135 }), PHOTO, &yaw, &roll));
+    QVERIFY(qAbs(roll - 45.0) < 0.5);
+    QVERIFY(qAbs(yaw) < 5.0);
+}
+
+void TstFaceQuality::missingLandmarks()
+{
+    double yaw = 0.0;
+    double roll = 0.0;
+    QVERIFY(!FaceQuality::pose(QVector<QPointF>(), PHOTO, &yaw, &roll));
+    QVERIFY(!FaceQuality::pose(landmarks({ 2000, 1000 }, { 2000, 1000 }, { 2000, 1080 }), PHOTO, &yaw, &roll));
+
+    // Unknown pose is no reason to drop a face: only its size counts then
+    const FaceQuality::Thresholds normal = FaceQuality::thresholds(FaceQuality::Normal);
+    QCOMPARE(FaceQuality::checkGeometry(normal, 200, QVector<QPointF>(), PHOTO), FaceQuality::Pass);
+}
+
+void TstFaceQuality::sharpness()
+{
+    const QVector<uchar> flat = image(32, 32, [](int, int) -> uchar { return 128; });
+    const QVector<uchar> edges = image(32, 32, [](int x, int y) -> uchar { return ((x / 2 + y / 2) % 2) ? 255 : 0; });
+    const QVector<uchar> soft = image(32, 32, [](int x, int) -> uchar { return uchar(x * 8); });
+
+    QCOMPARE(FaceQuality::sharpness(flat.constData(), 32, 32, 32), 0.0);
+    // A linear ramp has no second derivative either
+    QCOMPARE(FaceQuality::sharpness(soft.constData(), 32, 32, 32), 0.0);
+    QVERIFY(FaceQuality::sharpness(edges.constData(), 32, 32, 32) > 1000.0);
+
+    // Only the first 16 columns of each line are the image
+    QCOMPARE(FaceQuality::sharpness(flat.constData(), 16, 32, 32), 0.0);
+    QCOMPARE(FaceQuality::sharpness(flat.constData(), 2, 2, 32), 0.0);
+}
+
+void TstFaceQuality::levels()
+{
+    const QVector<QPointF> frontal = landmarks({ 1900, 1000 }, { 2100, 1000 }, { 2000, 1080 });
+    const QVector<QPointF> turned = landmarks({ 1900, 1000 }, { 2100, 1000 }, { 2060, 1080 });
+    const QVector<QPointF> tilted = landmarks({ 1900, 1000 }, { 2000, 1100 }, { 1930, 1070 });
+
+    const FaceQuality::Thresholds off = FaceQuality::thresholds(FaceQuality::Off);
+    const FaceQuality::Thresholds normal = FaceQuality::thresholds(FaceQuality::Normal);
+    const FaceQuality::Thresholds strict = FaceQuality::thresholds(FaceQuality::Strict);
+
+    QCOMPARE(FaceQuality::checkGeometry(off, 8, turned, PHOTO), FaceQuality::Pass);
+    QCOMPARE(FaceQuality::checkSharpness(off, 0.0), FaceQuality::Pass);
+
+    QCOMPARE(FaceQuality::checkGeometry(normal, 20, frontal, PHOTO), FaceQuality::TooSmall);
+    QCOMPARE(FaceQuality::checkGeometry(normal, 300, frontal, PHOTO), FaceQuality::Pass);
+    QCOMPARE(FaceQuality::checkGeometry(normal, 300, turned, PHOTO), FaceQuality::Pass);
+    QCOMPARE(FaceQuality::checkGeometry(normal, 300, tilted, PHOTO), FaceQuality::Pass);
+    QCOMPARE(FaceQuality::checkSharpness(normal, 5.0), FaceQuality::Blurred);
+
+    QCOMPARE(FaceQuality::checkGeometry(strict, 50, frontal, PHOTO), FaceQuality::TooSmall);
+    QCOMPARE(FaceQuality::checkGeometry(strict, 300, turned, PHOTO), FaceQuality::TurnedAway);
+    QCOMPARE(FaceQuality::checkGeometry(strict, 300, tilted, PHOTO), FaceQuality::TurnedAway);
+    QCOMPARE(FaceQuality::checkSharpness(strict, 40.0), FaceQuality::Blurred);
+
+    QCOMPARE(FaceQuality::levelFromString("strict"), FaceQuality::Strict);
+    QCOMPARE(FaceQuality::levelFromString("bogus"), FaceQuality::Normal);
+    QCOMPARE(FaceQuality::levelName(FaceQuality::Off), QString("off"));
+}
+
+QTEST_APPLESS_MAIN(TstFaceQuality)
+
+#include "tst_facequality.moc"
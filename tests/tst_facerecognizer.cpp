@@ -0,0 +1,217 @@
+// Tests for batched SFace inference. Batching is only a speed-up if it is
+// invisible: the embedding of a face must not depend on which other faces
+// shared its forward pass, nor differ from what OpenCV's FaceRecognizerSF
+// gives, or every library scanned before would stop matching.
+//
+// Needs the SFace model: NAMI_MODELS, or python/models as downloaded per
+// python/models/DOWNLOAD_INSTRUCTIONS.md. Skipped without it.
+
+#include <QtTest>
+#include <QFileInfo>
+#include <opencv2/objdetect.hpp>
+
+#include "facerecognizer.h"
+
+namespace {
+
+const char MODEL_NAME[] = "face_recognition_sface_2021dec.onnx";
+
+QString modelPath()
+{
+    const QString dir = qEnvironmentVariableIsSet("NAMI_MODELS")
+        ? QString::fromLocal8Bit(qgetenv("NAMI_MODELS")) : QStringLiteral(NAMI_MODELS_DIR);
+    return dir + '/' + MODEL_NAME;
+}
+
+// Deterministic texture: the network's output is what is compared, not
+// whether it sees a face
+cv::Mat makeImage(int seed)
+{
+    cv::Mat image(480, 640, CV_8UC3);
+    cv::RNG rng(seed);
+    rng.fill(image, cv::RNG::UNIFORM, 0, 256);
+    cv::GaussianBlur(image, image, cv::Size(5, 5), 0);
+    return image;
+}
+
+// A plausible, slightly rotated face somewhere in a 640x480 image
+FaceDetection makeFace(int i)
+{
+    const double x = 0.2 + 0.05 * (i % 8);
+    const double y = 0.25 + 0.04 * (i % 5);
+    const double tilt = 0.01 * ((i % 3) - 1);
+    FaceDetection face;
+    face.bbox = QRectF(x - 0.08, y - 0.1, 0.16, 0.22);
+    face.confidence = 0.9f;
+    face.landmarks = { QPointF(x - 0.04, y - 0.02 - tilt), QPointF(x + 0.04, y - 0.02 + tilt),
+                       QPointF(x, y + 0.02), QPointF(x - 0.03, y + 0.06 - tilt),
+                       QPointF(x + 0.03, y + 0.06 + tilt) };
+    return face;
+}
+
+// The YuNet row FaceRecognizerSF::alignCrop reads
+cv::Mat faceRow(const cv::Mat &image, const FaceDetection &face)
+{
+    cv::Mat row(1, 15, CV_32F, cv::Scalar(0));
+    row.at<float>(0, 0) = float(face.bbox.x() * image.cols);
+    row.at<float>(0, 1) = float(face.bbox.y() * image.rows);
+    row.at<float>(0, 2) = float(face.bbox.width() * image.cols);
+    row.at<float>(0, 3) = float(face.bbox.height() * image.rows);
+    for (int i = 0; i < 5; i++) {
+        row.at<float>(0, 4 + i * 2) = float(face.landmarks[i].x() * image.cols);
+        row.at<float>(0, 5 + i * 2) = float(face.landmarks[i].y() * image.rows);
+    }
+    row.at<float>(0, 14) = face.confidence;
+    return row;
+}
+
+float maxDifference(const FaceEmbedding &a, const FaceEmbedding &b)
+{
+    if (a.size() != b.size()) {
+        return 1e9f;
+    }
+    float worst = 0.0f;
+    for (size_t i = 0; i < a.size(); i++) {
+        worst = qMax(worst, std::abs(a[i] - b[i]));
+    }
+    return worst;
+}
+
+// Float noise between differently sized GEMMs, nothing more
+const float TOLERANCE = 1e-5f;
+
+} // namespace
+
+class TstFaceRecognizer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void alignsLikeFaceRecognizerSF();
+    void embedsLikeFaceRecognizerSF();
+    void batchGivesTheSameEmbeddings();
+    void keepsOrderAcrossChunks();
+    void rejectsMissingLandmarks();
+
+    void benchmark_data();
+    void benchmark();
+
+private:
+    FaceRecognizer m_recognizer;
+    cv::Ptr<cv::FaceRecognizerSF> m_reference;
+    cv::Mat m_image;
+};
+
+void TstFaceRecognizer::initTestCase()
+{
+    if (!QFileInfo::exists(modelPath())) {
+        QSKIP("SFace model not found, set NAMI_MODELS");
+    }
+    QVERIFY(m_recognizer.loadModel(modelPath()));
+    m_reference = cv::FaceRecognizerSF::create(modelPath().toStdString(), "");
+    QVERIFY(!m_reference.empty());
+    m_image = makeImage(1);
+}
+
+void TstFaceRecognizer::alignsLikeFaceRecognizerSF()
+{
+    for (int i = 0; i < 6; i++) {
+        const FaceDetection face = makeFace(i);
+        cv::Mat expected;
+        m_reference->alignCrop(m_image, faceRow(m_image, face), expected);
+        const cv::Mat aligned = m_recognizer.alignFace(m_image, face);
+
+        QCOMPARE(aligned.size(), expected.size());
+        QCOMPARE(aligned.type(), expected.type());
+        // Same transform up to float rounding: at most one grey level here
+        // and there from bilinear interpolation
+        QVERIFY(cv::norm(aligned, expected, cv::NORM_INF) <= 1.0);
+    }
+}
+
+void TstFaceRecognizer::embedsLikeFaceRecognizerSF()
+{
+    const FaceDetection face = makeFace(3);
+    cv::Mat aligned;
+    m_reference->alignCrop(m_image, faceRow(m_image, face), aligned);
+    cv::Mat feature;
+    m_reference->feature(aligned, feature);
+    const FaceEmbedding expected = FaceRecognizer::normalizeEmbedding(
+        FaceEmbedding(feature.ptr<float>(0), feature.ptr<float>(0) + feature.cols));
+
+    const QVector<FaceEmbedding> embeddings = m_recognizer.embedAligned({ aligned });
+    QCOMPARE(embeddings.size(), 1);
+    QVERIFY(maxDifference(embeddings[0], expected) < TOLERANCE);
+
+    // And through the whole single-face path
+    QVERIFY(FaceRecognizer::computeSimilarity(m_recognizer.extractEmbedding(m_image, face), expected) > 0.9999f);
+}
+
+void TstFaceRecognizer::batchGivesTheSameEmbeddings()
+{
+    std::vector<cv::Mat> faces;
+    for (int i = 0; i < 12; i++) {
+        faces.push_back(m_recognizer.alignFace(i % 2 ? m_image : makeImage(i), makeFace(i)));
+    }
+
+    const QVector<FaceEmbedding> batched = m_recognizer.embedAligned(faces);
+    QCOMPARE(batched.size(), 12);
+    for (int i = 0; i < 12; i++) {
+        const FaceEmbedding single = m_recognizer.embedAligned({ faces[i] }).value(0);
+        QCOMPARE(single.size(), size_t(128));
+        QVERIFY2(maxDifference(batched[i], single) < TOLERANCE, qPrintable(QString("face %1").arg(i)));
+    }
+}
+
+void TstFaceRecognizer::keepsOrderAcrossChunks()
+{
+    // More than one batch: the second chunk must not land on the first
+    std::vector<cv::Mat> faces;
+    for (int i = 0; i < FaceRecognizer::MAX_BATCH + 5; i++) {
+        faces.push_back(m_recognizer.alignFace(makeImage(100 + i), makeFace(i)));
+    }
+    const QVector<FaceEmbedding> batched = m_recognizer.embedAligned(faces);
+    QCOMPARE(batched.size(), int(faces.size()));
+
+    const int last = int(faces.size()) - 1;
+    QVERIFY(maxDifference(batched[last], m_recognizer.embedAligned({ faces[last] }).value(0)) < TOLERANCE);
+    QVERIFY(maxDifference(batched[0], m_recognizer.embedAligned({ faces[0] }).value(0)) < TOLERANCE);
+
+    QVERIFY(m_recognizer.embedAligned({}).isEmpty());
+}
+
+void TstFaceRecognizer::rejectsMissingLandmarks()
+{
+    FaceDetection face = makeFace(0);
+    face.landmarks.removeLast();
+    QVERIFY(m_recognizer.alignFace(m_image, face).empty());
+    QVERIFY(m_recognizer.extractEmbedding(m_image, face).empty());
+}
+
+// Photos' worth of faces per forward pass; compare the per-face times
+//   ./tst_facerecognizer benchmark -iterations 20
+void TstFaceRecognizer::benchmark_data()
+{
+    QTest::addColumn<int>("batch");
+    QTest::newRow("1") << 1;
+    QTest::newRow("4") << 4;
+    QTest::newRow("16") << 16;
+}
+
+void TstFaceRecognizer::benchmark()
+{
+    QFETCH(int, batch);
+    std::vector<cv::Mat> faces;
+    for (int i = 0; i < batch; i++) {
+        faces.push_back(m_recognizer.alignFace(m_image, makeFace(i)));
+    }
+
+    QBENCHMARK {
+        m_recognizer.embedAligned(faces);
+    }
+}
+
+QTEST_APPLESS_MAIN(TstFaceRecognizer)
+#include "tst_facerecognizer.moc"
@@ -0,0 +1,131 @@
+// Tests for the change detection behind incremental scans. Getting it
+// wrong either way hurts: a missed edit leaves faces on a photo that no
+// longer shows them, a false alarm re-runs detection on the whole library.
+
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QFile>
+
+#include "filefingerprint.h"
+
+namespace {
+
+FileFingerprint fingerprint(qint64 size, qint64 mtimeMs, quint64 inode, quint64 device)
+{
+    FileFingerprint f;
+    f.size = size;
+    f.mtimeMs = mtimeMs;
+    f.inode = inode;
+    f.device = device;
+    return f;
+}
+
+StoredFingerprint row(int photoId, const QString &path, const FileFingerprint &f,
+                      bool processed = true)
+{
+    return StoredFingerprint{ photoId, path, processed, f };
+}
+
+} // namespace
+
+class TstFileFingerprint : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void statsARealFile();
+    void missingFileIsInvalid();
+    void classifiesEveryFile();
+    void inodeOnlyCountsOnTheSameDevice();
+    void unreadableFileIsLeftAlone();
+};
+
+void TstFileFingerprint::statsARealFile()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.filePath("a.jpg");
+
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("12345");
+    file.close();
+
+    const FileFingerprint before = FileFingerprint::of(path);
+    QVERIFY(before.isValid());
+    QCOMPARE(before.size, qint64(5));
+    QVERIFY(before.mtimeMs > 0);
+    QVERIFY(before.sameContents(FileFingerprint::of(path)));
+
+    // Saved by writing a new file over the old one: another inode
+    const QString tmp = dir.filePath("a.jpg.tmp");
+    QFile replacement(tmp);
+    QVERIFY(replacement.open(QIODevice::WriteOnly));
+    replacement.write("1234567");
+    replacement.close();
+    QVERIFY(QFile::remove(path));
+    QVERIFY(QFile::rename(tmp, path));
+
+    QVERIFY(!FileFingerprint::of(path).sameContents(before));
+}
+
+void TstFileFingerprint::missingFileIsInvalid()
+{
+    QVERIFY(!FileFingerprint::of("/nonexistent/nami/photo.jpg").isValid());
+}
+
+void TstFileFingerprint::classifiesEveryFile()
+{
+    const FileFingerprint same = fingerprint(100, 1000, 7, 1);
+    const QVector<QPair<QString, FileFingerprint>> onDisk = {
+        qMakePair(QString("/p/new.jpg"), same),
+        qMakePair(QString("/p/same.jpg"), same),
+        qMakePair(QString("/p/bigger.jpg"), fingerprint(120, 1000, 8, 1)),
+        qMakePair(QString("/p/touched.jpg"), fingerprint(100, 2000, 9, 1)),
+        qMakePair(QString("/p/replaced.jpg"), fingerprint(100, 1000, 99, 1)),
+        qMakePair(QString("/p/interrupted.jpg"), same),
+    };
+    const QVector<StoredFingerprint> stored = {
+        row(6, "/p/interrupted.jpg", same, /*processed*/ false),
+        row(5, "/p/replaced.jpg", fingerprint(100, 1000, 10, 1)),
+        row(4, "/p/touched.jpg", fingerprint(100, 1000, 9, 1)),
+        row(3, "/p/bigger.jpg", fingerprint(100, 1000, 8, 1)),
+        row(2, "/p/same.jpg", same),
+        row(1, "/p/deleted.jpg", same),
+    };
+
+    const FingerprintDiff diff = diffFingerprints(onDisk, stored);
+    QCOMPARE(diff.added, (QStringList{ "/p/interrupted.jpg", "/p/new.jpg" }));
+    QCOMPARE(diff.changed, (QStringList{ "/p/bigger.jpg", "/p/replaced.jpg", "/p/touched.jpg" }));
+    QCOMPARE(diff.unchanged, 1);
+    QVERIFY(diff.refresh.isEmpty());
+}
+
+void TstFileFingerprint::inodeOnlyCountsOnTheSameDevice()
+{
+    // An SD card remounted: new device, and vfat made up new inode numbers
+    const FileFingerprint before = fingerprint(100, 1000, 7, 1);
+    const FileFingerprint remounted = fingerprint(100, 1000, 4242, 2);
+
+    const FingerprintDiff diff = diffFingerprints({ qMakePair(QString("/sd/a.jpg"), remounted) },
+                                                  { row(1, "/sd/a.jpg", before) });
+    QVERIFY(diff.changed.isEmpty());
+    QCOMPARE(diff.unchanged, 1);
+    QCOMPARE(diff.refresh.size(), 1);
+    QCOMPARE(diff.refresh.first().first, 1);
+    QCOMPARE(diff.refresh.first().second, remounted);
+}
+
+void TstFileFingerprint::unreadableFileIsLeftAlone()
+{
+    const FingerprintDiff diff = diffFingerprints({ qMakePair(QString("/p/a.jpg"), FileFingerprint()) },
+                                                  { row(1, "/p/a.jpg", fingerprint(100, 1000, 7, 1)) });
+    QVERIFY(diff.added.isEmpty());
+    QVERIFY(diff.changed.isEmpty());
+    QCOMPARE(diff.unchanged, 1);
+    QVERIFY(diff.refresh.isEmpty());
+}
+
+QTEST_APPLESS_MAIN(TstFileFingerprint)
+
+#include "tst_filefingerprint.moc"
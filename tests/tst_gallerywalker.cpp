@@ -0,0 +1,196 @@
+// Tests for the gallery folder walk. The cache has to be exact: a folder
+// wrongly taken as unchanged hides its new photos until the next time
+// something else happens to touch it.
+
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QDir>
+#include <QFile>
+
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "gallerywalker.h"
+
+namespace {
+
+void touch(const QString &path)
+{
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("x");
+}
+
+// Backdate a folder past RACY_WINDOW_MS so its listing may be cached
+void age(const QString &path, long seconds = 1500000000)
+{
+    const struct timeval old[2] = { { seconds, 0 }, { seconds, 0 } };
+    QCOMPARE(::utimes(QFile::encodeName(path).constData(), old), 0);
+}
+
+QStringList relative(const QString &root, const QStringList &paths)
+{
+    QStringList names;
+    for (const QString &path : paths) {
+        names.append(QDir(root).relativeFilePath(path));
+    }
+    return names;
+}
+
+} // namespace
+
+class TstGalleryWalker : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+
+    void findsImagesLikeQDirDid();
+    void nonRecursiveStaysInTheFolder();
+    void skipsUnreadablePhotos();
+    void rereadsOnlyChangedFolders();
+    void reportsFoldersThatAreGone();
+    void doesNotCacheFoldersChangedJustNow();
+    void followsSymlinksOnce();
+    void handsOverFolderByFolder();
+
+private:
+    QScopedPointer<QTemporaryDir> m_dir;
+    QString m_root;
+};
+
+void TstGalleryWalker::init()
+{
+    m_dir.reset(new QTemporaryDir);
+    QVERIFY(m_dir->isValid());
+    m_root = m_dir->path();
+
+    QVERIFY(QDir(m_root).mkpath("Camera/2024"));
+    QVERIFY(QDir(m_root).mkpath(".thumbnails"));
+    touch(m_root + "/a.jpg");
+    touch(m_root + "/B.JPEG");
+    touch(m_root + "/notes.txt");
+    touch(m_root + "/.hidden.jpg");
+    touch(m_root + "/.thumbnails/t.jpg");
+    touch(m_root + "/Camera/c.png");
+    touch(m_root + "/Camera/2024/d.gif");
+    for (const QString &dir : { QString("/Camera/2024"), QString("/Camera"),
+                                QString("/.thumbnails"), QString() }) {
+        age(m_root + dir);
+    }
+}
+
+void TstGalleryWalker::findsImagesLikeQDirDid()
+{
+    GalleryWalker walker;
+    const QStringList files = walker.walk(m_root, true);
+    QCOMPARE(relative(m_root, files),
+             (QStringList{ "a.jpg", "B.JPEG", "Camera/c.png", "Camera/2024/d.gif" }));
+    QCOMPARE(walker.dirsListed(), 3);
+    QCOMPARE(walker.dirsCached(), 0);
+}
+
+void TstGalleryWalker::nonRecursiveStaysInTheFolder()
+{
+    GalleryWalker walker;
+    QCOMPARE(relative(m_root, walker.walk(m_root, false)), (QStringList{ "a.jpg", "B.JPEG" }));
+}
+
+void TstGalleryWalker::skipsUnreadablePhotos()
+{
+    if (::geteuid() == 0) {
+        QSKIP("root reads everything");
+    }
+    touch(m_root + "/locked.jpg");
+    QVERIFY(QFile::setPermissions(m_root + "/locked.jpg", QFileDevice::WriteOwner));
+
+    GalleryWalker walker;
+    QCOMPARE(relative(m_root, walker.walk(m_root, false)), (QStringList{ "a.jpg", "B.JPEG" }));
+}
+
+void TstGalleryWalker::rereadsOnlyChangedFolders()
+{
+    GalleryWalker first;
+    const QStringList before = first.walk(m_root, true);
+    QCOMPARE(first.fresh().size(), 3);
+
+    touch(m_root + "/Camera/e.jpg");
+    age(m_root + "/Camera", 1600000000);
+
+    GalleryWalker second(first.fresh());
+    const QStringList after = second.walk(m_root, true);
+    QCOMPARE(second.dirsListed(), 1);
+    QCOMPARE(second.dirsCached(), 2);
+    QCOMPARE(after.size(), before.size() + 1);
+    QVERIFY(after.contains(m_root + "/Camera/e.jpg"));
+    QVERIFY(second.fresh().contains(m_root + "/Camera"));
+}
+
+void TstGalleryWalker::reportsFoldersThatAreGone()
+{
+    GalleryWalker first;
+    first.walk(m_root, true);
+
+    QVERIFY(QDir(m_root + "/Camera/2024").removeRecursively());
+    age(m_root + "/Camera", 1600000000);
+
+    GalleryWalker second(first.fresh());
+    second.walk(m_root, true);
+    QCOMPARE(second.gone({ m_root }), QStringList{ m_root + "/Camera/2024" });
+    QVERIFY(second.gone({ m_root + "/Elsewhere" }).isEmpty());
+}
+
+void TstGalleryWalker::doesNotCacheFoldersChangedJustNow()
+{
+    touch(m_root + "/Camera/new.jpg");  // Camera's mtime is now
+
+    GalleryWalker walker;
+    walker.walk(m_root, true);
+    QCOMPARE(walker.dirsListed(), 3);
+    QVERIFY(!walker.fresh().contains(m_root + "/Camera"));
+    QVERIFY(walker.fresh().contains(m_root + "/Camera/2024"));
+}
+
+void TstGalleryWalker::followsSymlinksOnce()
+{
+    QVERIFY(QFile::link(m_root + "/Camera", m_root + "/Camera/2024/loop"));
+    QVERIFY(QFile::link(m_root + "/Camera", m_root + "/sdcard"));
+    age(m_root + "/Camera/2024");
+    age(m_root);
+
+    GalleryWalker walker;
+    const QStringList files = walker.walk(m_root, true);
+    QCOMPARE(files.filter("c.png").size(), 1);
+    QCOMPARE(files.filter("d.gif").size(), 1);
+}
+
+void TstGalleryWalker::handsOverFolderByFolder()
+{
+    GalleryWalker walker;
+    QStringList folders;
+    const bool complete = walker.walk(m_root, true, [&](const QString &folder, const QStringList &files) {
+        folders.append(folder);
+        for (const QString &file : files) {
+            if (!file.startsWith(folder + '/')) {
+                return false;
+            }
+        }
+        return true;
+    });
+    QVERIFY(complete);
+    QCOMPARE(folders, (QStringList{ m_root, m_root + "/Camera", m_root + "/Camera/2024" }));
+
+    // The visitor can stop the walk; nothing after it is read
+    GalleryWalker stopped;
+    int visits = 0;
+    QVERIFY(!stopped.walk(m_root, true, [&](const QString &, const QStringList &) {
+        return ++visits < 2;
+    }));
+    QCOMPARE(visits, 2);
+    QCOMPARE(stopped.dirsListed(), 2);
+}
+
+QTEST_APPLESS_MAIN(TstGalleryWalker)
+
+#include "tst_gallerywalker.moc"
@@ -0,0 +1,170 @@
+// Tests for the gallery watcher behind background ingestion. What matters
+// is that no new photo goes unreported, and that a burst of shots comes
+// out as one batch rather than one ingestion step per file.
+
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QDir>
+#include <QFile>
+#include <QSet>
+
+#include "gallerywatcher.h"
+
+namespace {
+
+void touch(const QString &path)
+{
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("x");
+}
+
+QSet<QString> reported(const QSignalSpy &spy)
+{
+    QSet<QString> paths;
+    for (const QList<QVariant> &signal : spy) {
+        paths.unite(signal.at(0).toStringList().toSet());
+    }
+    return paths;
+}
+
+const int SETTLE_MS = GalleryWatcher::DEBOUNCE_MS + 3000;
+
+} // namespace
+
+class TstGalleryWatcher : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+
+    void reportsExistingPhotosOnWatch();
+    void burstComesOutOnce();
+    void seesWriteThenRename();
+    void followsNewFolders();
+    void pollsWithoutInotify();
+    void stopsReporting();
+
+private:
+    QScopedPointer<QTemporaryDir> m_dir;
+    QString m_root;
+};
+
+void TstGalleryWatcher::init()
+{
+    m_dir.reset(new QTemporaryDir);
+    QVERIFY(m_dir->isValid());
+    m_root = m_dir->path();
+
+    QVERIFY(QDir(m_root).mkpath("Camera"));
+    touch(m_root + "/a.jpg");
+    touch(m_root + "/Camera/b.jpg");
+}
+
+void TstGalleryWatcher::reportsExistingPhotosOnWatch()
+{
+    GalleryWatcher watcher;
+    QSignalSpy spy(&watcher, &GalleryWatcher::photosChanged);
+    watcher.watch({ m_root }, true);
+    QVERIFY(watcher.isActive());
+
+    // Written before anyone was watching: reported, for the receiver to sort out
+    QVERIFY(spy.wait(SETTLE_MS));
+    QCOMPARE(reported(spy), (QSet<QString>{ m_root + "/a.jpg", m_root + "/Camera/b.jpg" }));
+}
+
+void TstGalleryWatcher::burstComesOutOnce()
+{
+    GalleryWatcher watcher;
+    watcher.watch({ m_root }, true);
+    if (!watcher.usesInotify()) {
+        QSKIP("inotify not available here");
+    }
+    QSignalSpy spy(&watcher, &GalleryWatcher::photosChanged);
+    QVERIFY(spy.wait(SETTLE_MS));
+    spy.clear();
+
+    for (int i = 0; i < 20; i++) {
+        touch(QString("%1/Camera/burst%2.jpg").arg(m_root).arg(i));
+    }
+    touch(m_root + "/Camera/notes.txt");
+
+    QVERIFY(spy.wait(SETTLE_MS));
+    QCOMPARE(spy.count(), 1);
+    const QStringList paths = spy.at(0).at(0).toStringList();
+    QCOMPARE(paths.size(), 20);
+    QCOMPARE(paths.toSet().size(), 20);
+}
+
+void TstGalleryWatcher::seesWriteThenRename()
+{
+    GalleryWatcher watcher;
+    watcher.watch({ m_root }, true);
+    if (!watcher.usesInotify()) {
+        QSKIP("inotify not available here");
+    }
+    QSignalSpy spy(&watcher, &GalleryWatcher::photosChanged);
+    QVERIFY(spy.wait(SETTLE_MS));
+    spy.clear();
+
+    // How most camera apps save: a hidden temporary file, then a rename
+    touch(m_root + "/Camera/.pending.jpg");
+    QVERIFY(QFile::rename(m_root + "/Camera/.pending.jpg", m_root + "/Camera/shot.jpg"));
+
+    QVERIFY(spy.wait(SETTLE_MS));
+    QCOMPARE(reported(spy), (QSet<QString>{ m_root + "/Camera/shot.jpg" }));
+}
+
+void TstGalleryWatcher::followsNewFolders()
+{
+    GalleryWatcher watcher;
+    watcher.watch({ m_root }, true);
+    if (!watcher.usesInotify()) {
+        QSKIP("inotify not available here");
+    }
+    QSignalSpy spy(&watcher, &GalleryWatcher::photosChanged);
+    QVERIFY(spy.wait(SETTLE_MS));
+    spy.clear();
+
+    // The first photo may land before the new folder's watch does
+    QVERIFY(QDir(m_root).mkpath("Trip"));
+    touch(m_root + "/Trip/first.jpg");
+    QVERIFY(spy.wait(SETTLE_MS));
+    QVERIFY(reported(spy).contains(m_root + "/Trip/first.jpg"));
+    spy.clear();
+
+    touch(m_root + "/Trip/second.jpg");
+    QVERIFY(spy.wait(SETTLE_MS));
+    QCOMPARE(reported(spy), (QSet<QString>{ m_root + "/Trip/second.jpg" }));
+}
+
+void TstGalleryWatcher::pollsWithoutInotify()
+{
+    GalleryWatcher watcher(false);
+    QSignalSpy spy(&watcher, &GalleryWatcher::photosChanged);
+    watcher.watch({ m_root }, true);
+    QVERIFY(!watcher.usesInotify());
+    QVERIFY(spy.wait(SETTLE_MS));
+    spy.clear();
+
+    touch(m_root + "/Camera/new.jpg");
+    QVERIFY(spy.wait(GalleryWatcher::CHECK_MS + SETTLE_MS));
+    QCOMPARE(reported(spy), (QSet<QString>{ m_root + "/Camera/new.jpg" }));
+}
+
+void TstGalleryWatcher::stopsReporting()
+{
+    GalleryWatcher watcher;
+    QSignalSpy spy(&watcher, &GalleryWatcher::photosChanged);
+    watcher.watch({ m_root }, true);
+    watcher.stop();
+    QVERIFY(!watcher.isActive());
+
+    touch(m_root + "/late.jpg");
+    QVERIFY(!spy.wait(SETTLE_MS));
+}
+
+QTEST_MAIN(TstGalleryWatcher)
+
+#include "tst_gallerywatcher.moc"
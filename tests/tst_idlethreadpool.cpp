@@ -0,0 +1,69 @@
+// Tests for the idle-priority pool. Linux only: the point is the scheduling
+// policy its threads end up with, and the ones of every other pool.
+
+#include <QtTest>
+#include <QThread>
+#include <sched.h>
+
+#include "idlethreadpool.h"
+
+namespace {
+
+int currentPolicy()
+{
+    return sched_getscheduler(0);
+}
+
+QThread *currentThread()
+{
+    return QThread::currentThread();
+}
+
+} // namespace
+
+class TstIdleThreadPool : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void runsAtIdlePriority();
+    void otherPoolsStayNormal();
+    void keepsItsThreads();
+};
+
+void TstIdleThreadPool::runsAtIdlePriority()
+{
+    IdleThreadPool pool;
+    QCOMPARE(pool.run(currentPolicy).result(), SCHED_IDLE);
+    QCOMPARE(pool.run([]() { return 42; }).result(), 42);
+}
+
+void TstIdleThreadPool::otherPoolsStayNormal()
+{
+    // The scan's two pools: a background task, then a photo on the normal
+    // one, whose thread already existed. A thread made idle stays idle, so
+    // this only holds as long as none of them ever was.
+    QThreadPool normal;
+    normal.setMaxThreadCount(1);
+    IdleThreadPool background;
+
+    QCOMPARE(QtConcurrent::run(&normal, currentPolicy).result(), SCHED_OTHER);
+    QCOMPARE(background.run(currentPolicy).result(), SCHED_IDLE);
+    QCOMPARE(QtConcurrent::run(&normal, currentPolicy).result(), SCHED_OTHER);
+    QCOMPARE(QtConcurrent::run(currentPolicy).result(), SCHED_OTHER);
+}
+
+void TstIdleThreadPool::keepsItsThreads()
+{
+    IdleThreadPool pool;
+    QCOMPARE(pool.maxThreadCount(), 1);
+    QCOMPARE(pool.expiryTimeout(), -1);
+
+    QThread *first = pool.run(currentThread).result();
+    QCOMPARE(pool.run(currentThread).result(), first);
+    QCOMPARE(pool.run(currentPolicy).result(), SCHED_IDLE);
+}
+
+QTEST_APPLESS_MAIN(TstIdleThreadPool)
+
+#include "tst_idlethreadpool.moc"
@@ -0,0 +1,120 @@
+// Tests for the QImage -> BGR cv::Mat conversion every photo goes through
+// before detection. Getting a channel order wrong does not crash anything,
+// it silently feeds the networks blue-tinted faces and degrades every
+// embedding - so this checks the pixels, then measures the copy savings.
+
+#include <QtTest>
+#include <opencv2/imgproc.hpp>
+#include "imageconvert.h"
+
+namespace {
+
+// What the pipeline used to do: two full-frame copies
+cv::Mat legacyConversion(const QImage &image)
+{
+    QImage rgb = image.convertToFormat(QImage::Format_RGB888);
+    cv::Mat rgbMat(rgb.height(), rgb.width(), CV_8UC3,
+                   const_cast<uchar *>(rgb.bits()), rgb.bytesPerLine());
+    cv::Mat bgr;
+    cv::cvtColor(rgbMat, bgr, cv::COLOR_RGB2BGR);
+    return bgr;
+}
+
+// Deterministic, non-uniform content so a channel swap cannot go unnoticed
+QImage makeImage(int width, int height, QImage::Format format)
+{
+    QImage image(width, height, QImage::Format_ARGB32);
+    for (int y = 0; y < height; y++) {
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < width; x++) {
+            line[x] = qRgb((x * 7) & 0xFF, (y * 13) & 0xFF, ((x + y) * 3) & 0xFF);
+        }
+    }
+    return image.convertToFormat(format);
+}
+
+bool sameMat(const cv::Mat &a, const cv::Mat &b)
+{
+    return a.size() == b.size() && a.type() == b.type()
+        && cv::countNonZero(a.reshape(1) != b.reshape(1)) == 0;
+}
+
+} // namespace
+
+class TstImageConvert : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void matchesTheLegacyConversion_data();
+    void matchesTheLegacyConversion();
+    void putsBlueFirst();
+    void honoursPaddedScanlines();
+    void returnsEmptyForANullImage();
+
+    void benchmarkLegacy();
+    void benchmarkDirect();
+};
+
+void TstImageConvert::matchesTheLegacyConversion_data()
+{
+    QTest::addColumn<int>("format");
+    QTest::newRow("RGB32 (JPEG decoder)") << int(QImage::Format_RGB32);
+    QTest::newRow("ARGB32 (PNG decoder)") << int(QImage::Format_ARGB32);
+    QTest::newRow("RGB888") << int(QImage::Format_RGB888);
+    QTest::newRow("Grayscale8") << int(QImage::Format_Grayscale8);
+}
+
+void TstImageConvert::matchesTheLegacyConversion()
+{
+    QFETCH(int, format);
+    const QImage image = makeImage(97, 61, QImage::Format(format));
+
+    const cv::Mat mat = qImageToBgrMat(image);
+    QCOMPARE(mat.type(), CV_8UC3);
+    QVERIFY(sameMat(mat, legacyConversion(image)));
+}
+
+void TstImageConvert::putsBlueFirst()
+{
+    QImage image(1, 1, QImage::Format_RGB32);
+    image.setPixel(0, 0, qRgb(10, 20, 30));
+
+    const cv::Vec3b pixel = qImageToBgrMat(image).at<cv::Vec3b>(0, 0);
+    QCOMPARE(int(pixel[0]), 30);
+    QCOMPARE(int(pixel[1]), 20);
+    QCOMPARE(int(pixel[2]), 10);
+}
+
+void TstImageConvert::honoursPaddedScanlines()
+{
+    // RGB888 rows are padded to 4 bytes; an odd width exposes a wrong stride
+    const QImage image = makeImage(33, 5, QImage::Format_RGB888);
+    QVERIFY(image.bytesPerLine() != image.width() * 3);
+    QVERIFY(sameMat(qImageToBgrMat(image), legacyConversion(image)));
+}
+
+void TstImageConvert::returnsEmptyForANullImage()
+{
+    QVERIFY(qImageToBgrMat(QImage()).empty());
+}
+
+// A 12 MP photo as the JPEG decoder returns it; compare the two timings
+void TstImageConvert::benchmarkLegacy()
+{
+    const QImage image = makeImage(4000, 3000, QImage::Format_RGB32);
+    QBENCHMARK {
+        legacyConversion(image);
+    }
+}
+
+void TstImageConvert::benchmarkDirect()
+{
+    const QImage image = makeImage(4000, 3000, QImage::Format_RGB32);
+    QBENCHMARK {
+        qImageToBgrMat(image);
+    }
+}
+
+QTEST_MAIN(TstImageConvert)
+#include "tst_imageconvert.moc"
@@ -0,0 +1,71 @@
+// Tests for the model registry behind the FP32/INT8 choice. Asking for a
+// variant that is not installed must fall back to one that is, never leave
+// the app with no model to load.
+
+#include <QtTest>
+#include <QFile>
+#include <QTemporaryDir>
+
+#include "modelregistry.h"
+
+class TstModelRegistry : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void namesFollowOpenCvZoo();
+    void idsAreStable();
+    void fallsBackToFp32();
+};
+
+void TstModelRegistry::namesFollowOpenCvZoo()
+{
+    QCOMPARE(ModelRegistry::fileName(ModelRegistry::Detector, ModelRegistry::Fp32),
+             QString("face_detection_yunet_2023mar.onnx"));
+    QCOMPARE(ModelRegistry::fileName(ModelRegistry::Detector, ModelRegistry::Int8),
+             QString("face_detection_yunet_2023mar_int8.onnx"));
+    QCOMPARE(ModelRegistry::fileName(ModelRegistry::Recognizer, ModelRegistry::Fp32),
+             QString("face_recognition_sface_2021dec.onnx"));
+    QCOMPARE(ModelRegistry::fileName(ModelRegistry::Recognizer, ModelRegistry::Int8),
+             QString("face_recognition_sface_2021dec_int8.onnx"));
+
+    const ModelRegistry registry("/usr/share/harbour-nami/models");
+    QCOMPARE(registry.path(ModelRegistry::Recognizer, ModelRegistry::Int8),
+             QString("/usr/share/harbour-nami/models/face_recognition_sface_2021dec_int8.onnx"));
+}
+
+void TstModelRegistry::idsAreStable()
+{
+    // Stored with every face: changing them orphans existing libraries
+    QCOMPARE(ModelRegistry::modelId(ModelRegistry::Recognizer, ModelRegistry::Fp32),
+             QString("sface_2021dec_fp32"));
+    QCOMPARE(ModelRegistry::modelId(ModelRegistry::Recognizer, ModelRegistry::Int8),
+             QString("sface_2021dec_int8"));
+    QCOMPARE(ModelRegistry::modelId(ModelRegistry::Detector, ModelRegistry::Int8),
+             QString("yunet_2023mar_int8"));
+
+    QCOMPARE(ModelRegistry::precisionFromString("int8"), ModelRegistry::Int8);
+    QCOMPARE(ModelRegistry::precisionFromString("fp16"), ModelRegistry::Fp32);
+    QCOMPARE(ModelRegistry::precisionName(ModelRegistry::Int8), QString("int8"));
+}
+
+void TstModelRegistry::fallsBackToFp32()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const ModelRegistry registry(dir.path());
+
+    QFile detector(registry.path(ModelRegistry::Detector, ModelRegistry::Int8));
+    QVERIFY(detector.open(QIODevice::WriteOnly));
+    detector.close();
+
+    QVERIFY(registry.isAvailable(ModelRegistry::Detector, ModelRegistry::Int8));
+    QVERIFY(!registry.isAvailable(ModelRegistry::Recognizer, ModelRegistry::Int8));
+    QCOMPARE(registry.resolve(ModelRegistry::Detector, ModelRegistry::Int8), ModelRegistry::Int8);
+    QCOMPARE(registry.resolve(ModelRegistry::Recognizer, ModelRegistry::Int8), ModelRegistry::Fp32);
+    QCOMPARE(registry.resolve(ModelRegistry::Recognizer, ModelRegistry::Fp32), ModelRegistry::Fp32);
+}
+
+QTEST_APPLESS_MAIN(TstModelRegistry)
+
+#include "tst_modelregistry.moc"
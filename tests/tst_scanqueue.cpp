@@ -0,0 +1,186 @@
+// Tests for the queue between the scan's walk and its extraction workers.
+// A lost wake-up here hangs a scan forever, with the progress ring stuck.
+
+#include <QtTest>
+#include <QThread>
+#include <QAtomicInt>
+
+#include "scanqueue.h"
+
+namespace {
+
+// Pushes count items, as the walk does, then records how many went in
+class Producer : public QThread
+{
+public:
+    Producer(ScanQueue &queue, int count) : m_queue(queue), m_count(count) {}
+
+    QAtomicInt pushed;
+    bool lastPushOk = true;
+
+protected:
+    void run() override
+    {
+        for (int i = 0; i < m_count; i++) {
+            lastPushOk = m_queue.push(ScanItem{QString::number(i), i % 2 == 1});
+            if (!lastPushOk) {
+                return;
+            }
+            pushed.fetchAndAddOrdered(1);
+        }
+    }
+
+private:
+    ScanQueue &m_queue;
+    int m_count;
+};
+
+} // namespace
+
+class TstScanQueue : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void keepsOrderAndFlags();
+    void producerWaitsForRoom();
+    void closeReleasesAWaitingProducer();
+    void resetReopens();
+    void newestFirst();
+    void urgentGoesFirstEvenWhenFull();
+    void promoteMovesQueuedPhotosUp();
+};
+
+void TstScanQueue::keepsOrderAndFlags()
+{
+    ScanQueue queue(8);
+    QVERIFY(queue.push(ScanItem{"a.jpg", false}));
+    QVERIFY(queue.push(ScanItem{"b.jpg", true}));
+    QCOMPARE(queue.size(), 2);
+
+    ScanItem item;
+    QVERIFY(queue.tryPop(item));
+    QCOMPARE(item.filePath, QString("a.jpg"));
+    QVERIFY(!item.changed);
+    QVERIFY(queue.tryPop(item));
+    QCOMPARE(item.filePath, QString("b.jpg"));
+    QVERIFY(item.changed);
+    QVERIFY(!queue.tryPop(item));
+    QVERIFY(queue.isEmpty());
+}
+
+void TstScanQueue::producerWaitsForRoom()
+{
+    ScanQueue queue(4);
+    Producer producer(queue, 100);
+    producer.start();
+
+    // Fills up to the capacity, then has to wait
+    QTRY_COMPARE(producer.pushed.load(), 4);
+    QTest::qWait(50);
+    QCOMPARE(producer.pushed.load(), 4);
+    QCOMPARE(queue.size(), 4);
+
+    // Everything comes through once someone consumes, in order
+    int expected = 0;
+    ScanItem item;
+    while (expected < 100) {
+        if (queue.tryPop(item)) {
+            QCOMPARE(item.filePath, QString::number(expected));
+            QCOMPARE(item.changed, expected % 2 == 1);
+            expected++;
+        } else {
+            QThread::yieldCurrentThread();
+        }
+        QVERIFY(queue.size() <= 4);
+    }
+    QVERIFY(producer.wait(5000));
+    QVERIFY(producer.lastPushOk);
+}
+
+void TstScanQueue::closeReleasesAWaitingProducer()
+{
+    ScanQueue queue(2);
+    Producer producer(queue, 10);
+    producer.start();
+    QTRY_COMPARE(queue.size(), 2);
+
+    queue.close();
+    QVERIFY(producer.wait(5000));
+    QVERIFY(!producer.lastPushOk);
+    QVERIFY(queue.isEmpty());
+    QVERIFY(!queue.push(ScanItem{"late.jpg", false}));
+}
+
+void TstScanQueue::resetReopens()
+{
+    ScanQueue queue(2);
+    queue.close();
+    queue.reset();
+    QVERIFY(queue.push(ScanItem{"a.jpg", false}));
+    QCOMPARE(queue.size(), 1);
+}
+
+void TstScanQueue::newestFirst()
+{
+    ScanQueue queue(8);
+    QVERIFY(queue.push(ScanItem{"old.jpg", false, 1000}));
+    QVERIFY(queue.push(ScanItem{"new.jpg", false, 3000}));
+    QVERIFY(queue.push(ScanItem{"mid.jpg", false, 2000}));
+    QVERIFY(queue.push(ScanItem{"mid2.jpg", false, 2000}));
+
+    QStringList order;
+    ScanItem item;
+    while (queue.tryPop(item)) {
+        order.append(item.filePath);
+    }
+    QCOMPARE(order, (QStringList{ "new.jpg", "mid.jpg", "mid2.jpg", "old.jpg" }));
+}
+
+void TstScanQueue::urgentGoesFirstEvenWhenFull()
+{
+    ScanQueue queue(2);
+    QVERIFY(queue.push(ScanItem{"a.jpg", false, 5000}));
+    QVERIFY(queue.push(ScanItem{"b.jpg", false, 4000}));
+
+    // Called from the main thread: must not wait for room
+    QVERIFY(queue.pushUrgent(ScanItem{"viewed.jpg", true}));
+    QVERIFY(queue.pushUrgent(ScanItem{"viewed-later.jpg", false}));
+    QCOMPARE(queue.size(), 4);
+
+    ScanItem item;
+    QVERIFY(queue.tryPop(item));
+    QCOMPARE(item.filePath, QString("viewed-later.jpg"));
+    QVERIFY(item.isUrgent());
+    QVERIFY(queue.tryPop(item));
+    QCOMPARE(item.filePath, QString("viewed.jpg"));
+    QVERIFY(item.changed);
+    QVERIFY(queue.tryPop(item));
+    QCOMPARE(item.filePath, QString("a.jpg"));
+    QVERIFY(!item.isUrgent());
+
+    queue.close();
+    QVERIFY(!queue.pushUrgent(ScanItem{"late.jpg", false}));
+}
+
+void TstScanQueue::promoteMovesQueuedPhotosUp()
+{
+    ScanQueue queue(8);
+    for (int i = 0; i < 5; i++) {
+        QVERIFY(queue.push(ScanItem{QString("%1.jpg").arg(i), false, 1000 - i}));
+    }
+
+    const QSet<QString> found = queue.promote({ "3.jpg", "missing.jpg" });
+    QCOMPARE(found, QSet<QString>{ "3.jpg" });
+    QCOMPARE(queue.size(), 5);
+
+    ScanItem item;
+    QVERIFY(queue.tryPop(item));
+    QCOMPARE(item.filePath, QString("3.jpg"));
+    QVERIFY(queue.tryPop(item));
+    QCOMPARE(item.filePath, QString("0.jpg"));
+}
+
+QTEST_MAIN(TstScanQueue)
+
+#include "tst_scanqueue.moc"
@@ -0,0 +1,178 @@
+// Tests for the scan throttle. Fed made-up photo times and load, so each
+// case is one story: what the phone did, and what the scan should do next.
+
+#include <QtTest>
+
+#include "scanthrottle.h"
+
+namespace {
+
+// count photos, one every stepMs, each taking extractMs; true if the last
+// one changed the worker or thread count
+bool feed(ScanThrottle &throttle, int count, qint64 extractMs, double load,
+          qint64 stepMs, qint64 &now)
+{
+    bool changed = false;
+    for (int i = 0; i < count; i++) {
+        now += stepMs;
+        changed = throttle.photoDone(extractMs, load, now);
+    }
+    return changed;
+}
+
+} // namespace
+
+class TstScanThrottle : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void profileNames();
+    void profilesStartAtTheirCap();
+    void switchingProfileAppliesAtOnce();
+    void backsOffUnderLoad();
+    void backsOffWhenPhotosSlowDown();
+    void keepsAWorkerThatPays();
+    void undoesAWorkerThatDoesNot();
+};
+
+void TstScanThrottle::profileNames()
+{
+    for (ScanThrottle::Profile profile : { ScanThrottle::Fast, ScanThrottle::Balanced, ScanThrottle::Background }) {
+        QCOMPARE(ScanThrottle::profileFromString(ScanThrottle::profileName(profile)), profile);
+    }
+    QCOMPARE(ScanThrottle::profileFromString("turbo"), ScanThrottle::Balanced);
+    QCOMPARE(ScanThrottle::profileFromString(QString()), ScanThrottle::Balanced);
+}
+
+void TstScanThrottle::profilesStartAtTheirCap()
+{
+    ScanThrottle throttle(8);
+
+    throttle.start(ScanThrottle::Fast, 7, 0);
+    QCOMPARE(throttle.workers(), 7);
+    QCOMPARE(throttle.cvThreads(), 1);
+
+    throttle.start(ScanThrottle::Balanced, 7, 0);
+    QCOMPARE(throttle.workers(), 4);
+    QCOMPARE(throttle.cvThreads(), 1);
+
+    throttle.start(ScanThrottle::Background, 7, 0);
+    QCOMPARE(throttle.workers(), 1);
+    QCOMPARE(throttle.cvThreads(), 1);
+
+    // Fewer workers than cores: the spare cores go to OpenCV instead
+    throttle.start(ScanThrottle::Fast, 2, 0);
+    QCOMPARE(throttle.workers(), 2);
+    QCOMPARE(throttle.cvThreads(), 4);
+    throttle.start(ScanThrottle::Balanced, 2, 0);
+    QCOMPARE(throttle.cvThreads(), 3);
+
+    // A single core still gets a worker
+    ScanThrottle single(1);
+    single.start(ScanThrottle::Fast, 1, 0);
+    QCOMPARE(single.workers(), 1);
+    QCOMPARE(single.cvThreads(), 1);
+}
+
+void TstScanThrottle::switchingProfileAppliesAtOnce()
+{
+    ScanThrottle throttle(8);
+    throttle.start(ScanThrottle::Fast, 7, 0);
+    throttle.setProfile(ScanThrottle::Background, 1000);
+    QCOMPARE(throttle.profile(), ScanThrottle::Background);
+    QCOMPARE(throttle.workers(), 1);
+    throttle.setProfile(ScanThrottle::Balanced, 2000);
+    QCOMPARE(throttle.workers(), 4);
+}
+
+void TstScanThrottle::backsOffUnderLoad()
+{
+    ScanThrottle throttle(8);
+    qint64 now = 0;
+    throttle.start(ScanThrottle::Balanced, 7, now);
+
+    // Nothing decided before a window is full
+    QVERIFY(!feed(throttle, ScanThrottle::WINDOW_PHOTOS - 1, 100, 12, 500, now));
+    QCOMPARE(throttle.workers(), 4);
+
+    // Something else wants the CPUs too
+    QVERIFY(feed(throttle, 1, 100, 12, 500, now));
+    QCOMPARE(throttle.workers(), 3);
+    QVERIFY(feed(throttle, ScanThrottle::WINDOW_PHOTOS, 100, 12, 500, now));
+    QCOMPARE(throttle.workers(), 2);
+
+    // Never below one
+    for (int i = 0; i < 5; i++) {
+        feed(throttle, ScanThrottle::WINDOW_PHOTOS, 100, 12, 500, now);
+    }
+    QCOMPARE(throttle.workers(), 1);
+}
+
+void TstScanThrottle::backsOffWhenPhotosSlowDown()
+{
+    ScanThrottle throttle(4);
+    qint64 now = 0;
+    throttle.start(ScanThrottle::Fast, 3, now);
+    QCOMPARE(throttle.workers(), 3);
+
+    QVERIFY(!feed(throttle, ScanThrottle::WINDOW_PHOTOS, 100, 2, 500, now));
+
+    // One slow window may be a big photo or two; the second is the SoC
+    QVERIFY(!feed(throttle, ScanThrottle::WINDOW_PHOTOS, 140, 2, 500, now));
+    QCOMPARE(throttle.workers(), 3);
+    QVERIFY(feed(throttle, ScanThrottle::WINDOW_PHOTOS, 140, 2, 500, now));
+    QCOMPARE(throttle.workers(), 2);
+}
+
+void TstScanThrottle::keepsAWorkerThatPays()
+{
+    ScanThrottle throttle(8);
+    qint64 now = 0;
+    throttle.start(ScanThrottle::Balanced, 7, now);
+
+    // Down to three under load, then the load goes away: a worker is
+    // added again, but not before HOLD_MS
+    QVERIFY(feed(throttle, ScanThrottle::WINDOW_PHOTOS, 100, 12, 500, now));
+    QCOMPARE(throttle.workers(), 3);
+    const qint64 changedAt = now;
+    while (now < changedAt + ScanThrottle::HOLD_MS - 4000) {
+        QVERIFY(!feed(throttle, ScanThrottle::WINDOW_PHOTOS, 100, 2, 500, now));
+    }
+    QVERIFY(feed(throttle, ScanThrottle::WINDOW_PHOTOS, 100, 2, 500, now));
+    QCOMPARE(throttle.workers(), 4);
+
+    // 2.5 photos/s against 2: kept
+    QVERIFY(!feed(throttle, ScanThrottle::WINDOW_PHOTOS, 100, 2, 400, now));
+    QCOMPARE(throttle.workers(), 4);
+}
+
+void TstScanThrottle::undoesAWorkerThatDoesNot()
+{
+    ScanThrottle throttle(8);
+    qint64 now = 0;
+    throttle.start(ScanThrottle::Balanced, 7, now);
+
+    QVERIFY(feed(throttle, ScanThrottle::WINDOW_PHOTOS, 100, 12, 500, now));
+    while (throttle.workers() == 3) {
+        feed(throttle, ScanThrottle::WINDOW_PHOTOS, 100, 2, 500, now);
+    }
+    QCOMPARE(throttle.workers(), 4);
+
+    // Same 2 photos/s with the extra worker: memory-bound, it goes again
+    QVERIFY(feed(throttle, ScanThrottle::WINDOW_PHOTOS, 100, 2, 500, now));
+    QCOMPARE(throttle.workers(), 3);
+
+    // ...and is not tried again for BACKOFF_MS
+    const qint64 undoneAt = now;
+    while (now < undoneAt + ScanThrottle::BACKOFF_MS - 4000) {
+        QVERIFY(!feed(throttle, ScanThrottle::WINDOW_PHOTOS, 100, 2, 500, now));
+    }
+    QCOMPARE(throttle.workers(), 3);
+    QVERIFY(feed(throttle, ScanThrottle::WINDOW_PHOTOS, 100, 2, 500, now));
+    QCOMPARE(throttle.workers(), 4);
+}
+
+QTEST_APPLESS_MAIN(TstScanThrottle)
+
+#include "tst_scanthrottle.moc"
@@ -0,0 +1,227 @@
+// Tests for the exemplar matrix and the SIMD dot products behind every
+// face match and suggestion. A kernel that drops a tail element or reads a
+// padded row wrong still returns plausible numbers, just the wrong person -
+// so each path is checked against the plain loop, then benchmarked.
+
+#include <QtTest>
+#include <QPair>
+#include <cmath>
+
+#include "embeddingmatrix.h"
+
+namespace {
+
+FaceEmbedding unitVector(int dim, quint32 seed)
+{
+    // Small LCG: deterministic without pulling in <random>
+    FaceEmbedding v(dim);
+    float norm = 0.0f;
+    for (int i = 0; i < dim; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        v[i] = static_cast<float>(seed >> 8) / (1 << 24) - 0.5f;
+        norm += v[i] * v[i];
+    }
+    for (float &x : v) {
+        x /= std::sqrt(norm);
+    }
+    return v;
+}
+
+float similarity(const FaceEmbedding &a, const FaceEmbedding &b)
+{
+    return (EmbeddingMath::dotScalar(a.data(), b.data(), static_cast<int>(a.size())) + 1.0f) / 2.0f;
+}
+
+// The layout the pipeline used before the matrix
+typedef QVector<QPair<int, QVector<FaceEmbedding>>> NestedExemplars;
+
+NestedExemplars makePeople(int people, int exemplarsEach)
+{
+    NestedExemplars nested;
+    for (int p = 0; p < people; p++) {
+        QVector<FaceEmbedding> exemplars;
+        for (int e = 0; e < exemplarsEach; e++) {
+            exemplars.append(unitVector(128, p * 100 + e + 1));
+        }
+        nested.append(qMakePair(p + 1, exemplars));
+    }
+    return nested;
+}
+
+} // namespace
+
+class TstSimilarity : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void dotMatchesTheScalarLoopForEveryLength();
+    void bestMatchMatchesTheNestedScan();
+    void replacingAPersonKeepsEveryoneInPlace();
+    void emptyExemplarsRemoveAPerson();
+    void skipsEmbeddingsOfAnotherDimension();
+    void oddDimensionsArePadded();
+
+    void benchmarkNestedScalar();
+    void benchmarkMatrix();
+};
+
+void TstSimilarity::dotMatchesTheScalarLoopForEveryLength()
+{
+    qDebug() << "dot kernel:" << EmbeddingMath::kernelName();
+
+    // Every length up to a few vectors wide, so each tail size is hit
+    for (int n = 0; n <= 70; n++) {
+        const FaceEmbedding a = unitVector(qMax(n, 1), n + 7);
+        const FaceEmbedding b = unitVector(qMax(n, 1), n + 1000);
+        const float simd = EmbeddingMath::dot(a.data(), b.data(), n);
+        const float scalar = EmbeddingMath::dotScalar(a.data(), b.data(), n);
+        QVERIFY2(std::fabs(simd - scalar) < 1e-5f, qPrintable(QString("length %1").arg(n)));
+    }
+}
+
+void TstSimilarity::bestMatchMatchesTheNestedScan()
+{
+    const NestedExemplars nested = makePeople(40, 5);
+    EmbeddingMatrix matrix;
+    for (const auto &entry : nested) {
+        matrix.setPerson(entry.first, entry.second);
+    }
+    QCOMPARE(matrix.personCount(), 40);
+    QCOMPARE(matrix.rowCount(), 200);
+
+    for (quint32 q = 0; q < 20; q++) {
+        const FaceEmbedding query = unitVector(128, 5000 + q);
+
+        int bestPerson = -1;
+        float bestScore = 0.0f;
+        QVector<float> perPerson;
+        for (const auto &entry : nested) {
+            float personBest = 0.0f;
+            for (const FaceEmbedding &exemplar : entry.second) {
+                const float s = similarity(query, exemplar);
+                personBest = qMax(personBest, s);
+                if (s > bestScore) {
+                    bestScore = s;
+                    bestPerson = entry.first;
+                }
+            }
+            perPerson.append(personBest);
+        }
+
+        const EmbeddingMatrix::PersonScore best = matrix.bestMatch(query);
+        QCOMPARE(best.personId, bestPerson);
+        QVERIFY(std::fabs(best.similarity - bestScore) < 1e-5f);
+
+        const QVector<EmbeddingMatrix::PersonScore> scores = matrix.bestPerPerson(query);
+        QCOMPARE(scores.size(), nested.size());
+        for (int i = 0; i < scores.size(); i++) {
+            QCOMPARE(scores[i].personId, nested[i].first);
+            QVERIFY(std::fabs(scores[i].similarity - perPerson[i]) < 1e-5f);
+        }
+    }
+}
+
+// Suggestions break ties by cache order, so identifying someone must not
+// move them (or anyone after them) around
+void TstSimilarity::replacingAPersonKeepsEveryoneInPlace()
+{
+    EmbeddingMatrix matrix;
+    matrix.setPerson(1, { unitVector(128, 1) });
+    matrix.setPerson(2, { unitVector(128, 2) });
+    matrix.setPerson(3, { unitVector(128, 3), unitVector(128, 4) });
+
+    const FaceEmbedding grown = unitVector(128, 20);
+    matrix.setPerson(2, { unitVector(128, 21), grown, unitVector(128, 22) });
+    QCOMPARE(matrix.rowCount(), 6);
+
+    const QVector<EmbeddingMatrix::PersonScore> scores = matrix.bestPerPerson(grown);
+    QCOMPARE(scores.size(), 3);
+    QCOMPARE(scores[0].personId, 1);
+    QCOMPARE(scores[1].personId, 2);
+    QCOMPARE(scores[2].personId, 3);
+    QVERIFY(std::fabs(scores[1].similarity - 1.0f) < 1e-5f);
+
+    // Person 3's rows moved with the gap: still scored against their own
+    const FaceEmbedding third = unitVector(128, 4);
+    QCOMPARE(matrix.bestMatch(third).personId, 3);
+
+    matrix.setPerson(2, { grown });
+    QCOMPARE(matrix.rowCount(), 4);
+    QCOMPARE(matrix.bestMatch(third).personId, 3);
+    QCOMPARE(matrix.bestMatch(grown).personId, 2);
+}
+
+void TstSimilarity::emptyExemplarsRemoveAPerson()
+{
+    EmbeddingMatrix matrix;
+    matrix.setPerson(1, { unitVector(128, 1) });
+    matrix.setPerson(2, { unitVector(128, 2) });
+
+    matrix.setPerson(1, QVector<FaceEmbedding>());
+    QCOMPARE(matrix.personCount(), 1);
+    QCOMPARE(matrix.bestMatch(unitVector(128, 1)).personId, 2);
+
+    matrix.setPerson(2, QVector<FaceEmbedding>());
+    QVERIFY(matrix.isEmpty());
+    QCOMPARE(matrix.bestMatch(unitVector(128, 1)).personId, -1);
+}
+
+void TstSimilarity::skipsEmbeddingsOfAnotherDimension()
+{
+    EmbeddingMatrix matrix;
+    matrix.setPerson(1, { unitVector(128, 1), unitVector(64, 2) });
+    QCOMPARE(matrix.dimension(), 128);
+    QCOMPARE(matrix.rowCount(), 1);
+
+    // A query of the wrong size matches no one rather than reading past it
+    QCOMPARE(matrix.bestMatch(unitVector(64, 2)).personId, -1);
+}
+
+void TstSimilarity::oddDimensionsArePadded()
+{
+    EmbeddingMatrix matrix;
+    const FaceEmbedding a = unitVector(37, 1);
+    const FaceEmbedding b = unitVector(37, 2);
+    matrix.setPerson(1, { a });
+    matrix.setPerson(2, { b });
+
+    const EmbeddingMatrix::PersonScore best = matrix.bestMatch(b);
+    QCOMPARE(best.personId, 2);
+    QVERIFY(std::fabs(best.similarity - 1.0f) < 1e-5f);
+    QVERIFY(std::fabs(matrix.bestPerPerson(b)[0].similarity - similarity(a, b)) < 1e-5f);
+}
+
+// A large library: 500 people x 5 exemplars, one query. Compare the two.
+void TstSimilarity::benchmarkNestedScalar()
+{
+    const NestedExemplars nested = makePeople(500, 5);
+    const FaceEmbedding query = unitVector(128, 99999);
+
+    QBENCHMARK {
+        float best = 0.0f;
+        for (const auto &entry : nested) {
+            for (const FaceEmbedding &exemplar : entry.second) {
+                best = qMax(best, similarity(query, exemplar));
+            }
+        }
+        QVERIFY(best > 0.0f);
+    }
+}
+
+void TstSimilarity::benchmarkMatrix()
+{
+    const NestedExemplars nested = makePeople(500, 5);
+    EmbeddingMatrix matrix;
+    for (const auto &entry : nested) {
+        matrix.setPerson(entry.first, entry.second);
+    }
+    const FaceEmbedding query = unitVector(128, 99999);
+
+    QBENCHMARK {
+        QVERIFY(matrix.bestMatch(query).similarity > 0.0f);
+    }
+}
+
+QTEST_MAIN(TstSimilarity)
+#include "tst_similarity.moc"
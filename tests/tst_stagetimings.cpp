@@ -0,0 +1,91 @@
+// Tests for the per-stage scan timings behind getScanStats(). The numbers
+// are only useful if p95 means p95, and if an old slow patch ages out of
+// the window instead of haunting the rest of the scan.
+
+#include <QtTest>
+
+#include "stagetimings.h"
+
+class TstStageTimings : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void emptyStage();
+    void percentiles();
+    void windowRollsTotalsDoNot();
+    void variantMap();
+};
+
+void TstStageTimings::emptyStage()
+{
+    StageTimings timings;
+    const StageTimings::Summary summary = timings.summary(StageTimings::Detect);
+    QCOMPARE(summary.count, 0);
+    QCOMPARE(summary.totalUs, qint64(0));
+    QCOMPARE(summary.p50Us, qint64(0));
+    QCOMPARE(summary.maxUs, qint64(0));
+}
+
+void TstStageTimings::percentiles()
+{
+    StageTimings timings;
+    // 100..1, out of order
+    for (int i = 100; i >= 1; i--) {
+        timings.add(StageTimings::Embed, i * 1000);
+    }
+    timings.add(StageTimings::Hash, 7);
+
+    const StageTimings::Summary embed = timings.summary(StageTimings::Embed);
+    QCOMPARE(embed.count, 100);
+    QCOMPARE(embed.totalUs, qint64(5050 * 1000));
+    QCOMPARE(embed.p50Us, qint64(50 * 1000));
+    QCOMPARE(embed.p95Us, qint64(95 * 1000));
+    QCOMPARE(embed.maxUs, qint64(100 * 1000));
+
+    // Stages do not mix
+    QCOMPARE(timings.summary(StageTimings::Hash).count, 1);
+    QCOMPARE(timings.summary(StageTimings::Hash).maxUs, qint64(7));
+}
+
+void TstStageTimings::windowRollsTotalsDoNot()
+{
+    StageTimings timings;
+    // A slow start (cold caches, a throttled SoC), then a long fast stretch
+    for (int i = 0; i < StageTimings::WINDOW; i++) {
+        timings.add(StageTimings::Detect, 900);
+    }
+    for (int i = 0; i < StageTimings::WINDOW; i++) {
+        timings.add(StageTimings::Detect, 100);
+    }
+
+    const StageTimings::Summary detect = timings.summary(StageTimings::Detect);
+    QCOMPARE(detect.count, 2 * StageTimings::WINDOW);
+    QCOMPARE(detect.totalUs, qint64(StageTimings::WINDOW) * 1000);
+    QCOMPARE(detect.maxUs, qint64(100));
+
+    timings.clear();
+    QCOMPARE(timings.summary(StageTimings::Detect).count, 0);
+}
+
+void TstStageTimings::variantMap()
+{
+    StageTimings timings;
+    timings.add(StageTimings::Commit, 1500);
+
+    const QVariantMap map = timings.toVariantMap();
+    QCOMPARE(map.size(), int(StageTimings::StageCount));
+    for (int i = 0; i < StageTimings::StageCount; i++) {
+        QVERIFY(map.contains(StageTimings::stageName(static_cast<StageTimings::Stage>(i))));
+    }
+
+    const QVariantMap commit = map.value("commit").toMap();
+    QCOMPARE(commit.value("count").toInt(), 1);
+    QCOMPARE(commit.value("total_ms").toDouble(), 1.5);
+    QCOMPARE(commit.value("p95_ms").toDouble(), 1.5);
+    QCOMPARE(map.value("read").toMap().value("count").toInt(), 0);
+}
+
+QTEST_APPLESS_MAIN(TstStageTimings)
+
+#include "tst_stagetimings.moc"
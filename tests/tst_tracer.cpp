@@ -0,0 +1,140 @@
+// Tests for the trace_event writer. A trace that Perfetto refuses to load
+// is worth nothing, and one that mixes up threads is worse than nothing.
+
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QThread>
+
+#include "tracer.h"
+
+namespace {
+
+void tracedWork()
+{
+    TRACE_FUNCTION("test");
+    QThread::usleep(200);
+}
+
+QJsonArray readTrace(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QJsonArray();
+    }
+    QJsonParseError error;
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+    return error.error == QJsonParseError::NoError ? document.array() : QJsonArray();
+}
+
+class TracedThread : public QThread
+{
+protected:
+    void run() override { tracedWork(); }
+};
+
+} // namespace
+
+class TstTracer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void offRecordsNothing();
+    void spansCarryTheirThread();
+    void stopWithASpanOpen();
+
+private:
+    QScopedPointer<QTemporaryDir> m_dir;
+};
+
+void TstTracer::init()
+{
+    m_dir.reset(new QTemporaryDir);
+    QVERIFY(m_dir->isValid());
+}
+
+void TstTracer::cleanup()
+{
+    Tracer::stop();
+}
+
+void TstTracer::offRecordsNothing()
+{
+    QVERIFY(!Tracer::isEnabled());
+    tracedWork();
+    QVERIFY(Tracer::filePath().isEmpty());
+
+    // Started, then stopped: the span after stop() is not in the file
+    const QString path = m_dir->path() + "/off.json";
+    QVERIFY(Tracer::start(path));
+    Tracer::stop();
+    tracedWork();
+    QCOMPARE(readTrace(path).size(), 0);
+}
+
+void TstTracer::spansCarryTheirThread()
+{
+    const QString path = m_dir->path() + "/trace.json";
+    QVERIFY(Tracer::start(path));
+    QVERIFY(Tracer::isEnabled());
+    QCOMPARE(Tracer::filePath(), path);
+
+    tracedWork();
+    TracedThread thread;
+    thread.setObjectName("helper");
+    thread.start();
+    QVERIFY(thread.wait(5000));
+    tracedWork();
+    Tracer::stop();
+
+    QSet<qint64> spanThreads;
+    QHash<qint64, QString> names;
+    int spans = 0;
+    for (const QJsonValue &value : readTrace(path)) {
+        const QJsonObject event = value.toObject();
+        const qint64 tid = static_cast<qint64>(event.value("tid").toDouble());
+        if (event.value("ph").toString() == "M") {
+            QVERIFY(!names.contains(tid));  // once per thread
+            names.insert(tid, event.value("args").toObject().value("name").toString());
+            continue;
+        }
+        QCOMPARE(event.value("ph").toString(), QString("X"));
+        QCOMPARE(event.value("name").toString(), QString("tracedWork"));
+        QCOMPARE(event.value("cat").toString(), QString("test"));
+        QVERIFY(event.value("dur").toDouble() >= 200);
+        QVERIFY(names.contains(tid));  // named before its first span
+        spanThreads.insert(tid);
+        spans++;
+    }
+
+    QCOMPARE(spans, 3);
+    QCOMPARE(spanThreads.size(), 2);
+    QVERIFY(names.values().contains("helper"));
+}
+
+void TstTracer::stopWithASpanOpen()
+{
+    const QString path = m_dir->path() + "/open.json";
+    QVERIFY(Tracer::start(path));
+    {
+        TRACE_SCOPE("test", "outer");
+        tracedWork();
+        Tracer::stop();
+    }
+
+    // The finished span is kept, the open one dropped, and the file is whole
+    const QJsonArray events = readTrace(path);
+    QCOMPARE(events.size(), 2);
+    QCOMPARE(events.at(1).toObject().value("name").toString(), QString("tracedWork"));
+}
+
+QTEST_GUILESS_MAIN(TstTracer)
+
+#include "tst_tracer.moc"